@@ -4,3 +4,4 @@
 // Aggregate functions
 #include "SOFIE/RFunction_Sum.hxx"
 #include "SOFIE/RFunction_Mean.hxx"
+#include "SOFIE/RFunction_Max.hxx"
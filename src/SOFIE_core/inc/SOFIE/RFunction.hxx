@@ -34,6 +34,7 @@ protected:
     FunctionTarget fTarget;
     GraphType fGraphType;
     std::vector<std::string> fInputTensors;
+    std::vector<ETensorType> fInputTensorTypes;
     std::vector<ROperator*> fAddlOp;  // temporary vector to store pointer that will be moved in a unique_ptr
 
 public:
@@ -52,6 +53,10 @@ public:
     }
     std::string GenerateModel(const std::string& filename, long read_pos = 0, long block_size = -1);
     std::string Generate(const std::vector<std::string>& inputPtrs);
+    // generate the call leaving the output in the session tensor returned by GetOutputTensorPtr (no copy).
+    // The session object can be given when it is not the default one (e.g. one session per thread)
+    std::string GenerateNoCopy(const std::vector<std::string>& inputPtrs, const std::string& session = "");
+    std::string GetOutputTensorPtr(const std::string& session = "");
     FunctionTarget GetFunctionTarget() {
         return fTarget;
     }
@@ -66,7 +71,6 @@ public:
     RFunction_Aggregate(FunctionReducer reducer): fReducer(reducer) {
         fType = FunctionType::AGGREGATE;
     }
-    virtual std::string GenerateModel() = 0;
     std::string GetFunctionName() {
         return fFuncName;
     }
@@ -75,6 +79,10 @@ public:
     }
     std::string Generate(std::size_t num_features, const std::vector<std::string>& inputTensors);
     std::string Generate(std::size_t num_features, const std::string & inputTensors);
+    // call of the segment reduction (SOFIE::UTILITY::Segment{Sum,Mean,Max}) of the rows of inputData
+    // grouped by the CSR offsets/index, writing nSegments rows in output
+    std::string GenerateSegmentReduce(std::size_t num_features, const std::string & inputData, const std::string & offsets,
+                                      const std::string & index, const std::string & nSegments, const std::string & output);
 
 };
 
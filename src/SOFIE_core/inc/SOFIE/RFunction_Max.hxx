@@ -0,0 +1,18 @@
+#ifndef SOFIE_RFUNCTION_MAX
+#define SOFIE_RFUNCTION_MAX
+
+#include "SOFIE/RFunction.hxx"
+
+namespace SOFIE {
+
+class RFunction_Max: public RFunction_Aggregate {
+
+public:
+    RFunction_Max():RFunction_Aggregate(FunctionReducer::MAX) {
+        fFuncName = "Aggregate_by_Max";
+    }
+};
+
+} //SOFIE
+
+#endif //SOFIE_RFUNCTION_MAX
@@ -0,0 +1,98 @@
+#ifndef SOFIE_RINTERPRETER
+#define SOFIE_RINTERPRETER
+
+#include "SOFIE/RModel.hxx"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SOFIE {
+
+/// Reference interpreter running the operators of a model directly (see ROperator::Execute), without generating
+/// and compiling code, e.g. for validating the generated code or for running a model quickly after parsing.
+/// The intermediate tensors are placed in an arena following the same memory plan as in the generated Session.
+/// The tensors outside of the plan (dynamic tensors, or tensors larger at run time than their planned size)
+/// have their own buffers. The shapes of the inputs with parametric dimensions are given at each run.
+/// Only the operators implementing Execute are supported, an exception is thrown for the other ones.
+/// The interpreter is available only when SOFIE is built with BLAS (SOFIE_USE_BLAS defined).
+class RInterpreter {
+
+public:
+   struct Tensor {
+      ETensorType type = ETensorType::UNDEFINED;
+      std::vector<size_t> shape;
+      void *data = nullptr;
+   };
+
+private:
+   RModel &fModel;
+   bool fVerbose = false;
+
+   std::vector<char> fArena;                                      // memory of the planned intermediate tensors
+   std::map<std::string, std::pair<size_t, size_t>> fArenaChunks; // offset and size in the arena of the planned tensors
+   std::unordered_map<std::string, std::vector<char>> fBuffers;   // memory of the tensors outside of the arena
+   std::unordered_map<std::string, Tensor> fTensors;              // tensors of the current run
+
+   void PlanMemory();
+
+   // interpreter of single operators used by RModel for constant folding, the model is not initialized
+   // and all the tensors have their own buffers
+   friend class RModel;
+   struct NoPlan {};
+   RInterpreter(RModel &model, NoPlan) : fModel(model) {}
+
+public:
+   // the model is initialized for the given batch size (or input parameters) if it is not yet initialized
+   RInterpreter(RModel &model, int batchSize = -1, bool verbose = false);
+   RInterpreter(RModel &model, const std::map<std::string, size_t> &inputParams, bool verbose = false);
+
+   RModel &GetModel() { return fModel; }
+   size_t GetArenaSize() const { return fArena.size(); }
+
+   // run the model on the given inputs (in the order of the model inputs). The shapes are needed only for the
+   // inputs with parametric dimensions, an empty shape is used for the inputs with a defined shape
+   void Run(const std::vector<const void *> &inputs, const std::vector<std::vector<size_t>> &inputShapes = {});
+
+   // run the model and return the outputs (all of type T)
+   template <typename T>
+   std::vector<std::vector<T>> Infer(const std::vector<const void *> &inputs,
+                                     const std::vector<std::vector<size_t>> &inputShapes = {})
+   {
+      Run(inputs, inputShapes);
+      std::vector<std::vector<T>> outputs;
+      for (auto &name : fModel.GetOutputTensorNames()) {
+         const T *data = GetData<T>(name);
+         outputs.emplace_back(data, data + ConvertShapeToLength(GetTensor(name).shape));
+      }
+      return outputs;
+   }
+
+   // tensors used by the operators: inputs and outputs of the operators already run, and initialized tensors
+   bool HasTensor(const std::string &name) const;
+   const Tensor &GetTensor(const std::string &name);
+
+   template <typename T>
+   T *GetData(const std::string &name)
+   {
+      auto &t = GetTensor(name);
+      if (t.type != GetTemplatedType<T>(T()))
+         throw std::runtime_error("TMVA-SOFIE: tensor " + name + " has type " + ConvertTypeToString(t.type) +
+                                  " and not " + TensorType<T>::Name());
+      return static_cast<T *>(t.data);
+   }
+
+   // allocate an output (or temporary) tensor of an operator, in the arena if it is planned there
+   void *AllocateTensor(const std::string &name, ETensorType type, const std::vector<size_t> &shape);
+
+   template <typename T>
+   T *AllocateTensor(const std::string &name, const std::vector<size_t> &shape)
+   {
+      return static_cast<T *>(AllocateTensor(name, GetTemplatedType<T>(T()), shape));
+   }
+};
+
+} // namespace SOFIE
+
+#endif // SOFIE_RINTERPRETER
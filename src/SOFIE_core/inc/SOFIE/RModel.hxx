@@ -5,6 +5,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 
+#include <functional>
 
 namespace SOFIE {
 
@@ -12,6 +13,7 @@ class RModel final : public RModel_Base {
 
 private:
    bool fIsInitialized = false;
+   bool fIsBlockedLayoutAssigned = false;
    bool fIsSubGraph = false;
    int fVerbose = 0;
    int fBatchSize = -1;
@@ -30,13 +32,19 @@ private:
    std::vector<std::unique_ptr<ROperator>> fOperators;
 
    std::vector<std::shared_ptr<RModel>> fSubGraphs;    ///<!  sub-graph models (transient)
+   std::vector<std::shared_ptr<RModel>> fBatchSpecializations;    ///<!  models initialized for fixed batch sizes (transient)
+   std::function<RModel()> fModelSource;    ///<!  function parsing again the model, for creating the specializations (transient)
    RModel * fParentGraph = nullptr;
 
    const std::string SP = "   ";
 
+   // the compiler generates the model with its own options and restores the ones of the user
+   friend class RModelCompiler;
+
    // memory pool information for intermediate tensors
    MemoryPoolInfo fIntermediateMemoryInfo;    ///<!  intermediate memory info (transient)
    std::unordered_map<std::string_view, size_t> fIntermediateTensorFrequencyLookup;    ///<!  lookup table for intermediate tensor frequency (transient)
+   std::vector<std::string> fOptimizationReport;    ///<!  operators and tensors removed by the graph optimizations (transient)
 
 public:
    // Rule of five: explicitly define move semantics, disallow copy
@@ -141,6 +149,18 @@ public:
    {
       Generate(static_cast<std::underlying_type_t<Options>>(options), batchSize, pos, verbose);
    }
+   // generate an infer function specialized for each of the given batch sizes, in addition to the one for a
+   // dynamic batch size (given as -1 in the list, always generated) used for the other sizes. The Session
+   // dispatches the calls on the batch size; the specializations share its weights and its memory pool
+   void Generate(std::underlying_type_t<Options> options, const std::vector<int> &batchSizes, long pos = 0,
+                 bool verbose = false);
+   void Generate(Options options, const std::vector<int> &batchSizes, long pos = 0, bool verbose = false)
+   {
+      Generate(static_cast<std::underlying_type_t<Options>>(options), batchSizes, pos, verbose);
+   }
+   // set the function parsing again the model (e.g. from its ONNX file), needed to generate the specializations
+   // for fixed batch sizes since a model can be initialized only once
+   void SetModelSource(std::function<RModel()> source) { fModelSource = std::move(source); }
    // generate the infer function signature. If isdecl= false generate the calling infer function
    // used to infer the sub-graphs
    std::string GenerateInferSignature(bool isdecl = true);
@@ -148,6 +168,10 @@ public:
    // calculate total intermediate memory and position intermediate tensor addresses
    std::string AllocateIntermediateMemory(std::span<const std::string_view> op_output_tensors);
    void CheckAndFlushIntermediateMemory(std::span<const std::string_view> op_output_tensors, const size_t& op_idx);
+   void ReleaseIntermediateMemory(std::string_view tensor_name);
+   // plan the intermediate memory pool of the initialized model as done for the generated Session:
+   // fill the offsets of the tensors in the pool and return the pool size
+   size_t PlanIntermediateMemory(std::map<std::string, size_t> &offsets);
 
 protected:
    // internal functions
@@ -157,24 +181,55 @@ protected:
    void GenerateIntermediateTensorInfo();
    // generate code for the dynamic tensors
    void GenerateDynamicTensorInfo();
+   // generate the capacity members and the reserve function growing the dynamic tensors (GNN components)
+   void GenerateDynamicCapacityCode();
    // generate code for declarations needed by operators
    void GenerateOperatorDeclarations();
    // generate code for inference
    void GenerateOutput();
    // generate code for initializing memory pool for intermediate tensors
    void GenerateIntermediateMemoryPool();
+   // remove an operator and update the last usages of the intermediate tensors recorded for the following ones
+   void EraseOperator(size_t op_idx);
+   // fold a BatchNormalization consuming the output of the given operator in the operator weights
+   bool FoldChannelAffine(size_t op_idx);
+   // check if all the inputs of the operator are initialized tensors
+   bool IsConstantFoldable(size_t op_idx);
+   // evaluate an initialized operator with initialized inputs, replace its outputs by initialized tensors and remove it
+   bool FoldConstantOperator(size_t op_idx, const std::set<std::string> &declaredTensors);
+   // remove the operators whose outputs are not needed for computing the model outputs
+   void RemoveDeadOperators();
+   // remove the initialized tensors not used by the code generated for the operators
+   void RemoveUnusedInitializedTensors();
+   // use the channel-blocked layout for the tensors between the operators supporting it (e.g. Conv, Pool, BatchNormalization
+   // and element-wise operators). The layout is converted by the operators at the boundaries of the blocked sub-graphs
+   void AssignBlockedLayout();
+   // generate the reset/get_state/set_state/step functions of a streaming Session
+   void GenerateStreamingCode();
+   // generate the C interface (create_session, infer, destroy_session and shape queries) of the Session
+   void GenerateCInterface();
    // Generate all session code
    void GenerateSessionCode();
+   // generate the struct with the infer function of a model specialized for a fixed batch size, using the
+   // weights and the memory pool of the Session generated for the given model
+   void GenerateBatchSpecializationCode(const RModel &session);
 
 public:
    const std::vector<std::string> &GetInputTensorNames() const { return fInputTensorNames; }
    const std::vector<std::string> &GetOutputTensorNames() const { return fOutputTensorNames; }
+   // operators in execution order (e.g. for selecting their kernel variants)
+   const std::vector<std::unique_ptr<ROperator>> &GetOperators() const { return fOperators; }
 
    void ReadInitializedTensorsFromFile(long);
    long WriteInitializedTensorsToFile(std::string filename = "");
 
    void PrintIntermediateTensors();
    void PrintOutputTensors();
+   // operators and tensors removed when initializing and generating the model (dead code, duplicated
+   // operators found by the parser, constant folding, unused weights)
+   const std::vector<std::string> &GetOptimizationReport() const { return fOptimizationReport; }
+   void AddOptimizationReport(const std::string &entry) { fOptimizationReport.push_back(entry); }
+   void PrintOptimizationReport();
    void OutputGenerated(std::string filename = "", bool append = false);
    std::vector<std::string> GetOutputTensorNames() { return fOutputTensorNames; }
    void SetFilename(std::string filename) { fName = filename; }
@@ -198,6 +253,7 @@ public:
    void HeadInitializedTensors(std::string name, int n_print = 50);
 
    bool UseSession() const { return fUseSession; }
+   bool IsStreaming() const { return fIsStreaming; }
 
    // Use the ClassDef macro to allow definition of custom streaming
    ClassDefNV(RModel, 3);
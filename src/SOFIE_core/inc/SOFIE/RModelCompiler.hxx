@@ -0,0 +1,129 @@
+#ifndef SOFIE_RMODELCOMPILER
+#define SOFIE_RMODELCOMPILER
+
+#include "SOFIE/RModel.hxx"
+
+#include <string>
+#include <vector>
+
+namespace SOFIE {
+
+/// Compile the code generated for a model in a shared library with a C interface
+/// (see Options::kCInterface). The weights are embedded in the library, which is linked to SOFIE_core
+/// (for the functions of SOFIE_common used by the generated code) and to BLAS when needed.
+/// Libraries are cached in a directory, keyed by the hash of the generated code, of the compiler and
+/// of its flags, and stored per CPU target:  <cacheDir>/<model>/<target>/<hash>.so.
+/// The link <cacheDir>/<model>/<target>.so points to the last library compiled for the target.
+///
+/// The compiler can also tune the model: the operators having several implementations (kernel variants)
+/// are benchmarked on the host and the fastest variants are selected. The choices are stored per CPU model
+/// in a tuning cache file, so that the following generations (e.g. on the other nodes of the same type)
+/// reuse them without benchmarking.
+class RModelCompiler {
+
+private:
+   std::string fCacheDirectory;
+   std::string fCompiler = "c++";
+   std::string fFlags;
+   std::string fLinkFlags;
+   std::vector<std::string> fIncludeDirs;
+   std::string fTuningCache;
+   int fTuningIterations = 20;
+   bool fVerbose = false;
+
+   // compile the code unless the library is already in the cache, return the library path
+   std::string CompileCode(const std::string &modelName, const std::string &code, bool updateLink);
+   // generate the code of the model with the given options, keeping the options and the code generated before
+   std::string GenerateCode(RModel &model, std::underlying_type_t<Options> options, int batchSize);
+
+public:
+   RModelCompiler(std::string cacheDir = "sofie_cache");
+
+   void SetCompiler(std::string compiler) { fCompiler = compiler; }
+   // compilation flags. By default optimize for the CPU target of the host
+   void SetFlags(std::string flags) { fFlags = flags; }
+   // additional link flags (the BLAS libraries found when configuring SOFIE are added when needed by the model)
+   void SetLinkFlags(std::string flags) { fLinkFlags = flags; }
+   void AddIncludeDir(std::string dir) { fIncludeDirs.push_back(dir); }
+   void SetVerbose(bool verbose = true) { fVerbose = verbose; }
+   // file storing the kernel variants selected by Tune. By default <cacheDir>/tuning.txt
+   void SetTuningCache(std::string file) { fTuningCache = file; }
+   // number of inferences used for benchmarking each variant
+   void SetTuningIterations(int n) { fTuningIterations = n; }
+
+   // generate the code of the model and compile it, unless the library is already in the cache.
+   // Additional generation options (e.g. Options::kStreaming) can be given. The generation options and the code
+   // of the model are restored afterwards. Return the path of the library
+   std::string Compile(RModel &model, int batchSize = -1, std::underlying_type_t<Options> options = 0);
+   std::string Compile(RModel &model, int batchSize, Options options)
+   {
+      return Compile(model, batchSize, static_cast<std::underlying_type_t<Options>>(options));
+   }
+
+   // select the kernel variants of the operators of the model: the choices found in the tuning cache for the
+   // host CPU model are used, the other operators are benchmarked (the model is then generated and compiled
+   // once per variant) and the results are added to the cache.
+   // The selection is kept by the operators for the following generations of the model
+   void Tune(RModel &model, int batchSize = -1);
+
+   // CPU target of the host (x86-64 micro-architecture level or architecture name)
+   static std::string GetCPUTarget();
+   // compatible CPU targets of the host, from the most to the least specific
+   static std::vector<std::string> GetCompatibleCPUTargets();
+   // CPU model of the host (as given by the system, the CPU target if not available)
+   static std::string GetCPUModel();
+};
+
+/// Model loaded from a shared library produced by RModelCompiler
+class RCompiledModel {
+
+private:
+   void *fHandle = nullptr;
+   void *fSession = nullptr;
+   std::string fName;
+
+   void (*fDestroySession)(void *) = nullptr;
+   int (*fInfer)(void *, const void *const *, void *const *) = nullptr;
+   size_t (*fNumTensors[2])() = {nullptr, nullptr};
+   const char *(*fTensorName[2])(size_t) = {nullptr, nullptr};
+   int (*fTensorType[2])(size_t) = {nullptr, nullptr};
+   size_t (*fTensorRank[2])(size_t) = {nullptr, nullptr};
+   const size_t *(*fTensorShape[2])(size_t) = {nullptr, nullptr};
+   // only in libraries of models generated with Options::kProfile
+   size_t (*fNumOperators)() = nullptr;
+   const double *(*fOperatorTimes)(void *) = nullptr;
+
+   void *GetSymbol(const std::string &name);
+
+public:
+   RCompiledModel(const std::string &library);
+   ~RCompiledModel();
+   RCompiledModel(const RCompiledModel &) = delete;
+   RCompiledModel &operator=(const RCompiledModel &) = delete;
+
+   // find in the cache the library of a model built for the host CPU (or a compatible target)
+   static std::string FindLibrary(const std::string &cacheDir, const std::string &modelName);
+
+   const std::string &GetName() const { return fName; }
+
+   size_t GetNumInputs() const { return fNumTensors[0](); }
+   std::string GetInputName(size_t i) const { return fTensorName[0](i); }
+   ETensorType GetInputType(size_t i) const { return static_cast<ETensorType>(fTensorType[0](i)); }
+   std::vector<size_t> GetInputShape(size_t i) const;
+
+   size_t GetNumOutputs() const { return fNumTensors[1](); }
+   std::string GetOutputName(size_t i) const { return fTensorName[1](i); }
+   ETensorType GetOutputType(size_t i) const { return static_cast<ETensorType>(fTensorType[1](i)); }
+   std::vector<size_t> GetOutputShape(size_t i) const;
+
+   // run the inference: the outputs are written in the given buffers, which must have the output shapes
+   void Infer(const std::vector<const void *> &inputs, const std::vector<void *> &outputs);
+
+   // time in seconds spent in each operator, summed over the inferences
+   // (empty if the model is not generated with Options::kProfile)
+   std::vector<double> GetOperatorTimes() const;
+};
+
+} // namespace SOFIE
+
+#endif // SOFIE_RMODELCOMPILER
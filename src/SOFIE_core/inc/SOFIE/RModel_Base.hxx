@@ -25,6 +25,12 @@ enum class Options {
    kRootBinaryWeightFile = 0x4,
    kGNN = 0x8,
    kGNNComponent = 0x10,
+   kStreaming = 0x20,
+   kBinaryConstants = 0x40,
+   kCInterface = 0x80,
+   kProfile = 0x100,
+   kBlockedLayout = 0x200,
+   kNoDeadCodeRemoval = 0x400,
 };
 
 enum class WeightFileType { None, RootBinary, Text };
@@ -42,7 +48,7 @@ protected:
 
    std::unordered_set<std::string> fNeededBlasRoutines;
 
-   const std::unordered_set<std::string> fAllowedStdLib = {"vector", "algorithm", "cmath", "memory", "span"};
+   const std::unordered_set<std::string> fAllowedStdLib = {"vector", "algorithm", "cmath", "memory", "span", "chrono"};
    std::unordered_set<std::string> fNeededStdLib = {"vector"};
    std::unordered_set<std::string> fCustomOpHeaders;
 
@@ -52,6 +58,12 @@ protected:
    bool fUseSession = true;
    bool fIsGNN = false;
    bool fIsGNNComponent = false;
+   bool fIsStreaming = false;  // recurrent state is kept in the Session between infer calls
+   bool fUseBinaryConstants = false;  // constant tensors are generated as raw bytes instead of lists of values
+   bool fUseCInterface = false;  // generate extern "C" functions to use the Session from a shared library
+   bool fProfileOperators = false;  // measure the time spent in each operator during inference
+   bool fUseBlockedLayout = false;  // CNN sub-graphs use the channel-blocked layout (NCHW8c)
+   bool fRemoveDeadCode = true;  // remove the operators and initialized tensors not needed for the model outputs
 
 public:
    /**
@@ -95,7 +107,7 @@ enum class GraphType { INVALID = 0, GNN = 1, GraphIndependent = 2 };
 
 enum class FunctionType { UPDATE = 0, AGGREGATE = 1 };
 enum class FunctionTarget { INVALID = 0, NODES = 1, EDGES = 2, GLOBALS = 3 };
-enum class FunctionReducer { INVALID = 0, SUM = 1, MEAN = 2 };
+enum class FunctionReducer { INVALID = 0, SUM = 1, MEAN = 2, MAX = 3 };
 enum class FunctionRelation { INVALID = 0, NODES_EDGES = 1, NODES_GLOBALS = 2, EDGES_GLOBALS = 3 };
 
 class RModel_GNNBase : public RModel_Base {
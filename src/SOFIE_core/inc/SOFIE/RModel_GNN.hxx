@@ -31,6 +31,9 @@ struct GNN_Init {
 
    std::size_t num_nodes;
    std::vector<std::pair<int, int>> edges;
+   // number of graphs processed together in a batched inference. num_graphs, num_nodes and the number of
+   // edges are the initial capacities of the generated Session, which grows its buffers for larger inputs
+   std::size_t num_graphs = 1;
 
    std::size_t num_node_features;
    std::size_t num_edge_features;
@@ -107,8 +110,9 @@ private:
    std::unique_ptr<RFunction_Aggregate> edge_global_agg_block;
    std::unique_ptr<RFunction_Aggregate> node_global_agg_block;
 
-   std::size_t num_nodes; // maximum number of nodes
-   std::size_t num_edges; // maximum number of edges
+   std::size_t num_nodes; // initial capacity in nodes
+   std::size_t num_edges; // initial capacity in edges
+   std::size_t num_graphs = 1; // initial capacity in graphs of a batch
 
    std::size_t num_node_features;
    std::size_t num_edge_features;
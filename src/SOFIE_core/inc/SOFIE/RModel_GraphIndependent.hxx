@@ -29,6 +29,11 @@ struct GraphIndependent_Init {
    int num_edge_features;
    int num_global_features;
 
+   // number of threads used by the generated Session: the edge, node and global blocks run concurrently and the
+   // edges and nodes of large graphs are split across threads, whose sessions share the weights. The generated
+   // code uses OpenMP tasks and must be compiled with -fopenmp, otherwise they run in sequence
+   std::size_t num_threads = 1;
+
    std::string filename;
 
    template <typename T>
@@ -77,6 +82,8 @@ private:
    std::size_t num_edge_features;
    std::size_t num_global_features;
 
+   std::size_t num_threads = 1;
+
 public:
    /**
        Default constructor. Needed to allow serialization of ROOT objects. See
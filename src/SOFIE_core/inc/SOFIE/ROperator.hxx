@@ -13,6 +13,7 @@
 namespace SOFIE{
 
 class RModel;
+class RInterpreter;
 
 class ROperator{
 
@@ -30,7 +31,39 @@ public:
    virtual std::string GenerateDeclCode() { return "";}
    // generate session data members specific to operator
    virtual std::string GenerateSessionMembersCode(std::string /*opName*/) { return ""; }
+   // generate code resetting the state carried between infer calls (streaming mode)
+   virtual std::string GenerateStreamingResetCode(std::string /*opName*/) { return ""; }
+   // session vectors (name, type and length) holding the state carried between infer calls (streaming mode)
+   virtual std::vector<std::pair<std::string, TensorInfo>> GetStreamingStateInfo(std::string /*opName*/) { return {}; }
    virtual std::string Header() { return "";}
+   // per-channel affine transformation y = x * scale[c] + shift[c] (followed by activation) applied by the operator,
+   // returns false if the operator cannot be expressed in this form (e.g. BatchNormalization with non constant parameters)
+   virtual bool GetChannelAffine(RModel&, std::vector<float>& /*scale*/, std::vector<float>& /*shift*/, EActivationType& /*activation*/) { return false; }
+   // fold a per-channel affine transformation (and activation) applied on the output in the operator weights,
+   // the operator output is then renamed to newOutputName. Returns false if folding is not possible.
+   // Called before the operator is initialized
+   virtual bool FoldChannelAffine(RModel&, const std::vector<float>& /*scale*/, const std::vector<float>& /*shift*/,
+                                  const std::string& /*newOutputName*/, EActivationType /*activation*/) { return false; }
+   // alternative implementations of the operator which can be selected by the kernel tuner (none if there is only one).
+   // Called after the operator is initialized
+   virtual std::vector<std::string> GetKernelVariants() { return {}; }
+   // key identifying the computation done by the operator (type, shapes and attributes), used to cache the tuning results
+   virtual std::string GetKernelKey() { return ""; }
+   void SetKernelVariant(const std::string & variant) { fKernelVariant = variant; }
+   const std::string & GetKernelVariant() const { return fKernelVariant; }
+   // support of the channel-blocked layout for the 4d data tensors (see RModel::AssignBlockedLayout).
+   // Called after the operator is initialized
+   virtual EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) { return EBlockedLayoutSupport::NONE; }
+   // generate the code reading the data inputs and writing the output in the channel-blocked layout. The operator
+   // can add initialized tensors (e.g. weights packed for the blocked layout) and stop using some of its tensors
+   virtual void SetBlockedLayout(RModel&, bool /*blockedInput*/, bool /*blockedOutput*/) {}
+   // run the operator on the tensors of the interpreter, without generating code.
+   // Called after the operator is initialized; the shapes are taken from the input tensors at run time.
+   // The operators implement it only when SOFIE is built with BLAS (SOFIE_USE_BLAS)
+   virtual void Execute(RInterpreter &) {
+      throw std::runtime_error("TMVA-SOFIE: operator is not supported by the interpreter");
+   }
+   bool IsOutputConstant() const { return fIsOutputConstant; }
 
    //virtual void Forward_reference() = 0;
    //virtual void Forward_blas() = 0;
@@ -41,9 +74,11 @@ protected:
    const std::string SP = "   ";    ///< space used to correctly indent the generated C++ code
    bool fUseSession = false;        ///< flag to identify if using the session class
    bool fIsOutputConstant = false;  ///< flag to identify if operator has a constant output (no need to generate code)
+   std::string fKernelVariant;      ///< implementation selected by the kernel tuner (empty for the default one)
    
    mutable std::vector<std::string_view> fInputTensorNames;
    mutable std::vector<std::string_view> fOutputTensorNames;
+   mutable std::vector<std::string_view> fScratchTensorNames;  ///< temporary tensors used only while the operator runs
 
 public:
    std::span<const std::string_view> GetOpInputTensors() const {
@@ -53,6 +88,10 @@ public:
    std::span<const std::string_view> GetOpOutputTensors() const {
       return fOutputTensorNames;
    }
+
+   std::span<const std::string_view> GetOpScratchTensors() const {
+      return fScratchTensorNames;
+   }
    
 };
 
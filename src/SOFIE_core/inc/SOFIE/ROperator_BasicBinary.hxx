@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 
@@ -110,6 +111,8 @@ public:
                // Update the data and the shape of A
                model.AddConstantTensor(fNBroadcastedA, model.GetTensorType(fNA), fShapeY, broadcastedData);
                fShapeA = fShapeY;
+               // the generated code reads the broadcasted tensor instead of A
+               fInputTensorNames[0] = fNBroadcastedA;
             } else {
                // Add an intermediate tensor for broadcasting A
                model.AddIntermediateTensor(fNBroadcastedA, model.GetTensorType(fNA), fShapeY);
@@ -130,6 +133,7 @@ public:
                   ConvertValuesToString(ConvertShapeToLength(fShapeY), static_cast<T*>(broadcastedData.get())) << std::endl;
                model.AddConstantTensor(fNBroadcastedB, model.GetTensorType(fNB), fShapeY, broadcastedData);
                fShapeB = fShapeY;
+               fInputTensorNames[1] = fNBroadcastedB;
             } else {
                // Add an intermediate tensor for broadcasting B
                model.AddIntermediateTensor(fNBroadcastedB, model.GetTensorType(fNB), fShapeY);
@@ -167,6 +171,42 @@ public:
       return out.str();
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      // the initialized inputs are broadcasted once in Initialize, as for the generated code
+      auto &model = interpreter.GetModel();
+      const std::string &nameA = (!fNBroadcastedA.empty() && model.IsInitializedTensor(fNBroadcastedA)) ? fNBroadcastedA : fNA;
+      const std::string &nameB = (!fNBroadcastedB.empty() && model.IsInitializedTensor(fNBroadcastedB)) ? fNBroadcastedB : fNB;
+      auto &shapeA = interpreter.GetTensor(nameA).shape;
+      auto &shapeB = interpreter.GetTensor(nameB).shape;
+      const T *dataA = interpreter.GetData<T>(nameA);
+      const T *dataB = interpreter.GetData<T>(nameB);
+      auto shapeY = UTILITY::UnidirectionalBroadcastShape(shapeA, shapeB);
+      size_t length = ConvertShapeToLength(shapeY);
+      // broadcast the inputs in temporary tensors
+      if (!UTILITY::AreSameShape(shapeA, shapeY)) {
+         T *data = interpreter.AllocateTensor<T>("Broadcasted" + fNA + "to" + fNY, shapeY);
+         UTILITY::UnidirectionalBroadcast<T>(dataA, shapeA, shapeY, std::span<T>(data, length));
+         dataA = data;
+      }
+      if (!UTILITY::AreSameShape(shapeB, shapeY)) {
+         T *data = interpreter.AllocateTensor<T>("Broadcasted" + fNB + "to" + fNY, shapeY);
+         UTILITY::UnidirectionalBroadcast<T>(dataB, shapeB, shapeY, std::span<T>(data, length));
+         dataB = data;
+      }
+      T *dataY = interpreter.AllocateTensor<T>(fNY, shapeY);
+      for (size_t id = 0; id < length; id++)
+         dataY[id] = BinaryOperatorTrait<T, Op>::Func(dataA[id], dataB[id]);
+   }
+#endif
+
+   // the element-wise code does not depend on the layout when the inputs are not broadcasted
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override {
+      if (fIsOutputConstant || !fNBroadcastedA.empty() || !fNBroadcastedB.empty())
+         return EBlockedLayoutSupport::NONE;
+      return EBlockedLayoutSupport::SAME;
+   }
+
    std::string Generate(std::string OpName) override {
 
       if (fIsOutputConstant) return "";
@@ -3,6 +3,7 @@
 
 #include <SOFIE/ROperator.hxx>
 #include <SOFIE/RModel.hxx>
+#include <SOFIE/RInterpreter.hxx>
 #include <SOFIE/SOFIE_common.hxx>
 
 
@@ -18,48 +19,56 @@ template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kReciprocal> {
    static std::string Name() { return "Reciprocal"; }
    static std::string Op(const std::string &X) { return "1/" + X; }
+   static T Func(T x) { return 1 / x; }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kSqrt> {
    static std::string Name() { return "Sqrt"; }
    static std::string Op(const std::string &X) { return "std::sqrt(" + X + ")"; }
+   static T Func(T x) { return std::sqrt(x); }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kNeg> {
    static std::string Name() { return "Neg"; }
    static std::string Op(const std::string &X) { return "-" + X; }
+   static T Func(T x) { return -x; }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kExp> {
    static std::string Name() { return "Exp"; }
    static std::string Op(const std::string &X) { return "std::exp(" + X + ")"; }
+   static T Func(T x) { return std::exp(x); }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kLog> {
    static std::string Name() { return "Log"; }
    static std::string Op(const std::string &X) { return "std::log(" + X + ")"; }
+   static T Func(T x) { return std::log(x); }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kSin> {
    static std::string Name() { return "Sin"; }
    static std::string Op(const std::string &X) { return "std::sin(" + X + ")"; }
+   static T Func(T x) { return std::sin(x); }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kCos> {
    static std::string Name() { return "Cos"; }
    static std::string Op(const std::string &X) { return "std::cos(" + X + ")"; }
+   static T Func(T x) { return std::cos(x); }
 };
 
 template <typename T>
 struct UnaryOpTraits<T, EBasicUnaryOperator::kAbs> {
    static std::string Name() { return "Abs"; }
    static std::string Op(const std::string &X) { return "std::abs(" + X + ")"; }
+   static T Func(T x) { return std::abs(x); }
 };
 
 template <typename T, EBasicUnaryOperator Op>
@@ -94,6 +103,19 @@ public:
       model.AddIntermediateTensor(fNY, model.GetTensorType(fNX), fShapeY);
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &shape = interpreter.GetTensor(fNX).shape;
+      const T *x = interpreter.GetData<T>(fNX);
+      T *y = interpreter.AllocateTensor<T>(fNY, shape);
+      size_t length = ConvertShapeToLength(shape);
+      for (size_t i = 0; i < length; i++)
+         y[i] = UnaryOpTraits<T, Op>::Func(x[i]);
+   }
+#endif
+
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override { return EBlockedLayoutSupport::SAME; }
+
    std::string Generate(std::string OpName) override
    {
       OpName = "op_" + OpName;
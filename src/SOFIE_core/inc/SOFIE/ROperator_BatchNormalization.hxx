@@ -4,9 +4,12 @@
 #include "SOFIE_common.hxx"
 #include "ROperator.hxx"
 #include "RModel.hxx"
+#include "RInterpreter.hxx"
 
 
 #include <cmath>
+#include <iomanip>
+#include <map>
 #include <sstream>
 
 namespace SOFIE{
@@ -29,6 +32,8 @@ private:
    std::string fNVar;
    std::string fNY;
    EActivationType fActivation;
+   bool fBlockedLayout = false;   // input and output in the channel-blocked layout
+   bool fChannelAffine = true;    // parameters folded in a per-channel scale and shift (see Initialize)
 
    std::vector<size_t> fShapeX;
    std::vector<size_t> fShapeScale;
@@ -51,7 +56,7 @@ public:
    fNB(UTILITY::Clean_name(nameB)), fNMean(UTILITY::Clean_name(nameMean)),
    fNVar(UTILITY::Clean_name(nameVar)), fNY(UTILITY::Clean_name(nameY)), fActivation(activation)
    {
-      fInputTensorNames = { fNX };
+      fInputTensorNames = { fNX, fNScale, fNB, fNMean, fNVar };
       fOutputTensorNames = { fNY };
 
       if(std::is_same<T, float>::value){
@@ -121,66 +126,99 @@ public:
       fShapeY = fShapeX;
       model.AddIntermediateTensor(fNY, model.GetTensorType(fNX), fShapeY);
 
-      if (fShapeB.size() == 1) {
-         // Broadcast scale, bias, input_mean and input_var to shape_X
-         auto original_B = model.GetInitializedTensorData(fNB);
-         auto original_S = model.GetInitializedTensorData(fNScale);
-         auto original_M = model.GetInitializedTensorData(fNMean);
-         auto original_V = model.GetInitializedTensorData(fNVar);
-         size_t batchSize = fShapeX[0];
-         size_t channels = fShapeX[1];
-         size_t height = (fShapeX.size() > 2) ? fShapeX[2] : 1;
-         size_t width = (fShapeX.size() > 3) ? fShapeX[3] : 1;
-         size_t n = batchSize * channels * height * width;
-         if (fType == "float") {
-            float *original_bias = static_cast<float *>(original_B.get());
-            float *original_scale = static_cast<float *>(original_S.get());
-            float *original_mean = static_cast<float *>(original_M.get());
-            float *original_var = static_cast<float *>(original_V.get());
-            float *new_bias = new float[n];
-            float *new_scale = new float[n];
-            float *new_mean = new float[n];
-            float *new_var = new float[n];
-            size_t bs = 0, ch = 0, h = 0, w = 0;
-            for (ch = 0; ch < channels; ch++) {
-               for (h = 0; h < height; h++) {
-                  for (w = 0; w < width; w++) {
-                     new_bias[bs * channels * height * width + ch * height * width + h * width + w] = original_bias[ch];
-                     new_scale[bs * channels * height * width + ch * height * width + h * width + w] =
-                        original_scale[ch];
-                     new_mean[bs * channels * height * width + ch * height * width + h * width + w] = original_mean[ch];
-                     new_var[bs * channels * height * width + ch * height * width + h * width + w] = original_var[ch];
-                  }
+      // precompute per-channel scale' = scale / sqrt(var + epsilon) and shift' = B - mean * scale'
+      // so the generated code applies a single scale-shift per element
+      std::vector<float> scale;
+      std::vector<float> shift;
+      size_t channels = fShapeX[1];
+      fChannelAffine = ComputeChannelAffine(model, scale, shift) && scale.size() == channels;
+      if (!fChannelAffine) {
+         // parameters which are not constant or given per element: normalization computed from all of them
+         size_t length = ConvertShapeToLength(fShapeX);
+         for (auto &name : {fNScale, fNB, fNMean, fNVar}) {
+            size_t n = ConvertShapeToLength(model.GetTensorShape(name));
+            if (n != channels && n != length / fShapeX[0] && n != length)
+               throw std::runtime_error("TMVA SOFIE BatchNormalization Op parameter " + name + " of shape " +
+                                        ConvertShapeToString(model.GetTensorShape(name)) +
+                                        " does not match the input shape " + ConvertShapeToString(fShapeX));
+         }
+         return;
+      }
+      std::shared_ptr<void> new_scale_ptr(new float[channels], std::default_delete<float[]>());
+      std::shared_ptr<void> new_bias_ptr(new float[channels], std::default_delete<float[]>());
+      std::copy(scale.begin(), scale.end(), static_cast<float *>(new_scale_ptr.get()));
+      std::copy(shift.begin(), shift.end(), static_cast<float *>(new_bias_ptr.get()));
+      model.UpdateInitializedTensor(fNScale, model.GetTensorType(fNScale), {channels}, new_scale_ptr);
+      model.UpdateInitializedTensor(fNB, model.GetTensorType(fNB), {channels}, new_bias_ptr);
+      // mean and var are included in the new scale and bias
+      model.SetNotWritableInitializedTensor(fNMean);
+      model.SetNotWritableInitializedTensor(fNVar);
+      fInputTensorNames = { fNX, fNScale, fNB };
+      fShapeScale = model.GetTensorShape(fNScale);
+      fShapeB = model.GetTensorShape(fNB);
+   }
+
+   // BatchNormalization in inference mode is a per-channel affine transformation that can be folded
+   // in the weights of the preceding operator
+   std::vector<std::string> GetStdLibs() override { return { std::string("cmath") }; }
+
+   bool GetChannelAffine(RModel& model, std::vector<float>& scale, std::vector<float>& shift, EActivationType& activation) override {
+      if (!ComputeChannelAffine(model, scale, shift))
+         return false;
+      activation = fActivation;
+      return true;
+   }
+
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      // scale and bias include already the mean and the variance (see Initialize)
+      auto &shapeX = interpreter.GetTensor(fNX).shape;
+      if (shapeX.size() < 2)
+         throw std::runtime_error("TMVA SOFIE Batch Normalization input has invalid shape " + ConvertShapeToString(shapeX));
+      const T *x = interpreter.GetData<T>(fNX);
+      const T *scale = interpreter.GetData<T>(fNScale);
+      const T *bias = interpreter.GetData<T>(fNB);
+      T *y = interpreter.AllocateTensor<T>(fNY, shapeX);
+      size_t channels = shapeX[1];
+      size_t spatial = 1;
+      for (size_t i = 2; i < shapeX.size(); i++)
+         spatial *= shapeX[i];
+      if (!fChannelAffine) {
+         const T *mean = interpreter.GetData<T>(fNMean);
+         const T *var = interpreter.GetData<T>(fNVar);
+         auto index = [&](const std::string &name, size_t c, size_t i) {
+            size_t n = ConvertShapeToLength(interpreter.GetTensor(name).shape);
+            return (n == channels) ? c : i % n;
+         };
+         for (size_t n = 0; n < shapeX[0]; n++) {
+            for (size_t c = 0; c < channels; c++) {
+               size_t offset = (n * channels + c) * spatial;
+               for (size_t i = offset; i < offset + spatial; i++) {
+                  T value = (x[i] - mean[index(fNMean, c, i)]) / std::sqrt(var[index(fNVar, c, i)] + fepsilon) *
+                               scale[index(fNScale, c, i)] + bias[index(fNB, c, i)];
+                  y[i] = (fActivation == EActivationType::RELU && value < 0) ? 0 : value;
                }
             }
-            size_t Batchoffset = channels * height * width;
-            for (bs = 1; bs < batchSize; bs++) {
-               std::copy(new_bias, new_bias + Batchoffset, new_bias + (bs * Batchoffset));
-               std::copy(new_scale, new_scale + Batchoffset, new_scale + (bs * Batchoffset));
-               std::copy(new_mean, new_mean + Batchoffset, new_mean + (bs * Batchoffset));
-               std::copy(new_var, new_var + Batchoffset, new_var + (bs * Batchoffset));
-            }
-            //// new_var =1. / sqrt(input_var + fepsilon)
-            for (size_t i = 0; i < n; i++) {
-               new_var[i] = 1. / sqrt(new_var[i] + fepsilon);
-               new_scale[i] *= new_var[i]; // include var in new scale
+         }
+         return;
+      }
+      for (size_t n = 0; n < shapeX[0]; n++) {
+         for (size_t c = 0; c < channels; c++) {
+            size_t offset = (n * channels + c) * spatial;
+            for (size_t i = offset; i < offset + spatial; i++) {
+               T value = x[i] * scale[c] + bias[c];
+               y[i] = (fActivation == EActivationType::RELU && value < 0) ? 0 : value;
             }
-            std::vector<size_t> new_bias_shape = {batchSize, channels, height, width};
-            std::shared_ptr<void> new_bias_ptr(new_bias, std::default_delete<float[]>());
-            std::shared_ptr<void> new_scale_ptr(new_scale, std::default_delete<float[]>());
-            std::shared_ptr<void> new_mean_ptr(new_mean, std::default_delete<float[]>());
-            std::shared_ptr<void> new_var_ptr(new_var, std::default_delete<float[]>());
-            model.UpdateInitializedTensor(fNB, model.GetTensorType(fNB), new_bias_shape, new_bias_ptr);
-            model.UpdateInitializedTensor(fNScale, model.GetTensorType(fNScale), new_bias_shape, new_scale_ptr);
-            model.UpdateInitializedTensor(fNMean, model.GetTensorType(fNMean), new_bias_shape, new_mean_ptr);
-            model.UpdateInitializedTensor(fNVar, model.GetTensorType(fNVar), new_bias_shape, new_var_ptr);
-            fShapeB = model.GetTensorShape(fNB);
-            fShapeScale = model.GetTensorShape(fNScale);
-            fShapeMean = model.GetTensorShape(fNMean);
-            fShapeVar = model.GetTensorShape(fNVar);
          }
       }
    }
+#endif
+
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override {
+      return (fShapeX.size() == 4 && fChannelAffine) ? EBlockedLayoutSupport::SAME : EBlockedLayoutSupport::NONE;
+   }
+
+   void SetBlockedLayout(RModel&, bool blockedInput, bool) override { fBlockedLayout = blockedInput; }
 
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
@@ -194,40 +232,105 @@ public:
       size_t channels = fShapeX[1];
       size_t height = (fShapeX.size() > 2) ? fShapeX[2] : 1;
       size_t width = (fShapeX.size() > 3) ? fShapeX[3] : 1;
-      size_t n = batchSize * channels * height * width;
+      size_t spatial = height * width;
 
-      //// copy X into Y
       out << "\n\n//---- BatchNorm\n";
-      out << SP << "constexpr int " << OpName << "_N =" << batchSize * channels * height * width << ";\n";
-      out << SP << "constexpr int "<<OpName<< "_incx = 1;\n";
-      out << SP << "constexpr int "<<OpName<< "_incy = 1;\n";
-      out << SP << "BLAS::scopy_(&" << OpName << "_N, " << "tensor_" << fNX << ", &" << OpName << "_incx," << "tensor_" << fNY << ", &" << OpName << "_incy);\n\n";
-
-      //// blas saxpy (Y = -Bmean + Y)
-      out << SP << "float "<<OpName<< "_alpha = -1;\n";
-      out << SP << "BLAS::saxpy_(&" << OpName << "_N, &" << OpName << "_alpha, " << "tensor_" << fNMean << ", &" << OpName << "_incx,"
-         << "tensor_" << fNY <<", &" << OpName << "_incy);\n\n ";
-
-      //// Y *= scale*var
-      out << SP << "for (size_t i = 0; i < " << n << "; i++) {\n";
-      // scale tensor contains already the var
-      out << SP << SP << "tensor_" << fNY << "[i] *= tensor_" << fNScale << "[i]; \n";
-      out << SP << "}\n";
-
-      //// blas saxpy (Y = Bbias + Y)
-      out << SP <<OpName<< "_alpha = 1;\n";
-      out << SP << "BLAS::saxpy_(&" << OpName << "_N, &" << OpName << "_alpha, " << "tensor_" << fNB << ", &" << OpName << "_incx, "
-         << "tensor_" << fNY << ", &" << OpName << "_incy);\n\n";
-
-      if(fActivation == EActivationType::RELU){
-         out << SP << "for (int id = 0; id < " << ConvertShapeToLength(fShapeY) << " ; id++){\n";
-         out << SP << SP << "tensor_" << fNY << "[id] = ((tensor_" << fNY << "[id] > 0 )? tensor_" << fNY << "[id] : 0);\n";
+      if (!fChannelAffine) {
+         //// Y = (X - mean) / sqrt(var + epsilon) * scale + bias, with parameters given per channel or per element
+         size_t length = batchSize * channels * spatial;
+         std::map<std::string, std::string> index;
+         for (auto &p : {std::make_pair(fNScale, fShapeScale), std::make_pair(fNB, fShapeB),
+                         std::make_pair(fNMean, fShapeMean), std::make_pair(fNVar, fShapeVar)}) {
+            size_t n = ConvertShapeToLength(p.second);
+            index[p.first] = (n == channels) ? "c" : ((n == length) ? "i" : "i % " + std::to_string(n));
+         }
+         out << SP << "for (size_t n = 0; n < " << batchSize << "; n++) {\n";
+         out << SP << SP << "for (size_t c = 0; c < " << channels << "; c++) {\n";
+         out << SP << SP << SP << "const size_t " << OpName << "_offset = (n * " << channels << " + c) * " << spatial << ";\n";
+         out << SP << SP << SP << "for (size_t i = " << OpName << "_offset; i < " << OpName << "_offset + " << spatial << "; i++) {\n";
+         out << SP << SP << SP << SP << "float y = (tensor_" << fNX << "[i] - tensor_" << fNMean << "[" << index[fNMean]
+             << "]) / std::sqrt(tensor_" << fNVar << "[" << index[fNVar] << "] + " << std::setprecision(9) << fepsilon
+             << "f) * tensor_" << fNScale << "[" << index[fNScale] << "] + tensor_" << fNB << "[" << index[fNB] << "];\n";
+         if (fActivation == EActivationType::RELU)
+            out << SP << SP << SP << SP << "tensor_" << fNY << "[i] = (y > 0) ? y : 0;\n";
+         else
+            out << SP << SP << SP << SP << "tensor_" << fNY << "[i] = y;\n";
+         out << SP << SP << SP << "}\n";
+         out << SP << SP << "}\n";
+         out << SP << "}\n";
+         return out.str();
+      }
+      //// Y = X * scale' + bias' (scale' and bias' include mean and var)
+      if (fBlockedLayout) {
+         // the values of the channels of a block are contiguous for each pixel
+         const size_t block = kChannelBlockSize;
+         out << SP << "for (size_t n = 0; n < " << batchSize * channels / block << "; n++) {\n";
+         out << SP << SP << "const float * " << OpName << "_s = tensor_" << fNScale << " + (n % " << channels / block
+             << ") * " << block << ";\n";
+         out << SP << SP << "const float * " << OpName << "_b = tensor_" << fNB << " + (n % " << channels / block
+             << ") * " << block << ";\n";
+         out << SP << SP << "for (size_t i = n * " << spatial * block << "; i < (n + 1) * " << spatial * block
+             << "; i += " << block << ") {\n";
+         out << SP << SP << SP << "for (size_t b = 0; b < " << block << "; b++) {\n";
+         if (fActivation == EActivationType::RELU) {
+            out << SP << SP << SP << SP << "float y = tensor_" << fNX << "[i + b] * " << OpName << "_s[b] + " << OpName
+                << "_b[b];\n";
+            out << SP << SP << SP << SP << "tensor_" << fNY << "[i + b] = (y > 0) ? y : 0;\n";
+         } else {
+            out << SP << SP << SP << SP << "tensor_" << fNY << "[i + b] = tensor_" << fNX << "[i + b] * " << OpName
+                << "_s[b] + " << OpName << "_b[b];\n";
+         }
+         out << SP << SP << SP << "}\n";
+         out << SP << SP << "}\n";
          out << SP << "}\n";
+         return out.str();
       }
+      out << SP << "for (size_t n = 0; n < " << batchSize << "; n++) {\n";
+      out << SP << SP << "for (size_t c = 0; c < " << channels << "; c++) {\n";
+      out << SP << SP << SP << "const float " << OpName << "_s = tensor_" << fNScale << "[c];\n";
+      out << SP << SP << SP << "const float " << OpName << "_b = tensor_" << fNB << "[c];\n";
+      out << SP << SP << SP << "const size_t " << OpName << "_offset = (n * " << channels << " + c) * " << spatial << ";\n";
+      out << SP << SP << SP << "for (size_t i = " << OpName << "_offset; i < " << OpName << "_offset + " << spatial << "; i++) {\n";
+      if (fActivation == EActivationType::RELU) {
+         out << SP << SP << SP << SP << "float y = tensor_" << fNX << "[i] * " << OpName << "_s + " << OpName << "_b;\n";
+         out << SP << SP << SP << SP << "tensor_" << fNY << "[i] = (y > 0) ? y : 0;\n";
+      } else {
+         out << SP << SP << SP << SP << "tensor_" << fNY << "[i] = tensor_" << fNX << "[i] * " << OpName << "_s + " << OpName << "_b;\n";
+      }
+      out << SP << SP << SP << "}\n";
+      out << SP << SP << "}\n";
+      out << SP << "}\n";
       return out.str();
    }
 
-   std::vector<std::string> GetBlasRoutines() override { return { std::string("Copy"), std::string("Axpy") }; }
+private:
+   // compute scale' = scale / sqrt(var + epsilon) and shift' = B - mean * scale' from the constant
+   // one-dimensional parameters. Return false if they are not available
+   bool ComputeChannelAffine(RModel& model, std::vector<float>& scale, std::vector<float>& shift) {
+      if (fType != "float")
+         return false;
+      for (auto & name : {fNScale, fNB, fNMean, fNVar}) {
+         if (!model.IsInitializedTensor(name) || model.GetTensorShape(name).size() != 1 ||
+             model.GetTensorType(name) != ETensorType::FLOAT)
+            return false;
+      }
+      size_t channels = model.GetTensorShape(fNScale)[0];
+      for (auto & name : {fNB, fNMean, fNVar}) {
+         if (model.GetTensorShape(name)[0] != channels)
+            return false;
+      }
+      const float *s = static_cast<float *>(model.GetInitializedTensorData(fNScale).get());
+      const float *b = static_cast<float *>(model.GetInitializedTensorData(fNB).get());
+      const float *m = static_cast<float *>(model.GetInitializedTensorData(fNMean).get());
+      const float *v = static_cast<float *>(model.GetInitializedTensorData(fNVar).get());
+      scale.resize(channels);
+      shift.resize(channels);
+      for (size_t c = 0; c < channels; c++) {
+         scale[c] = s[c] / std::sqrt(v[c] + fepsilon);
+         shift[c] = b[c] - m[c] * scale[c];
+      }
+      return true;
+   }
 };
 
 }//SOFIE
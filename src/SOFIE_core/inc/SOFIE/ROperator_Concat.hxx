@@ -198,9 +198,10 @@
             std::stringstream out;
             out<<"\n//--------- Concat\n";
             // special case when memory is contiguous
+            // (a parametric dimension can be larger than its default value 1 at run time)
             bool hasShapeOnes = true;
             for(int i = 0; i<fAxis; ++i){
-               if(fInputShapes[0][i].dim !=1){
+               if(fInputShapes[0][i].isParam || fInputShapes[0][i].dim !=1){
                   hasShapeOnes = false;
                   break;
                }
@@ -32,8 +32,9 @@ public:
       fValues(values),
       fAttrType(type)
       {
-         fInputTensorNames = { };
-         fOutputTensorNames = { };
+         if (!fNX.empty())
+            fInputTensorNames = { fNX };
+         fOutputTensorNames = { fNY };
       }
 
    std::vector<ETensorType> TypeInference(std::vector<ETensorType> input) override {
@@ -89,6 +90,8 @@ public:
       // following operators using as input Constant or ConstantOfShape
        // resize fValues to shape length
       model.AddConstantTensor(fNY, fShape, fValues);
+      fIsOutputConstant = true;
+      fOutputTensorNames.pop_back();
       if (model.Verbose()) {
          std::cout << "adding constant tensor " << fNY << " with shape " << ConvertShapeToString(fShape)
          << " and values [";
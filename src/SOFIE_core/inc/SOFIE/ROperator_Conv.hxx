@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <memory>
 #include <sstream>
@@ -32,8 +33,7 @@ private:
    std::string fNB2; // bias tensor name after broadcasting
    std::string fNY;
 
-   std::string convK;
-   std::string imcol;
+   std::string fNPanel; // buffer of the im2col panels
 
    std::vector<size_t> fShapeX;
    std::vector<size_t> fShapeW;
@@ -41,9 +41,16 @@ private:
    std::vector<size_t> fShapeY;
 
    std::string fType;
+   EActivationType fActivation = EActivationType::UNDEFINED;  // activation fused from a folded BatchNormalization
 
    size_t fDim;   // dimension of the convolution
 
+   // channel-blocked layout of the input and of the output, using the weights and the bias packed in blocks
+   bool fBlockedInput = false;
+   bool fBlockedOutput = false;
+   std::string fNWBlocked;
+   std::string fNBBlocked;
+
 
 public:
 
@@ -64,7 +71,7 @@ public:
          throw
             std::runtime_error("TMVA SOFIE Encountered unsupported type parsing a Conv operator");
       }
-      fInputTensorNames = { fNX, fNB };
+      fInputTensorNames = { fNX, fNW, fNB };
       fOutputTensorNames = { fNY };
    }
 
@@ -82,7 +89,7 @@ public:
          throw
             std::runtime_error("TMVA SOFIE Encountered unsupported type parsing a Conv operator");
       }
-      fInputTensorNames = { fNX };
+      fInputTensorNames = { fNX, fNW };
       fOutputTensorNames = { fNY };
    }
 
@@ -260,31 +267,139 @@ public:
                // we need to add a new intermediate tensor for broadcasted bias tensor
                fNB2 = fNB + "bcast";
                model.AddIntermediateTensor(fNB2, model.GetTensorType(fNB), targetShape);
+               fInputTensorNames.emplace_back(fNB2);
             }
          }
       }
 
-      size_t outputChannelSize = fShapeY[2];  // size/channel = D * H * W
-      size_t kernelSize = fAttrKernelShape[0];
-      for (size_t i = 1; i < fDim; i++) {
-         outputChannelSize *= fShapeY[2 + i];
-         kernelSize *= fAttrKernelShape[i];
+      // buffer of the im2col panels unrolled by the implicit Gemm (the im2col matrix is never built in full)
+      size_t outputChannelSize = ConvertShapeToLength(std::vector<size_t>(fShapeY.begin() + 2, fShapeY.end()));
+      size_t kernelSize = ConvertShapeToLength(std::vector<size_t>(fShapeW.begin() + 2, fShapeW.end()));
+      fNPanel = fNY + "_xpanel";
+      std::vector<size_t> shapePanel = {UTILITY::ConvPanelSize(fShapeW[1] * kernelSize, outputChannelSize)};
+      model.AddIntermediateTensor(fNPanel, ConvertStringToType(fType), shapePanel);
+      fScratchTensorNames = {fNPanel};
+
+      // the kernels support only symmetric padding. Done here and not in Generate, which can be called several times
+      if (fDim ==1) {
+         if (fAttrPads[0] != fAttrPads[1] ) {
+            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding "
+                      << std::endl;
+            fAttrPads[0] = (fAttrPads[0] + fAttrPads[1]) / 2;
+         }
+         fAttrPads[1] = 0;
+         fAttrStrides[1] = 1;
+      }
+      if (fDim == 2) {
+         if (fAttrPads[0] != fAttrPads[2] || fAttrPads[1] != fAttrPads[3]) {
+            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding " << std::endl;
+            fAttrPads[0] = (fAttrPads[0] + fAttrPads[2]) / 2;
+            fAttrPads[1] = (fAttrPads[1] + fAttrPads[3]) / 2;
+         }
       }
+      if (fDim == 3) {
+         if (fAttrPads[0] != fAttrPads[3] || fAttrPads[1] != fAttrPads[4] || fAttrPads[2] != fAttrPads[5]) {
+            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding " << std::endl;
+            fAttrPads[0] = (fAttrPads[0] + fAttrPads[3]) / 2;
+            fAttrPads[1] = (fAttrPads[1] + fAttrPads[4]) / 2;
+            fAttrPads[2] = (fAttrPads[2] + fAttrPads[5]) / 2;
+         }
+      }
+   }
+
+   // fold a following per-channel affine transformation (BatchNormalization) in the filters and the bias:
+   // W'[oc] = W[oc] * scale[oc], B'[oc] = B[oc] * scale[oc] + shift[oc]
+   bool FoldChannelAffine(RModel& model, const std::vector<float>& scale, const std::vector<float>& shift,
+                          const std::string& newOutputName, EActivationType activation) override {
+      if (fType != "float" || fActivation != EActivationType::UNDEFINED || !model.IsInitializedTensor(fNW))
+         return false;
+      auto shapeW = model.GetTensorShape(fNW);
+      if (shapeW.size() < 3 || shapeW[0] != scale.size() || model.GetTensorType(fNW) != ETensorType::FLOAT)
+         return false;
+      size_t channels = shapeW[0];
+      std::vector<size_t> shapeB = {channels};
+      if (!fNB.empty()) {
+         if (!model.IsInitializedTensor(fNB) || model.GetTensorType(fNB) != ETensorType::FLOAT)
+            return false;
+         shapeB = model.GetTensorShape(fNB);
+         if (ConvertShapeToLength(shapeB) != channels)
+            return false;
+      }
+      size_t filterSize = ConvertShapeToLength(shapeW) / channels;
+      const float *w = static_cast<float *>(model.GetInitializedTensorData(fNW).get());
+      std::shared_ptr<void> new_w_ptr(new float[channels * filterSize], std::default_delete<float[]>());
+      float *new_w = static_cast<float *>(new_w_ptr.get());
+      for (size_t oc = 0; oc < channels; oc++) {
+         for (size_t i = 0; i < filterSize; i++)
+            new_w[oc * filterSize + i] = w[oc * filterSize + i] * scale[oc];
+      }
+      std::shared_ptr<void> new_b_ptr(new float[channels], std::default_delete<float[]>());
+      float *new_b = static_cast<float *>(new_b_ptr.get());
+      const float *b = (fNB.empty()) ? nullptr : static_cast<float *>(model.GetInitializedTensorData(fNB).get());
+      for (size_t oc = 0; oc < channels; oc++)
+         new_b[oc] = ((b) ? b[oc] * scale[oc] : 0.f) + shift[oc];
+
+      model.UpdateInitializedTensor(fNW, ETensorType::FLOAT, shapeW, new_w_ptr);
+      if (fNB.empty()) {
+         fNB = newOutputName + "_bias";
+         model.AddInitializedTensor(fNB, ETensorType::FLOAT, shapeB, new_b_ptr);
+      } else {
+         model.UpdateInitializedTensor(fNB, ETensorType::FLOAT, shapeB, new_b_ptr);
+      }
+      fNY = newOutputName;
+      fActivation = activation;
+      fInputTensorNames = { fNX, fNW, fNB };
+      fOutputTensorNames = { fNY };
+      return true;
+   }
 
-      std::vector<size_t> shape1 = {fShapeW[0], fShapeW[1], kernelSize};
-      std::vector<size_t> shape2 = {fShapeW[1], kernelSize, outputChannelSize};
-      model.AddIntermediateTensor(fNX +"_f", ConvertStringToType(fType), shape1 );
-      model.AddIntermediateTensor(fNX +"_xcol", ConvertStringToType(fType), shape2 );
-      convK = fNX +"_f";
-      imcol = fNX +"_xcol";
-      fOutputTensorNames.emplace_back(convK);
-      fOutputTensorNames.emplace_back(imcol);
+   // 2d convolutions without groups, with the input and the output in any layout
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel& model) override {
+      if (fType != "float" || fDim != 2 || fAttrGroup != 1 || !model.IsInitializedTensor(fNW) ||
+          (!fNB.empty() && !model.IsInitializedTensor(fNB)))
+         return EBlockedLayoutSupport::NONE;
+      return EBlockedLayoutSupport::CONVERT;
+   }
+
+   // pack the weights as (out_channels / B, channels, kernel_h, kernel_w, B) and the bias per channel, padded with
+   // zeros to a multiple of B. The original filters and the panel buffer are not needed anymore
+   void SetBlockedLayout(RModel& model, bool blockedInput, bool blockedOutput) override {
+      const size_t block = kChannelBlockSize;
+      size_t outChannels = fShapeW[0];
+      size_t channels = fShapeW[1];
+      size_t kernelSize = fShapeW[2] * fShapeW[3];
+      size_t outBlocks = (outChannels + block - 1) / block;
+      const float *w = static_cast<float *>(model.GetInitializedTensorData(fNW).get());
+      std::shared_ptr<void> new_w_ptr(new float[outBlocks * channels * kernelSize * block](), std::default_delete<float[]>());
+      float *new_w = static_cast<float *>(new_w_ptr.get());
+      for (size_t oc = 0; oc < outChannels; oc++) {
+         for (size_t i = 0; i < channels * kernelSize; i++)
+            new_w[((oc / block) * channels * kernelSize + i) * block + oc % block] = w[oc * channels * kernelSize + i];
+      }
+      std::shared_ptr<void> new_b_ptr(new float[outBlocks * block](), std::default_delete<float[]>());
+      if (!fNB.empty()) {
+         // the bias can be already broadcasted to the output shape
+         const float *b = static_cast<float *>(model.GetInitializedTensorData(fNB).get());
+         size_t stride = ConvertShapeToLength(model.GetTensorShape(fNB)) / outChannels;
+         for (size_t oc = 0; oc < outChannels; oc++)
+            static_cast<float *>(new_b_ptr.get())[oc] = b[oc * stride];
+      }
+      fNWBlocked = fNY + "_wblocked";
+      fNBBlocked = fNY + "_bblocked";
+      model.AddInitializedTensor(fNWBlocked, ETensorType::FLOAT, {outBlocks, channels, fShapeW[2], fShapeW[3], block},
+                                 new_w_ptr);
+      model.AddInitializedTensor(fNBBlocked, ETensorType::FLOAT, {outBlocks * block}, new_b_ptr);
+      fBlockedInput = blockedInput;
+      fBlockedOutput = blockedOutput;
+      fInputTensorNames = { fNX, fNWBlocked, fNBBlocked };
+      fOutputTensorNames = { fNY };
+      fScratchTensorNames.clear();
    }
 
    std::string GenerateInitCode() override {
       std::stringstream out;
       // Generate initialization code for broadcasting of bias tensor
-      if (!fNB2.empty()) {
+      if (!fNB2.empty() && fNWBlocked.empty()) {
          // include a separate scope to avoid defining unique operator temp variables
          std::vector<size_t> shape(fDim + 1, 1);
          shape[0] = fShapeB[0];
@@ -299,6 +414,66 @@ public:
       return out.str();
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      if (fDim > 2)
+         throw std::runtime_error("TMVA SOFIE Conv Op: 3d convolution is not supported by the interpreter");
+      // direct convolution (no im2col buffer). The batch size and the image size are taken from the input
+      auto &shapeX = interpreter.GetTensor(fNX).shape;
+      if (shapeX.size() != fDim + 2 || shapeX[1] != fShapeX[1])
+         throw std::runtime_error("TMVA SOFIE Conv Op: invalid input shape " + ConvertShapeToString(shapeX));
+      // parameters along the height and the width (a 1d convolution has a height of 1)
+      int iHeight = (fDim > 1) ? shapeX[2] : 1;
+      int iWidth = shapeX[fDim + 1];
+      int kHeight = (fDim > 1) ? fShapeW[2] : 1;
+      int kWidth = fShapeW[fDim + 1];
+      int padH = (fDim > 1) ? fAttrPads[0] : 0;
+      int padW = (fDim > 1) ? fAttrPads[1] : fAttrPads[0];
+      int strideH = (fDim > 1) ? fAttrStrides[0] : 1;
+      int strideW = (fDim > 1) ? fAttrStrides[1] : fAttrStrides[0];
+      int dilationH = (fDim > 1) ? fAttrDilations[0] : 1;
+      int dilationW = (fDim > 1) ? fAttrDilations[1] : fAttrDilations[0];
+      int oHeight = (iHeight + 2 * padH - (dilationH * (kHeight - 1) + 1)) / strideH + 1;
+      int oWidth = (iWidth + 2 * padW - (dilationW * (kWidth - 1) + 1)) / strideW + 1;
+      std::vector<size_t> shapeY = {shapeX[0], fShapeW[0]};
+      if (fDim > 1)
+         shapeY.push_back(oHeight);
+      shapeY.push_back(oWidth);
+
+      const float *X = interpreter.GetData<float>(fNX);
+      const float *W = interpreter.GetData<float>(fNW);
+      float *Y = interpreter.AllocateTensor<float>(fNY, shapeY);
+      size_t channels = fShapeW[1];  // input channels per group
+      size_t outChannels = fShapeW[0] / fAttrGroup;
+      size_t inputSize = size_t(iHeight) * iWidth;
+      size_t outputSize = size_t(oHeight) * oWidth;
+      for (size_t n = 0; n < shapeX[0]; n++) {
+         for (size_t g = 0; g < fAttrGroup; g++) {
+            UTILITY::DirectConv2d<float>(X + (n * shapeX[1] + g * channels) * inputSize,
+                                         W + g * outChannels * channels * kHeight * kWidth, channels, iHeight, iWidth,
+                                         outChannels, kHeight, kWidth, padH, padW, strideH, strideW, dilationH,
+                                         dilationW, Y + (n * fShapeW[0] + g * outChannels) * outputSize);
+         }
+      }
+      // bias given per channel, or already broadcasted to the output shape
+      size_t lengthY = ConvertShapeToLength(shapeY);
+      if (!fNB.empty()) {
+         const float *B = interpreter.GetData<float>(fNB);
+         size_t lengthB = ConvertShapeToLength(interpreter.GetTensor(fNB).shape);
+         size_t sampleSize = fShapeW[0] * outputSize;
+         if (lengthB != fShapeW[0] && lengthB != sampleSize)
+            throw std::runtime_error("TMVA SOFIE Conv op: Bias Tensor has wrong shape: " +
+                                     ConvertShapeToString(interpreter.GetTensor(fNB).shape));
+         for (size_t i = 0; i < lengthY; i++)
+            Y[i] += (lengthB == sampleSize) ? B[i % sampleSize] : B[(i / outputSize) % fShapeW[0]];
+      }
+      if (fActivation == EActivationType::RELU) {
+         for (size_t i = 0; i < lengthY; i++)
+            Y[i] = (Y[i] > 0) ? Y[i] : 0;
+      }
+   }
+#endif
+
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
 
@@ -321,189 +496,71 @@ public:
 
       out << "\n//----  operator Conv " << OpName << "\n";
 
-      // vectorize the (dilated)convolution kernels into a matrix
-      // no need to transpose the matrix
-      // to fix for 1d and 3d
-
-      size_t id = (fDim > 2) ? fDim-3 : 2;
-      size_t ih = (fDim > 1) ? fDim-2 : 1;
-      size_t iw = fDim-1;
-
-      size_t wstrideDil = fAttrDilations[iw];
-      size_t hstride = kWidth;
-      size_t hstrideDil = fAttrDilations[ih] * fAttrKernelShape[iw];  // stride dilated in the height
-      size_t dstride = kHeight * kWidth;
-      size_t dstrideDil = fAttrDilations[id] * fAttrKernelShape[ih] * fAttrKernelShape[iw];
-      size_t icstride = kHeight * kWidth * kDepth;
-      size_t icstrideDil = fAttrKernelShape[id] * fAttrKernelShape[ih] * fAttrKernelShape[iw];
-      size_t ocstride = fShapeW[1] * icstride;
-      size_t ocstrideDil = fShapeW[1] * icstrideDil;
-
-      out << SP << "for (std::size_t oc = 0; oc < " << fShapeW[0] << "; oc++) {\n";
-      out << SP << SP << "for (std::size_t ic = 0; ic < " << fShapeW[1] << "; ic++) {\n";
-      if (fDim > 2)
-         out << SP << SP << SP << "for (std::size_t kd = 0; kd < " << kDepth << "; kd++) {\n";
-      if (fDim > 1)
-         out << SP << SP << SP << "for (std::size_t kh = 0; kh < " << kHeight << "; kh++) {\n";
-      out << SP << SP << SP << SP << "for (std::size_t kw = 0; kw < " << kWidth << "; kw++) {\n";
-
-      out << SP << SP << SP << SP << SP << "tensor_" <<fNX <<  "_f[oc * "
-          << ocstrideDil << " + ic * " << icstrideDil;
-      if (fDim > 2) out << " + kd * " << dstrideDil;
-      if (fDim > 1) out << " + kh * " << hstrideDil;
-      out << " + kw * " << wstrideDil  << "  ] = tensor_" << fNW << "[oc * " << ocstride << " + ic * " << icstride;
-      if (fDim > 2) out << " + kd * " << dstride;
-      if (fDim > 1) out << " + kh * " << hstride;
-      out  << " + kw ];\n";
-
-      out << SP << SP << SP << SP << "}\n";
-      if (fDim > 1) out << SP << SP << SP << "}\n";
-      if (fDim > 2) out << SP << SP << SP << "}\n";
-      out << SP << SP << "}\n";
-      out << SP << "}\n";
-
-      //out << SP << "char " << OpName << "_transA = 'T';\n";
-      out << SP << "char " << OpName << "_transA = 'N';\n";
-      out << SP << "char " << OpName << "_transB = 'N';\n";
-      out << SP << "int " << OpName << "_m = " << oHeight * oWidth * oDepth << ";\n"; // output h*w
+      if (!fNWBlocked.empty()) {
+         out << SP << "for (size_t n = 0; n < " << bsize << "; n++) {\n";
+         out << SP << SP << "SOFIE::UTILITY::DirectConvBlocked2d<" << kChannelBlockSize << ", "
+             << (fBlockedInput ? "true" : "false") << ", " << (fBlockedOutput ? "true" : "false") << ">(tensor_" << fNX
+             << " + n * " << fShapeX[1] * iHeight * iWidth << ", tensor_" << fNWBlocked << ", tensor_" << fNBBlocked
+             << ", " << fShapeW[1] << "," << iHeight << "," << iWidth << "," << fShapeW[0] << "," << kHeight << ","
+             << kWidth << "," << fAttrPads[0] << "," << fAttrPads[1] << "," << fAttrStrides[0] << ","
+             << fAttrStrides[1] << "," << fAttrDilations[0] << "," << fAttrDilations[1] << ", "
+             << ((fActivation == EActivationType::RELU) ? "true" : "false") << ", tensor_" << fNY << " + n * "
+             << fShapeY[1] * oHeight * oWidth << ");\n";
+         out << SP << "}\n";
+         return out.str();
+      }
+
       assert(fShapeY[1] == fShapeW[0]);
       assert(fShapeW[1] == fShapeX[1] / fAttrGroup);
-      out << SP << "int " << OpName << "_n = " << fShapeW[0] << ";\n"; // output channels
-      out << SP << "int " << OpName << "_k = " << fShapeW[1] * fAttrKernelShape[0] * fAttrKernelShape[1] * fAttrKernelShape[2] << ";\n";
-      out << SP << "float " << OpName << "_alpha = 1.0;\n";
-      out << SP << "float " << OpName << "_beta = 0.0;\n";
-
+      size_t channels = fShapeW[1];  // input channels per group
+      size_t outChannels = fShapeW[0] / fAttrGroup;
+      size_t inputSize = iDepth * iHeight * iWidth;
+      size_t outputSize = oDepth * oHeight * oWidth;
 
       // Loop on batch size
       out << SP << "for (size_t n = 0; n < " << bsize << "; n++) {\n";
+      out << SP << SP << "size_t out_offset = n * " << fShapeY[1] * outputSize << ";\n";
+      out << SP << SP << "size_t x_offset = n * " << fShapeX[1] * inputSize << ";\n";
 
-      // IM2COL: Unroll the input tensor
-      // order input data as  (e.g. kernel 2x2)  and (xa,ya) is channel 1 and (xb,yb) is channel 2
-      //   (xa1,..,xak,ya1,..yak)(xb1,...,xbk,yb1,..,ybk)
-      //   (xa2,...xak+1,ya1,...yak)(......)
-      // trick for speed is using caffe im2col and output a matrix which contains filtered values as rows.
-      // By doing this one has consecutive memory reads and writes
-      // Resulting matrix op_xcol is (input channels * filter_h * filter_w , output_h * output_w)
-      if (fDim ==1) {
-         if (fAttrPads[0] != fAttrPads[1] ) {
-            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding "
-                      << std::endl;
-            fAttrPads[0] = (fAttrPads[0] + fAttrPads[1]) / 2;
-         }
-         fAttrPads[1] = 0;
-         fAttrStrides[1] = 1;
-      }
-      if (fDim == 2) {
-         if (fAttrPads[0] != fAttrPads[2] || fAttrPads[1] != fAttrPads[3]) {
-            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding " << std::endl;
-            fAttrPads[0] = (fAttrPads[0] + fAttrPads[2]) / 2;
-            fAttrPads[1] = (fAttrPads[1] + fAttrPads[3]) / 2;
-         }
-      }
-      if (fDim == 3) {
-         if (fAttrPads[0] != fAttrPads[3] || fAttrPads[1] != fAttrPads[4] || fAttrPads[2] != fAttrPads[5]) {
-            std::cout << "TMVA SOFIE Operator Conv:  asymmetric padding not supported. Assume an average padding " << std::endl;
-            fAttrPads[0] = (fAttrPads[0] + fAttrPads[3]) / 2;
-            fAttrPads[1] = (fAttrPads[1] + fAttrPads[4]) / 2;
-            fAttrPads[2] = (fAttrPads[2] + fAttrPads[5]) / 2;
-         }
-      }
-      out << SP << SP << "size_t out_offset = n * " << fShapeY[1] * oDepth * oHeight * oWidth << ";\n";
-
-      if (fAttrGroup == 1) {
-         out << SP << SP << "size_t x_offset = n * " << fShapeX[1] * iHeight * iWidth << ";\n";
-         // when using im2col - resulting matrix is transposed, the dimension is (input_c * filter_h * filter_y,  output_h *
-         // output_w)
-         if (fDim < 3) {
-            out << SP << SP << "SOFIE::UTILITY::Im2col<float>(tensor_" << fNX
-                << " + x_offset,"
-                //  channels, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
-                //  dilation_w,
-                //
-                << fShapeW[1] << "," << iHeight << "," << iWidth << ",";
-            if (fDim == 1)
-               out << "1, " << fAttrKernelShape[0] << ",0," << fAttrPads[0] << ",1," << fAttrStrides[0] << ",1,"
-                   << fAttrDilations[0];
-            else // dim ==2
-               out << fAttrKernelShape[0] << "," << fAttrKernelShape[1] << "," << fAttrPads[0] << "," << fAttrPads[1]
-                   << "," << fAttrStrides[0] << "," << fAttrStrides[1] << "," << fAttrDilations[0] << ","
-                   << fAttrDilations[1];
-            out << "," << "tensor_" <<fNX << "_xcol);\n\n ";
-         } else {
-            // 3d im2col
-            out << SP << SP << "SOFIE::UTILITY::Im2col_3d<float>(tensor_" << fNX
-                << " + x_offset,"
-                //  channels, d, h, w, k_d, k_h, k_w, pad_d, pad_h, pad_w, stride_d, stride_h, stride_w,
-                //  dilation_d, dilation_h, dilation_w,
-                //
-                << fShapeW[1] << "," << iDepth << "," << iHeight << "," << iWidth << ","
-                << fAttrKernelShape[0] << "," << fAttrKernelShape[1] << "," << fAttrKernelShape[2] << ","
-                << fAttrPads[0] << "," << fAttrPads[1] << "," << fAttrPads[2] << ","
-                << fAttrStrides[0] << "," << fAttrStrides[1] << "," << fAttrStrides[2] << ","
-                << fAttrDilations[0] << "," << fAttrDilations[1] << "," << fAttrDilations[2] << ","
-                << "tensor_" << fNX << "_xcol);\n\n ";
-         }
-         // BLAS
-         out << SP << SP << "BLAS::sgemm_(&" << OpName << "_transA, &" << OpName << "_transB, &" << OpName << "_m, &"
-             << OpName << "_n, &" << OpName << "_k, &" << OpName << "_alpha, " << "tensor_" << fNX << "_xcol, &" << OpName
-             << "_m,\n"; // use m if op_xcol is not transpose , otherwise k
-         out << SP << SP << SP << "tensor_" << fNX << "_f, &" << OpName << "_k, &" << OpName << "_beta, tensor_" << fNY
-             << " + out_offset, &" << OpName << "_m);\n";
+      if (fKernelVariant == "direct") {
+         out << SP << SP << "SOFIE::UTILITY::DirectConv2d<float>(tensor_" << fNX << " + x_offset, tensor_" << fNW << ","
+             << fShapeW[1] << "," << iHeight << "," << iWidth << "," << fShapeW[0] << ",";
+         // the weights are not dilated: use the original kernel size
+         if (fDim == 1)
+            out << "1, " << kWidth << ",0," << fAttrPads[0] << ",1," << fAttrStrides[0] << ",1,"
+                << fAttrDilations[0];
+         else
+            out << kHeight << "," << kWidth << "," << fAttrPads[0] << "," << fAttrPads[1]
+                << "," << fAttrStrides[0] << "," << fAttrStrides[1] << "," << fAttrDilations[0] << ","
+                << fAttrDilations[1];
+         out << ", tensor_" << fNY << " + out_offset);\n";
       } else {
-         // case of group convolution
-         // Unroll (IM2COL) the input tensor- make loop on groups and repeat operations (IM2COL + GEMM for each
-         // group)
-         // out << SP << SP << "size_t out_offset = n * " << fShapeY[1] * oDepth * oHeight * oWidth << ";\n";
-         out << SP << SP << "for (size_t g = 0; g < " << fAttrGroup << "; g++) {\n";
-         out << SP << SP << "size_t x_offset = n * " << fShapeX[1] * iDepth * iHeight * iWidth << " + g * "
-             << fShapeW[1] * iDepth * iHeight * iWidth << ";\n ";
-         out << SP << SP << "size_t out_offset = n * " << fShapeY[1] * oDepth * oHeight * oWidth << " + g * "
-             << fShapeW[0] * oDepth * oHeight * oWidth / fAttrGroup << ";\n ";
-
-         if (fDim < 3) {
-            out << SP << SP << "SOFIE::UTILITY::Im2col<float>(tensor_" << fNX
-                << " + x_offset,"
-                //  channels, height, width, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
-                //  dilation_w,
-                //
-                << fShapeW[1] << "," << iHeight << "," << iWidth << ",";
-            if (fDim == 1)
-               out << "1, " << fAttrKernelShape[0] << ",0," << fAttrPads[0] << ",1," << fAttrStrides[0] << ",1,"
-                   << fAttrDilations[0];
-            else // dim ==2
-               out << fAttrKernelShape[0] << "," << fAttrKernelShape[1] << "," << fAttrPads[0] << "," << fAttrPads[1]
-                   << "," << fAttrStrides[0] << "," << fAttrStrides[1] << "," << fAttrDilations[0] << ","
-                   << fAttrDilations[1];
-            out << ", tensor_" << fNX << "_xcol);\n\n ";
-         } else {
-            // 3d im2col
-            out << SP << SP << "SOFIE::UTILITY::Im2col_3d<float>(tensor_" << fNX
-                << " + x_offset,"
-                //  channels, d, h, w, k_d, k_h, k_w, pad_d, pad_h, pad_w, stride_d, stride_h, stride_w,
-                //  dilation_d, dilation_h, dilation_w,
-                //
-                << fShapeW[1] << "," << iDepth << "," << iHeight << "," << iWidth << "," << fAttrKernelShape[0] << ","
-                << fAttrKernelShape[1] << "," << fAttrKernelShape[2] << "," << fAttrPads[0] << "," << fAttrPads[1]
-                << "," << fAttrPads[2] << "," << fAttrStrides[0] << "," << fAttrStrides[1] << "," << fAttrStrides[2]
-                << "," << fAttrDilations[0] << "," << fAttrDilations[1] << "," << fAttrDilations[2] << ",tensor_" << fNX
-                << "_xcol);\n\n ";
+         // implicit Gemm for each group: the panels of the im2col matrix (channels * kernel size, output size) are
+         // unrolled on the fly and multiplied with the filters, which are used as they are (not dilated).
+         // The attributes are given along (depth, height, width), 1d and 2d convolutions have a depth (and height) of 1
+         size_t offset = 3 - fDim;
+         auto spatial = [&](const std::vector<size_t> &attr, size_t missing) {
+            std::stringstream s;
+            for (size_t i = 0; i < 3; i++)
+               s << ((i < offset) ? missing : attr[i - offset]) << ",";
+            return s.str();
+         };
+         std::string indent = SP + SP;
+         if (fAttrGroup > 1) {
+            out << SP << SP << "for (size_t g = 0; g < " << fAttrGroup << "; g++) {\n";
+            indent += SP;
          }
-
-         // BLAS
-         // n must be divided by the number of groups
-         out << SP << SP << SP << OpName << "_n = " << fShapeW[0] / fAttrGroup << ";\n";
-         // offset g must be  g * k * n
-         out << SP << SP << SP << "size_t offset_f = g * "
-             << fShapeW[0] * fShapeW[1] * fAttrKernelShape[0] * fAttrKernelShape[1] * fAttrKernelShape[2] / fAttrGroup
-             << ";\n";
-         out << SP << SP << "BLAS::sgemm_(&" << OpName << "_transA, &" << OpName << "_transB, &" << OpName << "_m, &"
-             << OpName << "_n, &" << OpName << "_k, &" << OpName << "_alpha, tensor_" << fNX << "_xcol, &" << OpName
-             << "_m,\n"; // use m if op_xcol is not transpose , otherwise k
-         out << SP << SP << SP << "tensor_" << fNX << "_f + offset_f, &" << OpName << "_k, &" << OpName << "_beta, tensor_" << fNY
-             << " + out_offset"
-             << ", &" << OpName << "_m);\n";
-
-         out << SP << SP << "}\n"; // end of group loop
+         out << indent << "SOFIE::UTILITY::ConvImplicitGemm(tensor_" << fNX << " + x_offset";
+         if (fAttrGroup > 1) out << " + g * " << channels * inputSize;
+         out << ", tensor_" << fNW;
+         if (fAttrGroup > 1) out << " + g * " << outChannels * channels * kDepth * kHeight * kWidth;
+         out << ", " << channels << "," << iDepth << "," << iHeight << "," << iWidth << "," << outChannels << ","
+             << kDepth << "," << kHeight << "," << kWidth << "," << spatial(fAttrPads, 0)
+             << spatial(fAttrStrides, 1) << spatial(fAttrDilations, 1) << " tensor_" << fNY << " + out_offset";
+         if (fAttrGroup > 1) out << " + g * " << outChannels * outputSize;
+         out << ", tensor_" << fNPanel << ");\n";
+         if (fAttrGroup > 1)
+            out << SP << SP << "}\n"; // end of group loop
       }
 
       if (fNB2 != "") {
@@ -516,6 +573,10 @@ public:
              << OpName << "_incx, tensor_" << fNY << " + out_offset, &" << OpName << "_incy);\n";
 
       }
+      if (fActivation == EActivationType::RELU) {
+         out << SP << SP << "for (size_t id = out_offset; id < out_offset + " << fShapeY[1] * oDepth * oHeight * oWidth << "; id++)\n";
+         out << SP << SP << SP << "tensor_" << fNY << "[id] = ((tensor_" << fNY << "[id] > 0 )? tensor_" << fNY << "[id] : 0);\n";
+      }
       out << SP << "}\n"; // end of batch size loop
 
       return out.str();
@@ -524,6 +585,20 @@ public:
    /*! \brief Returns the blas routines needed to compile the generated code
     */
    std::vector<std::string> GetBlasRoutines() override { return { std::string("Gemm"), std::string("Axpy") }; }
+
+   // implicit Gemm or direct convolution (only for 1d and 2d convolutions without groups)
+   std::vector<std::string> GetKernelVariants() override {
+      if (fAttrGroup != 1 || fDim > 2 || !fNWBlocked.empty()) return {};
+      return { "gemm", "direct" };
+   }
+
+   std::string GetKernelKey() override {
+      std::stringstream key;
+      key << "Conv X" << ConvertShapeToString(fShapeX) << " W" << ConvertShapeToString(fShapeW) << " pads"
+          << ConvertShapeToString(fAttrPads) << " strides" << ConvertShapeToString(fAttrStrides) << " dilations"
+          << ConvertShapeToString(fAttrDilations) << " group=" << fAttrGroup;
+      return key.str();
+   }
 };
 
 } // namespace SOFIE
@@ -18,6 +18,9 @@ namespace SOFIE {
 /*! \brief Transposed Convolution operator
  *
  * Inference code generation for a transposed convolution layer.
+ * The outputs are computed with a sub-pixel decomposition: for each phase of the outputs along the strided
+ * dimensions, a regular convolution of the input is written interleaved in the output (see
+ * UTILITY::ConvTransposeSubPixel).
  * See the <a href="https://github.com/onnx/onnx/blob/main/docs/Operators.md#convtranspose">ONNX documentation</a> for
  * details about the transposed conv layer.
  */
@@ -36,11 +39,12 @@ private:
    std::string fNX;
    std::string fNW;
    std::string fNB;
-   std::string fNBroadcastedB;
    std::string fNY;
 
-   std::string fConvK;
-   std::string fImcol;
+   std::string fNWPacked; ///< weights packed for the sub-convolutions of each phase
+   std::string fNBuffer;  ///< outputs of a phase (empty if all the strides are 1)
+   std::string fNPanel;   ///< buffer of the im2col panels of the sub-convolutions
+   bool fPackWeights = false; ///< weights not initialized, packed at each inference
 
    std::vector<size_t> fShapeX;
    std::vector<size_t> fShapeW;
@@ -48,9 +52,15 @@ private:
    std::vector<size_t> fShapeY;
 
    std::string fType;
+   EActivationType fActivation = EActivationType::UNDEFINED; ///< activation fused from a folded BatchNormalization
 
    size_t fDim; // dimension of the convolution
 
+   /*! \brief Attribute along (depth, height, width), with the value `missing` for the dimensions not present
+    * in 1d and 2d transposed convolutions
+    */
+   std::vector<int> GetSpatialAttribute(const std::vector<size_t> &attr, int missing) const;
+
 public:
    /*! Default constructor of ROperator_ConvTranspose */
    ROperator_ConvTranspose() {}
@@ -111,9 +121,16 @@ public:
     */
    void Initialize(RModel &) override;
 
-   /*! \brief Generate code for initializing the op
+   /*! \brief Fold a per-channel affine transformation (e.g. BatchNormalization) applied on the output
+    * in the weights and the bias
+    * \param model Model
+    * \param scale scale of each output channel
+    * \param shift shift of each output channel
+    * \param newOutputName name of the output after folding
+    * \param activation activation applied after the affine transformation
     */
-   std::string GenerateInitCode() override;
+   bool FoldChannelAffine(RModel &model, const std::vector<float> &scale, const std::vector<float> &shift,
+                          const std::string &newOutputName, EActivationType activation) override;
 
    /*! \brief Generate the inference code
     * \param opName name of the operator
@@ -122,7 +139,7 @@ public:
 
    /*! \brief Returns the blas routines needed to compile the generated code
     */
-   std::vector<std::string> GetBlasRoutines() override { return { std::string("Gemm"), std::string("Axpy") }; }
+   std::vector<std::string> GetBlasRoutines() override { return { std::string("Gemm") }; }
 };
 
 } // namespace SOFIE
@@ -7,6 +7,10 @@
 
 #include <sstream>
 #include <cassert>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <set>
 
 
 namespace SOFIE{
@@ -26,10 +30,26 @@ private:
    std::vector<std::string> fInputLabels;
    std::string fOutputLabels;
    std::string fSumLabels;  // string containing the reducing labels
-   std::string fGemmType;
 
    std::vector<int> fSumDims; // dimension of the labels we use to perform summing
 
+   // one pairwise contraction of the plan, computed as the batched product
+   //  R[batch,m,n] = A[batch,m,k] * B[batch,k,n]
+   struct ContractionStep {
+      std::string fNA, fNB, fNR;         // operand and result tensors
+      std::string fLabelsA, fLabelsB;    // labels of the operands as stored in memory
+      std::string fNPermA, fNPermB;      // tensors with the permuted (and reduced) operands, empty if not needed
+      std::string fBatch, fM, fN, fK;    // labels of the batch, rows, columns and contracted dimensions
+      bool fTransA = false;
+      bool fTransB = false;
+   };
+   bool fUsePlan = false;                  // contraction lowered to (batched) GEMM
+   std::vector<ContractionStep> fPlan;
+   std::string fNFinal;                    // tensor to permute in the output when not computed in place
+   std::string fFinalLabels;
+   std::map<char, size_t> fLabelDims;
+   std::vector<std::string> fNScratch;     // intermediate tensors of the plan (allocated in the memory pool)
+
    std::vector<std::vector<size_t>> fShapeInputs;
    std::vector<size_t> fShapeY;
 
@@ -122,10 +142,114 @@ public:
       return ret;
    }
 
+   // Plan the pairwise contractions. At each step the pair of operands with the lowest cost
+   // (number of multiply-adds, i.e. product of the dimensions of all their labels) is contracted,
+   // as in the greedy strategy of opt_einsum. Labels of an operand that are not needed by the output or
+   // by the other operands are summed when permuting the operand.
+   void PlanContractions(RModel & model) {
+      // the plan is made again when the operator is initialized again
+      fPlan.clear();
+      fNScratch.clear();
+      fScratchTensorNames.clear();
+      fNFinal.clear();
+      fFinalLabels.clear();
+      auto type = model.GetTensorType(fNInputs[0]);
+      auto length = [&](const std::string & labels) {
+         size_t n = 1;
+         for (char l : labels) n *= fLabelDims[l];
+         return n;
+      };
+      auto addScratch = [&](const std::string & labels) {
+         std::string name = fNY + "_einsum" + std::to_string(fNScratch.size());
+         std::vector<size_t> shape;
+         for (char l : labels) shape.push_back(fLabelDims[l]);
+         if (shape.empty()) shape = {1};
+         model.AddIntermediateTensor(name, type, shape);
+         fNScratch.push_back(name);
+         return name;
+      };
+      auto contains = [](const std::string & labels, char l) { return labels.find(l) != std::string::npos; };
+
+      std::vector<std::string> labels(fInputLabels);
+      std::vector<std::string> names(fNInputs);
+      std::vector<size_t> alive(labels.size());
+      std::iota(alive.begin(), alive.end(), 0);
+      while (alive.size() > 1) {
+         // find the cheapest pair
+         size_t ia = 0, ib = 1;
+         size_t minCost = std::numeric_limits<size_t>::max();
+         for (size_t i = 0; i < alive.size(); i++) {
+            for (size_t j = i + 1; j < alive.size(); j++) {
+               std::string all = labels[alive[i]];
+               for (char l : labels[alive[j]])
+                  if (!contains(all, l)) all += l;
+               size_t cost = length(all);
+               if (cost < minCost) {
+                  minCost = cost;
+                  ia = i;
+                  ib = j;
+               }
+            }
+         }
+         // labels still needed after this contraction
+         std::string needed = fOutputLabels;
+         for (size_t i = 0; i < alive.size(); i++) {
+            if (i != ia && i != ib) needed += labels[alive[i]];
+         }
+         ContractionStep step;
+         step.fNA = names[alive[ia]];
+         step.fNB = names[alive[ib]];
+         step.fLabelsA = labels[alive[ia]];
+         step.fLabelsB = labels[alive[ib]];
+         for (char l : step.fLabelsA) {
+            bool inB = contains(step.fLabelsB, l);
+            bool keep = contains(needed, l);
+            if (inB && keep) step.fBatch += l;
+            else if (inB) step.fK += l;
+            else if (keep) step.fM += l;
+         }
+         for (char l : step.fLabelsB) {
+            if (!contains(step.fLabelsA, l) && contains(needed, l)) step.fN += l;
+         }
+         // use the operands in place when their layout is already the one of a (transposed) matrix
+         if (step.fLabelsA != step.fBatch + step.fM + step.fK) {
+            if (step.fLabelsA == step.fBatch + step.fK + step.fM)
+               step.fTransA = true;
+            else
+               step.fNPermA = addScratch(step.fBatch + step.fM + step.fK);
+         }
+         if (step.fLabelsB != step.fBatch + step.fK + step.fN) {
+            if (step.fLabelsB == step.fBatch + step.fN + step.fK)
+               step.fTransB = true;
+            else
+               step.fNPermB = addScratch(step.fBatch + step.fK + step.fN);
+         }
+         std::string labelsR = step.fBatch + step.fM + step.fN;
+         // last contraction is written directly in the output when possible
+         if (alive.size() == 2 && labelsR == fOutputLabels)
+            step.fNR = fNY;
+         else
+            step.fNR = addScratch(labelsR);
+         labels.push_back(labelsR);
+         names.push_back(step.fNR);
+         fPlan.push_back(step);
+         alive.erase(alive.begin() + ib);
+         alive.erase(alive.begin() + ia);
+         alive.push_back(labels.size() - 1);
+      }
+      fNFinal = (names[alive[0]] != fNY) ? names[alive[0]] : "";
+      fFinalLabels = labels[alive[0]];
+
+      // the intermediate tensors are placed in the memory pool and released once the operator is executed
+      fScratchTensorNames.assign(fNScratch.begin(), fNScratch.end());
+   }
+
    void Initialize(RModel& model) override {
       // input must be a graph input, or already initialized intermediate tensor
       size_t i = 0;
       std::map<char, int> labelsMap;
+      fShapeInputs.clear();
+      fShapeY.clear();
       for ( auto & name : fNInputs) {
          if (!model.CheckIfTensorAlreadyExist(name))
             throw std::runtime_error(std::string("TMVA SOFIE Einsum Op Input Tensor ") + name + "is not found in model");
@@ -163,26 +287,20 @@ public:
          }
       }
 
-      // check if we can use MatMul for EinSum
-      // need to have one sum labels in the last 2 and have the first in common
-      if (fNInputs.size() == 2 && fSumDims.size() == 1 && fShapeInputs[0].size() >=2 && fShapeInputs[1].size() >= 2 ) {
-         // find positions of dum labels
-         char l = fSumLabels[0];
-         size_t pos1 = fInputLabels[0].find(l);
-         size_t pos2 = fInputLabels[1].find(l);
-         // check if summing is done in the last 2 indices of tensor
-
-         if (pos1 == fInputLabels[0].length() - 1 && pos2 == fInputLabels[1].length() - 2)
-            fGemmType = "nn";
-         else if (pos1 == fInputLabels[0].length() - 2 && pos2 == fInputLabels[1].length() - 2)
-            fGemmType = "tn";
-         else if (pos1 == fInputLabels[0].length() - 1 && pos2 == fInputLabels[1].length() - 1)
-            fGemmType = "nt";
-         else if (pos1 == fInputLabels[0].length() - 2 && pos2 == fInputLabels[1].length() - 1)
-            fGemmType = "tt";
-         else
-            fGemmType = "";
+      // lower the contraction to a sequence of (batched) GEMM, unless some labels are repeated in
+      // the same tensor (traces, diagonals) where the generic loops are used
+      fLabelDims.clear();
+      for (auto & l : labelsMap)
+         fLabelDims[l.first] = l.second;
+      fUsePlan = true;
+      for (auto & labels : fInputLabels) {
+         if (std::set<char>(labels.begin(), labels.end()).size() != labels.length())
+            fUsePlan = false;
       }
+      if (std::set<char>(fOutputLabels.begin(), fOutputLabels.end()).size() != fOutputLabels.length())
+         fUsePlan = false;
+      if (fUsePlan)
+         PlanContractions(model);
 
       model.AddIntermediateTensor(fNY, model.GetTensorType(fNInputs[0]), fShapeY);
 
@@ -231,8 +349,63 @@ public:
 
       auto outputStride = UTILITY::ComputeStrideFromShape(fShapeY);
 
+      if (fUsePlan) {
+         // permute an operand (summing the labels which are not in the target) with the labels of the target
+         auto permute = [&](const std::string & nameIn, const std::string & labelsIn, const std::string & nameOut,
+                            const std::string & labelsOut) {
+            std::string perm;
+            std::vector<size_t> order;
+            for (char l : labelsOut) order.push_back(labelsIn.find(l));
+            for (size_t i = 0; i < labelsIn.length(); i++) {
+               if (labelsOut.find(labelsIn[i]) == std::string::npos) order.push_back(i);
+            }
+            std::vector<size_t> shape;
+            for (char l : labelsIn) shape.push_back(fLabelDims[l]);
+            if (shape.empty()) shape = {1};
+            if (order.empty()) order = {0};
+            out << SP << "{\n";
+            out << SP << SP << "const size_t shape[] = " << ConvertValuesToString(shape) << ";\n";
+            out << SP << SP << "const size_t perm[] = " << ConvertValuesToString(order) << ";\n";
+            out << SP << SP << "SOFIE::UTILITY::EinsumTranspose(tensor_" << nameIn << ", " << shape.size()
+                << ", shape, perm, " << labelsOut.length() << ", tensor_" << nameOut << ");\n";
+            out << SP << "}\n";
+         };
+         auto length = [&](const std::string & labels) {
+            size_t n = 1;
+            for (char l : labels) n *= fLabelDims[l];
+            return n;
+         };
+         for (auto & step : fPlan) {
+            out << SP << "// contract " << step.fLabelsA << "," << step.fLabelsB << "->"
+                << step.fBatch + step.fM + step.fN << "\n";
+            std::string nA = step.fNA;
+            std::string nB = step.fNB;
+            if (!step.fNPermA.empty()) {
+               permute(step.fNA, step.fLabelsA, step.fNPermA, step.fBatch + step.fM + step.fK);
+               nA = step.fNPermA;
+            }
+            if (!step.fNPermB.empty()) {
+               permute(step.fNB, step.fLabelsB, step.fNPermB, step.fBatch + step.fK + step.fN);
+               nB = step.fNPermB;
+            }
+            size_t m = length(step.fM);
+            size_t n = length(step.fN);
+            size_t k = length(step.fK);
+            out << SP << "{\n";
+            out << SP << SP << "const size_t batchShape[] = {" << length(step.fBatch) << "};\n";
+            out << SP << SP << "const size_t strideA[] = {" << m * k << "};\n";
+            out << SP << SP << "const size_t strideB[] = {" << k * n << "};\n";
+            out << SP << SP << "SOFIE::UTILITY::BatchedGemm(" << (step.fTransA ? "true" : "false") << ", "
+                << (step.fTransB ? "true" : "false") << ", " << m << ", " << n << ", " << k << ", 1.f, tensor_" << nA
+                << ", tensor_" << nB << ", 0.f, tensor_" << step.fNR << ", 1, batchShape, strideA, strideB);\n";
+            out << SP << "}\n";
+         }
+         if (!fNFinal.empty())
+            permute(fNFinal, fFinalLabels, fNY, fOutputLabels);
+         return out.str();
+      }
+
       // loops on the output indices  i0,....iN
-      if (fGemmType.empty()) {
       int outDims = fShapeY.size();
       int inDims = fSumLabels.length();
       assert(outDims == int(fOutputLabels.size()));
@@ -272,66 +445,6 @@ public:
       }
 
 
-      } else {
-         // case we use Gemm
-         out << SP << "// implementing Einsum using MatMul   \n";
-         // note A is second input and B first one - due to transpose of Fortran rep.
-         out << SP << "char " << opName << "_transA = '" << fGemmType[0] << "';\n";
-         out << SP << "char " << opName << "_transB = '" << fGemmType[1] << "';\n";
-         // need to consider case A and B have dim > 2 (for MatMul)
-         int64_t dimA = fShapeInputs[0].size();
-         int64_t dimB = fShapeInputs[1].size();
-
-         auto m = (fGemmType[0] == 't') ? fShapeInputs[0][dimA-1] : fShapeInputs[0][dimA-2];
-         auto n = (fGemmType[1] == 't') ? fShapeInputs[1][dimB-2] : fShapeInputs[1][dimB-1];
-         auto k = (fGemmType[0] == 't') ? fShapeInputs[0][dimA-2] : fShapeInputs[0][dimA-1];
-
-         out << SP << "int " << opName << "_m = " << m << ";\n";
-         out << SP << "int " << opName << "_n = " << n << ";\n";
-         out << SP << "int " << opName << "_k = " << k << ";\n";
-         out << SP << "float " << opName << "_alpha = 1.0;\n";
-         out << SP << "float " << opName << "_beta = 0.0;\n";
-         out << SP << "int " << opName << "_lda = " << ((fGemmType[0] == 't') ? m : k) << ";\n";
-         out << SP << "int " << opName << "_ldb = " << ((fGemmType[1] == 't') ? k : n) << ";\n";
-
-         auto inputStrideA = UTILITY::ComputeStrideFromShape(fShapeInputs[0]);
-         auto inputStrideB = UTILITY::ComputeStrideFromShape(fShapeInputs[1]);
-
-         int stackDims = fShapeY.size()-2;
-         for (int i = 0; i < stackDims; i++) {
-            for (int j = 0; j < i; j++) out << SP;
-            std::string l {fOutputLabels[i]};
-            out << "for (int " << l << " = 0; " << l << " < " << fShapeY[i] << "; " << l << "++) {\n";
-         }
-         auto tensorOffset = [](const std::vector<size_t> & stride, const std::string & labels) {
-            std::stringstream strst;
-            int dims = labels.length()-2;
-            // scalar case
-            if (dims == 0) return std::string("0");
-            assert (dims +2 == (int) stride.size());
-            for (int i = 0; i < dims; i++) {
-               strst << stride[i] << "*" << std::string{labels[i]};
-               if (i < dims-1) strst << " + ";
-            }
-            return strst.str();
-         };
-         // only float type supported
-         out << SP << "BLAS::sgemm_(&" << opName << "_transB, &" << opName << "_transA, &" << opName
-             << "_n, &" << opName << "_m, &" << opName << "_k, &" << opName << "_alpha, "
-             << "&tensor_" << fNInputs[1] << "[" << tensorOffset(inputStrideB, fInputLabels[1])
-             << "], &" << opName << "_ldb, "
-             << "&tensor_" << fNInputs[0] << "[" << tensorOffset(inputStrideA, fInputLabels[0]  ) << "], &" << opName << "_lda, &" << opName << "_beta, "
-             << "&tensor_" << fNY << "[" << tensorOffset(outputStride,fOutputLabels) << "],  &" << opName << "_n);\n";
-
-
-         for (int i = stackDims-1; i >= 0; i--) {
-            for (int j = 0; j < i; j++) out << SP;
-            out << "}\n";
-         }
-
-      }
-
-
       return out.str();
    }
 
@@ -56,6 +56,8 @@ public:
    }
 
 
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override { return EBlockedLayoutSupport::SAME; }
+
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
       if (fShape.empty()) {
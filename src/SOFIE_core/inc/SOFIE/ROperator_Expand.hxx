@@ -29,7 +29,7 @@ public:
    ROperator_Expand(){}
    ROperator_Expand(std::string nameX, std::string nameShape, std::string nameY):
       fNX(UTILITY::Clean_name(nameX)), fNShape(UTILITY::Clean_name(nameShape)), fNY(UTILITY::Clean_name(nameY)){
-         fInputTensorNames = { fNX };
+         fInputTensorNames = { fNX, fNShape };
          fOutputTensorNames = { fNY };
       }
 
@@ -0,0 +1,196 @@
+#ifndef SOFIE_ROPERATOR_FUSEDMLP
+#define SOFIE_ROPERATOR_FUSEDMLP
+
+
+#include "SOFIE/SOFIE_common.hxx"
+#include "SOFIE/ROperator.hxx"
+#include "SOFIE/RModel.hxx"
+
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <iomanip>
+#include <limits>
+#include <cassert>
+
+namespace SOFIE{
+
+/*! \brief Fused multi-layer perceptron operator
+ *
+ * Computes a chain of dense layers  Y = f(...f(f(X * W_0 + B_0) * W_1 + B_1)... * W_L + B_L)  where f is ReLU
+ * for the hidden layers (optionally also for the last one). The rows of X are processed by blocks: the hidden
+ * activations of a block are kept in small tiles which stay in cache across the layers, instead of writing
+ * the full (rows, width) output of every Gemm and Relu operator. Each layer is computed by
+ * UTILITY::DenseBlock specialized for its number of input and output features, with the bias and the
+ * activation fused in, and the weights and biases of all layers are packed in a single tensor.
+ */
+template <typename T>
+class ROperator_FusedMLP final : public ROperator
+{
+
+private:
+
+   std::string fNX;                    ///< input (rows, K_0)
+   std::vector<std::string> fNW;       ///< kernels of the layers (K_i, N_i)
+   std::vector<std::string> fNB;       ///< biases of the layers (N_i), can be empty
+   std::string fNY;                    ///< output (rows, N_L)
+   std::string fNPacked;               ///< packed weights and biases of all layers
+   bool fReluHidden = true;            ///< ReLU applied after the hidden layers
+   bool fReluOutput = false;           ///< ReLU applied after the last layer
+
+   std::vector<Dim> fShapeX;
+   std::vector<Dim> fShapeY;
+   std::vector<size_t> fWidths;        ///< K_0, N_0, N_1, ..., N_L
+   std::vector<size_t> fOffsetW;       ///< offset of the kernel of each layer in the packed tensor
+   std::vector<size_t> fOffsetB;       ///< offset of the bias of each layer in the packed tensor
+   size_t fBlockRows = 0;              ///< number of rows processed together
+   size_t fTileSize = 0;               ///< size of a tile of hidden activations
+
+   std::string fType;
+
+public:
+
+   ROperator_FusedMLP(){}
+   ROperator_FusedMLP(std::string nameX, std::vector<std::string> nameW, std::vector<std::string> nameB,
+                      bool reluHidden, bool reluOutput, std::string nameY):
+      fNX(UTILITY::Clean_name(nameX)), fNY(UTILITY::Clean_name(nameY)), fReluHidden(reluHidden),
+      fReluOutput(reluOutput)
+   {
+      if (std::is_same<T, float>::value) {
+         fType = "float";
+      } else {
+         throw std::runtime_error("TMVA SOFIE Encountered unsupported type parsing a FusedMLP operator");
+      }
+      if (nameW.empty() || nameW.size() != nameB.size())
+         throw std::runtime_error("TMVA SOFIE FusedMLP Op needs a kernel and a bias name for each layer");
+      for (auto & name : nameW)
+         fNW.push_back(UTILITY::Clean_name(name));
+      for (auto & name : nameB)
+         fNB.push_back(UTILITY::Clean_name(name));
+      fInputTensorNames = { fNX };
+      for (auto & name : fNW)
+         fInputTensorNames.emplace_back(name);
+      for (auto & name : fNB)
+         if (!name.empty()) fInputTensorNames.emplace_back(name);
+      fOutputTensorNames = { fNY };
+   }
+
+   std::vector<ETensorType> TypeInference(std::vector<ETensorType> input) override {
+      return { input[0] };
+   }
+
+   std::vector<std::vector<size_t>> ShapeInference(std::vector<std::vector<size_t>> input) override {
+      // output is (rows, N_L) with N_L the number of columns of the last kernel
+      return { { input[0][0], input[fNW.size()][1] } };
+   }
+
+   void Initialize(RModel& model) override {
+      if (!model.CheckIfTensorAlreadyExist(fNX))
+         throw std::runtime_error("TMVA SOFIE FusedMLP Op Input Tensor " + fNX + " is not found in model");
+      if (model.IsDynamicTensor(fNX) || model.IsDimInputTensor(fNX))
+         fShapeX = model.GetDynamicTensorShape(fNX);
+      else
+         fShapeX = ConvertShapeToDim(model.GetTensorShape(fNX));
+      if (fShapeX.size() != 2 || fShapeX[1].isParam)
+         throw std::runtime_error("TMVA SOFIE FusedMLP Op needs an input of rank 2 with a fixed number of features");
+
+      // pack kernels and biases of all layers, each one starting at a multiple of 16 floats
+      auto align = [](size_t n) { return (n + 15) / 16 * 16; };
+      fWidths = { fShapeX[1].dim };
+      std::vector<float> packed;
+      for (size_t i = 0; i < fNW.size(); i++) {
+         if (!model.IsInitializedTensor(fNW[i]) || model.GetTensorType(fNW[i]) != ETensorType::FLOAT)
+            throw std::runtime_error("TMVA SOFIE FusedMLP Op kernel " + fNW[i] + " must be an initialized float tensor");
+         auto shapeW = model.GetTensorShape(fNW[i]);
+         if (shapeW.size() != 2 || shapeW[0] != fWidths.back())
+            throw std::runtime_error("TMVA SOFIE FusedMLP Op kernel " + fNW[i] + " has shape " +
+                                     ConvertShapeToString(shapeW) + " not matching " +
+                                     std::to_string(fWidths.back()) + " input features");
+         const size_t K = shapeW[0];
+         const size_t N = shapeW[1];
+         const float * w = static_cast<float *>(model.GetInitializedTensorData(fNW[i]).get());
+         fOffsetW.push_back(packed.size());
+         packed.insert(packed.end(), w, w + K * N);
+         packed.resize(align(packed.size()), 0.f);
+         fOffsetB.push_back(packed.size());
+         if (!fNB[i].empty()) {
+            if (!model.IsInitializedTensor(fNB[i]) || ConvertShapeToLength(model.GetTensorShape(fNB[i])) != N)
+               throw std::runtime_error("TMVA SOFIE FusedMLP Op bias " + fNB[i] + " must be an initialized tensor of size " +
+                                        std::to_string(N));
+            const float * b = static_cast<float *>(model.GetInitializedTensorData(fNB[i]).get());
+            packed.insert(packed.end(), b, b + N);
+            model.SetNotWritableInitializedTensor(fNB[i]);
+         } else {
+            packed.resize(packed.size() + N, 0.f);
+         }
+         packed.resize(align(packed.size()), 0.f);
+         model.SetNotWritableInitializedTensor(fNW[i]);
+         fWidths.push_back(N);
+      }
+      fNPacked = fNY + "_packed";
+      model.AddInitializedTensor<float>(fNPacked, {packed.size()}, packed.data());
+      // the generated code reads only the packed parameters
+      fInputTensorNames = { fNX, fNPacked };
+
+      // blocks of rows whose hidden activations take about 16 kB (multiple of 4 rows, see UTILITY::DenseBlock)
+      size_t maxHidden = 1;
+      for (size_t i = 1; i + 1 < fWidths.size(); i++)
+         maxHidden = std::max(maxHidden, fWidths[i]);
+      fBlockRows = std::min<size_t>(256, std::max<size_t>(4, 4096 / maxHidden / 4 * 4));
+      fTileSize = fBlockRows * maxHidden;
+
+      fShapeY = { fShapeX[0], Dim(fWidths.back()) };
+      if (fShapeX[0].isParam)
+         model.AddDynamicTensor(fNY, model.GetTensorType(fNX), fShapeY);
+      else
+         model.AddIntermediateTensor(fNY, model.GetTensorType(fNX), ConvertShapeToInt(fShapeY));
+
+      if (model.Verbose()) {
+         std::cout << "FusedMLP " << fNX << " ---> " << fNY << " shape " << ConvertDynamicShapeToString(fShapeY)
+                   << " with " << fNW.size() << " layers" << std::endl;
+      }
+      model.AddNeededStdLib("algorithm");
+   }
+
+   std::string GenerateSessionMembersCode(std::string opName) override {
+      if (fNW.size() < 2) return "";
+      opName = "op_" + opName;
+      std::stringstream out;
+      // tiles of hidden activations of a block of rows, used alternately as input and output of the layers
+      out << "std::vector<" << fType << "> fVec_" << opName << "_tile0 = std::vector<" << fType << ">(" << fTileSize << ");\n";
+      if (fNW.size() > 2)
+         out << "std::vector<" << fType << "> fVec_" << opName << "_tile1 = std::vector<" << fType << ">(" << fTileSize << ");\n";
+      return out.str();
+   }
+
+   std::string Generate(std::string opName) override {
+      opName = "op_" + opName;
+      if (fShapeY.empty()) {
+         throw std::runtime_error("TMVA SOFIE FusedMLP Op called to Generate without being initialized first");
+      }
+      const size_t nLayers = fNW.size();
+      std::stringstream out;
+      out << "\n//--------- FusedMLP\n";
+      out << SP << "{\n";
+      out << SP << SP << "const size_t " << opName << "_rows = " << fShapeX[0].GetVal() << ";\n";
+      out << SP << SP << "for (size_t r0 = 0; r0 < " << opName << "_rows; r0 += " << fBlockRows << ") {\n";
+      out << SP << SP << SP << "const size_t nr = std::min<size_t>(" << fBlockRows << ", " << opName << "_rows - r0);\n";
+      for (size_t i = 0; i < nLayers; i++) {
+         std::string input = (i == 0) ? "tensor_" + fNX + " + r0 * " + std::to_string(fWidths[0])
+                                      : "fVec_" + opName + "_tile" + std::to_string((i - 1) % 2) + ".data()";
+         std::string output = (i == nLayers - 1) ? "tensor_" + fNY + " + r0 * " + std::to_string(fWidths.back())
+                                                 : "fVec_" + opName + "_tile" + std::to_string(i % 2) + ".data()";
+         bool relu = (i == nLayers - 1) ? fReluOutput : fReluHidden;
+         out << SP << SP << SP << "SOFIE::UTILITY::DenseBlock<" << fWidths[i] << ", " << fWidths[i + 1] << ", "
+             << (relu ? "true" : "false") << ">(" << input << ", nr, tensor_" << fNPacked << " + " << fOffsetW[i]
+             << ", tensor_" << fNPacked << " + " << fOffsetB[i] << ", " << output << ");\n";
+      }
+      out << SP << SP << "}\n";
+      out << SP << "}\n";
+      return out.str();
+   }
+};
+
+}//SOFIE
+
+#endif //SOFIE_ROPERATOR_FUSEDMLP
@@ -4,7 +4,9 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -212,6 +214,33 @@ public:
       return out.str();
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &x = interpreter.GetTensor(fNX);
+      auto &indices = interpreter.GetTensor(fNIndices);
+      if (indices.type != ETensorType::INT64 && indices.type != ETensorType::INT32)
+         throw std::runtime_error("TMVA SOFIE Gather Op - indices tensor " + fNIndices + " must be of integer type");
+      size_t typeSize = GetTypeSize(x.type);
+      char *y = static_cast<char *>(interpreter.AllocateTensor(fNY, x.type, fShapeY));
+      // X is seen as [outer, X[axis], inner] and Y as [outer, indices, inner]
+      size_t outer = ConvertShapeToLength(std::vector<size_t>(fShapeX.begin(), fShapeX.begin() + fAttrAxis));
+      size_t inner = ConvertShapeToLength(std::vector<size_t>(fShapeX.begin() + fAttrAxis + 1, fShapeX.end())) * typeSize;
+      size_t dimAxis = fShapeX[fAttrAxis];
+      size_t indicesLength = ConvertShapeToLength(fShapeIndices);
+      const char *xData = static_cast<const char *>(x.data);
+      for (size_t i = 0; i < indicesLength; i++) {
+         int64_t k = (indices.type == ETensorType::INT64) ? static_cast<const int64_t *>(indices.data)[i]
+                                                          : static_cast<const int32_t *>(indices.data)[i];
+         if (k < 0)
+            k += dimAxis;
+         if (k < 0 || size_t(k) >= dimAxis)
+            throw std::runtime_error("TMVA SOFIE Gather Op - index " + std::to_string(k) + " is out of range");
+         for (size_t j = 0; j < outer; j++)
+            std::memcpy(y + (j * indicesLength + i) * inner, xData + (j * dimAxis + k) * inner, inner);
+      }
+   }
+#endif
+
 };
 
 }//SOFIE
@@ -0,0 +1,257 @@
+#ifndef SOFIE_ROPERATOR_GATHERGEMM
+#define SOFIE_ROPERATOR_GATHERGEMM
+
+
+#include "SOFIE/SOFIE_common.hxx"
+#include "SOFIE/ROperator.hxx"
+#include "SOFIE/RModel.hxx"
+
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <iomanip>
+#include <limits>
+#include <cassert>
+
+namespace SOFIE{
+
+/*! \brief Fused gather and Gemm operator for the first layer of a GNN edge update
+ *
+ * Computes the linear layer applied on the concatenation of the edge, receiver node, sender node
+ * and global features of each edge, without building the concatenated input:
+ *
+ *    Y[k] = E[k] * W_e + X[r] * W_r + X[s] * W_s + G[graph[r]] * W_g + B,   r = receivers[k], s = senders[k]
+ *
+ * where W = [W_e; W_r; W_s; W_g] is the kernel of the layer split in row blocks and graph[j] is the
+ * graph of node j when several disjoint graphs are processed together (one row of G per graph).
+ * The node projections X * [W_r, W_s] are computed once per node with a single Gemm, the projection
+ * of the globals is added to the receiver part, and they are then gathered by the edge indices.
+ */
+template <typename T>
+class ROperator_GatherGemm final : public ROperator
+{
+
+private:
+
+   std::string fNE;           ///< edge features (num_edges, e)
+   std::string fNX;           ///< node features (num_nodes, n)
+   std::string fNG;           ///< global features (num_graphs, g)
+   std::string fNReceivers;   ///< receiver index of the edges (num_edges)
+   std::string fNSenders;     ///< sender index of the edges (num_edges)
+   std::string fNGraph;       ///< graph index of the nodes (num_nodes)
+   std::string fNW;           ///< kernel of the layer (e + 2n + g, H)
+   std::string fNB;           ///< bias of the layer (H), optional
+   std::string fNY;           ///< output (num_edges, H)
+
+   std::string fNWE;          ///< edge block of the kernel (e, H)
+   std::string fNWX;          ///< receiver and sender blocks of the kernel side by side (n, 2H)
+   std::string fNWG;          ///< global block of the kernel (g, H)
+
+   std::vector<Dim> fShapeE;
+   std::vector<Dim> fShapeX;
+   std::vector<Dim> fShapeG;
+   std::vector<Dim> fShapeY;
+   size_t fSizeE = 0;
+   size_t fSizeX = 0;
+   size_t fSizeG = 0;
+   size_t fSizeH = 0;
+
+   std::string fType;
+
+public:
+
+   ROperator_GatherGemm(){}
+   ROperator_GatherGemm(std::string nameE, std::string nameX, std::string nameG, std::string nameReceivers,
+                        std::string nameSenders, std::string nameGraph, std::string nameW, std::string nameB,
+                        std::string nameY):
+      fNE(UTILITY::Clean_name(nameE)), fNX(UTILITY::Clean_name(nameX)), fNG(UTILITY::Clean_name(nameG)),
+      fNReceivers(UTILITY::Clean_name(nameReceivers)), fNSenders(UTILITY::Clean_name(nameSenders)),
+      fNGraph(UTILITY::Clean_name(nameGraph)), fNW(UTILITY::Clean_name(nameW)), fNB(UTILITY::Clean_name(nameB)),
+      fNY(UTILITY::Clean_name(nameY))
+   {
+      if (std::is_same<T, float>::value) {
+         fType = "float";
+      } else {
+         throw std::runtime_error("TMVA SOFIE Encountered unsupported type parsing a GatherGemm operator");
+      }
+      fInputTensorNames = { fNE, fNX, fNG, fNReceivers, fNSenders, fNGraph, fNW };
+      if (!fNB.empty())
+         fInputTensorNames.emplace_back(fNB);
+      fOutputTensorNames = { fNY };
+   }
+
+   std::vector<ETensorType> TypeInference(std::vector<ETensorType> input) override {
+      return { input[0] };
+   }
+
+   std::vector<std::vector<size_t>> ShapeInference(std::vector<std::vector<size_t>> input) override {
+      // output is (num_edges, H) with H the number of columns of the kernel
+      return { { input[0][0], input[6][1] } };
+   }
+
+   void Initialize(RModel& model) override {
+      for (auto & name : { fNE, fNX, fNG, fNReceivers, fNSenders, fNGraph, fNW }) {
+         if (!model.CheckIfTensorAlreadyExist(name))
+            throw std::runtime_error("TMVA SOFIE GatherGemm Op Input Tensor " + name + " is not found in model");
+      }
+      auto dynamicShape = [&](const std::string & name) {
+         if (model.IsDynamicTensor(name) || model.IsDimInputTensor(name))
+            return model.GetDynamicTensorShape(name);
+         return ConvertShapeToDim(model.GetTensorShape(name));
+      };
+      fShapeE = dynamicShape(fNE);
+      fShapeX = dynamicShape(fNX);
+      fShapeG = dynamicShape(fNG);
+      if (fShapeE.size() != 2 || fShapeX.size() != 2 || fShapeG.size() != 2 || fShapeE[1].isParam ||
+          fShapeX[1].isParam || fShapeG[1].isParam)
+         throw std::runtime_error("TMVA SOFIE GatherGemm Op needs inputs of rank 2 with a fixed number of features");
+      fSizeE = fShapeE[1].dim;
+      fSizeX = fShapeX[1].dim;
+      fSizeG = fShapeG[1].dim;
+
+      // split the kernel in the row blocks applied to each input
+      if (!model.IsInitializedTensor(fNW) || model.GetTensorType(fNW) != ETensorType::FLOAT)
+         throw std::runtime_error("TMVA SOFIE GatherGemm Op kernel " + fNW + " must be an initialized float tensor");
+      auto shapeW = model.GetTensorShape(fNW);
+      if (shapeW.size() != 2 || shapeW[0] != fSizeE + 2 * fSizeX + fSizeG)
+         throw std::runtime_error("TMVA SOFIE GatherGemm Op kernel " + fNW + " has shape " + ConvertShapeToString(shapeW) +
+                                  " not matching the input features");
+      fSizeH = shapeW[1];
+      const float * w = static_cast<float *>(model.GetInitializedTensorData(fNW).get());
+      const size_t H = fSizeH;
+      std::vector<float> wE(w, w + fSizeE * H);
+      std::vector<float> wX(fSizeX * 2 * H);
+      const float * wR = w + fSizeE * H;
+      const float * wS = wR + fSizeX * H;
+      for (size_t i = 0; i < fSizeX; i++) {
+         std::copy(wR + i * H, wR + (i + 1) * H, wX.begin() + i * 2 * H);
+         std::copy(wS + i * H, wS + (i + 1) * H, wX.begin() + i * 2 * H + H);
+      }
+      std::vector<float> wG(wS + fSizeX * H, wS + fSizeX * H + fSizeG * H);
+      fNWE = fNW + "_edge";
+      fNWX = fNW + "_nodes";
+      fNWG = fNW + "_global";
+      model.AddInitializedTensor<float>(fNWE, {fSizeE, H}, wE.data());
+      model.AddInitializedTensor<float>(fNWX, {fSizeX, 2 * H}, wX.data());
+      if (fSizeG > 0)
+         model.AddInitializedTensor<float>(fNWG, {fSizeG, H}, wG.data());
+      // the full kernel is not needed anymore
+      model.SetNotWritableInitializedTensor(fNW);
+      fInputTensorNames = { fNE, fNX, fNG, fNReceivers, fNSenders, fNGraph, fNWE, fNWX };
+      if (fSizeG > 0)
+         fInputTensorNames.emplace_back(fNWG);
+      if (!fNB.empty())
+         fInputTensorNames.emplace_back(fNB);
+
+      if (!fNB.empty()) {
+         if (!model.IsInitializedTensor(fNB) || ConvertShapeToLength(model.GetTensorShape(fNB)) != H)
+            throw std::runtime_error("TMVA SOFIE GatherGemm Op bias " + fNB + " must be an initialized tensor of size " +
+                                     std::to_string(H));
+      }
+
+      fShapeY = { fShapeE[0], Dim(H) };
+      if (fShapeE[0].isParam)
+         model.AddDynamicTensor(fNY, model.GetTensorType(fNE), fShapeY);
+      else
+         model.AddIntermediateTensor(fNY, model.GetTensorType(fNE), ConvertShapeToInt(fShapeY));
+
+      if (model.Verbose()) {
+         std::cout << "GatherGemm " << fNE << " , " << fNX << " , " << fNG << " ---> " << fNY << " shape "
+                   << ConvertDynamicShapeToString(fShapeY) << std::endl;
+      }
+      model.AddNeededStdLib("algorithm");
+   }
+
+   std::string GenerateSessionMembersCode(std::string opName) override {
+      opName = "op_" + opName;
+      std::stringstream out;
+      // projections of the nodes and of the globals (including the bias) of each graph,
+      // resized when a graph with more nodes or a batch with more graphs is processed
+      out << "std::vector<" << fType << "> fVec_" << opName << "_nodeProj;\n";
+      out << "std::vector<" << fType << "> fVec_" << opName << "_globalProj;\n";
+      return out.str();
+   }
+
+   std::string Generate(std::string opName) override {
+      opName = "op_" + opName;
+      if (fShapeY.empty()) {
+         throw std::runtime_error("TMVA SOFIE GatherGemm Op called to Generate without being initialized first");
+      }
+      const std::string H = std::to_string(fSizeH);
+      const std::string H2 = std::to_string(2 * fSizeH);
+      const std::string numEdges = fShapeE[0].GetVal();
+      const std::string numNodes = fShapeX[0].GetVal();
+      const std::string numGraphs = fShapeG[0].GetVal();
+      std::stringstream out;
+      out << "\n//--------- GatherGemm\n";
+      out << SP << "{\n";
+      out << SP << SP << "char " << opName << "_trans = 'n';\n";
+      out << SP << SP << "float " << opName << "_alpha = 1;\n";
+      out << SP << SP << "float " << opName << "_beta = 0;\n";
+      out << SP << SP << "int " << opName << "_nE = " << numEdges << ";\n";
+      out << SP << SP << "int " << opName << "_nX = " << numNodes << ";\n";
+      out << SP << SP << "size_t " << opName << "_nG = " << numGraphs << ";\n";
+      out << SP << SP << "int " << opName << "_n = " << H << ";\n";
+      out << SP << SP << "int " << opName << "_n2 = " << H2 << ";\n";
+      out << SP << SP << "int " << opName << "_kE = " << fSizeE << ";\n";
+      out << SP << SP << "int " << opName << "_kX = " << fSizeX << ";\n";
+      // globals projection and bias of each graph: (num_graphs, H)
+      out << SP << SP << "if (fVec_" << opName << "_globalProj.size() < " << opName << "_nG * " << H << ")\n";
+      out << SP << SP << SP << "fVec_" << opName << "_globalProj.resize(" << opName << "_nG * " << H << ");\n";
+      out << SP << SP << "float * " << opName << "_glob = fVec_" << opName << "_globalProj.data();\n";
+      out << SP << SP << "for (size_t b = 0; b < " << opName << "_nG; b++) {\n";
+      out << SP << SP << SP << "float * gb = " << opName << "_glob + b * " << H << ";\n";
+      if (!fNB.empty())
+         out << SP << SP << SP << "std::copy(tensor_" << fNB << ", tensor_" << fNB << " + " << H << ", gb);\n";
+      else
+         out << SP << SP << SP << "std::fill(gb, gb + " << H << ", 0.f);\n";
+      if (fSizeG > 0) {
+         out << SP << SP << SP << "for (size_t i = 0; i < " << fSizeG << "; i++) {\n";
+         out << SP << SP << SP << SP << "const float g = tensor_" << fNG << "[b * " << fSizeG << " + i];\n";
+         out << SP << SP << SP << SP << "for (size_t h = 0; h < " << H << "; h++)\n";
+         out << SP << SP << SP << SP << SP << "gb[h] += g * tensor_" << fNWG << "[i * " << H << " + h];\n";
+         out << SP << SP << SP << "}\n";
+      }
+      out << SP << SP << "}\n";
+      // receiver and sender projections of every node: (num_nodes, 2H)
+      out << SP << SP << "if (fVec_" << opName << "_nodeProj.size() < size_t(" << opName << "_nX) * " << H2 << ")\n";
+      out << SP << SP << SP << "fVec_" << opName << "_nodeProj.resize(size_t(" << opName << "_nX) * " << H2 << ");\n";
+      out << SP << SP << "float * " << opName << "_proj = fVec_" << opName << "_nodeProj.data();\n";
+      out << SP << SP << "if (" << opName << "_nX > 0)\n";
+      out << SP << SP << SP << "BLAS::sgemm_(&" << opName << "_trans, &" << opName << "_trans, &" << opName << "_n2, &"
+          << opName << "_nX, &" << opName << "_kX, &" << opName << "_alpha, tensor_" << fNWX << ", &" << opName
+          << "_n2, tensor_" << fNX << ", &" << opName << "_kX, &" << opName << "_beta, " << opName << "_proj, &"
+          << opName << "_n2);\n";
+      // the globals of the graph of the receiver are added once per node
+      out << SP << SP << "for (int j = 0; j < " << opName << "_nX; j++) {\n";
+      out << SP << SP << SP << "float * pr = " << opName << "_proj + j * " << H2 << ";\n";
+      out << SP << SP << SP << "const float * gb = " << opName << "_glob + tensor_" << fNGraph << "[j] * " << H << ";\n";
+      out << SP << SP << SP << "for (size_t h = 0; h < " << H << "; h++)\n";
+      out << SP << SP << SP << SP << "pr[h] += gb[h];\n";
+      out << SP << SP << "}\n";
+      // edge projection written in the output
+      out << SP << SP << "if (" << opName << "_nE > 0)\n";
+      out << SP << SP << SP << "BLAS::sgemm_(&" << opName << "_trans, &" << opName << "_trans, &" << opName << "_n, &"
+          << opName << "_nE, &" << opName << "_kE, &" << opName << "_alpha, tensor_" << fNWE << ", &" << opName
+          << "_n, tensor_" << fNE << ", &" << opName << "_kE, &" << opName << "_beta, tensor_" << fNY << ", &" << opName
+          << "_n);\n";
+      // gather the node projections of receivers and senders
+      out << SP << SP << "for (int k = 0; k < " << opName << "_nE; k++) {\n";
+      out << SP << SP << SP << "const float * pr = " << opName << "_proj + tensor_" << fNReceivers << "[k] * " << H2
+          << ";\n";
+      out << SP << SP << SP << "const float * ps = " << opName << "_proj + tensor_" << fNSenders << "[k] * " << H2
+          << " + " << H << ";\n";
+      out << SP << SP << SP << "float * y = tensor_" << fNY << " + k * " << H << ";\n";
+      out << SP << SP << SP << "for (size_t h = 0; h < " << H << "; h++)\n";
+      out << SP << SP << SP << SP << "y[h] += pr[h] + ps[h];\n";
+      out << SP << SP << "}\n";
+      out << SP << "}\n";
+      return out.str();
+   }
+
+   std::vector<std::string> GetBlasRoutines() override { return { std::string("Gemm") }; }
+};
+
+}//SOFIE
+
+#endif //SOFIE_ROPERATOR_GATHERGEMM
@@ -5,6 +5,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 #include <algorithm>
@@ -63,6 +64,7 @@ namespace SOFIE{
          fActivation = activation;
          fType = "float";
 
+         fInputTensorNames = { fNA, fNB, fNC };
          fOutputTensorNames = { fNY };
       }
 
@@ -116,8 +118,9 @@ namespace SOFIE{
                   else
                      throw std::runtime_error("TMVA SOFIE Gemm Op - invalid input shapes " + valueA.GetVal() + " and "
                         + valueB.GetVal());
+               } else {
+                  s_y.push_back(input[0][i]);
                }
-               s_y.push_back(input[0][i]);
             }
          }
 
@@ -136,6 +139,66 @@ namespace SOFIE{
 
 
 
+      // fold a following per-channel affine transformation (BatchNormalization on the N output features)
+      // in the columns of B and in the bias: B'[:,j] = B[:,j] * scale[j], C'[j] = beta * C[j] * scale[j] + shift[j]
+      bool FoldChannelAffine(RModel& model, const std::vector<float>& scale, const std::vector<float>& shift,
+                             const std::string& newOutputName, EActivationType activation) override {
+         if (fActivation != EActivationType::UNDEFINED || !model.IsInitializedTensor(fNB) ||
+             model.GetTensorType(fNB) != ETensorType::FLOAT)
+            return false;
+         // output features must be the channel axis, i.e. Y has shape M x N
+         if (model.IsDynamicTensor(fNA) || model.IsDimInputTensor(fNA) || !model.CheckIfTensorAlreadyExist(fNA) ||
+             model.GetTensorShape(fNA).size() != 2)
+            return false;
+         auto shapeB = model.GetTensorShape(fNB);
+         if (shapeB.size() != 2)
+            return false;
+         size_t k = (fAttrTransB) ? shapeB[1] : shapeB[0];
+         size_t n = (fAttrTransB) ? shapeB[0] : shapeB[1];
+         size_t m = model.GetTensorShape(fNA)[(fAttrTransA) ? 1 : 0];
+         if (n != scale.size())
+            return false;
+         std::vector<size_t> shapeC = {n};
+         if (!fNC.empty()) {
+            if (!model.IsInitializedTensor(fNC) || model.GetTensorType(fNC) != ETensorType::FLOAT)
+               return false;
+            shapeC = model.GetTensorShape(fNC);
+            size_t lengthC = ConvertShapeToLength(shapeC);
+            // bias must be given per feature or for the full output
+            if (shapeC.empty() || shapeC.back() != n || (lengthC != n && lengthC != m * n))
+               return false;
+         }
+         const float *b = static_cast<float *>(model.GetInitializedTensorData(fNB).get());
+         std::shared_ptr<void> new_b_ptr(new float[k * n], std::default_delete<float[]>());
+         float *new_b = static_cast<float *>(new_b_ptr.get());
+         for (size_t i = 0; i < k; i++) {
+            for (size_t j = 0; j < n; j++) {
+               size_t idx = (fAttrTransB) ? j * k + i : i * n + j;
+               new_b[idx] = b[idx] * scale[j];
+            }
+         }
+         size_t lengthC = ConvertShapeToLength(shapeC);
+         std::shared_ptr<void> new_c_ptr(new float[lengthC], std::default_delete<float[]>());
+         float *new_c = static_cast<float *>(new_c_ptr.get());
+         const float *c = (fNC.empty()) ? nullptr : static_cast<float *>(model.GetInitializedTensorData(fNC).get());
+         for (size_t i = 0; i < lengthC; i++)
+            new_c[i] = ((c) ? fAttrBeta * c[i] * scale[i % n] : 0.f) + shift[i % n];
+
+         model.UpdateInitializedTensor(fNB, ETensorType::FLOAT, shapeB, new_b_ptr);
+         if (fNC.empty()) {
+            fNC = newOutputName + "_bias";
+            model.AddInitializedTensor(fNC, ETensorType::FLOAT, shapeC, new_c_ptr);
+         } else {
+            model.UpdateInitializedTensor(fNC, ETensorType::FLOAT, shapeC, new_c_ptr);
+         }
+         fAttrBeta = 1.0;
+         fNY = newOutputName;
+         fActivation = activation;
+         fInputTensorNames = { fNA, fNB, fNC };
+         fOutputTensorNames = { fNY };
+         return true;
+      }
+
       void Initialize(RModel& model) override {
          //TODO: propagate A or B as specified by ONNX standard
 
@@ -289,6 +352,78 @@ namespace SOFIE{
          return out.str();
       }
 
+#ifdef SOFIE_USE_BLAS
+      void Execute(RInterpreter &interpreter) override {
+         // same conventions as in Initialize for the inputs of rank 1 and of different ranks
+         auto shapeA = interpreter.GetTensor(fNA).shape;
+         auto shapeB = interpreter.GetTensor(fNB).shape;
+         bool prependOne = (shapeA.size() == 1);
+         if (prependOne)
+            shapeA.insert(shapeA.begin(), 1);
+         bool appendOne = (shapeB.size() == 1);
+         if (appendOne)
+            shapeB.push_back(1);
+         if (shapeA.size() < shapeB.size())
+            shapeA.insert(shapeA.begin(), shapeB.size() - shapeA.size(), 1);
+         else if (shapeB.size() < shapeA.size())
+            shapeB.insert(shapeB.begin(), shapeA.size() - shapeB.size(), 1);
+         auto shapeY = ShapeInference({shapeA, shapeB})[0];
+         size_t dimY = shapeY.size();
+         int m = (fAttrTransA ? shapeA[dimY - 1] : shapeA[dimY - 2]);
+         int n = (fAttrTransB ? shapeB[dimY - 2] : shapeB[dimY - 1]);
+         int k = (fAttrTransA ? shapeA[dimY - 2] : shapeA[dimY - 1]);
+         if (k != static_cast<int>(fAttrTransB ? shapeB[dimY - 1] : shapeB[dimY - 2]))
+            throw std::runtime_error("TMVA SOFIE Gemm Op - invalid input shapes " + ConvertShapeToString(shapeA) +
+                                     " and " + ConvertShapeToString(shapeB));
+
+         auto outputShape = shapeY;
+         if (prependOne)
+            outputShape.erase(outputShape.begin());
+         if (appendOne)
+            outputShape.pop_back();
+         const float *A = interpreter.GetData<float>(fNA);
+         const float *B = interpreter.GetData<float>(fNB);
+         float *Y = interpreter.AllocateTensor<float>(fNY, outputShape);
+         size_t lengthY = ConvertShapeToLength(shapeY);
+
+         // the bias is broadcasted in the output
+         float beta = 0;
+         if (!fNC.empty()) {
+            auto &shapeC = interpreter.GetTensor(fNC).shape;
+            const float *C = interpreter.GetData<float>(fNC);
+            if (ConvertShapeToLength(shapeC) == lengthY)
+               std::copy(C, C + lengthY, Y);
+            else
+               UTILITY::UnidirectionalBroadcast<float>(C, shapeC, shapeY, std::span<float>(Y, lengthY));
+            beta = fAttrBeta;
+         }
+
+         // stacked products advance on the extra dimensions with the input strides (0 for broadcasted dimensions)
+         std::vector<size_t> batchShape(shapeY.begin(), shapeY.end() - 2);
+         auto stridesA = UTILITY::ComputeStrideFromShape(shapeA);
+         auto stridesB = UTILITY::ComputeStrideFromShape(shapeB);
+         std::vector<size_t> batchStrideA(dimY - 2);
+         std::vector<size_t> batchStrideB(dimY - 2);
+         for (size_t i = 0; i < dimY - 2; i++) {
+            batchStrideA[i] = (shapeA[i] == 1) ? 0 : stridesA[i];
+            batchStrideB[i] = (shapeB[i] == 1) ? 0 : stridesB[i];
+         }
+         // same kernels as in the generated code: BLAS, except for small stacked products
+         size_t blasThreshold = (dimY > 2) ? 32768 : 0;
+         if (fKernelVariant == "blas")
+            blasThreshold = 0;
+         else if (fKernelVariant == "loop")
+            blasThreshold = std::numeric_limits<size_t>::max();
+         UTILITY::BatchedGemm(fAttrTransA, fAttrTransB, m, n, k, fAttrAlpha, A, B, beta, Y, dimY - 2,
+                              batchShape.data(), batchStrideA.data(), batchStrideB.data(), blasThreshold);
+
+         if (fActivation == EActivationType::RELU) {
+            for (size_t id = 0; id < lengthY; id++)
+               Y[id] = (Y[id] > 0) ? Y[id] : 0;
+         }
+      }
+#endif
+
       std::string Generate(std::string opName) override {
          opName = "op_" + opName;
 
@@ -351,28 +486,60 @@ namespace SOFIE{
          // include MatMul case where we stack the Gemm operations
          // exclude case where we have only 1's in the additional dims
          bool doStackMul = dimY > 2 && ( fIsDynamic  || std::stoi(lengthExtra) > 1);
-         if (doStackMul) {
-            out << SP << "size_t " << opName << "_yoffset = 0;\n"; // needed if we stack the gemm operations
-            out << SP << "for (int i = 0; i < " << lengthExtra << "; i++){\n";
-            out << SP;
-         }
+
          // in the case of bias
          if (!fNC.empty()){
-            out << SP << "std::copy(" << "tensor_" << fNC2 << ", " << "tensor_" << fNC2 << " + " << lengthGemm << ", "
-               << "tensor_" << fNY;
-            if (doStackMul) out << " + " << opName << "_yoffset";
-            out << ");\n";
+            if (doStackMul) {
+               out << SP << "for (size_t i = 0; i < " << lengthExtra << "; i++)\n";
+               out << SP << SP << "std::copy(" << "tensor_" << fNC2 << ", " << "tensor_" << fNC2 << " + " << lengthGemm
+                   << ", " << "tensor_" << fNY << " + i * " << lengthGemm << ");\n";
+            } else {
+               out << SP << "std::copy(" << "tensor_" << fNC2 << ", " << "tensor_" << fNC2 << " + " << lengthGemm << ", "
+                  << "tensor_" << fNY << ");\n";
+            }
          }
 
-
          if (fType == "float"){
 
-            out << SP << "BLAS::sgemm_(&" << opName << "_transB, &" << opName << "_transA, &" << opName
-             << "_n, &" << opName << "_m, &" << opName << "_k, &" << opName << "_alpha, " << "tensor_" << fNB
-             << ", &" << opName << "_ldb, " << "tensor_" << fNA << ", &" << opName << "_lda, &" << opName << "_beta, "
-             << "tensor_" << fNY;
-             if (doStackMul) out << " + " << opName << "_yoffset";
-             out << ", &" << opName << "_n);\n";
+            if (doStackMul) {
+               // stacked multiplications are done in a single batched call where each input advances
+               // with its own strides on the extra dimensions (stride 0 when the dimension is broadcasted)
+               auto stridesA = UTILITY::ComputeStrideFromShape(fShapeA);
+               auto stridesB = UTILITY::ComputeStrideFromShape(fShapeB);
+               auto batchStride = [](const Dim & d, const Dim & stride) {
+                  return (!d.isParam && d.dim == 1) ? std::string("0") : stride.GetVal();
+               };
+               out << SP << "const size_t " << opName << "_batchShape[] = {";
+               for (int64_t i = 0; i < dimY - 2; i++)
+                  out << fShapeY[i].GetVal() << ((i < dimY - 3) ? ", " : "};\n");
+               out << SP << "const size_t " << opName << "_batchStrideA[] = {";
+               for (int64_t i = 0; i < dimY - 2; i++)
+                  out << batchStride(fShapeA[i], stridesA[i]) << ((i < dimY - 3) ? ", " : "};\n");
+               out << SP << "const size_t " << opName << "_batchStrideB[] = {";
+               for (int64_t i = 0; i < dimY - 2; i++)
+                  out << batchStride(fShapeB[i], stridesB[i]) << ((i < dimY - 3) ? ", " : "};\n");
+               out << SP << "SOFIE::UTILITY::BatchedGemm(" << (fAttrTransA ? "true" : "false") << ", "
+                   << (fAttrTransB ? "true" : "false") << ", " << opName << "_m, " << opName << "_n, " << opName
+                   << "_k, " << opName << "_alpha, tensor_" << fNA << ", tensor_" << fNB << ", " << opName
+                   << "_beta, tensor_" << fNY << ", " << dimY - 2 << ", " << opName << "_batchShape, " << opName
+                   << "_batchStrideA, " << opName << "_batchStrideB";
+               if (fKernelVariant == "blas")
+                  out << ", 0";
+               else if (fKernelVariant == "loop")
+                  out << ", std::numeric_limits<size_t>::max()";
+               out << ");\n";
+            } else if (fKernelVariant == "loop") {
+               // internal kernel, which can be faster than BLAS for small matrices
+               out << SP << "SOFIE::UTILITY::BatchedGemm(" << (fAttrTransA ? "true" : "false") << ", "
+                   << (fAttrTransB ? "true" : "false") << ", " << opName << "_m, " << opName << "_n, " << opName
+                   << "_k, " << opName << "_alpha, tensor_" << fNA << ", tensor_" << fNB << ", " << opName
+                   << "_beta, tensor_" << fNY << ", 0, nullptr, nullptr, nullptr, std::numeric_limits<size_t>::max());\n";
+            } else {
+               out << SP << "BLAS::sgemm_(&" << opName << "_transB, &" << opName << "_transA, &" << opName
+                   << "_n, &" << opName << "_m, &" << opName << "_k, &" << opName << "_alpha, " << "tensor_" << fNB
+                   << ", &" << opName << "_ldb, " << "tensor_" << fNA << ", &" << opName << "_lda, &" << opName << "_beta, "
+                   << "tensor_" << fNY << ", &" << opName << "_n);\n";
+            }
 
             if(fActivation == EActivationType::RELU){
                out << SP << "for (int id = 0; id < " << SOFIE::ConvertDynamicShapeToLength(fShapeY) << " ; id++){\n";
@@ -381,16 +548,23 @@ namespace SOFIE{
             }
          }
 
-         if (doStackMul) {
-            out << SP << SP <<  opName << "_yoffset += " << lengthGemm << ";\n";
-            out << "}\n"; // end of loop on the stacked multiplications
-         }
-
          return out.str();
       }
 
       std::vector<std::string> GetBlasRoutines() override { return { std::string("Gemm"), std::string("Gemv") }; }
 
+      // BLAS or internal kernel (by default the internal one is used only for small stacked products)
+      std::vector<std::string> GetKernelVariants() override {
+         if (fType != "float" || fIsDynamic) return {};
+         return { "blas", "loop" };
+      }
+
+      std::string GetKernelKey() override {
+         return "Gemm A" + ConvertDynamicShapeToString(fShapeA) + " B" + ConvertDynamicShapeToString(fShapeB) +
+                " transA=" + std::to_string(fAttrTransA) + " transB=" + std::to_string(fAttrTransB) +
+                " bias=" + std::to_string(!fNC.empty());
+      }
+
    };
 
 
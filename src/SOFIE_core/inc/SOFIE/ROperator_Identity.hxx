@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 
@@ -62,6 +63,16 @@ public:
          model.AddIntermediateTensor(fNY, model.GetTensorType(fNX), fShape);
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      // the output is copied since it has its own place in the memory plan
+      auto &shape = interpreter.GetTensor(fNX).shape;
+      const T *x = interpreter.GetData<T>(fNX);
+      T *y = interpreter.AllocateTensor<T>(fNY, shape);
+      std::copy(x, x + ConvertShapeToLength(shape), y);
+   }
+#endif
+
    std::string GenerateInitCode() override {
       // generate init code for identity operator
       if (!fIsInputInitialized) return "";
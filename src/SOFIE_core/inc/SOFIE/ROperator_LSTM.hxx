@@ -55,6 +55,7 @@ template <typename T> class ROperator_LSTM final : public ROperator {
    std::vector<size_t> fShapeY_c;             ///< Shape of the last sequence of the cell states
 
    std::string fType;                         ///< Type of the tensors
+   bool fStreaming = false;                   ///< Keep the state between infer calls
 
  public:
    /*! Default constructor of ROperator_LSTM */
@@ -169,6 +170,12 @@ template <typename T> class ROperator_LSTM final : public ROperator {
     */
    std::string GenerateSessionMembersCode(std::string opName);
 
+   // generate code resetting the hidden (and cell) state kept in streaming mode
+   std::string GenerateStreamingResetCode(std::string opName);
+
+   // session vectors holding the state kept in streaming mode
+   std::vector<std::pair<std::string, TensorInfo>> GetStreamingStateInfo(std::string opName);
+
    /*! \brief Returns the blas routines needed to compile the generated code
     */
    std::vector<std::string> GetBlasRoutines() { return { std::string("Gemm"), std::string("Axpy") }; }
@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 
@@ -58,6 +59,19 @@ public:
    }
 
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &shape = interpreter.GetTensor(fNX).shape;
+      const T *x = interpreter.GetData<T>(fNX);
+      T *y = interpreter.AllocateTensor<T>(fNY, shape);
+      size_t length = ConvertShapeToLength(shape);
+      for (size_t id = 0; id < length; id++)
+         y[id] = (x[id] >= 0) ? x[id] : falpha * x[id];
+   }
+#endif
+
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override { return EBlockedLayoutSupport::SAME; }
+
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
       if (fShape.empty()) {
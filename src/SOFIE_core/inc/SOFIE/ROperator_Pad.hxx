@@ -47,6 +47,10 @@ public:
             fMode = kWrap;
          
          fInputTensorNames = { fNX };
+         for (auto &name : { &fNP, &fNCV, &fNAX }) {
+            if (!name->empty())
+               fInputTensorNames.emplace_back(*name);
+         }
          fOutputTensorNames = { fNY };
       }
 
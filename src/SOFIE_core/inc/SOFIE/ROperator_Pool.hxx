@@ -55,6 +55,7 @@ private:
 
    size_t fDim;   // dimension of the MaxPool
    bool fUseSession = false;
+   bool fBlockedLayout = false;   // input (and output) in the channel-blocked layout
 
 public:
 
@@ -263,6 +264,16 @@ public:
       return out.str();
    }
 
+   // 2d pooling in the channel-blocked layout. An output of size 1x1 (e.g. GlobalAveragePool) has the same
+   // values order in both layouts, it can be used by the operators expecting the plain layout
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override {
+      if (fDim != 2)
+         return EBlockedLayoutSupport::NONE;
+      return (fShapeY[2] * fShapeY[3] == 1) ? EBlockedLayoutSupport::CONVERT : EBlockedLayoutSupport::SAME;
+   }
+
+   void SetBlockedLayout(RModel&, bool blockedInput, bool) override { fBlockedLayout = blockedInput; }
+
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
 
@@ -326,7 +337,48 @@ public:
          doPadding |= (e > 0);
 
 
-      if(fDim==1){
+      if (fBlockedLayout) {
+         // same as the 2d case, the values of the channels of a block being contiguous for each pixel
+         const size_t block = kChannelBlockSize;
+         out << SP << "size_t outIndex = 0;\n";
+         out << SP << "for (size_t n = 0; n < " << fShapeX[0] * fShapeX[1] / block << "; n++) {\n";
+         out << SP << SP << "size_t inputOffset = n*" << fShapeX[2] * fShapeX[3] * block << ";\n";
+         out << SP << SP << "for (int i = hmin; i < hmax; i+=" << fAttrStrides[0] << ") {\n";
+         out << SP << SP << SP << "for (int j = wmin; j < wmax; j+=" << fAttrStrides[1] << ") {\n";
+         out << SP << SP << SP << SP << "float value[" << block << "];\n";
+         out << SP << SP << SP << SP << "for (int b = 0; b < " << block << "; b++) value[b] = "
+             << ((fPoolMode == MaxPool) ? "-INFINITY" : "0") << ";\n";
+         if (fPoolMode == AveragePool) {
+            if (fAttrCountIncludePad == 0 && doPadding)
+               out << SP << SP << SP << SP << "int nsum = 0;\n";
+            else
+               out << SP << SP << SP << SP << "constexpr int nsum = kw*kh;\n";
+         }
+         out << SP << SP << SP << SP << "for (int l = i;  l < i + kh; l++) {\n";
+         out << SP << SP << SP << SP << SP << "if (l < 0 || l >= hsize) continue;\n";
+         out << SP << SP << SP << SP << SP << "for (int m = j; m < j + kw; m++) {\n";
+         out << SP << SP << SP << SP << SP << SP << "if (m < 0 || m >= wsize) continue;\n";
+         out << SP << SP << SP << SP << SP << SP << "const float * x = tensor_" << fNX << " + inputOffset + (l*wsize + m)*"
+             << block << ";\n";
+         if (fPoolMode == MaxPool) {
+            out << SP << SP << SP << SP << SP << SP << "for (int b = 0; b < " << block
+                << "; b++) value[b] = (x[b] > value[b]) ? x[b] : value[b];\n";
+         } else if (fPoolMode == AveragePool) {
+            out << SP << SP << SP << SP << SP << SP << "for (int b = 0; b < " << block << "; b++) value[b] += x[b];\n";
+            if (fAttrCountIncludePad == 0 && doPadding)
+               out << SP << SP << SP << SP << SP << SP << "nsum++;\n";
+         }
+         out << SP << SP << SP << SP << SP << "}\n";
+         out << SP << SP << SP << SP << "}\n"; // end loop on region elements
+         if (fPoolMode == AveragePool)
+            out << SP << SP << SP << SP << "for (int b = 0; b < " << block << "; b++) value[b] /= float(nsum);\n";
+         out << SP << SP << SP << SP << "for (int b = 0; b < " << block << "; b++) tensor_" << fNY
+             << "[outIndex++] = value[b];\n";
+         out << SP << SP << SP << "}\n";   // end loop on j (columns of image)
+         out << SP << SP << "}\n";   // end loop on i (image rows)
+         out << SP << "}\n";  // end loop on blocks of channels
+      }
+      else if(fDim==1){
          // loop on batches and channels
          out << SP << "size_t outIndex = 0;\n";
          out << SP << "for (size_t n = 0; n < " << fShapeX[0]*fShapeX[1] << "; n++) {\n";
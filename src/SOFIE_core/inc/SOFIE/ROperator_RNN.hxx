@@ -47,6 +47,7 @@ template <typename T> class ROperator_RNN final : public ROperator {
    std::vector<size_t> fShapeY_h;             ///< Shape of the last sequence of the output
 
    std::string fType; ///< Type of the tensors
+   bool fStreaming = false; ///< Keep the state between infer calls
 
  public:
    /*! Default constructor of ROperator_RNN */
@@ -142,6 +143,12 @@ template <typename T> class ROperator_RNN final : public ROperator {
    // generate code for Session data members (e.g. internal vectors)
    std::string GenerateSessionMembersCode(std::string opName);
 
+   // generate code resetting the hidden (and cell) state kept in streaming mode
+   std::string GenerateStreamingResetCode(std::string opName);
+
+   // session vectors holding the state kept in streaming mode
+   std::vector<std::pair<std::string, TensorInfo>> GetStreamingStateInfo(std::string opName);
+
    /*! \brief Returns the blas routines needed to compile the generated code
     */
    std::vector<std::string> GetBlasRoutines()  { return { std::string("Gemm"), std::string("Axpy") }; }
@@ -36,6 +36,7 @@ public:
       }
       static_assert( (std::is_same_v<T, float> || std::is_same_v<T, int64_t>),
                   "TMVA::SOFIE - Unsupported type by Range operator");
+      fInputTensorNames = { fNStart, fNLimit, fNDelta };
    }
 
    std::vector<ETensorType> TypeInference(std::vector<ETensorType> input) override {
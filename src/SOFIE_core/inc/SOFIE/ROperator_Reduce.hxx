@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <memory>
 #include <sstream>
@@ -212,7 +213,7 @@ public:
          out << SP << SP << "}\n"; // end j loop
          out << SP  << "}\n"; // end i loop
          if(fReduceOpMode == ReduceMean) {
-            out << SP  << "for (size_t j = 0; i < " << outputLength << "; j++) {\n";
+            out << SP  << "for (size_t j = 0; j < " << outputLength << "; j++) {\n";
             out << SP << SP << "tensor_" << fNY << "[j] /= static_cast<float>(" << reducedLength << ");\n";
             out << SP << "}\n"; // end j loop
          }
@@ -261,6 +262,37 @@ public:
       return out.str();
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      const T *x = interpreter.GetData<T>(fNX);
+      T *y = interpreter.AllocateTensor<T>(fNY, fShapeY);
+      size_t inputLength = ConvertShapeToLength(fShapeX);
+      size_t outputLength = ConvertShapeToLength(fShapeY);
+      auto inputStrides = UTILITY::ComputeStrideFromShape(fShapeX);
+      auto outputStrides = UTILITY::ComputeStrideFromShape(fShapeYNotPruned);
+      std::fill(y, y + outputLength, (fReduceOpMode == ReduceProd) ? T(1) : T(0));
+      // general case of the generated code: find the output index of each input element
+      for (size_t i = 0; i < inputLength; i++) {
+         size_t outputIndex = 0;
+         for (size_t k = 0; k < fShapeX.size(); k++) {
+            if (std::find(fAttrAxes.begin(), fAttrAxes.end(), int64_t(k)) == fAttrAxes.end())
+               outputIndex += (i / inputStrides[k] % fShapeX[k]) * outputStrides[k];
+         }
+         if (fReduceOpMode == ReduceProd)
+            y[outputIndex] *= x[i];
+         else if (fReduceOpMode == ReduceSumSquare)
+            y[outputIndex] += x[i] * x[i];
+         else
+            y[outputIndex] += x[i];
+      }
+      if (fReduceOpMode == ReduceMean) {
+         size_t reducedLength = inputLength / outputLength;
+         for (size_t i = 0; i < outputLength; i++)
+            y[i] /= static_cast<T>(reducedLength);
+      }
+   }
+#endif
+
 };
 
 }//SOFIE
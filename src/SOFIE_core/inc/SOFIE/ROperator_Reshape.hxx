@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <cassert>
 #include <sstream>
@@ -218,6 +219,20 @@ public:
       }
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &input = interpreter.GetTensor(fNData);
+      size_t length = ConvertShapeToLength(fShapeOutput);
+      if (length != ConvertShapeToLength(input.shape))
+         throw std::runtime_error("TMVA SOFIE Reshape Op : wrong output shape - is " +
+                                  ConvertShapeToString(fShapeOutput) + " and input is " +
+                                  ConvertShapeToString(input.shape));
+      const char *data = static_cast<const char *>(input.data);
+      void *output = interpreter.AllocateTensor(fNOutput, input.type, fShapeOutput);
+      std::copy(data, data + length * GetTypeSize(input.type), static_cast<char *>(output));
+   }
+#endif
+
    std::string Generate(std::string OpName) override {
       if (fIsOutputConstant) return "";  //no op for constant tensors
 
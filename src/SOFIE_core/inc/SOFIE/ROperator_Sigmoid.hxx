@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 
@@ -45,6 +46,19 @@ public:
    }
 
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &shape = interpreter.GetTensor(fNX).shape;
+      const T *x = interpreter.GetData<T>(fNX);
+      T *y = interpreter.AllocateTensor<T>(fNY, shape);
+      size_t length = ConvertShapeToLength(shape);
+      for (size_t id = 0; id < length; id++)
+         y[id] = 1 / (1 + std::exp(-x[id]));
+   }
+#endif
+
+   EBlockedLayoutSupport GetBlockedLayoutSupport(RModel&) override { return EBlockedLayoutSupport::SAME; }
+
    std::string Generate(std::string opName) override {
       if (fShape.empty()){
          throw std::runtime_error("TMVA SOFIE Operator Sigmoid called to Generate without being initialized first");
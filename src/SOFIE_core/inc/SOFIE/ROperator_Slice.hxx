@@ -50,6 +50,10 @@ public:
     }
 
     fInputTensorNames = { fNData };
+    for (auto &name : fNames) {
+       if (!name.empty())
+          fInputTensorNames.emplace_back(name);
+    }
     fOutputTensorNames = { fNOutput };
    }
    // ctor for versions < 10
@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 
@@ -14,6 +15,7 @@ class ROperator_Softmax final : public ROperator {
 
 private:
    int64_t fAttrAxis;
+   bool fLogSoftmax = false;  // compute LogSoftmax instead of Softmax
 
    std::string fNX;
    std::string fNY;
@@ -23,8 +25,8 @@ private:
 
 public:
    ROperator_Softmax() {}
-   ROperator_Softmax(int64_t attr_axis, std::string nameX, std::string nameY)
-      : fAttrAxis(attr_axis), fNX(UTILITY::Clean_name(nameX)), fNY(UTILITY::Clean_name(nameY))
+   ROperator_Softmax(int64_t attr_axis, std::string nameX, std::string nameY, bool logSoftmax = false)
+      : fAttrAxis(attr_axis), fLogSoftmax(logSoftmax), fNX(UTILITY::Clean_name(nameX)), fNY(UTILITY::Clean_name(nameY))
    {
          fInputTensorNames = { fNX };
          fOutputTensorNames = { fNY };
@@ -45,11 +47,33 @@ public:
       fShape = model.GetTensorShape(fNX);
       model.AddIntermediateTensor(fNY, model.GetTensorType(fNX), fShape);
       fType = ConvertTypeToString(model.GetTensorType(fNX));
+      if (fType != "float") {
+         throw std::runtime_error("TMVA SOFIE Softmax Op supports only float tensors, input is " + fType);
+      }
       if (model.Verbose()) {
-         std::cout << "Softmax -> " << fNY << " " << ConvertShapeToString(fShape) << std::endl;
+         std::cout << ((fLogSoftmax) ? "LogSoftmax -> " : "Softmax -> ") << fNY << " " << ConvertShapeToString(fShape) << std::endl;
       }
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &shape = interpreter.GetTensor(fNX).shape;
+      int64_t size = shape.size();
+      int64_t axis = fAttrAxis < 0 ? size + fAttrAxis : fAttrAxis;
+      if (axis < 0 || axis >= size || shape[axis] == 0)
+         throw std::runtime_error("TMVA::SOFIE - Softmax operator along the axis " + std::to_string(fAttrAxis) +
+                                  " not supported for input shape " + ConvertShapeToString(shape));
+      size_t N = shape[axis];
+      size_t outer = 1;
+      for (int64_t i = 0; i < axis; i++)
+         outer *= shape[i];
+      size_t inner = ConvertShapeToLength(shape) / (outer * N);
+      const float *x = interpreter.GetData<float>(fNX);
+      float *y = interpreter.AllocateTensor<float>(fNY, shape);
+      UTILITY::Softmax(x, y, outer, N, inner, fLogSoftmax);
+   }
+#endif
+
    std::string Generate(std::string OpName) override {
       OpName = "op_" + OpName;
       if (fShape.empty()) {
@@ -58,128 +82,25 @@ public:
       std::stringstream out;
       size_t size = fShape.size();
       size_t length = ConvertShapeToLength(fShape);
-      size_t axis = fAttrAxis < 0 ? size + fAttrAxis : fAttrAxis;
-      out << "\n" << SP << "//------ SOFTMAX - " << size << "  " << length << "  " << axis << "\n";
-      // use safe numerically implementation by subtracting max of tensor
-      if (size == 1) {
-         out << SP << fType << " vmax = tensor_" << fNX << "[0];\n";
-         out << SP << "for (size_t i = 1; i < " << length << " ; i++){\n";
-         out << SP << SP << "if (tensor_" << fNX << "[i] > vmax) vmax = tensor_" << fNX << "[i];\n";
-         out << SP << "}\n";
-         out << SP << fType << " sum = 0.0;\n";
-         out << SP << "for (size_t i = 0; i < " << length << " ; i++){\n";
-         out << SP << SP << "tensor_" << fNY << "[i] = std::exp(tensor_" << fNX << "[i] - vmax);\n";
-         out << SP << SP << "sum += tensor_" << fNY << "[i];\n";
-         out << SP << "}\n";
-         out << SP << "for (size_t i = 0; i < " << length << " ; i++){\n";
-         out << SP << SP << "tensor_" << fNY << "[i] /= sum;\n";
-         out << SP << "}\n";
-      } else {
-         size_t batch = fShape[0];
-         size_t channel = fShape[1];
-         size_t width = (size > 2) ? fShape[size - 1] : 1;
-         size_t height = (size > 3) ? fShape[size - 2] : 1;
-         size_t depth = (size > 4) ? fShape[size - 3] : 1;
-         size_t hStride = width;
-         size_t dStride = height * width;
-         size_t cStride = depth * dStride;
-         size_t bStride = channel * cStride;
-
-         size_t N = 0; // Size of the axis
-         size_t iStride = 0;
-         if (axis == 0) {
-            N = batch;
-            iStride = bStride;
-         } else if (axis == 1) {
-            N = channel;
-            iStride = cStride;
-         } else if (axis == size - 1) {
-            N = width;
-            iStride = 1;
-         } else if (size > 3 && axis == size - 2) {
-            N = height;
-            iStride = hStride;
-         } else if (size == 5 && axis == size - 3) {
-            N = depth;
-            iStride = dStride;
-         } else {
-            throw
-               std::runtime_error("TMVA::SOFIE - Softmax operator along the axis "
-                  + std::to_string(fAttrAxis) + " with " + std::to_string(size)
-                  + "d input tensor not supported.");
-         }
-
-         bool notBatch = axis != 0;
-         bool notChannel = axis != 1;
-         bool notDepth = (size == 5 && axis != 2);
-         bool notHeight = (size == 5 && axis != 3) || (size == 4 && axis != 2);
-         bool notWidth = (size == 5 && axis != 4) || (size == 4 && axis != 3) || (size == 3 && axis != 2);
-
-         if (notBatch) {
-            out << SP << "for (size_t n = 0; n < " << batch << " ; n++){\n";
-         }
-         if (notChannel) {
-            out << SP << SP << "for (size_t c = 0; c < " << channel << " ; c++){\n";
-         }
-         if (notDepth) {
-            out << SP << SP << "for (size_t d = 0; d < " << depth << " ; d++){\n";
-         }
-         if (notHeight) {
-            out << SP << SP << "for (size_t h = 0; h < " << height << " ; h++){\n";
-         }
-         if (notWidth) {
-            out << SP << SP << "for (size_t w = 0; w < " << width << " ; w++){\n";
-         }
-         out << SP << SP << SP << fType << " sum = 0.;\n";
-         out << SP << SP << SP << "size_t index = 0";
-         if (notBatch) {
-            out << " + n * " << bStride;
-         }
-         if (notChannel) {
-            out << "+ c * " << cStride;
-         }
-         if (notDepth) {
-            out << " + d * " << dStride;
-         }
-         if (notHeight) {
-            out << " + h * " << hStride;
-         }
-         if (notWidth) {
-            out << " + w";
-         }
-         out << ";\n";
-         // apply softmax along the axis - find first maximum value for numerical stability
-         if (N == 0)
-            throw std::runtime_error("TMVA::SOFIE - Softmax operator is along axis with zero elements");
-         out << SP << SP << SP << fType << " vmax = tensor_" << fNX << "[index];\n";
-         out << SP << SP << SP << "for (size_t i = 1; i < " << N << "; i++) {\n";
-         out << SP << SP << SP << SP << "if (tensor_" << fNX << "[index + i*" << iStride << "] > vmax)\n";
-         out << SP << SP << SP << SP << SP << "vmax = tensor_" << fNX << "[index + i*" << iStride << "];\n";
-         out << SP << SP << SP << "}\n";
-         out << SP << SP << SP << "for (size_t i = 0; i < " << N << "; i++) {\n";
-         out << SP << SP << SP << SP << "tensor_" << fNY << "[index + i*" << iStride << "] = std::exp(tensor_" << fNX
-             << "[index + i*" << iStride << "] - vmax);\n";
-         out << SP << SP << SP << SP << "sum += tensor_" << fNY << "[index + i*" << iStride << "];\n";
-         out << SP << SP << SP << "}\n";
-         out << SP << SP << SP << "for (size_t i = 0; i < " << N << "; i++) {\n";
-         out << SP << SP << SP << SP << "tensor_" << fNY << "[index + i*" << iStride << "] /= sum;\n";
-         out << SP << SP << SP << "}\n";
-         if (notWidth) {
-            out << SP << SP << "}\n"; // end w
-         }
-         if (notHeight) {
-            out << SP << SP << "}\n"; // end h
-         }
-         if (notDepth) {
-            out << SP << SP << "}\n"; // end d
-         }
-         if (notChannel) {
-            out << SP << SP << "}\n"; // end c
-         }
-         if (notBatch) {
-            out << SP << "}\n"; // end n
-         }
+      int64_t axis = fAttrAxis < 0 ? size + fAttrAxis : fAttrAxis;
+      if (axis < 0 || axis >= static_cast<int64_t>(size)) {
+         throw std::runtime_error("TMVA::SOFIE - Softmax operator along the axis " + std::to_string(fAttrAxis) +
+                                  " with " + std::to_string(size) + "d input tensor not supported.");
       }
+      // view the tensor as (outer, N, inner) where N is the size of the axis
+      size_t N = fShape[axis];
+      if (N == 0)
+         throw std::runtime_error("TMVA::SOFIE - Softmax operator is along axis with zero elements");
+      size_t outer = 1;
+      for (int64_t i = 0; i < axis; i++)
+         outer *= fShape[i];
+      size_t inner = length / (outer * N);
+      out << "\n" << SP << "//------ " << ((fLogSoftmax) ? "LOGSOFTMAX" : "SOFTMAX") << " - " << size << "  " << length
+          << "  " << axis << "\n";
+      // single pass online computation of max and normalization (numerically safe), rows along a
+      // non-last axis are processed together
+      out << SP << "SOFIE::UTILITY::Softmax(tensor_" << fNX << ", tensor_" << fNY << ", " << outer << ", " << N << ", "
+          << inner << ", " << ((fLogSoftmax) ? "true" : "false") << ");\n";
       return out.str();
    }
 };
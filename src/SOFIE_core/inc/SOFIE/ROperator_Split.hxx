@@ -35,6 +35,8 @@ public:
             fNYs.push_back(UTILITY::Clean_name(name));
 
          fInputTensorNames = { fNX };
+         if (!fNSplit.empty())
+            fInputTensorNames.emplace_back(fNSplit);
          fOutputTensorNames.resize(fNYs.size());
          std::transform(fNYs.begin(), fNYs.end(), fOutputTensorNames.begin(),
                    [](const std::string& s) -> std::string_view { return s; });
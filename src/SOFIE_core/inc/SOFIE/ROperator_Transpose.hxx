@@ -4,6 +4,7 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator.hxx"
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 
 #include <sstream>
 #include <cassert>
@@ -112,6 +113,35 @@ public:
       }
    }
 
+#ifdef SOFIE_USE_BLAS
+   void Execute(RInterpreter &interpreter) override {
+      auto &shapeData = interpreter.GetTensor(fNData).shape;
+      auto shapeOutput = ShapeInference({shapeData})[0];
+      const T *data = interpreter.GetData<T>(fNData);
+      T *output = interpreter.AllocateTensor<T>(fNOutput, shapeOutput);
+      size_t dim = shapeData.size();
+      auto inStrides = UTILITY::ComputeStrideFromShape(shapeData);
+      // strides of the input for the output indices
+      std::vector<size_t> strides(dim);
+      for (size_t k = 0; k < dim; k++)
+         strides[k] = inStrides[fAttrPerm[k]];
+      std::vector<size_t> index(dim, 0);
+      size_t offset = 0;
+      size_t length = ConvertShapeToLength(shapeOutput);
+      for (size_t id = 0; id < length; id++) {
+         output[id] = data[offset];
+         // increment the output index and update the input offset
+         for (size_t k = dim; k-- > 0;) {
+            offset += strides[k];
+            if (++index[k] < shapeOutput[k])
+               break;
+            offset -= index[k] * strides[k];
+            index[k] = 0;
+         }
+      }
+   }
+#endif
+
    std::string Generate(std::string OpName) override {
       if (fIsOutputConstant) return "";  //no op for constant tensors
       OpName = "op_" + OpName;
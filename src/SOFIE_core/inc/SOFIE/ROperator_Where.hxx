@@ -109,6 +109,8 @@ public:
                // Update the data and the shape of A
                model.AddConstantTensor(fNBroadcastedA, model.GetTensorType(fNA), fShapeY, broadcastedData);
                fShapeA = fShapeY;
+               // the generated code reads the broadcasted tensor instead of A
+               fInputTensorNames[0] = fNBroadcastedA;
             } else {
                // Add an intermediate tensor for broadcasting A
                model.AddIntermediateTensor(fNBroadcastedA, model.GetTensorType(fNA), fShapeY);
@@ -125,6 +127,7 @@ public:
                // do not update tensor B but add broadcasted one (since it can be input to some other operators)
                model.AddConstantTensor(fNBroadcastedB, model.GetTensorType(fNB), fShapeY, broadcastedData);
                fShapeB = fShapeY;
+               fInputTensorNames[1] = fNBroadcastedB;
             } else {
                // Add an intermediate tensor for broadcasting B
                model.AddIntermediateTensor(fNBroadcastedB, model.GetTensorType(fNB), fShapeY);
@@ -141,6 +144,7 @@ public:
                // do not update tensor C but add broadcasted one (since it can be input to some other operators)
                model.AddConstantTensor(fNBroadcastedC, model.GetTensorType(fNC), fShapeY, broadcastedData);
                fShapeC = fShapeY;
+               fInputTensorNames[2] = fNBroadcastedC;
             } else {
                // Add an intermediate tensor for broadcasting B
                model.AddIntermediateTensor(fNBroadcastedC, model.GetTensorType(fNC), fShapeY);
@@ -20,6 +20,9 @@
 #include <iomanip>
 #include <cassert>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 
 
 namespace SOFIE{
@@ -35,6 +38,16 @@ enum class EActivationType{
    UNDEFINED = 0, RELU = 1, SOFTMAX = 2, SIGMOID = 3, LEAKYRELU = 4, TANH = 5, ELU = 6
 };
 
+// support of the channel-blocked layout (NCHW8c) by an operator: SAME if its data inputs and its output can be in the
+// blocked layout, all in the same layout (e.g. element-wise operators), CONVERT if the data input and the output can be
+// in different layouts (e.g. Conv, which converts the layout at the boundaries of the blocked sub-graphs)
+enum class EBlockedLayoutSupport{
+   NONE = 0, SAME = 1, CONVERT = 2
+};
+
+// number of channels of a block in the channel-blocked layout, whose values are contiguous for each pixel
+constexpr size_t kChannelBlockSize = 8;
+
 constexpr size_t GetTypeSize(ETensorType type) {
     switch (type) {
         case ETensorType::FLOAT:     return sizeof(float);
@@ -146,6 +159,9 @@ struct MemoryPoolInfo {
 
    // ordered map with chunk_idx as key and chunk_size as value
    std::map<size_t, size_t> available_stack;
+
+   // offset in the pool of each allocated tensor
+   std::map<std::string, size_t> tensor_offsets;
 };
 
 std::vector<Dim> ConvertShapeToDim(std::vector<size_t> shape);
@@ -191,6 +207,10 @@ std::string ConvertValuesToString(const std::vector<T> & data) {
   return ConvertValuesToString(data.size(), data.data());
 }
 
+// convert raw bytes in a C++ string literal (split on several lines), which is much faster to compile
+// than a list of values
+std::string ConvertBytesToStringLiteral(size_t n, const char * data);
+
 class InitializedTensor {
 public:
    InitializedTensor() = default;
@@ -446,6 +466,7 @@ void UnidirectionalBroadcast(const T* data, const std::vector<size_t>& shape, co
       size_t offset = targetSize - shape.size();
       std::copy(shape.begin(), shape.end(), newShape.begin() + offset);
       BroadcastTensor<T>(inData, newShape, targetShape, broadcastedData);
+      return;
    }
    BroadcastTensor<T, std::span<T>>(inData, shape, targetShape, broadcastedData);
 }
@@ -517,6 +538,119 @@ void Im2col(const T *data_im, const int channels, const int height, const int wi
    }
 }
 
+/// direct 2d convolution of a single image without grouping, an alternative to Im2col + Gemm which does not need
+/// the (channels * kernel_h * kernel_w, output_h * output_w) buffer. The weights have the ONNX layout
+/// (out_channels, channels, kernel_h, kernel_w). For each weight the contribution is accumulated on the output rows,
+/// in a loop on the output columns reading inside the input, so that the inner loop has no padding checks
+template <typename T>
+void DirectConv2d(const T *data_im, const T *weights, const int channels, const int height, const int width,
+                  const int out_channels, const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+                  const int stride_h, const int stride_w, const int dilation_h, const int dilation_w, T *data_out)
+{
+   const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+   const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+   std::fill(data_out, data_out + size_t(out_channels) * output_h * output_w, T(0));
+   for (int oc = 0; oc < out_channels; oc++) {
+      T *out = data_out + size_t(oc) * output_h * output_w;
+      for (int c = 0; c < channels; c++) {
+         const T *im = data_im + size_t(c) * height * width;
+         const T *w = weights + (size_t(oc) * channels + c) * kernel_h * kernel_w;
+         for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+            for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+               const T weight = w[kernel_row * kernel_w + kernel_col];
+               // output columns with 0 <= input_col < width
+               const int col_offset = -pad_w + kernel_col * dilation_w;
+               const int col_begin = (col_offset >= 0) ? 0 : (-col_offset + stride_w - 1) / stride_w;
+               const int col_end =
+                  (width > col_offset) ? std::min(output_w, (width - col_offset + stride_w - 1) / stride_w) : 0;
+               for (int output_row = 0; output_row < output_h; output_row++) {
+                  const int input_row = output_row * stride_h - pad_h + kernel_row * dilation_h;
+                  if (!is_a_ge_zero_and_a_lt_b(input_row, height))
+                     continue;
+                  const T *in = im + size_t(input_row) * width;
+                  T *o = out + size_t(output_row) * output_w;
+                  for (int output_col = col_begin; output_col < col_end; output_col++)
+                     o[output_col] += weight * in[output_col * stride_w + col_offset];
+               }
+            }
+         }
+      }
+   }
+}
+
+/// direct 2d convolution of a single image in the channel-blocked layout, where the channels are split in blocks of B
+/// whose values are contiguous for each pixel: (channels / B, height, width, B) instead of (channels, height, width).
+/// The input and the output can also be in the plain layout, for the convolutions at the boundaries of the blocked
+/// sub-graphs. The weights are packed as (out_channels / B, channels, kernel_h, kernel_w, B) and the bias as
+/// (out_channels), both padded with zeros to a multiple of B. The output is computed by tiles of TW pixels of a row
+/// times B output channels, whose accumulators stay in registers: the loop on the B channels is vectorized and each
+/// packed weight vector is used for the TW pixels
+template <int B, bool BlockedInput, bool BlockedOutput, typename T>
+void DirectConvBlocked2d(const T *data_im, const T *weights, const T *bias, const int channels, const int height,
+                         const int width, const int out_channels, const int kernel_h, const int kernel_w,
+                         const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+                         const int dilation_h, const int dilation_w, const bool relu, T *data_out)
+{
+   constexpr int TW = 8;
+   const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+   const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+   const int out_blocks = (out_channels + B - 1) / B;
+   // distance between two pixels of a channel in the input
+   constexpr int pixel_stride = (BlockedInput) ? B : 1;
+   for (int ob = 0; ob < out_blocks; ob++) {
+      for (int output_row = 0; output_row < output_h; output_row++) {
+         for (int col0 = 0; col0 < output_w; col0 += TW) {
+            const int ncols = std::min(TW, output_w - col0);
+            T acc[TW][B];
+            for (int t = 0; t < TW; t++) {
+               for (int b = 0; b < B; b++)
+                  acc[t][b] = bias[ob * B + b];
+            }
+            for (int c = 0; c < channels; c++) {
+               const T *im = (BlockedInput) ? data_im + size_t(c / B) * height * width * B + c % B
+                                            : data_im + size_t(c) * height * width;
+               const T *w = weights + (size_t(ob) * channels + c) * kernel_h * kernel_w * B;
+               for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+                  const int input_row = output_row * stride_h - pad_h + kernel_row * dilation_h;
+                  if (!is_a_ge_zero_and_a_lt_b(input_row, height))
+                     continue;
+                  const T *in = im + size_t(input_row) * width * pixel_stride;
+                  for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+                     const T *wb = w + (kernel_row * kernel_w + kernel_col) * B;
+                     const int input_col = col0 * stride_w - pad_w + kernel_col * dilation_w;
+                     if (ncols == TW && input_col >= 0 && input_col + (TW - 1) * stride_w < width) {
+                        // tile inside the image: fixed size loops without padding checks
+                        for (int t = 0; t < TW; t++) {
+                           const T x = in[(input_col + t * stride_w) * pixel_stride];
+                           for (int b = 0; b < B; b++)
+                              acc[t][b] += x * wb[b];
+                        }
+                     } else {
+                        for (int t = 0; t < ncols; t++) {
+                           if (!is_a_ge_zero_and_a_lt_b(input_col + t * stride_w, width))
+                              continue;
+                           const T x = in[(input_col + t * stride_w) * pixel_stride];
+                           for (int b = 0; b < B; b++)
+                              acc[t][b] += x * wb[b];
+                        }
+                     }
+                  }
+               }
+            }
+            for (int t = 0; t < ncols; t++) {
+               for (int b = 0; b < B; b++) {
+                  const T value = (relu && acc[t][b] < 0) ? 0 : acc[t][b];
+                  if (BlockedOutput)
+                     data_out[((size_t(ob) * output_h + output_row) * output_w + col0 + t) * B + b] = value;
+                  else if (ob * B + b < out_channels)
+                     data_out[(size_t(ob * B + b) * output_h + output_row) * output_w + col0 + t] = value;
+               }
+            }
+         }
+      }
+   }
+}
+
 /// 3d implementation
 template <typename T>
 void Im2col_3d(const T *data_im, const int channels,
@@ -629,6 +763,701 @@ extern "C" void sgemm_(const char * transa, const char * transb, const int * m,
                        const float * beta, float * C, const int * ldc);
 }//BLAS
 
+namespace UTILITY {
+
+/// batched (stacked) matrix product in row-major layout, as for MatMul with inputs of rank > 2:
+///    Y[b] = alpha * op(A[b]) * op(B[b]) + beta * Y[b]     for b = 0,...,batch-1
+/// The batch index is decomposed over the `nBatchDims` extra dimensions `batchShape` and
+/// every operand advances with its own stride per dimension (stride 0 for broadcasted dimensions).
+/// The output slices are contiguous (stride m*n).
+/// Small products use an internal kernel packing op(B) once for all the consecutive slices
+/// sharing the same B (e.g. weights broadcasted on the batch), large ones are sent to BLAS.
+/// The loop on the slices of the internal kernel is parallelized when the code is compiled with OpenMP
+/// (e.g. -fopenmp, as for the sessions of RModel_GraphIndependent), otherwise they are computed in sequence.
+/// The products with m*n*k larger than `blasThreshold` are sent to BLAS (0 for always, max for never).
+inline void BatchedGemm(bool transA, bool transB, int m, int n, int k, float alpha, const float *A, const float *B,
+                        float beta, float *Y, size_t nBatchDims, const size_t *batchShape, const size_t *strideA,
+                        const size_t *strideB, size_t blasThreshold = 32768)
+{
+   // offsets of A and B for each element of the batch
+   size_t batch = 1;
+   for (size_t i = 0; i < nBatchDims; i++)
+      batch *= batchShape[i];
+   std::vector<size_t> offsetA(batch);
+   std::vector<size_t> offsetB(batch);
+   std::vector<size_t> index(nBatchDims, 0);
+   bool sharedB = true;
+   for (size_t i = 0; i < nBatchDims; i++)
+      if (batchShape[i] > 1 && strideB[i] != 0) sharedB = false;
+   for (size_t b = 0; b < batch; b++) {
+      size_t oA = 0, oB = 0;
+      for (size_t i = 0; i < nBatchDims; i++) {
+         oA += index[i] * strideA[i];
+         oB += index[i] * strideB[i];
+      }
+      offsetA[b] = oA;
+      offsetB[b] = oB;
+      // increment the multi-dimensional batch index
+      for (size_t i = nBatchDims; i-- > 0;) {
+         if (++index[i] < batchShape[i]) break;
+         index[i] = 0;
+      }
+   }
+   const size_t sizeB = size_t(k) * n;
+   const size_t sizeY = size_t(m) * n;
+
+   // large matrices: BLAS is more efficient (row-major product computed as Y^T = B^T * A^T)
+   if (size_t(m) * n * k > blasThreshold) {
+      char tA = transA ? 't' : 'n';
+      char tB = transB ? 't' : 'n';
+      int lda = transA ? m : k;
+      int ldb = transB ? k : n;
+      for (size_t b = 0; b < batch; b++) {
+         BLAS::sgemm_(&tB, &tA, &n, &m, &k, &alpha, B + offsetB[b], &ldb, A + offsetA[b], &lda, &beta,
+                      Y + b * sizeY, &n);
+      }
+      return;
+   }
+
+   // pack op(B) as a contiguous (k x n) row-major matrix
+   auto packB = [&](const float *src, float *dst) {
+      if (!transB) {
+         std::copy(src, src + sizeB, dst);
+      } else {
+         for (int p = 0; p < k; p++)
+            for (int j = 0; j < n; j++)
+               dst[p * n + j] = src[j * k + p];
+      }
+   };
+   std::vector<float> sharedPackedB;
+   if (sharedB) {
+      sharedPackedB.resize(sizeB);
+      packB(B, sharedPackedB.data());
+   }
+
+   // op(B) is packed again only when its offset changes between consecutive slices of the same thread
+#pragma omp parallel if (batch > 1)
+   {
+      std::vector<float> localPackedB(sharedB ? 0 : sizeB);
+      size_t lastOffsetB = std::numeric_limits<size_t>::max();
+#pragma omp for schedule(static)
+      for (size_t b = 0; b < batch; b++) {
+         const float *pB = sharedPackedB.data();
+         if (!sharedB) {
+            if (offsetB[b] != lastOffsetB) {
+               packB(B + offsetB[b], localPackedB.data());
+               lastOffsetB = offsetB[b];
+            }
+            pB = localPackedB.data();
+         }
+         const float *pA = A + offsetA[b];
+         float *pY = Y + b * sizeY;
+         for (int i = 0; i < m; i++) {
+            float *y = pY + size_t(i) * n;
+            if (beta == 0.f)
+               std::fill(y, y + n, 0.f);
+            else if (beta != 1.f)
+               for (int j = 0; j < n; j++) y[j] *= beta;
+            for (int p = 0; p < k; p++) {
+               const float a = alpha * (transA ? pA[size_t(p) * m + i] : pA[size_t(i) * k + p]);
+               const float *bRow = pB + size_t(p) * n;
+               for (int j = 0; j < n; j++)
+                  y[j] += a * bRow[j];
+            }
+         }
+      }
+   }
+}
+
+/// maximum size of the im2col panels of ConvImplicitGemm (rows of the unrolled filters x output pixels)
+constexpr size_t kConvPanelK = 256;
+constexpr size_t kConvPanelP = 128;
+
+/// size of the panel buffer needed by ConvImplicitGemm for a convolution with k = channels * kernel size
+/// and p = output size
+inline size_t ConvPanelSize(size_t k, size_t p)
+{
+   return std::min(k, kConvPanelK) * std::min(p, kConvPanelP);
+}
+
+/// implicit Gemm convolution of a single image and a single group: the output (out_channels, output_size) is the
+/// product of the filters (out_channels, channels * kernel_d * kernel_h * kernel_w) with the im2col matrix, which is
+/// never built in full. Panels of at most kConvPanelK rows and kConvPanelP output pixels are unrolled on the fly in
+/// `panel` (of size ConvPanelSize) and multiplied with BLAS, accumulating the output block of the panel columns.
+/// The weights have the ONNX layout (not dilated). 1d and 2d convolutions are given with a depth (and height) of 1.
+/// The output sizes are given explicitly, the pads are the begin pads (they can be negative)
+inline void ConvImplicitGemm(const float *data_im, const float *weights, const int channels, const int depth,
+                             const int height, const int width, const int out_channels, const int kernel_d,
+                             const int kernel_h, const int kernel_w, const int pad_d, const int pad_h, const int pad_w,
+                             const int stride_d, const int stride_h, const int stride_w, const int dilation_d,
+                             const int dilation_h, const int dilation_w, const int output_d, const int output_h,
+                             const int output_w, float *data_out, float *panel)
+{
+   const int kernel_size = kernel_d * kernel_h * kernel_w;
+   const int k = channels * kernel_size;
+   const int p = output_d * output_h * output_w;
+   const int channel_size = depth * height * width;
+   const char trans = 'n';
+   const float alpha = 1.f;
+   for (int p0 = 0; p0 < p; p0 += int(kConvPanelP)) {
+      int np = std::min(int(kConvPanelP), p - p0);
+      // output position of the first column of the panel
+      const int x0 = p0 % output_w;
+      const int y0 = (p0 / output_w) % output_h;
+      const int z0 = p0 / (output_w * output_h);
+      for (int k0 = 0; k0 < k; k0 += int(kConvPanelK)) {
+         int nk = std::min(int(kConvPanelK), k - k0);
+         // unroll the rows k0,...,k0+nk-1 of the im2col matrix, each row by runs of output columns
+         for (int row = 0; row < nk; row++) {
+            const int c = (k0 + row) / kernel_size;
+            const int kernel_index = (k0 + row) % kernel_size;
+            const int kz = kernel_index / (kernel_h * kernel_w) * dilation_d - pad_d;
+            const int ky = (kernel_index / kernel_w) % kernel_h * dilation_h - pad_h;
+            const int kx = kernel_index % kernel_w * dilation_w - pad_w;
+            const float *src = data_im + size_t(c) * channel_size;
+            float *dst = panel + size_t(row) * np;
+            int x = x0, y = y0, z = z0;
+            for (int col = 0; col < np;) {
+               const int len = std::min(output_w - x, np - col);
+               const int iz = z * stride_d + kz;
+               const int iy = y * stride_h + ky;
+               if (!is_a_ge_zero_and_a_lt_b(iz, depth) || !is_a_ge_zero_and_a_lt_b(iy, height)) {
+                  std::fill(dst + col, dst + col + len, 0.f);
+               } else {
+                  const float *src_row = src + (size_t(iz) * height + iy) * width;
+                  for (int i = 0; i < len; i++) {
+                     const int ix = (x + i) * stride_w + kx;
+                     dst[col + i] = is_a_ge_zero_and_a_lt_b(ix, width) ? src_row[ix] : 0.f;
+                  }
+               }
+               col += len;
+               x += len;
+               if (x == output_w) {
+                  x = 0;
+                  if (++y == output_h) {
+                     y = 0;
+                     z++;
+                  }
+               }
+            }
+         }
+         // column-major product: out^T (np x out_channels) += panel^T (np x nk) * W^T (nk x out_channels)
+         const float beta = (k0 == 0) ? 0.f : 1.f;
+         BLAS::sgemm_(&trans, &trans, &np, &out_channels, &nk, &alpha, panel, &np, weights + k0, &k, &beta,
+                      data_out + p0, &p);
+      }
+   }
+}
+
+/// implicit Gemm convolution with symmetric padding (see above)
+inline void ConvImplicitGemm(const float *data_im, const float *weights, const int channels, const int depth,
+                             const int height, const int width, const int out_channels, const int kernel_d,
+                             const int kernel_h, const int kernel_w, const int pad_d, const int pad_h, const int pad_w,
+                             const int stride_d, const int stride_h, const int stride_w, const int dilation_d,
+                             const int dilation_h, const int dilation_w, float *data_out, float *panel)
+{
+   const int output_d = (depth + 2 * pad_d - (dilation_d * (kernel_d - 1) + 1)) / stride_d + 1;
+   const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+   const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+   ConvImplicitGemm(data_im, weights, channels, depth, height, width, out_channels, kernel_d, kernel_h, kernel_w, pad_d,
+                    pad_h, pad_w, stride_d, stride_h, stride_w, dilation_d, dilation_h, dilation_w, output_d, output_h,
+                    output_w, data_out, panel);
+}
+
+/// outputs of a transposed convolution along one dimension for the phase r: the outputs o = first + q * stride
+/// (q = 0,...,outputs-1), which are the ones with (o + pad) % stride == r, only get contributions of the kernel
+/// indices k = first_k + j * step_k (j = 0,...,taps-1), the ones with k * dilation % stride == r. They are a regular
+/// convolution (stride 1) of the input with these taps in reverse order, a dilation and a begin padding
+struct ConvTransposePhase {
+   int first_k = 0;  ///< first kernel index of the phase
+   int step_k = 1;   ///< step between the kernel indices of the phase
+   int taps = 0;     ///< kernel size of the sub-convolution (0 if no kernel index contributes)
+   int dilation = 1; ///< dilation of the sub-convolution
+   int pad = 0;      ///< begin padding of the sub-convolution (can be negative)
+   int first = 0;    ///< first output of the phase
+   int outputs = 0;  ///< number of outputs of the phase
+};
+
+inline ConvTransposePhase GetConvTransposePhase(int r, int kernel, int stride, int dilation, int pad, int output)
+{
+   ConvTransposePhase phase;
+   int g = std::gcd(stride, dilation);
+   phase.step_k = stride / g;
+   phase.dilation = dilation / g;
+   // index of the first output of the phase in the input grid refined by the stride (pad - r > -stride)
+   int qStart = (pad - r + stride - 1) / stride;
+   phase.first = qStart * stride + r - pad;
+   phase.outputs = (phase.first < output) ? (output - 1 - phase.first) / stride + 1 : 0;
+   for (int k = 0; k < phase.step_k && k < kernel; k++) {
+      if ((k * dilation) % stride == r) {
+         phase.first_k = k;
+         phase.taps = (kernel - 1 - k) / phase.step_k + 1;
+         break;
+      }
+   }
+   if (phase.taps > 0)
+      phase.pad = (phase.first_k * dilation - r) / stride + (phase.taps - 1) * phase.dilation - qStart;
+   return phase;
+}
+
+/// pack the weights (channels, out_channels / group, kernel_d, kernel_h, kernel_w) of a transposed convolution for
+/// ConvTransposeSubPixel: for each phase (rd, rh, rw) and each group, the filters of the sub-convolution
+/// (out_channels / group, channels / group, taps_d, taps_h, taps_w) with the taps in reverse order.
+/// Each kernel index belongs to a single phase, the packed weights have the same size
+inline void PackConvTransposeWeights(const float *weights, const int channels, const int out_channels, const int group,
+                                     const int kernel_d, const int kernel_h, const int kernel_w, const int stride_d,
+                                     const int stride_h, const int stride_w, const int dilation_d,
+                                     const int dilation_h, const int dilation_w, float *packed)
+{
+   const int cg = channels / group;
+   const int mg = out_channels / group;
+   for (int rd = 0; rd < stride_d; rd++) {
+      for (int rh = 0; rh < stride_h; rh++) {
+         for (int rw = 0; rw < stride_w; rw++) {
+            auto pd = GetConvTransposePhase(rd, kernel_d, stride_d, dilation_d, 0, 0);
+            auto ph = GetConvTransposePhase(rh, kernel_h, stride_h, dilation_h, 0, 0);
+            auto pw = GetConvTransposePhase(rw, kernel_w, stride_w, dilation_w, 0, 0);
+            for (int g = 0; g < group; g++) {
+               for (int m = 0; m < mg; m++) {
+                  for (int c = 0; c < cg; c++) {
+                     const float *w = weights + (size_t(g * cg + c) * mg + m) * kernel_d * kernel_h * kernel_w;
+                     for (int jd = pd.taps - 1; jd >= 0; jd--) {
+                        for (int jh = ph.taps - 1; jh >= 0; jh--) {
+                           for (int jw = pw.taps - 1; jw >= 0; jw--) {
+                              int k = ((pd.first_k + jd * pd.step_k) * kernel_h + ph.first_k + jh * ph.step_k) *
+                                         kernel_w + pw.first_k + jw * pw.step_k;
+                              *(packed++) = w[k];
+                           }
+                        }
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+/// sizes of the buffer holding the outputs of a phase (0 if all the strides are 1) and of the panel buffer needed by
+/// ConvTransposeSubPixel
+inline void ConvTransposeBufferSizes(const int channels, const int out_channels, const int group, const int *kernel,
+                                     const int *pad, const int *stride, const int *dilation, const int *output,
+                                     size_t &bufferSize, size_t &panelSize)
+{
+   bufferSize = 0;
+   panelSize = 0;
+   bool unitStride = (stride[0] == 1 && stride[1] == 1 && stride[2] == 1);
+   for (int rd = 0; rd < stride[0]; rd++) {
+      for (int rh = 0; rh < stride[1]; rh++) {
+         for (int rw = 0; rw < stride[2]; rw++) {
+            auto pd = GetConvTransposePhase(rd, kernel[0], stride[0], dilation[0], pad[0], output[0]);
+            auto ph = GetConvTransposePhase(rh, kernel[1], stride[1], dilation[1], pad[1], output[1]);
+            auto pw = GetConvTransposePhase(rw, kernel[2], stride[2], dilation[2], pad[2], output[2]);
+            size_t outputs = size_t(pd.outputs) * ph.outputs * pw.outputs;
+            size_t taps = size_t(pd.taps) * ph.taps * pw.taps;
+            if (!unitStride)
+               bufferSize = std::max(bufferSize, outputs * (out_channels / group));
+            if (taps > 0 && outputs > 0)
+               panelSize = std::max(panelSize, ConvPanelSize(taps * (channels / group), outputs));
+         }
+      }
+   }
+}
+
+/// transposed convolution of a single image with the sub-pixel decomposition: for each phase (rd, rh, rw) of the
+/// outputs along the strided dimensions and each group, the outputs are a regular convolution of the input
+/// computed by ConvImplicitGemm with the weights packed by PackConvTransposeWeights. They are written interleaved in
+/// the output, adding the bias (can be null) and applying ReLU, so that every output is written once, without zero
+/// filling nor scatter-add. The outputs of a phase are computed in `buffer`, except when all the strides are 1 where
+/// they are computed in place. The buffer sizes are given by ConvTransposeBufferSizes
+inline void ConvTransposeSubPixel(const float *data_im, const float *packed, const float *bias, const int channels,
+                                  const int depth, const int height, const int width, const int out_channels,
+                                  const int group, const int kernel_d, const int kernel_h, const int kernel_w,
+                                  const int pad_d, const int pad_h, const int pad_w, const int stride_d,
+                                  const int stride_h, const int stride_w, const int dilation_d, const int dilation_h,
+                                  const int dilation_w, const int output_d, const int output_h, const int output_w,
+                                  bool relu, float *data_out, float *buffer, float *panel)
+{
+   const int cg = channels / group;
+   const int mg = out_channels / group;
+   const size_t input_size = size_t(depth) * height * width;
+   const size_t output_size = size_t(output_d) * output_h * output_w;
+   const bool unit_stride = (stride_d == 1 && stride_h == 1 && stride_w == 1);
+   for (int rd = 0; rd < stride_d; rd++) {
+      for (int rh = 0; rh < stride_h; rh++) {
+         for (int rw = 0; rw < stride_w; rw++) {
+            auto pd = GetConvTransposePhase(rd, kernel_d, stride_d, dilation_d, pad_d, output_d);
+            auto ph = GetConvTransposePhase(rh, kernel_h, stride_h, dilation_h, pad_h, output_h);
+            auto pw = GetConvTransposePhase(rw, kernel_w, stride_w, dilation_w, pad_w, output_w);
+            const int taps = pd.taps * ph.taps * pw.taps;
+            const int outputs = pd.outputs * ph.outputs * pw.outputs;
+            for (int g = 0; g < group && outputs > 0; g++) {
+               float *y = (unit_stride) ? data_out + size_t(g) * mg * output_size : buffer;
+               if (taps > 0)
+                  ConvImplicitGemm(data_im + g * cg * input_size, packed + size_t(g) * mg * cg * taps, cg, depth,
+                                   height, width, mg, pd.taps, ph.taps, pw.taps, pd.pad, ph.pad, pw.pad, 1, 1, 1,
+                                   pd.dilation, ph.dilation, pw.dilation, pd.outputs, ph.outputs, pw.outputs, y, panel);
+               else
+                  std::fill(y, y + size_t(mg) * outputs, 0.f);
+               // bias, activation and interleaved write of the phase outputs (in place for unit strides)
+               for (int m = 0; m < mg; m++) {
+                  const float b = (bias) ? bias[g * mg + m] : 0.f;
+                  const float *src = y + size_t(m) * outputs;
+                  float *dst = data_out + size_t(g * mg + m) * output_size;
+                  for (int qd = 0; qd < pd.outputs; qd++) {
+                     for (int qh = 0; qh < ph.outputs; qh++) {
+                        float *row = dst + (size_t(pd.first + qd * stride_d) * output_h + ph.first + qh * stride_h) *
+                                              output_w + pw.first;
+                        for (int qw = 0; qw < pw.outputs; qw++) {
+                           float v = *(src++) + b;
+                           row[qw * stride_w] = (relu && v < 0.f) ? 0.f : v;
+                        }
+                     }
+                  }
+               }
+            }
+            packed += size_t(group) * mg * cg * taps;
+         }
+      }
+   }
+}
+
+/// copy the row-major tensor `in` of shape `shape` into `out` permuting its dimensions:
+/// dimension i of the output is dimension perm[i] of the input for i < nOut, while the
+/// remaining input dimensions perm[nOut],...,perm[rank-1] are summed over (as for Einsum labels
+/// appearing in a single operand)
+inline void EinsumTranspose(const float *in, size_t rank, const size_t *shape, const size_t *perm, size_t nOut,
+                            float *out)
+{
+   std::vector<size_t> inStride(rank, 1);
+   for (size_t i = rank; i-- > 1;)
+      inStride[i - 1] = inStride[i] * shape[i];
+   // dimensions and input strides following the output order, summed dimensions last
+   std::vector<size_t> dims(rank);
+   std::vector<size_t> strides(rank);
+   size_t outLength = 1;
+   size_t sumLength = 1;
+   for (size_t i = 0; i < rank; i++) {
+      dims[i] = shape[perm[i]];
+      strides[i] = inStride[perm[i]];
+      if (i < nOut)
+         outLength *= dims[i];
+      else
+         sumLength *= dims[i];
+   }
+   std::vector<size_t> index(rank, 0);
+   size_t offset = 0;
+   for (size_t o = 0; o < outLength; o++) {
+      float sum = 0;
+      for (size_t s = 0; s < sumLength; s++) {
+         sum += in[offset];
+         // move to the next input element, last dimension running fastest
+         for (size_t d = rank; d-- > 0;) {
+            offset += strides[d];
+            if (++index[d] < dims[d]) break;
+            offset -= dims[d] * strides[d];
+            index[d] = 0;
+         }
+      }
+      out[o] = sum;
+   }
+}
+
+/// merge the online softmax state (running maximum m, running sum s of exp(x_i - m)) with the one of a block
+inline void SoftmaxOnlineMerge(float &m, float &s, float blockMax, float blockSum)
+{
+   const float newMax = std::max(m, blockMax);
+   s = s * std::exp(m - newMax) + blockSum * std::exp(blockMax - newMax);
+   m = newMax;
+}
+
+/// maximum m of the len values x (bounded from below by the lowest float, so that blocks of -inf give
+/// exp(-inf - m) = 0) and sum s of exp(x_i - m); the exponentials are stored in y unless computing LogSoftmax
+inline void SoftmaxBlock(const float *x, float *y, size_t len, bool logSoftmax, float &m, float &s)
+{
+   float vmax = std::numeric_limits<float>::lowest();
+   for (size_t i = 0; i < len; i++)
+      vmax = std::max(vmax, x[i]);
+   float sum = 0;
+   if (logSoftmax) {
+      for (size_t i = 0; i < len; i++)
+         sum += std::exp(x[i] - vmax);
+   } else {
+      for (size_t i = 0; i < len; i++) {
+         y[i] = std::exp(x[i] - vmax);
+         sum += y[i];
+      }
+   }
+   m = vmax;
+   s = sum;
+}
+
+/// Softmax (or LogSoftmax) of the row-major tensor x viewed as (outer, n, inner) along the middle axis of size n.
+/// Online softmax in two passes: the first one computes for blocks of elements their maximum and the
+/// exponentials relative to it (stored in y), merging the block sums in a running sum rescaled at every new maximum;
+/// the second one rescales each block by exp(blockMax - max) / sum (LogSoftmax needs only the final shift).
+/// For a non-last axis (inner > 1) kBlock consecutive rows along the inner dimension are processed together
+/// as vector lanes, without transposing the tensor.
+inline void Softmax(const float *x, float *y, size_t outer, size_t n, size_t inner, bool logSoftmax)
+{
+   constexpr size_t kBlock = 16;
+   constexpr size_t kRowBlock = 1024;
+   // maxima are bounded from below so that blocks of -inf values give exp(-inf - lowest) = 0
+   const float lowest = std::numeric_limits<float>::lowest();
+   const size_t nBlocks = (n + kBlock - 1) / kBlock;
+   const size_t nRowBlocks = (n + kRowBlock - 1) / kRowBlock;
+   std::vector<float> blockMax((inner == 1) ? nRowBlocks : nBlocks * kBlock);
+   float m[kBlock];
+   float s[kBlock];
+   float bm[kBlock];
+   float bs[kBlock];
+   for (size_t o = 0; o < outer; o++) {
+      const float *xo = x + o * n * inner;
+      float *yo = y + o * n * inner;
+      if (inner == 1) {
+         // contiguous axis: blocks of kRowBlock consecutive elements of the row, kept in cache between
+         // the computation of the exponentials and their rescaling
+         float vmax = lowest;
+         float sum = 0;
+         for (size_t b = 0; b < nRowBlocks; b++) {
+            const size_t i0 = b * kRowBlock;
+            float blockM;
+            float blockS;
+            SoftmaxBlock(xo + i0, yo + i0, std::min(kRowBlock, n - i0), logSoftmax, blockM, blockS);
+            blockMax[b] = blockM;
+            SoftmaxOnlineMerge(vmax, sum, blockM, blockS);
+         }
+         if (logSoftmax) {
+            const float shift = vmax + std::log(sum);
+            for (size_t i = 0; i < n; i++)
+               yo[i] = xo[i] - shift;
+         } else {
+            for (size_t b = 0; b < nRowBlocks; b++) {
+               const size_t i0 = b * kRowBlock;
+               const size_t len = std::min(kRowBlock, n - i0);
+               const float f = std::exp(blockMax[b] - vmax) / sum;
+               for (size_t i = 0; i < len; i++)
+                  yo[i0 + i] *= f;
+            }
+         }
+         continue;
+      }
+      // strided axis: each lane is a different row, elements along the axis are inner apart
+      for (size_t j0 = 0; j0 < inner; j0 += kBlock) {
+         const size_t nl = std::min(kBlock, inner - j0);
+         std::fill(m, m + kBlock, lowest);
+         std::fill(s, s + kBlock, 0.f);
+         for (size_t b = 0; b < nBlocks; b++) {
+            const size_t i0 = b * kBlock;
+            const size_t len = std::min(kBlock, n - i0);
+            std::fill(bm, bm + kBlock, lowest);
+            std::fill(bs, bs + kBlock, 0.f);
+            for (size_t i = i0; i < i0 + len; i++) {
+               const float *xr = xo + i * inner + j0;
+#pragma omp simd
+               for (size_t l = 0; l < nl; l++)
+                  bm[l] = std::max(bm[l], xr[l]);
+            }
+            for (size_t i = i0; i < i0 + len; i++) {
+               const float *xr = xo + i * inner + j0;
+               float *yr = yo + i * inner + j0;
+               if (logSoftmax) {
+#pragma omp simd
+                  for (size_t l = 0; l < nl; l++)
+                     bs[l] += std::exp(xr[l] - bm[l]);
+               } else {
+#pragma omp simd
+                  for (size_t l = 0; l < nl; l++) {
+                     yr[l] = std::exp(xr[l] - bm[l]);
+                     bs[l] += yr[l];
+                  }
+               }
+            }
+            for (size_t l = 0; l < nl; l++) {
+               blockMax[b * kBlock + l] = bm[l];
+               SoftmaxOnlineMerge(m[l], s[l], bm[l], bs[l]);
+            }
+         }
+         if (logSoftmax) {
+            for (size_t l = 0; l < nl; l++)
+               m[l] += std::log(s[l]);
+            for (size_t i = 0; i < n; i++) {
+               const float *xr = xo + i * inner + j0;
+               float *yr = yo + i * inner + j0;
+#pragma omp simd
+               for (size_t l = 0; l < nl; l++)
+                  yr[l] = xr[l] - m[l];
+            }
+         } else {
+            for (size_t b = 0; b < nBlocks; b++) {
+               const size_t i0 = b * kBlock;
+               const size_t len = std::min(kBlock, n - i0);
+               for (size_t l = 0; l < nl; l++)
+                  bm[l] = std::exp(blockMax[b * kBlock + l] - m[l]) / s[l];
+               for (size_t i = i0; i < i0 + len; i++) {
+                  float *yr = yo + i * inner + j0;
+#pragma omp simd
+                  for (size_t l = 0; l < nl; l++)
+                     yr[l] *= bm[l];
+               }
+            }
+         }
+      }
+   }
+}
+
+/// dense layer y = x * W + b, optionally followed by ReLU, on a block of rows (row-major, x is (rows, K), W is (K, N)
+/// and y is (rows, N)). The numbers of features are template parameters so that the generated code has a kernel
+/// specialized for each layer. Rows are processed by groups of 4 so that each row of W is loaded once for the 4 rows,
+/// and the bias and the activation are applied while the output rows are in cache
+template <size_t K, size_t N, bool Relu>
+inline void DenseBlock(const float *x, size_t rows, const float *w, const float *b, float *y)
+{
+   size_t r = 0;
+   for (; r + 4 <= rows; r += 4) {
+      const float *x0 = x + r * K;
+      float *y0 = y + r * N;
+      float *y1 = y0 + N;
+      float *y2 = y1 + N;
+      float *y3 = y2 + N;
+      for (size_t n = 0; n < N; n++)
+         y0[n] = y1[n] = y2[n] = y3[n] = b[n];
+      for (size_t k = 0; k < K; k++) {
+         const float *wk = w + k * N;
+         const float a0 = x0[k];
+         const float a1 = x0[K + k];
+         const float a2 = x0[2 * K + k];
+         const float a3 = x0[3 * K + k];
+#pragma omp simd
+         for (size_t n = 0; n < N; n++) {
+            y0[n] += a0 * wk[n];
+            y1[n] += a1 * wk[n];
+            y2[n] += a2 * wk[n];
+            y3[n] += a3 * wk[n];
+         }
+      }
+      if (Relu) {
+#pragma omp simd
+         for (size_t i = 0; i < 4 * N; i++)
+            y0[i] = std::max(y0[i], 0.f);
+      }
+   }
+   for (; r < rows; r++) {
+      const float *xr = x + r * K;
+      float *yr = y + r * N;
+      std::copy(b, b + N, yr);
+      for (size_t k = 0; k < K; k++) {
+         const float *wk = w + k * N;
+         const float a = xr[k];
+#pragma omp simd
+         for (size_t n = 0; n < N; n++)
+            yr[n] += a * wk[n];
+      }
+      if (Relu) {
+         for (size_t n = 0; n < N; n++)
+            yr[n] = std::max(yr[n], 0.f);
+      }
+   }
+}
+
+/// split nRows rows in at most nParts contiguous ranges of at least minRows rows (a single range for small inputs):
+/// range p is [offsets[p], offsets[p+1]). The vector is resized as needed and can be reused between calls
+inline void PartitionRows(size_t nRows, size_t nParts, size_t minRows, std::vector<size_t> &offsets)
+{
+   size_t n = std::max<size_t>(1, std::min(nParts, nRows / std::max<size_t>(1, minRows)));
+   offsets.resize(n + 1);
+   for (size_t p = 0; p <= n; p++)
+      offsets[p] = nRows * p / n;
+}
+
+/// CSR index of the edges grouped by receiver node, built with a counting sort on the receivers:
+/// the edges received by node j are index[offsets[j]],...,index[offsets[j+1]-1], in increasing edge order.
+/// The vectors are resized as needed and can be reused between calls
+inline void BuildCSRIndex(const int *receivers, size_t nEdges, size_t nNodes, std::vector<size_t> &offsets,
+                          std::vector<size_t> &index)
+{
+   offsets.assign(nNodes + 1, 0);
+   index.resize(nEdges);
+   for (size_t k = 0; k < nEdges; k++) {
+      if (receivers[k] < 0 || static_cast<size_t>(receivers[k]) >= nNodes)
+         throw std::runtime_error("TMVA SOFIE GNN - receiver index of edge " + std::to_string(k) + " is out of range");
+      offsets[receivers[k] + 1]++;
+   }
+   for (size_t j = 0; j < nNodes; j++)
+      offsets[j + 1] += offsets[j];
+   // offsets[j] is used as insertion position of node j and ends up as the start of node j+1
+   for (size_t k = 0; k < nEdges; k++)
+      index[offsets[receivers[k]]++] = k;
+   for (size_t j = nNodes; j > 0; j--)
+      offsets[j] = offsets[j - 1];
+   offsets[0] = 0;
+}
+
+/// segment reductions of the rows (of length nFeatures) of data: output row j is the sum of the rows
+/// index[offsets[j]],...,index[offsets[j+1]-1], or of the contiguous rows offsets[j],...,offsets[j+1]-1
+/// when index is a null pointer. Empty segments give a row of zeros.
+/// The features are reduced by blocks of kSegmentBlock accumulated in a local array over all the rows of the
+/// segment: the fixed-size loops on a block do not alias the output and are vectorized by the compiler
+constexpr size_t kSegmentBlock = 16;
+
+template <typename Reduce>
+inline void SegmentReduce(const float *data, size_t nFeatures, const size_t *offsets, const size_t *index,
+                          size_t nSegments, float *out, Reduce reduce)
+{
+   for (size_t j = 0; j < nSegments; j++) {
+      float *y = out + j * nFeatures;
+      if (offsets[j] == offsets[j + 1]) {
+         std::fill(y, y + nFeatures, 0.f);
+         continue;
+      }
+      for (size_t f0 = 0; f0 < nFeatures; f0 += kSegmentBlock) {
+         const size_t nf = std::min(kSegmentBlock, nFeatures - f0);
+         float acc[kSegmentBlock];
+         const float *x0 = data + (index ? index[offsets[j]] : offsets[j]) * nFeatures + f0;
+         std::copy(x0, x0 + nf, acc);
+         for (size_t e = offsets[j] + 1; e < offsets[j + 1]; e++) {
+            const float *x = data + (index ? index[e] : e) * nFeatures + f0;
+            if (nf == kSegmentBlock) {
+               for (size_t f = 0; f < kSegmentBlock; f++)
+                  acc[f] = reduce(acc[f], x[f]);
+            } else {
+               for (size_t f = 0; f < nf; f++)
+                  acc[f] = reduce(acc[f], x[f]);
+            }
+         }
+         std::copy(acc, acc + nf, y + f0);
+      }
+   }
+}
+
+inline void SegmentSum(const float *data, size_t nFeatures, const size_t *offsets, const size_t *index,
+                       size_t nSegments, float *out)
+{
+   SegmentReduce(data, nFeatures, offsets, index, nSegments, out, [](float a, float b) { return a + b; });
+}
+
+inline void SegmentMean(const float *data, size_t nFeatures, const size_t *offsets, const size_t *index,
+                        size_t nSegments, float *out)
+{
+   SegmentSum(data, nFeatures, offsets, index, nSegments, out);
+   for (size_t j = 0; j < nSegments; j++) {
+      const size_t count = offsets[j + 1] - offsets[j];
+      if (count < 2) continue;
+      const float scale = 1.f / count;
+      float *y = out + j * nFeatures;
+      for (size_t f = 0; f < nFeatures; f++)
+         y[f] *= scale;
+   }
+}
+
+inline void SegmentMax(const float *data, size_t nFeatures, const size_t *offsets, const size_t *index,
+                       size_t nSegments, float *out)
+{
+   SegmentReduce(data, nFeatures, offsets, index, nSegments, out, [](float a, float b) { return (a < b) ? b : a; });
+}
+
+}  // end namespace UTILITY
+
 
 struct GNN_Data {
       TMVA::Experimental::RTensor<float> node_data;      // the node feature data, tensor with shape (num_nodes, num_node_features)
@@ -643,10 +1472,44 @@ struct GNN_Data {
 
 };
 
+// non-owning view of a graph stored in caller buffers, with the same row-major layout as GNN_Data.
+// The generated GNN sessions accept it as input and write the updated features in the buffers of
+// an output view (which can be the input one) instead of resizing and copying GNN_Data tensors
+struct GNN_DataView {
+      std::span<float> node_data;      // num_nodes * num_node_features
+      std::span<float> edge_data;      // num_edges * num_edge_features
+      std::span<float> global_data;    // num_global_features
+      std::span<int> edge_index;       // receivers followed by senders, 2 * num_edges
+      std::size_t num_nodes = 0;
+      std::size_t num_edges = 0;
+      std::size_t num_node_features = 0;
+      std::size_t num_edge_features = 0;
+      std::size_t num_global_features = 0;
+
+      GNN_DataView() {}
+      // view on the tensors of a GNN_Data (no copy)
+      GNN_DataView(GNN_Data & data):
+         node_data(data.node_data.GetData(), data.node_data.GetSize()),
+         edge_data(data.edge_data.GetData(), data.edge_data.GetSize()),
+         global_data(data.global_data.GetData(), data.global_data.GetSize()),
+         edge_index(data.edge_index.GetData(), data.edge_index.GetSize()),
+         num_nodes(data.node_data.GetShape().empty() ? 0 : data.node_data.GetShape()[0]),
+         num_edges(data.edge_data.GetShape().empty() ? 0 : data.edge_data.GetShape()[0]),
+         num_node_features(data.node_data.GetShape().size() > 1 ? data.node_data.GetShape()[1] : 0),
+         num_edge_features(data.edge_data.GetShape().size() > 1 ? data.edge_data.GetShape()[1] : 0),
+         num_global_features(data.global_data.GetSize()) {}
+
+      // check that the buffers hold the given numbers of nodes, edges and features
+      bool HasValidSizes() const {
+         return node_data.size() >= num_nodes * num_node_features && edge_data.size() >= num_edges * num_edge_features &&
+                global_data.size() >= num_global_features && edge_index.size() >= 2 * num_edges;
+      }
+};
+
 template<typename T>
-TMVA::Experimental::RTensor<T> Concatenate( TMVA::Experimental::RTensor<T> & t1,  TMVA::Experimental::RTensor<T> & t2, int axis = 0)
+std::vector<size_t> ConcatenateShape( TMVA::Experimental::RTensor<T> & t1,  TMVA::Experimental::RTensor<T> & t2, int axis = 0)
 {
-   // concatenate tensor along axis. Shape must be the same except in the dimension of the concatenated axis
+   // shape of the concatenated tensor. Shape must be the same except in the dimension of the concatenated axis
    if (t1.GetMemoryLayout() != t2.GetMemoryLayout())
       throw std::runtime_error("TMVA RTensor Concatenate - tensors have different memory layout");
    auto & shape1 = t1.GetShape();
@@ -659,7 +1522,16 @@ TMVA::Experimental::RTensor<T> Concatenate( TMVA::Experimental::RTensor<T> & t1,
    }
    std::vector<size_t> outShape = shape1;
    outShape[axis] = shape1[axis] + shape2[axis];
-   TMVA::Experimental::RTensor<T> tout(outShape, t1.GetMemoryLayout());
+   return outShape;
+}
+
+// concatenate tensor along axis in a preallocated output tensor, which must have the concatenated shape
+template<typename T>
+void Concatenate( TMVA::Experimental::RTensor<T> & t1,  TMVA::Experimental::RTensor<T> & t2, TMVA::Experimental::RTensor<T> & tout, int axis = 0)
+{
+   if (tout.GetShape() != ConcatenateShape(t1, t2, axis) || tout.GetMemoryLayout() != t1.GetMemoryLayout())
+      throw std::runtime_error("TMVA RTensor Concatenate - output tensor has shape " + ConvertShapeToString(tout.GetShape()) +
+                               " instead of " + ConvertShapeToString(ConcatenateShape(t1, t2, axis)));
    if (t1.GetMemoryLayout() == TMVA::Experimental::MemoryLayout::ColumnMajor) {
       throw std::runtime_error("TMVA RTensor Concatenate is not yet supported for column major tensors");
    }
@@ -676,7 +1548,13 @@ TMVA::Experimental::RTensor<T> Concatenate( TMVA::Experimental::RTensor<T> & t1,
       std::copy(t1.GetData() + i*s1, t1.GetData() + (i+1)*s1, tout.GetData() + i * sout );
       std::copy(t2.GetData() + i*s2, t2.GetData() + (i+1)*s2, tout.GetData() + i * sout + s1 );
    }
+}
 
+template<typename T>
+TMVA::Experimental::RTensor<T> Concatenate( TMVA::Experimental::RTensor<T> & t1,  TMVA::Experimental::RTensor<T> & t2, int axis = 0)
+{
+   TMVA::Experimental::RTensor<T> tout(ConcatenateShape(t1, t2, axis), t1.GetMemoryLayout());
+   Concatenate(t1, t2, tout, axis);
    return tout;
 }
 
@@ -691,16 +1569,35 @@ inline GNN_Data Concatenate(GNN_Data & data1, GNN_Data & data2, int axis = 0) {
    return out;
 }
 
+// concatenate in a preallocated graph, whose tensors must have the concatenated shapes
+inline void Concatenate(GNN_Data & data1, GNN_Data & data2, GNN_Data & out, int axis = 0) {
+   Concatenate(data1.node_data, data2.node_data, out.node_data, axis);
+   Concatenate(data1.edge_data, data2.edge_data, out.edge_data, axis);
+   Concatenate<float>(data1.global_data, data2.global_data, out.global_data, axis-1);
+   // assume sender/receivers of data1 and data2 are the same
+   if (out.edge_index.GetShape() != data1.edge_index.GetShape())
+      throw std::runtime_error("TMVA SOFIE Concatenate - output graph has a wrong edge index shape");
+   std::copy(data1.edge_index.GetData(), data1.edge_index.GetData() + data1.edge_index.GetSize(), out.edge_index.GetData());
+}
+
+// copy in a preallocated graph, whose tensors must have the same shapes
+inline void Copy(const GNN_Data & data, GNN_Data & out) {
+   if (out.node_data.GetShape() != data.node_data.GetShape() || out.edge_data.GetShape() != data.edge_data.GetShape() ||
+       out.global_data.GetShape() != data.global_data.GetShape() || out.edge_index.GetShape() != data.edge_index.GetShape())
+      throw std::runtime_error("TMVA SOFIE Copy - output graph has different shapes");
+   std::copy(data.node_data.GetData(), data.node_data.GetData()+ data.node_data.GetSize(), out.node_data.GetData());
+   std::copy(data.edge_data.GetData(), data.edge_data.GetData()+ data.edge_data.GetSize(), out.edge_data.GetData());
+   std::copy(data.global_data.GetData(), data.global_data.GetData()+ data.global_data.GetSize(), out.global_data.GetData());
+   std::copy(data.edge_index.GetData(), data.edge_index.GetData()+ data.edge_index.GetSize(), out.edge_index.GetData());
+}
+
 inline GNN_Data Copy(const GNN_Data & data) {
    GNN_Data out;
    out.node_data = TMVA::Experimental::RTensor<float>(data.node_data.GetShape());
    out.edge_data = TMVA::Experimental::RTensor<float>(data.edge_data.GetShape());
    out.global_data = TMVA::Experimental::RTensor<float>(data.global_data.GetShape());
    out.edge_index = TMVA::Experimental::RTensor<int>(data.edge_index.GetShape());
-   std::copy(data.node_data.GetData(), data.node_data.GetData()+ data.node_data.GetSize(), out.node_data.GetData());
-   std::copy(data.edge_data.GetData(), data.edge_data.GetData()+ data.edge_data.GetSize(), out.edge_data.GetData());
-   std::copy(data.global_data.GetData(), data.global_data.GetData()+ data.global_data.GetSize(), out.global_data.GetData());
-   std::copy(data.edge_index.GetData(), data.edge_index.GetData()+ data.edge_index.GetSize(), out.edge_index.GetData());
+   Copy(data, out);
    return out;
 }
 
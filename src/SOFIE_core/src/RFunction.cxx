@@ -28,7 +28,11 @@ RFunction_Update::RFunction_Update(FunctionTarget target, GraphType gType): fTar
 
     if(fGraphType == GraphType::GNN) {
         if(fTarget == FunctionTarget::EDGES) {
-            fInputTensors = {"edge","receiver","sender","global"};
+            // node features are not copied per edge but gathered using the receiver and sender indices,
+            // globals are gathered using the graph index of the nodes (one row per graph of a batch)
+            fInputTensors = {"edge","node","global","receivers","senders","node_graph"};
+            fInputTensorTypes = {ETensorType::FLOAT, ETensorType::FLOAT, ETensorType::FLOAT,
+                                 ETensorType::INT32, ETensorType::INT32, ETensorType::INT32};
         } else if(fTarget == FunctionTarget::NODES || fTarget == FunctionTarget::GLOBALS) {
             fInputTensors = {"edge","node","global"};
         }
@@ -42,18 +46,21 @@ RFunction_Update::RFunction_Update(FunctionTarget target, GraphType gType): fTar
             fInputTensors = {"global"};
         }
     }
+    if(fInputTensorTypes.empty()) {
+        fInputTensorTypes.assign(fInputTensors.size(), ETensorType::FLOAT);
+    }
 }
 
 // add input tensors, order of provided shapes must be the same as in fInputTensors
 void RFunction_Update::AddInputTensors(const std::vector<std::vector<std::size_t>>& inputShapes) {
     for(long unsigned int i=0; i<inputShapes.size(); ++i) {
-        function_block->AddInputTensorInfo(fInputTensors[i],ETensorType::FLOAT, inputShapes[i]);
+        function_block->AddInputTensorInfo(fInputTensors[i],fInputTensorTypes[i], inputShapes[i]);
         function_block->AddInputTensorName(fInputTensors[i]);
     }
 }
 void RFunction_Update::AddInputTensors(const std::vector<std::vector<Dim>>& inputShapes) {
     for(long unsigned int i=0; i<inputShapes.size(); ++i) {
-        function_block->AddInputTensorInfo(fInputTensors[i],ETensorType::FLOAT, inputShapes[i]);
+        function_block->AddInputTensorInfo(fInputTensors[i],fInputTensorTypes[i], inputShapes[i]);
         function_block->AddInputTensorName(fInputTensors[i]);
     }
 }
@@ -80,6 +87,21 @@ std::string RFunction_Update::Generate(const std::vector<std::string>& inputs) {
     return inferFunc;
 }
 
+std::string RFunction_Update::GenerateNoCopy(const std::vector<std::string>& inputs, const std::string& session) {
+    std::string inferFunc = (session.empty() ? fFuncName + "." : session) + "doInfer(";
+    for(auto&it : inputs) {
+        inferFunc+=it;
+        inferFunc+=",";
+    }
+    inferFunc.pop_back();
+    inferFunc+=");";
+    return inferFunc;
+}
+
+std::string RFunction_Update::GetOutputTensorPtr(const std::string& session) {
+    return (session.empty() ? fFuncName + "." : session) + "tensor_" + function_block->GetOutputTensorNames()[0];
+}
+
 // passing as input a vector of strings for each input tensor
 std::string RFunction_Aggregate::Generate(std::size_t num_features, const std::vector<std::string>& inputTensors) {
     std::string inferFunc = fFuncName+"("+std::to_string(num_features)+",{";
@@ -98,6 +120,29 @@ std::string RFunction_Aggregate::Generate(std::size_t num_features, const std::s
     return inferFunc;
 }
 
+std::string RFunction_Aggregate::GenerateSegmentReduce(std::size_t num_features, const std::string & inputData, const std::string & offsets,
+                                                       const std::string & index, const std::string & nSegments, const std::string & output) {
+    std::string reduceFunc;
+    switch(fReducer) {
+    case FunctionReducer::SUM: {
+        reduceFunc = "SOFIE::UTILITY::SegmentSum";
+        break;
+    }
+    case FunctionReducer::MEAN: {
+        reduceFunc = "SOFIE::UTILITY::SegmentMean";
+        break;
+    }
+    case FunctionReducer::MAX: {
+        reduceFunc = "SOFIE::UTILITY::SegmentMax";
+        break;
+    }
+    default:
+        throw std::runtime_error("TMVA SOFIE: Invalid reducer for Aggregate function " + fFuncName);
+    }
+    return reduceFunc + "(" + inputData + ", " + std::to_string(num_features) + ", " + offsets + ", " + index + ", " +
+           nSegments + ", " + output + ");";
+}
+
 
 
 
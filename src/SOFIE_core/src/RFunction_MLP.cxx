@@ -4,6 +4,8 @@
 #include "SOFIE/SOFIE_common.hxx"
 #include "SOFIE/ROperator_Concat.hxx"
 #include "SOFIE/ROperator_Gemm.hxx"
+#include "SOFIE/ROperator_GatherGemm.hxx"
+#include "SOFIE/ROperator_FusedMLP.hxx"
 #include "SOFIE/ROperator_LayerNormalization.hxx"
 #include "SOFIE/ROperator_Relu.hxx"
 
@@ -28,38 +30,70 @@ RFunction_MLP::RFunction_MLP(FunctionTarget target, Int_t numLayers, Activation
 void RFunction_MLP::Initialize() {
 
     std::string fGemmInput;
+    // for the GNN edge update the first layer is computed gathering the node features with the edge indices
+    bool gatherInputs = false;
     if(fGraphType == GraphType::GNN) {
-        std::unique_ptr<ROperator> op_concat;
-        op_concat.reset(new ROperator_Concat(fInputTensors,1,0,fFuncName+"InputConcat"));
-        function_block->AddOperator(std::move(op_concat));
-        fGemmInput = fFuncName+"InputConcat";
+        if(fTarget == FunctionTarget::EDGES) {
+            gatherInputs = true;
+        } else {
+            std::unique_ptr<ROperator> op_concat;
+            op_concat.reset(new ROperator_Concat(fInputTensors,1,0,fFuncName+"InputConcat"));
+            function_block->AddOperator(std::move(op_concat));
+            fGemmInput = fFuncName+"InputConcat";
+        }
 
     } else if(fGraphType == GraphType::GraphIndependent) {
         fGemmInput = fInputTensors[0];
     }
 
-    std::unique_ptr<ROperator> op_gemm;
-    for(int i=0; i<fNumLayers-1; ++i) {
-        double beta = (fBiasTensors[i].empty()) ? 0. : 1.;
-        op_gemm.reset(new ROperator_Gemm<float>(1.0,beta,0,0,fGemmInput,UTILITY::Clean_name(fKernelTensors[i]),UTILITY::Clean_name(fBiasTensors[i]),fFuncName+"Gemm"+std::to_string(i)));
-        function_block->AddOperator(std::move(op_gemm));
-        fGemmInput = fFuncName+"Gemm"+i;
+    // linear layer i of the MLP, the first one of a GNN edge update is a fused gather and Gemm
+    auto makeLinear = [&](int i, const std::string& kernel, const std::string& bias, const std::string& output) {
+        std::unique_ptr<ROperator> op;
+        if(i == 0 && gatherInputs) {
+            op.reset(new ROperator_GatherGemm<float>(fInputTensors[0],fInputTensors[1],fInputTensors[2],fInputTensors[3],
+                                                     fInputTensors[4],fInputTensors[5],UTILITY::Clean_name(kernel),
+                                                     UTILITY::Clean_name(bias),output));
+        } else {
+            double beta = (bias.empty()) ? 0. : 1.;
+            op.reset(new ROperator_Gemm<float>(1.0,beta,0,0,fGemmInput,UTILITY::Clean_name(kernel),UTILITY::Clean_name(bias),output));
+        }
+        return op;
+    };
+
+    // the linear layers and their activations (after the gathering one for a GNN edge update) are computed
+    // by a single fused operator, keeping the hidden activations of a block of rows in cache
+    bool reluFinal = fActivateFinal && fActivationFunction == Activation::RELU;
+    int firstFused = (gatherInputs) ? 1 : 0;
+    bool fuseLayers = fNumLayers > firstFused;
+
+    int numUnfused = (fuseLayers) ? firstFused : fNumLayers;
+    for(int i=0; i<std::min(numUnfused,fNumLayers-1); ++i) {
+        function_block->AddOperator(makeLinear(i,fKernelTensors[i],fBiasTensors[i],fFuncName+"Gemm"+std::to_string(i)));
+        fGemmInput = fFuncName+"Gemm"+std::to_string(i);
         if (fActivationFunction == Activation::RELU) {
             std::unique_ptr<ROperator> op_relu;
             op_relu.reset(new ROperator_Relu<float>(fFuncName+"Gemm"+std::to_string(i), fFuncName+"Relu"+std::to_string(i)));
             function_block->AddOperator(std::move(op_relu));
-            fGemmInput = fFuncName+"Relu"+i;
+            fGemmInput = fFuncName+"Relu"+std::to_string(i);
 
         }
     }
-    double beta = (fBiasTensors.back().empty()) ? 0. : 1.;
-    op_gemm.reset(new ROperator_Gemm<float>(1.0,beta,0,0,fGemmInput,UTILITY::Clean_name(fKernelTensors.back()),UTILITY::Clean_name(fBiasTensors.back()),fFuncName+"Gemm"+std::to_string(fNumLayers)));
-    function_block->AddOperator(std::move(op_gemm));
-    if(fActivateFinal) {
-        if (fActivationFunction == Activation::RELU) {
-            std::unique_ptr<ROperator> op_relu;
-            op_relu.reset(new ROperator_Relu<float>(fFuncName+"Gemm"+std::to_string(fNumLayers), fFuncName+"Relu"+std::to_string(fNumLayers)));
-            function_block->AddOperator(std::move(op_relu));
+    if (fuseLayers) {
+        std::vector<std::string> kernels(fKernelTensors.begin() + firstFused, fKernelTensors.end());
+        std::vector<std::string> biases(fBiasTensors.begin() + firstFused, fBiasTensors.end());
+        std::string output = fFuncName + ((fActivateFinal) ? "Relu" : "Gemm") + std::to_string(fNumLayers);
+        std::unique_ptr<ROperator> op_mlp;
+        op_mlp.reset(new ROperator_FusedMLP<float>(fGemmInput, kernels, biases,
+                                                   fActivationFunction == Activation::RELU, reluFinal, output));
+        function_block->AddOperator(std::move(op_mlp));
+    } else {
+        function_block->AddOperator(makeLinear(fNumLayers-1,fKernelTensors.back(),fBiasTensors.back(),fFuncName+"Gemm"+std::to_string(fNumLayers)));
+        if(fActivateFinal) {
+            if (fActivationFunction == Activation::RELU) {
+                std::unique_ptr<ROperator> op_relu;
+                op_relu.reset(new ROperator_Relu<float>(fFuncName+"Gemm"+std::to_string(fNumLayers), fFuncName+"Relu"+std::to_string(fNumLayers)));
+                function_block->AddOperator(std::move(op_relu));
+            }
         }
     }
 
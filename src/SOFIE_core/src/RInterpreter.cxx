@@ -0,0 +1,122 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "SOFIE/RInterpreter.hxx"
+
+namespace SOFIE {
+
+RInterpreter::RInterpreter(RModel &model, int batchSize, bool verbose) : fModel(model), fVerbose(verbose)
+{
+   fModel.Initialize(batchSize, verbose);
+   PlanMemory();
+}
+
+RInterpreter::RInterpreter(RModel &model, const std::map<std::string, size_t> &inputParams, bool verbose)
+   : fModel(model), fVerbose(verbose)
+{
+   fModel.Initialize(inputParams, verbose);
+   PlanMemory();
+}
+
+void RInterpreter::PlanMemory()
+{
+   std::map<std::string, size_t> offsets;
+   size_t arenaSize = fModel.PlanIntermediateMemory(offsets);
+   fArena.assign(arenaSize, 0);
+   fArenaChunks.clear();
+   for (auto &o : offsets) {
+      size_t size = GetTypeSize(fModel.GetTensorType(o.first)) * ConvertShapeToLength(fModel.GetTensorShape(o.first));
+      fArenaChunks[o.first] = {o.second, size};
+   }
+   if (fVerbose)
+      std::cout << "RInterpreter: " << fArenaChunks.size() << " intermediate tensors planned in an arena of "
+                << arenaSize << " bytes" << std::endl;
+}
+
+bool RInterpreter::HasTensor(const std::string &name) const
+{
+   return fTensors.count(name) > 0 || fModel.IsInitializedTensor(name);
+}
+
+const RInterpreter::Tensor &RInterpreter::GetTensor(const std::string &name)
+{
+   auto itr = fTensors.find(name);
+   if (itr != fTensors.end())
+      return itr->second;
+   // initialized tensors are used directly from the model
+   if (fModel.IsInitializedTensor(name)) {
+      Tensor t{fModel.GetTensorType(name), fModel.GetTensorShape(name), fModel.GetInitializedTensorData(name).get()};
+      return fTensors.emplace(name, t).first->second;
+   }
+   throw std::runtime_error("TMVA-SOFIE: tensor " + name + " is not available in the interpreter");
+}
+
+void *RInterpreter::AllocateTensor(const std::string &name, ETensorType type, const std::vector<size_t> &shape)
+{
+   size_t size = GetTypeSize(type) * ConvertShapeToLength(shape);
+   Tensor &t = fTensors[name];
+   t.type = type;
+   t.shape = shape;
+   auto chunk = fArenaChunks.find(name);
+   if (chunk != fArenaChunks.end() && size <= chunk->second.second) {
+      t.data = fArena.data() + chunk->second.first;
+   } else {
+      // the buffers are kept between the runs
+      auto &buffer = fBuffers[name];
+      if (buffer.size() < size)
+         buffer.resize(size);
+      t.data = buffer.data();
+   }
+   return t.data;
+}
+
+void RInterpreter::Run(const std::vector<const void *> &inputs, const std::vector<std::vector<size_t>> &inputShapes)
+{
+   auto &inputNames = fModel.GetInputTensorNames();
+   if (inputs.size() != inputNames.size())
+      throw std::runtime_error("TMVA-SOFIE: interpreter called with " + std::to_string(inputs.size()) +
+                               " inputs while the model has " + std::to_string(inputNames.size()));
+   if (!inputShapes.empty() && inputShapes.size() != inputNames.size())
+      throw std::runtime_error("TMVA-SOFIE: interpreter called with a wrong number of input shapes");
+
+   fTensors.clear();
+   for (size_t i = 0; i < inputNames.size(); i++) {
+      auto &name = inputNames[i];
+      std::vector<size_t> shape = (inputShapes.empty()) ? std::vector<size_t>{} : inputShapes[i];
+      if (fModel.IsDimInputTensor(name)) {
+         auto dimShape = fModel.GetDynamicTensorShape(name);
+         if (shape.size() != dimShape.size())
+            throw std::runtime_error("TMVA-SOFIE: interpreter needs the shape of the input " + name + " " +
+                                     ConvertDynamicShapeToString(dimShape));
+         for (size_t j = 0; j < shape.size(); j++) {
+            if (!dimShape[j].isParam && dimShape[j].dim != shape[j])
+               throw std::runtime_error("TMVA-SOFIE: input " + name + " given with shape " +
+                                        ConvertShapeToString(shape) + " instead of " +
+                                        ConvertDynamicShapeToString(dimShape));
+         }
+      } else {
+         auto &modelShape = fModel.GetTensorShape(name);
+         if (!shape.empty() && shape != modelShape)
+            throw std::runtime_error("TMVA-SOFIE: input " + name + " given with shape " + ConvertShapeToString(shape) +
+                                     " instead of " + ConvertShapeToString(modelShape));
+         shape = modelShape;
+      }
+      // inputs are only read by the operators
+      fTensors[name] = Tensor{fModel.GetTensorType(name), shape, const_cast<void *>(inputs[i])};
+   }
+
+   auto &operators = fModel.GetOperators();
+   for (size_t op_idx = 0; op_idx < operators.size(); op_idx++) {
+      // the constant outputs are computed at initialization and stored as initialized tensors
+      if (operators[op_idx]->IsOutputConstant())
+         continue;
+      try {
+         operators[op_idx]->Execute(*this);
+      } catch (const std::exception &e) {
+         throw std::runtime_error("TMVA-SOFIE: interpreter failed running operator " + std::to_string(op_idx) +
+                                  " of model " + fModel.GetName() + ": " + e.what());
+      }
+   }
+}
+
+} // namespace SOFIE
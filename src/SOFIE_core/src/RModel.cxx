@@ -1,12 +1,15 @@
 #include <limits>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <unordered_set>
 
 #include "TFile.h"
 
 #include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
 #include "SOFIE/SOFIE_common.hxx"
 
 
@@ -33,6 +36,16 @@ RModel::RModel(RModel&& other) {
     fGC = other.fGC;
     fNeededBlasRoutines = other.fNeededBlasRoutines;
     fNeededStdLib = other.fNeededStdLib;
+    fIsStreaming = other.fIsStreaming;
+    fUseBinaryConstants = other.fUseBinaryConstants;
+    fUseCInterface = other.fUseCInterface;
+    fProfileOperators = other.fProfileOperators;
+    fUseBlockedLayout = other.fUseBlockedLayout;
+    fRemoveDeadCode = other.fRemoveDeadCode;
+    fIsBlockedLayoutAssigned = other.fIsBlockedLayoutAssigned;
+    fOptimizationReport = std::move(other.fOptimizationReport);
+    fBatchSpecializations = std::move(other.fBatchSpecializations);
+    fModelSource = std::move(other.fModelSource);
 }
 
 RModel& RModel::operator=(RModel&& other) {
@@ -49,6 +62,16 @@ RModel& RModel::operator=(RModel&& other) {
     fGC = other.fGC;
     fNeededBlasRoutines = other.fNeededBlasRoutines;
     fNeededStdLib = other.fNeededStdLib;
+    fIsStreaming = other.fIsStreaming;
+    fUseBinaryConstants = other.fUseBinaryConstants;
+    fUseCInterface = other.fUseCInterface;
+    fProfileOperators = other.fProfileOperators;
+    fUseBlockedLayout = other.fUseBlockedLayout;
+    fRemoveDeadCode = other.fRemoveDeadCode;
+    fIsBlockedLayoutAssigned = other.fIsBlockedLayoutAssigned;
+    fOptimizationReport = std::move(other.fOptimizationReport);
+    fBatchSpecializations = std::move(other.fBatchSpecializations);
+    fModelSource = std::move(other.fModelSource);
     return *this;
 }
 
@@ -322,6 +345,7 @@ std::string RModel:: AllocateIntermediateMemory(std::span<const std::string_view
                      auto new_chunk = fIntermediateMemoryInfo.total_stack[chunk->first].split(it, tensor_size);
                      auto new_chunk_location = chunk->first+chunk->second-tensor_size;
                      fIntermediateMemoryInfo.total_stack[new_chunk_location] = new_chunk;
+                     fIntermediateMemoryInfo.tensor_offsets[std::string(it)] = new_chunk_location;
 
                      memory_allocation_string += "\n" + ConvertTypeToString(GetTensorType(std::string(it))) +
                                                 "* tensor_" + std::string(it) +
@@ -349,6 +373,7 @@ std::string RModel:: AllocateIntermediateMemory(std::span<const std::string_view
                      it,
                      tensor_size
                    };
+               fIntermediateMemoryInfo.tensor_offsets[std::string(it)] = chunk_idx;
 
                memory_allocation_string += "\n"+ConvertTypeToString(GetTensorType(std::string(it)))+"* tensor_"+ std::string(it) + "= reinterpret_cast<"+ConvertTypeToString(GetTensorType(std::string(it)))+"*>(fIntermediateMemoryPool + " + std::to_string(chunk_idx) + ");\n";
          }
@@ -358,43 +383,81 @@ std::string RModel:: AllocateIntermediateMemory(std::span<const std::string_view
 
 void RModel::CheckAndFlushIntermediateMemory(std::span<const std::string_view> op_input_tensors, const size_t& op_idx){
    for (auto &it : op_input_tensors){
-      // last occurence of the tensor is reached => flush it from memory
-      if (fIntermediateTensorFrequencyLookup[it] == op_idx) {
-         for (auto chunk = fIntermediateMemoryInfo.total_stack.begin();
-               chunk != fIntermediateMemoryInfo.total_stack.end(); ++chunk ) {
-               if (chunk->second.tensor_name == it) {
-
-                     // check if nearby chunks in available memory can coalesce
-                     auto first_greater = fIntermediateMemoryInfo.available_stack.upper_bound(chunk->first); // smallest element greater than the flushed chunk idx
-                     auto last_smaller = (first_greater == fIntermediateMemoryInfo.available_stack.begin()) ? fIntermediateMemoryInfo.available_stack.end() : std::prev(first_greater); // largest element smaller than the flushed chunk idx
-
-                     // check if the next stack entry is actually adjacent in memory
-                     if (last_smaller->first+last_smaller->second + 1 == chunk->first){
-                        last_smaller->second += chunk->second.tensor_size;
-                        fIntermediateMemoryInfo.total_stack[last_smaller->first].merge(chunk->second);
-
-                        if (last_smaller->first + last_smaller->second + 1 == first_greater->first){
-                              fIntermediateMemoryInfo.total_stack[last_smaller->first].merge(fIntermediateMemoryInfo.total_stack[first_greater->first]);
-                              first_greater = fIntermediateMemoryInfo.available_stack.erase(first_greater);
-                        }
-                     } else{
-                        if (chunk->first + chunk->second.tensor_size + 1 == first_greater->first){
-                           fIntermediateMemoryInfo.total_stack[chunk->first].merge(fIntermediateMemoryInfo.total_stack[first_greater->first]);
-                           first_greater = fIntermediateMemoryInfo.available_stack.erase(first_greater);
-                        }
-                        fIntermediateMemoryInfo.available_stack.insert({
-                           chunk->first,
-                           chunk->second.tensor_size
-        });
-                     }
+      // last occurence of the tensor is reached => flush it from memory. The inputs which are not in the lookup
+      // table (e.g. weights or tensors declared in the Session) must not be added to it
+      auto itr = fIntermediateTensorFrequencyLookup.find(it);
+      if (itr != fIntermediateTensorFrequencyLookup.end() && itr->second == op_idx)
+         ReleaseIntermediateMemory(it);
+   }
+}
+
+void RModel::ReleaseIntermediateMemory(std::string_view tensor_name){
+   for (auto chunk = fIntermediateMemoryInfo.total_stack.begin();
+         chunk != fIntermediateMemoryInfo.total_stack.end(); ++chunk ) {
+         if (chunk->second.tensor_name == tensor_name) {
+
+               // check if nearby chunks in available memory can coalesce
+               auto first_greater = fIntermediateMemoryInfo.available_stack.upper_bound(chunk->first); // smallest element greater than the flushed chunk idx
+               auto last_smaller = (first_greater == fIntermediateMemoryInfo.available_stack.begin()) ? fIntermediateMemoryInfo.available_stack.end() : std::prev(first_greater); // largest element smaller than the flushed chunk idx
+
+               // check if the next stack entry is actually adjacent in memory
+               if (last_smaller != fIntermediateMemoryInfo.available_stack.end() &&
+                   last_smaller->first+last_smaller->second + 1 == chunk->first){
+                  last_smaller->second += chunk->second.tensor_size;
+                  fIntermediateMemoryInfo.total_stack[last_smaller->first].merge(chunk->second);
+
+                  if (first_greater != fIntermediateMemoryInfo.available_stack.end() &&
+                      last_smaller->first + last_smaller->second + 1 == first_greater->first){
+                        fIntermediateMemoryInfo.total_stack[last_smaller->first].merge(fIntermediateMemoryInfo.total_stack[first_greater->first]);
+                        first_greater = fIntermediateMemoryInfo.available_stack.erase(first_greater);
+                  }
+               } else{
+                  if (first_greater != fIntermediateMemoryInfo.available_stack.end() &&
+                      chunk->first + chunk->second.tensor_size + 1 == first_greater->first){
+                     fIntermediateMemoryInfo.total_stack[chunk->first].merge(fIntermediateMemoryInfo.total_stack[first_greater->first]);
+                     first_greater = fIntermediateMemoryInfo.available_stack.erase(first_greater);
+                  }
+                  fIntermediateMemoryInfo.available_stack.insert({
+                     chunk->first,
+                     chunk->second.tensor_size
+  });
                }
          }
-      }
    }
 }
 
 
 
+namespace {
+
+// size of the pool needed by the planned intermediate tensors
+size_t GetMemoryPoolSize(const MemoryPoolInfo &info)
+{
+   if (info.total_stack.empty())
+      return 0;
+   return info.total_stack.rbegin()->first + info.total_stack.rbegin()->second.tensor_size;
+}
+
+} // namespace
+
+size_t RModel::PlanIntermediateMemory(std::map<std::string, size_t> &offsets) {
+   if (!fIsInitialized)
+      throw std::runtime_error("TMVA-SOFIE: model " + fName + " must be initialized before planning its memory");
+   fIntermediateMemoryInfo = MemoryPoolInfo();
+   for (size_t op_idx = 0; op_idx < fOperators.size(); ++op_idx) {
+      AllocateIntermediateMemory(fOperators[op_idx]->GetOpOutputTensors());
+      AllocateIntermediateMemory(fOperators[op_idx]->GetOpScratchTensors());
+      CheckAndFlushIntermediateMemory(fOperators[op_idx]->GetOpInputTensors(), op_idx);
+      for (auto &name : fOperators[op_idx]->GetOpScratchTensors())
+         ReleaseIntermediateMemory(name);
+   }
+   offsets = fIntermediateMemoryInfo.tensor_offsets;
+   size_t poolSize = GetMemoryPoolSize(fIntermediateMemoryInfo);
+   // the plan is rebuilt when generating the code
+   fIntermediateMemoryInfo = MemoryPoolInfo();
+   return poolSize;
+}
+
 void RModel::Initialize(int batchSize, bool verbose) {
    std::map<std::string, size_t> inputParams;
    if (batchSize > 0) {
@@ -480,6 +543,10 @@ void RModel::Initialize(const std::map<std::string, size_t> & inputParams, bool
       if (!modelHasWeights)
          fUseWeightFile = false;
    }
+   // operators not needed for computing the model outputs are not initialized
+   if (fRemoveDeadCode)
+      RemoveDeadOperators();
+
    // Go through model and initialize each operator
    int i = 0;
 
@@ -490,7 +557,28 @@ void RModel::Initialize(const std::map<std::string, size_t> & inputParams, bool
          auto& r = *fOperators[op_idx].get();
          std::cout << "Initializing operator " << i << "  " << typeid(r).name() << std::endl;
       }
+      // fold a following BatchNormalization in the operator weights (e.g. Conv + BN) before initializing it
+      if (FoldChannelAffine(op_idx) && verbose) {
+         std::cout << "Folded BatchNormalization in operator " << i << std::endl;
+      }
+      // operators with only initialized inputs are evaluated and replaced by their outputs (constant folding).
+      // The tensors declared by the operator are needed to remove the ones it adds for itself
+      bool foldable = IsConstantFoldable(op_idx);
+      std::set<std::string> declaredTensors;
+      if (foldable) {
+         for (auto &t : fIntermediateTensorInfos)
+            declaredTensors.insert(t.first);
+         for (auto &t : fDynamicTensorInfos)
+            declaredTensors.insert(t.first);
+      }
       fOperators[op_idx]->Initialize(*this);
+      if (foldable && FoldConstantOperator(op_idx, declaredTensors)) {
+         if (verbose)
+            std::cout << "Folded constant operator " << i << std::endl;
+         i++;
+         op_idx--; // the next operator has now the same index
+         continue;
+      }
       for(auto &it:fOperators[op_idx]->GetOpOutputTensors()){
          if (fIntermediateTensorFrequencyLookup.find(it) == fIntermediateTensorFrequencyLookup.end() &&
              std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), std::string(it)) == fOutputTensorNames.end() &&
@@ -499,18 +587,397 @@ void RModel::Initialize(const std::map<std::string, size_t> & inputParams, bool
             fIntermediateTensorFrequencyLookup[it] = op_idx;
          }
       }
+      // the scratch tensors are placed in the memory pool and not declared as separate tensors
+      for (auto &it : fOperators[op_idx]->GetOpScratchTensors())
+         fIntermediateTensorFrequencyLookup[it] = op_idx;
       i++;
    }
 
    fIsInitialized = true;
 }
 
+void RModel::EraseOperator(size_t op_idx) {
+   fOperators.erase(fOperators.begin() + op_idx);
+   // the last usages recorded when adding the operators in a given order (as the parser does) refer to the
+   // operator indices; the ones added at the end have no valid index and are not changed
+   for (auto &it : fIntermediateTensorFrequencyLookup) {
+      if (it.second > op_idx && it.second <= fOperators.size())
+         it.second--;
+   }
+}
+
+bool RModel::FoldChannelAffine(size_t op_idx) {
+   // the operator output must be consumed only by the BatchNormalization and not be a model output
+   auto opOutputs = fOperators[op_idx]->GetOpOutputTensors();
+   if (opOutputs.size() != 1)
+      return false;
+   std::string name(opOutputs[0]);
+   if (std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), name) != fOutputTensorNames.end())
+      return false;
+   size_t consumer = fOperators.size();
+   for (size_t j = op_idx + 1; j < fOperators.size(); ++j) {
+      auto inputs = fOperators[j]->GetOpInputTensors();
+      if (std::find(inputs.begin(), inputs.end(), name) != inputs.end()) {
+         if (consumer != fOperators.size())
+            return false;
+         consumer = j;
+      }
+   }
+   if (consumer == fOperators.size() || fOperators[consumer]->GetOpInputTensors()[0] != name)
+      return false;
+
+   std::vector<float> scale;
+   std::vector<float> shift;
+   EActivationType activation = EActivationType::UNDEFINED;
+   if (!fOperators[consumer]->GetChannelAffine(*this, scale, shift, activation))
+      return false;
+   auto consumerOutputs = fOperators[consumer]->GetOpOutputTensors();
+   if (consumerOutputs.size() != 1)
+      return false;
+   if (!fOperators[op_idx]->FoldChannelAffine(*this, scale, shift, std::string(consumerOutputs[0]), activation))
+      return false;
+
+   fIntermediateTensorFrequencyLookup.erase(name);
+   EraseOperator(consumer);
+   return true;
+}
+
+bool RModel::IsConstantFoldable(size_t op_idx) {
+   auto inputs = fOperators[op_idx]->GetOpInputTensors();
+   // operators without inputs (e.g. random generators) are never folded
+   if (inputs.empty())
+      return false;
+   for (auto &name : inputs) {
+      // empty names are optional inputs not given
+      if (!name.empty() && !IsInitializedTensor(std::string(name)))
+         return false;
+   }
+   return true;
+}
+
+bool RModel::FoldConstantOperator(size_t op_idx, const std::set<std::string> &declaredTensors) {
+#ifndef SOFIE_USE_BLAS
+   // the operators are evaluated by RInterpreter, which is built only with BLAS
+   (void)op_idx;
+   (void)declaredTensors;
+   return false;
+#else
+   auto &op = *fOperators[op_idx];
+   // the operator has already computed its constant outputs in Initialize
+   if (op.IsOutputConstant())
+      return false;
+   std::vector<std::string> outputs;
+   for (auto &name : op.GetOpOutputTensors()) {
+      // the model outputs must remain computed by the Session
+      if (std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), std::string(name)) != fOutputTensorNames.end())
+         return false;
+      outputs.emplace_back(name);
+   }
+   if (outputs.empty())
+      return false;
+   bool constantInputs = true;
+   for (auto &name : op.GetOpInputTensors()) {
+      if (!name.empty() && !IsConstantTensor(std::string(name)))
+         constantInputs = false;
+   }
+
+   // evaluate the operator with the interpreter. The operators which are not supported are not folded
+   RInterpreter interpreter(*this, RInterpreter::NoPlan{});
+   try {
+      op.Execute(interpreter);
+   } catch (const std::exception &e) {
+      if (fVerbose)
+         std::cout << "Operator " << op_idx << " with constant inputs is not folded: " << e.what() << std::endl;
+      return false;
+   }
+   // only the types which can be generated as initialized tensors are folded
+   for (auto &name : outputs) {
+      if (!interpreter.HasTensor(name))
+         return false;
+      auto type = interpreter.GetTensor(name).type;
+      if (type != ETensorType::FLOAT && type != ETensorType::INT64)
+         return false;
+   }
+
+   for (auto &name : outputs) {
+      auto &t = interpreter.GetTensor(name);
+      size_t size = GetTypeSize(t.type) * ConvertShapeToLength(t.shape);
+      std::shared_ptr<void> data(malloc(size), free);
+      std::memcpy(data.get(), t.data, size);
+      fIntermediateTensorInfos.erase(name);
+      fDynamicTensorInfos.erase(name);
+      fIntermediateTensorFrequencyLookup.erase(name);
+      // outputs depending on weights are written in the weight file as the other weights
+      if (constantInputs || t.type != ETensorType::FLOAT)
+         AddConstantTensor(name, t.type, t.shape, data);
+      else
+         AddInitializedTensor(name, t.type, t.shape, data);
+   }
+   // remove the temporary tensors declared by the operator
+   for (auto itr = fIntermediateTensorInfos.begin(); itr != fIntermediateTensorInfos.end();) {
+      if (declaredTensors.count(itr->first) == 0) {
+         fIntermediateTensorFrequencyLookup.erase(itr->first);
+         itr = fIntermediateTensorInfos.erase(itr);
+      } else {
+         ++itr;
+      }
+   }
+   for (auto itr = fDynamicTensorInfos.begin(); itr != fDynamicTensorInfos.end();) {
+      if (declaredTensors.count(itr->first) == 0)
+         itr = fDynamicTensorInfos.erase(itr);
+      else
+         ++itr;
+   }
+   // the keys of the lookup table can refer to the tensor names stored in the removed operator
+   for (auto &name : op.GetOpInputTensors())
+      fIntermediateTensorFrequencyLookup.erase(name);
+
+   EraseOperator(op_idx);
+   std::string report = "folded constant operator computing";
+   for (auto &name : outputs)
+      report += " " + name;
+   fOptimizationReport.push_back(report);
+   return true;
+#endif
+}
+
+void RModel::RemoveDeadOperators() {
+   // without declared outputs all the operators are needed
+   if (fOutputTensorNames.empty())
+      return;
+   // go backward from the model outputs and collect the tensors needed by the operators computing them
+   std::unordered_set<std::string> neededTensors(fOutputTensorNames.begin(), fOutputTensorNames.end());
+   std::vector<bool> isDead(fOperators.size(), false);
+   bool hasDeadOperators = false;
+   for (size_t op_idx = fOperators.size(); op_idx-- > 0;) {
+      auto outputs = fOperators[op_idx]->GetOpOutputTensors();
+      // operators not declaring their outputs are always kept
+      bool isNeeded = outputs.empty();
+      for (auto &name : outputs) {
+         if (neededTensors.count(std::string(name)) > 0)
+            isNeeded = true;
+      }
+      if (!isNeeded) {
+         isDead[op_idx] = true;
+         hasDeadOperators = true;
+         continue;
+      }
+      for (auto &name : fOperators[op_idx]->GetOpInputTensors()) {
+         if (!name.empty())
+            neededTensors.emplace(name);
+      }
+   }
+   if (!hasDeadOperators)
+      return;
+
+   std::vector<std::unique_ptr<ROperator>> operators;
+   for (size_t op_idx = 0; op_idx < fOperators.size(); op_idx++) {
+      if (!isDead[op_idx]) {
+         operators.push_back(std::move(fOperators[op_idx]));
+         continue;
+      }
+      std::string report = "removed dead operator " + std::to_string(op_idx) + " computing";
+      for (auto &name : fOperators[op_idx]->GetOpOutputTensors())
+         report += " " + std::string(name);
+      if (fVerbose)
+         std::cout << report << std::endl;
+      fOptimizationReport.push_back(report);
+   }
+   fOperators = std::move(operators);
+
+   // the lookup table of the last usage of the intermediate tensors refers to the tensor names stored in the
+   // operators: build it again for the remaining ones. The outputs not used by other operators (and which are not
+   // model outputs) are last used by the operator computing them, as set when initializing the operators
+   fIntermediateTensorFrequencyLookup.clear();
+   for (size_t op_idx = 0; op_idx < fOperators.size(); op_idx++) {
+      for (auto &name : fOperators[op_idx]->GetOpInputTensors()) {
+         std::string tensorName(name);
+         if (name.empty() || fInitializedTensors.find(tensorName) != fInitializedTensors.end() ||
+             std::find(fInputTensorNames.begin(), fInputTensorNames.end(), tensorName) != fInputTensorNames.end())
+            continue;
+         fIntermediateTensorFrequencyLookup[name] = op_idx;
+      }
+      for (auto &name : fOperators[op_idx]->GetOpScratchTensors())
+         fIntermediateTensorFrequencyLookup[name] = op_idx;
+   }
+   for (size_t op_idx = 0; op_idx < fOperators.size(); op_idx++) {
+      for (auto &name : fOperators[op_idx]->GetOpOutputTensors()) {
+         std::string tensorName(name);
+         if (name.empty() || fIntermediateTensorFrequencyLookup.count(name) > 0 ||
+             std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), tensorName) != fOutputTensorNames.end() ||
+             fInitializedTensors.find(tensorName) != fInitializedTensors.end() ||
+             fDynamicTensorInfos.find(tensorName) != fDynamicTensorInfos.end())
+            continue;
+         fIntermediateTensorFrequencyLookup[name] = op_idx;
+      }
+   }
+}
+
+namespace {
+
+// add the tensors used by the code generated for an operator: its inputs (unless its outputs are constants computed
+// when initializing the model, then no code is generated), its outputs and its scratch tensors
+void CollectUsedTensors(const ROperator &op, std::unordered_set<std::string> &usedTensors)
+{
+   if (!op.IsOutputConstant()) {
+      for (auto &name : op.GetOpInputTensors())
+         usedTensors.emplace(name);
+   }
+   for (auto &name : op.GetOpOutputTensors())
+      usedTensors.emplace(name);
+   for (auto &name : op.GetOpScratchTensors())
+      usedTensors.emplace(name);
+}
+
+} // namespace
+
+void RModel::RemoveUnusedInitializedTensors() {
+   std::unordered_set<std::string> usedTensors;
+   for (size_t id = 0; id < fOperators.size(); id++)
+      CollectUsedTensors(*fOperators[id], usedTensors);
+
+   for (auto itr = fInitializedTensors.begin(); itr != fInitializedTensors.end();) {
+      if (usedTensors.count(itr->first) > 0 ||
+          std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), itr->first) != fOutputTensorNames.end()) {
+         ++itr;
+         continue;
+      }
+      std::string report = "removed unused " + std::string(itr->second.IsWeightTensor() ? "weight" : "constant") +
+                           " tensor " + itr->first + " " + ConvertShapeToString(itr->second.shape());
+      if (fVerbose)
+         std::cout << report << std::endl;
+      fOptimizationReport.push_back(report);
+      itr = fInitializedTensors.erase(itr);
+   }
+
+   // the weight file is not needed when all the weights are removed
+   if (fUseWeightFile) {
+      bool modelHasWeights = false;
+      for (auto &i : fInitializedTensors) {
+         if (i.second.type() == ETensorType::FLOAT) {
+            modelHasWeights = true;
+            break;
+         }
+      }
+      if (!modelHasWeights)
+         fUseWeightFile = false;
+   }
+}
+
+void RModel::AssignBlockedLayout() {
+   // the weights are packed once for the blocked layout, which is kept for the following generations
+   if (fIsBlockedLayoutAssigned)
+      return;
+
+   std::vector<EBlockedLayoutSupport> support(fOperators.size());
+   std::unordered_map<std::string, size_t> producers;
+   std::unordered_map<std::string, std::vector<size_t>> consumers;
+   for (size_t id = 0; id < fOperators.size(); id++) {
+      support[id] = fOperators[id]->GetBlockedLayoutSupport(*this);
+      auto outputs = fOperators[id]->GetOpOutputTensors();
+      if (!outputs.empty())
+         producers[std::string(outputs[0])] = id;
+      for (auto &name : fOperators[id]->GetOpInputTensors())
+         consumers[std::string(name)].push_back(id);
+   }
+   // the data inputs of an operator are the ones which are not initialized (e.g. not the weights), the operators
+   // converting the layout have a single data input
+   auto isDataInput = [&](size_t id, const std::string &name) {
+      auto inputs = fOperators[id]->GetOpInputTensors();
+      if (support[id] == EBlockedLayoutSupport::CONVERT)
+         return !inputs.empty() && inputs[0] == name;
+      return !IsInitializedTensor(name);
+   };
+
+   // candidates: 4d float intermediate tensors with a multiple of the block size channels and more than one pixel
+   // (otherwise both layouts are the same), produced and used by operators supporting the blocked layout
+   std::unordered_set<std::string> blocked;
+   for (auto &t : fIntermediateTensorInfos) {
+      auto &shape = t.second.shape;
+      if (t.second.type != ETensorType::FLOAT || shape.size() != 4 || shape[1] % kChannelBlockSize != 0 ||
+          shape[2] * shape[3] == 1)
+         continue;
+      if (std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), t.first) != fOutputTensorNames.end())
+         continue;
+      auto producer = producers.find(t.first);
+      auto consumer = consumers.find(t.first);
+      if (producer == producers.end() || support[producer->second] == EBlockedLayoutSupport::NONE ||
+          consumer == consumers.end())
+         continue;
+      bool supported = true;
+      for (auto id : consumer->second)
+         supported &= (support[id] != EBlockedLayoutSupport::NONE && isDataInput(id, t.first));
+      if (supported)
+         blocked.insert(t.first);
+   }
+   // the operators keeping the layout need all their data inputs and their output in the same layout
+   for (bool changed = true; changed;) {
+      changed = false;
+      for (size_t id = 0; id < fOperators.size(); id++) {
+         if (support[id] != EBlockedLayoutSupport::SAME)
+            continue;
+         std::vector<std::string> tensors;
+         for (auto &name : fOperators[id]->GetOpInputTensors()) {
+            if (isDataInput(id, std::string(name)))
+               tensors.emplace_back(name);
+         }
+         tensors.emplace_back(fOperators[id]->GetOpOutputTensors()[0]);
+         size_t nBlocked = 0;
+         for (auto &name : tensors)
+            nBlocked += blocked.count(name);
+         if (nBlocked > 0 && nBlocked < tensors.size()) {
+            for (auto &name : tensors)
+               blocked.erase(name);
+            changed = true;
+         }
+      }
+   }
+   if (blocked.empty())
+      return;
+   fIsBlockedLayoutAssigned = true;
+
+   // tensors which are not used anymore by the operators using the blocked layout (e.g. the im2col panel buffers)
+   std::unordered_set<std::string> released;
+   for (size_t id = 0; id < fOperators.size(); id++) {
+      if (support[id] == EBlockedLayoutSupport::NONE)
+         continue;
+      bool blockedInput = blocked.count(std::string(fOperators[id]->GetOpInputTensors()[0])) > 0;
+      bool blockedOutput = blocked.count(std::string(fOperators[id]->GetOpOutputTensors()[0])) > 0;
+      if (!blockedInput && !blockedOutput)
+         continue;
+      std::unordered_set<std::string> usedBefore;
+      std::unordered_set<std::string> usedAfter;
+      CollectUsedTensors(*fOperators[id], usedBefore);
+      fOperators[id]->SetBlockedLayout(*this, blockedInput, blockedOutput);
+      CollectUsedTensors(*fOperators[id], usedAfter);
+      for (auto &name : usedBefore) {
+         if (usedAfter.count(name) == 0)
+            released.insert(name);
+      }
+      if (fVerbose)
+         std::cout << "operator " << id << " uses the channel-blocked layout for its "
+                   << ((blockedInput && blockedOutput) ? "input and output" : (blockedInput ? "input" : "output"))
+                   << std::endl;
+   }
+   std::unordered_set<std::string> usedTensors;
+   for (size_t id = 0; id < fOperators.size(); id++)
+      CollectUsedTensors(*fOperators[id], usedTensors);
+   for (auto &name : released) {
+      if (usedTensors.count(name) > 0 || fIntermediateTensorInfos.count(name) == 0 ||
+          std::find(fOutputTensorNames.begin(), fOutputTensorNames.end(), name) != fOutputTensorNames.end())
+         continue;
+      fIntermediateTensorFrequencyLookup.erase(name);
+      fIntermediateTensorInfos.erase(name);
+   }
+}
+
 void RModel::InitializeSubGraph(std::shared_ptr<RModel>  graph) {
    // add the subgraph to the list
    fSubGraphs.push_back(graph);
    //this needs to be done before initializing
    graph->fParentGraph = this;
    graph->fIsSubGraph = true;
+   graph->fRemoveDeadCode = fRemoveDeadCode;
 
    graph->Initialize(fBatchSize, fVerbose);
    // set the same options as parent model
@@ -537,7 +1004,7 @@ void RModel::InitializeSubGraph(std::shared_ptr<RModel>  graph) {
 // Function to generate the code for declaring and initializing constant tensors
 // This is for tensors which are not part of weight files and can be created from the Constant operator
 template <typename T>
-std::string GenerateConstantTensorCode(const std::pair<std::string, InitializedTensor> &t)
+std::string GenerateConstantTensorCode(const std::pair<std::string, InitializedTensor> &t, bool binary)
 {
    std::stringstream strs;
    std::string type = ConvertTypeToString(t.second.type());
@@ -559,6 +1026,12 @@ std::string GenerateConstantTensorCode(const std::pair<std::string, InitializedT
    }
    if (allocateOnStack) {
       strs << type << " tensor_" << t.first << "[" << length << "] = " << ConvertValuesToString(length, data) << ";\n";
+   } else if (binary && !sameData) {
+      // raw bytes (in the byte order of the generating host) used directly as tensor data, without copy
+      strs << "alignas(64) static constexpr char fTensorBytes_" << t.first << "[" << length * sizeof(T) + 1 << "] =\n"
+           << ConvertBytesToStringLiteral(length * sizeof(T), reinterpret_cast<const char *>(data)) << ";\n";
+      strs << "const " << type << " * tensor_" << t.first << " = reinterpret_cast<const " << type << " *>(fTensorBytes_"
+           << t.first << ");\n";
    } else {
       strs << "std::vector<" << type << "> fTensor_" << t.first << " = ";
       if (sameData)
@@ -579,14 +1052,18 @@ void RModel::GenerateInitializedTensorInfo()
    for (auto &i : fInitializedTensors) {
       if (!fUseWeightFile || i.second.IsConstantTensor()) {
          if (i.second.type() == ETensorType::FLOAT)
-            fGC += GenerateConstantTensorCode<float>(i);
+            fGC += GenerateConstantTensorCode<float>(i, fUseBinaryConstants);
          else if (i.second.type() == ETensorType::INT64)
-            fGC += GenerateConstantTensorCode<int64_t>(i);
+            fGC += GenerateConstantTensorCode<int64_t>(i, fUseBinaryConstants);
 
       } else {
          // case of tensors which are read from a file
          size_t length = ConvertShapeToLength(i.second.shape());
-         if (i.second.type() == ETensorType::FLOAT) {
+         if (i.second.type() == ETensorType::FLOAT && fIsGNNComponent && i.second.IsWeightTensor()) {
+            // allocated when read, since the sessions can also use the weights of another one
+            fGC += "std::vector<float> fTensor_" + i.first + ";\n";
+            fGC += "float * tensor_" + i.first + " = nullptr;\n";
+         } else if (i.second.type() == ETensorType::FLOAT) {
             fGC += "std::vector<float> fTensor_" + i.first + " = std::vector<float>(" + std::to_string(length) + ");\n";
             fGC += "float * tensor_" + i.first + " = fTensor_" + i.first + ".data();\n";
          }
@@ -595,12 +1072,16 @@ void RModel::GenerateInitializedTensorInfo()
 }
 
 void RModel::GenerateIntermediateMemoryPool() {
-   if (fIntermediateMemoryInfo.total_stack.size() == 0) return;
+   // the specializations for fixed batch sizes use the same pool
+   size_t poolSize = GetMemoryPoolSize(fIntermediateMemoryInfo);
+   for (auto &spec : fBatchSpecializations)
+      poolSize = std::max(poolSize, GetMemoryPoolSize(spec->fIntermediateMemoryInfo));
+   if (poolSize == 0) return;
    fGC += "\n//--- Allocating session memory pool to be used for allocating intermediate tensors\n";
 
    // char memory block is allocated since char takes 1 byte, thus easier to allocate tensors
    // of other data types
-   fGC += "char* fIntermediateMemoryPool = new char[" + std::to_string(fIntermediateMemoryInfo.total_stack.rbegin()->first + fIntermediateMemoryInfo.total_stack.rbegin()->second.tensor_size)+ "];\n\n";
+   fGC += "char* fIntermediateMemoryPool = new char[" + std::to_string(poolSize)+ "];\n\n";
 }
 
 void RModel::GenerateIntermediateTensorInfo() {
@@ -677,6 +1158,26 @@ void RModel::GenerateDynamicTensorInfo() {
     fGC += out.str();
 }
 
+void RModel::GenerateDynamicCapacityCode() {
+   // the dynamic tensors are sized for the current value of the shape parameters (the capacity) and are
+   // grown only when infer is called with larger values, so that no allocation happens once warmed up
+   fGC += "// capacity of the dynamic tensors\n";
+   for (auto &p : fShapeParams)
+      fGC += "size_t fCapacity_" + p.first + " = 0;\n";
+   fGC += "\nvoid reserve(";
+   for (auto &p : fShapeParams)
+      fGC += "size_t " + p.first + ",";
+   fGC.back() = ')';
+   fGC += " {\n";
+   GenerateDynamicTensorInfo();
+   for (size_t id = 0; id < fOperators.size(); id++) {
+      fGC += fOperators[id]->GenerateInitCode();
+   }
+   for (auto &p : fShapeParams)
+      fGC += SP + "fCapacity_" + p.first + " = " + p.first + ";\n";
+   fGC += "}\n\n";
+}
+
 std::string RModel::GenerateInferSignature(bool isdecl) {
    // generate the infer signature given the inputs: eg. "float * tensor1, float * tensor2"
    // if (decl = false) generate only calling signature (tensor1,tensor2,....)
@@ -757,7 +1258,7 @@ void RModel::GenerateOutput() {
    std::string outputType = ConvertTypeToString(eOutputType);
    fGC += "\n\n";
    if (outputSize == 1) {
-      fGC += "std::vector<" + outputType + ">";
+      inferReturnType = "std::vector<" + outputType + ">";
    } else {
       // if all output types are the same we return an std::vector - otherwise a tuple
       for (size_t i = 1; i < outputSize; i++) {
@@ -765,7 +1266,7 @@ void RModel::GenerateOutput() {
             sameOutputTypes = false;
       }
       if (sameOutputTypes)
-         fGC += "std::vector<std::vector<" + outputType + ">>";
+         inferReturnType = "std::vector<std::vector<" + outputType + ">>";
       else {
          inferReturnType = "std::tuple<";
          for (size_t i = 0; i < outputSize; i++) {
@@ -773,19 +1274,80 @@ void RModel::GenerateOutput() {
             if (i < outputSize-1) inferReturnType += ",";
          }
          inferReturnType += ">";
-         fGC += inferReturnType;
       }
    }
 
-   fGC += " infer(";
+   // GNN components have the operator code in doInfer, which leaves the outputs in the session tensors
+   // (and grows the dynamic tensors when needed). infer returns then a copy of them
+   if (fIsGNNComponent)
+      fGC += "void doInfer(";
+   else
+      fGC += inferReturnType + " infer(";
 
    fGC += GenerateInferSignature();
 
    fGC += "){\n";
 
+   // the batch sizes having a specialized infer function are dispatched to it. All the shape parameters of the
+   // inputs are fixed by the batch size in the specializations
+   if (!fBatchSpecializations.empty()) {
+      std::set<std::string> inputParams;
+      for (auto &name : fInputTensorNames) {
+         if (!IsDimInputTensor(name)) continue;
+         for (auto &d : GetDynamicTensorShape(name))
+            if (d.isParam) inputParams.insert(d.param);
+      }
+      for (auto &spec : fBatchSpecializations) {
+         std::string bs = std::to_string(spec->fBatchSize);
+         std::string condition;
+         for (auto &p : inputParams) {
+            if (!condition.empty()) condition += " && ";
+            condition += p + " == " + bs;
+         }
+         fGC += SP + "if (" + condition + ")\n";
+         fGC += SP + SP + "return fSession_bs" + bs + ".infer(" + spec->GenerateInferSignature(false) + ");\n";
+      }
+   }
+
+   if (fIsGNNComponent && !fShapeParams.empty()) {
+      // shape parameters not given as input keep their current capacity
+      std::unordered_map<std::string, bool> inputParams;
+      for (auto &name : fInputTensorNames) {
+         if (!IsDimInputTensor(name)) continue;
+         for (auto &d : GetDynamicTensorShape(name))
+            if (d.isParam) inputParams[d.param] = true;
+      }
+      std::string condition, args;
+      for (auto &p : fShapeParams) {
+         if (inputParams.count(p.first) == 0) {
+            args += "fCapacity_" + p.first + ",";
+            continue;
+         }
+         if (!condition.empty()) condition += " || ";
+         condition += p.first + " > fCapacity_" + p.first;
+         args += "std::max(" + p.first + ", fCapacity_" + p.first + "),";
+      }
+      args.pop_back();
+      if (!condition.empty())
+         fGC += SP + "if (" + condition + ")\n" + SP + SP + "reserve(" + args + ");\n";
+   }
+
+   bool profile = fProfileOperators && !fIsSubGraph;
    for (size_t op_idx = 0; op_idx < fOperators.size(); ++op_idx) {
       if (fVerbose) std::cout << "Generating code for operator .... " << op_idx << std::endl;
-      fGC += (fOperators[op_idx]->Generate(std::to_string(op_idx)));
+      std::string opName = std::to_string(op_idx);
+      if (profile)
+         fGC += SP + "auto op_" + opName + "_start = std::chrono::steady_clock::now();\n";
+      fGC += (fOperators[op_idx]->Generate(opName));
+      if (profile)
+         fGC += SP + "fOperatorTimes[" + opName + "] += std::chrono::duration<double>(std::chrono::steady_clock::now() - op_" +
+                opName + "_start).count();\n";
+   }
+
+   if (fIsGNNComponent) {
+      fGC += "}\n\n";
+      fGC += inferReturnType + " infer(" + GenerateInferSignature() + "){\n";
+      fGC += SP + "doInfer(" + GenerateInferSignature(false) + ");\n";
    }
 
    fGC += SP + "return {";
@@ -819,7 +1381,20 @@ void RModel::GenerateSessionCode()
    intermediate_memory_alloc_string += "\n// --- Positioning intermediate tensor memory --";
    for (size_t op_idx = 0; op_idx < fOperators.size(); ++op_idx) {
       intermediate_memory_alloc_string += AllocateIntermediateMemory(fOperators[op_idx]->GetOpOutputTensors());
+      intermediate_memory_alloc_string += AllocateIntermediateMemory(fOperators[op_idx]->GetOpScratchTensors());
       CheckAndFlushIntermediateMemory(fOperators[op_idx]->GetOpInputTensors(), op_idx);
+      // the scratch tensors are not needed by the following operators
+      for (auto &name : fOperators[op_idx]->GetOpScratchTensors())
+         ReleaseIntermediateMemory(name);
+   }
+
+   // the specializations for fixed batch sizes are generated first, since the memory pool is sized for all of them
+   std::string specializationCode;
+   for (auto &spec : fBatchSpecializations) {
+      spec->GenerateBatchSpecializationCode(*this);
+      specializationCode += spec->fGC;
+      specializationCode += "Session_bs" + std::to_string(spec->fBatchSize) + " fSession_bs" +
+                            std::to_string(spec->fBatchSize) + ";\n";
    }
 
    // to check remaining unused fragments after memory allocation (lesser the better)
@@ -838,7 +1413,7 @@ void RModel::GenerateSessionCode()
    // generate code for declarations of some specific operators
    GenerateOperatorDeclarations();
 
-
+   fGC += specializationCode;
 
    // add subgraph session
    if (!fSubGraphs.empty()) fGC += "//   subgraph sessions\n";
@@ -857,6 +1432,10 @@ void RModel::GenerateSessionCode()
          std::string opName = std::to_string(id);
          fGC += fOperators[id]->GenerateSessionMembersCode(opName);
       }
+      if (fProfileOperators && !fIsSubGraph) {
+         fGC += "// time in seconds spent in each operator, summed over the infer calls\n";
+         fGC += "std::vector<double> fOperatorTimes = std::vector<double>(" + std::to_string(fOperators.size()) + ");\n";
+      }
       fGC += "\n";
       // here add initialization and reading of weight tensors
       if (fUseWeightFile) {
@@ -885,30 +1464,203 @@ void RModel::GenerateSessionCode()
 
       if (fUseWeightFile) {
          fGC += "\n//--- reading weights from file\n";
+         if (fIsGNNComponent) {
+            for (auto &i : fInitializedTensors) {
+               if (!i.second.IsWeightTensor() || i.second.type() != ETensorType::FLOAT)
+                  continue;
+               fGC += SP + "fTensor_" + i.first + ".resize(" + std::to_string(ConvertShapeToLength(i.second.shape())) +
+                      ");\n";
+               fGC += SP + "tensor_" + i.first + " = fTensor_" + i.first + ".data();\n";
+            }
+         }
          ReadInitializedTensorsFromFile(fReadPos);
          fGC += "\n";
          // fUseWeightFile = fUseWeightFile;
       }
 
-      // now we have passed the parameters we can allocate the dynamic tensors
-      GenerateDynamicTensorInfo();
+      if (fIsGNNComponent && !fShapeParams.empty()) {
+         // GNN components allocate the dynamic tensors in reserve(), called again by infer when
+         // a larger graph is given
+         fGC += SP + "reserve(";
+         for (auto &p : fShapeParams)
+            fGC += p.first + ",";
+         fGC.back() = ')';
+         fGC += ";\n";
+      } else {
+         // now we have passed the parameters we can allocate the dynamic tensors
+         GenerateDynamicTensorInfo();
 
-      // add here initialization code  for operator
-      for (size_t id = 0; id < fOperators.size(); id++) {
-         fGC += fOperators[id]->GenerateInitCode();
+         // add here initialization code  for operator
+         for (size_t id = 0; id < fOperators.size(); id++) {
+            fGC += fOperators[id]->GenerateInitCode();
+         }
+         // the specializations use the weights read above
+         for (auto &spec : fBatchSpecializations)
+            fGC += SP + "fSession_bs" + std::to_string(spec->fBatchSize) + ".init(*this);\n";
       }
 
+      // start streaming sessions from the initial recurrent state
+      if (fIsStreaming)
+         fGC += SP + "reset();\n";
+
       fGC += "}\n\n";
+
+      if (fIsGNNComponent && !fShapeParams.empty()) {
+         // session reading only the weights of another session and having its own intermediate tensors,
+         // e.g. for processing parts of the graph in several threads
+         fGC += "// session using the weights of another session (not copied), with its own intermediate tensors\n";
+         fGC += sessionName + "(const " + sessionName + " & weights";
+         for (auto &p : fShapeParams)
+            fGC += ", size_t " + p.first;
+         fGC += ") {\n";
+         if (fUseWeightFile) {
+            for (auto &i : fInitializedTensors) {
+               if (i.second.IsWeightTensor() && i.second.type() == ETensorType::FLOAT)
+                  fGC += SP + "tensor_" + i.first + " = weights.tensor_" + i.first + ";\n";
+            }
+         }
+         fGC += SP + "reserve(";
+         for (auto &p : fShapeParams)
+            fGC += p.first + ",";
+         fGC.back() = ')';
+         fGC += ";\n";
+         fGC += "}\n\n";
+         GenerateDynamicCapacityCode();
+      }
    }
    // generate the inference code
    GenerateOutput();
 
+   if (fIsStreaming)
+      GenerateStreamingCode();
+
    // end of session
    if (fUseSession && !fIsGNNComponent) {
       fGC += "};   // end of Session\n";
    }
 }
 
+void RModel::GenerateBatchSpecializationCode(const RModel &session)
+{
+   fGC.clear();
+   fUseBinaryConstants = session.fUseBinaryConstants;
+   std::string structName = "Session_bs" + std::to_string(fBatchSize);
+   fGC += "\n//--- inference specialized for batch size " + std::to_string(fBatchSize) +
+          ", using the weights and the memory pool of the Session\n";
+   fGC += "struct " + structName + " {\n";
+
+   // the initialized tensors are shared with the Session when they have the same content and the Session
+   // declares them as pointers (read from the weight file or large constants). The other ones are constants
+   std::string initCode;
+   for (auto &i : fInitializedTensors) {
+      if (i.second.type() != ETensorType::FLOAT && i.second.type() != ETensorType::INT64)
+         continue;
+      size_t length = ConvertShapeToLength(i.second.shape());
+      auto itr = session.fInitializedTensors.find(i.first);
+      bool shared = itr != session.fInitializedTensors.end() && itr->second.type() == i.second.type() &&
+                    itr->second.shape() == i.second.shape() &&
+                    std::memcmp(itr->second.data(), i.second.data(), GetTypeSize(i.second.type()) * length) == 0;
+      bool readFromFile = shared && session.fUseWeightFile && !itr->second.IsConstantTensor();
+      if (shared)
+         shared = (readFromFile) ? i.second.type() == ETensorType::FLOAT : length > 100;
+      if (shared) {
+         fGC += std::string(readFromFile ? "" : "const ") + ConvertTypeToString(i.second.type()) + " * tensor_" +
+                i.first + " = nullptr;\n";
+         initCode += SP + "tensor_" + i.first + " = s.tensor_" + i.first + ";\n";
+      } else if (i.second.type() == ETensorType::FLOAT) {
+         fGC += GenerateConstantTensorCode<float>(i, fUseBinaryConstants);
+      } else {
+         fGC += GenerateConstantTensorCode<int64_t>(i, fUseBinaryConstants);
+      }
+   }
+
+   // the intermediate tensors are placed in the memory pool of the Session
+   fIntermediateMemoryInfo = MemoryPoolInfo();
+   for (size_t op_idx = 0; op_idx < fOperators.size(); ++op_idx) {
+      AllocateIntermediateMemory(fOperators[op_idx]->GetOpOutputTensors());
+      AllocateIntermediateMemory(fOperators[op_idx]->GetOpScratchTensors());
+      CheckAndFlushIntermediateMemory(fOperators[op_idx]->GetOpInputTensors(), op_idx);
+      for (auto &name : fOperators[op_idx]->GetOpScratchTensors())
+         ReleaseIntermediateMemory(name);
+   }
+   for (auto &t : fIntermediateMemoryInfo.tensor_offsets) {
+      std::string type = ConvertTypeToString(GetTensorType(t.first));
+      fGC += type + " * tensor_" + t.first + " = nullptr;\n";
+      initCode += SP + "tensor_" + t.first + " = reinterpret_cast<" + type + " *>(s.fIntermediateMemoryPool + " +
+                  std::to_string(t.second) + ");\n";
+   }
+
+   GenerateIntermediateTensorInfo();
+   GenerateOperatorDeclarations();
+   fGC += "\n";
+   for (size_t id = 0; id < fOperators.size(); id++)
+      fGC += fOperators[id]->GenerateSessionMembersCode(std::to_string(id));
+
+   // called by the Session constructor once the weights are read
+   fGC += "\nvoid init(Session & s) {\n" + initCode;
+   for (size_t id = 0; id < fOperators.size(); id++)
+      fGC += fOperators[id]->GenerateInitCode();
+   fGC += "}\n";
+
+   GenerateOutput();
+   fGC += "};   // end of " + structName + "\n\n";
+}
+
+void RModel::GenerateStreamingCode()
+{
+   // collect the state vectors of the recurrent operators, in execution order
+   std::vector<std::pair<std::string, TensorInfo>> stateInfo;
+   std::string resetCode;
+   for (size_t id = 0; id < fOperators.size(); id++) {
+      std::string opName = std::to_string(id);
+      for (auto &state : fOperators[id]->GetStreamingStateInfo(opName))
+         stateInfo.push_back(state);
+      resetCode += fOperators[id]->GenerateStreamingResetCode(opName);
+   }
+   if (stateInfo.empty())
+      throw std::runtime_error("TMVA-SOFIE: RModel::Generate: streaming mode requested but model " + fName +
+                               " has no operator carrying a recurrent state");
+
+   // the state is exported as a single vector, of the type of the state tensors
+   ETensorType stateType = stateInfo.front().second.type;
+   size_t stateSize = 0;
+   for (auto &state : stateInfo) {
+      if (state.second.type != stateType)
+         throw std::runtime_error("TMVA-SOFIE: RModel::Generate: streaming mode requires recurrent states of the same "
+                                  "type in model " + fName);
+      stateSize += ConvertShapeToLength(state.second.shape);
+   }
+   std::string type = ConvertTypeToString(stateType);
+
+   fGC += "\n// --- streaming interface: the recurrent state is kept between calls\n";
+   // reset the state to the initial one (initial_h/initial_c when given, zero otherwise)
+   fGC += "void reset() {\n" + resetCode + "}\n\n";
+   fGC += "size_t state_size() const { return " + std::to_string(stateSize) + "; }\n\n";
+   // state is exported as the concatenation of all state vectors
+   fGC += "std::vector<" + type + "> get_state() const {\n";
+   fGC += SP + "std::vector<" + type + "> state;\n";
+   fGC += SP + "state.reserve(" + std::to_string(stateSize) + ");\n";
+   for (auto &state : stateInfo)
+      fGC += SP + "state.insert(state.end(), " + state.first + ".begin(), " + state.first + ".end());\n";
+   fGC += SP + "return state;\n";
+   fGC += "}\n\n";
+   fGC += "void set_state(const std::vector<" + type + "> & state) {\n";
+   fGC += SP + "if (state.size() != " + std::to_string(stateSize) + ")\n";
+   fGC += SP + SP + "throw std::runtime_error(\"SOFIE_" + fName + "::Session::set_state: state has size \" + " +
+          "std::to_string(state.size()) + \" instead of " + std::to_string(stateSize) + "\");\n";
+   fGC += SP + "auto itr = state.begin();\n";
+   for (auto &state : stateInfo) {
+      std::string size = std::to_string(ConvertShapeToLength(state.second.shape));
+      fGC += SP + "std::copy(itr, itr + " + size + ", " + state.first + ".begin());\n";
+      fGC += SP + "itr += " + size + ";\n";
+   }
+   fGC += "}\n\n";
+   // the recurrent operators of a streaming model have a sequence length of 1: each call advances one time step
+   fGC += "auto step(" + GenerateInferSignature() + ") {\n";
+   fGC += SP + "return infer(" + GenerateInferSignature(false) + ");\n";
+   fGC += "}\n";
+}
+
 void RModel::Generate(std::underlying_type_t<Options> options, int batchSize, long pos, bool verbose)
 {
    fVerbose = verbose;
@@ -933,13 +1685,61 @@ void RModel::Generate(std::underlying_type_t<Options> options, int batchSize, lo
          "TMVA-SOFIE: RModel::Generate: cannot use a separate weight file without generating a Session class");
    }
 
+   // the constants are generated as raw bytes only when requested, it is not kept for the following generations
+   fUseBinaryConstants = static_cast<std::underlying_type_t<Options>>(Options::kBinaryConstants) & options;
+   // the C interface is generated only when requested, it is not kept for the following generations
+   fUseCInterface = static_cast<std::underlying_type_t<Options>>(Options::kCInterface) & options;
+   if (fUseCInterface) {
+      if (!fUseSession || fIsGNN || fIsGNNComponent) {
+         throw std::runtime_error(
+            "TMVA-SOFIE: RModel::Generate: the C interface requires generating a stand-alone Session class");
+      }
+   }
+   // profiling is used for tuning and it is not kept for the following generations
+   fProfileOperators = static_cast<std::underlying_type_t<Options>>(Options::kProfile) & options;
+   if (fProfileOperators) {
+      if (!fUseSession || fIsGNN || fIsGNNComponent) {
+         throw std::runtime_error(
+            "TMVA-SOFIE: RModel::Generate: profiling requires generating a stand-alone Session class");
+      }
+   }
+
+   // the blocked layout is used only when requested, but once the weights are packed for it (see
+   // AssignBlockedLayout) the model cannot be generated again with the plain layout
+   fUseBlockedLayout = static_cast<std::underlying_type_t<Options>>(Options::kBlockedLayout) & options;
+   if (!fUseBlockedLayout && fIsBlockedLayoutAssigned) {
+      throw std::runtime_error("TMVA-SOFIE: RModel::Generate: model " + fName +
+                               " was generated with the blocked layout, whose weights are packed in place: it cannot "
+                               "be generated again without Options::kBlockedLayout");
+   }
+
+   // the dead operators are removed when initializing the model, and the unused initialized tensors at each
+   // generation: once removed they are not added back by a following generation without the removal
+   fRemoveDeadCode = !(static_cast<std::underlying_type_t<Options>>(Options::kNoDeadCodeRemoval) & options);
+
    if (static_cast<std::underlying_type_t<Options>>(Options::kGNN) & options)
       fIsGNN = true;
    if (static_cast<std::underlying_type_t<Options>>(Options::kGNNComponent) & options)
       fIsGNNComponent = true;
+   if (static_cast<std::underlying_type_t<Options>>(Options::kStreaming) & options) {
+      if (!fUseSession || fIsGNNComponent) {
+         throw std::runtime_error(
+            "TMVA-SOFIE: RModel::Generate: streaming mode requires generating a stand-alone Session class");
+      }
+      // the recurrent operators keep their state in the Session only when initialized in streaming mode
+      if (fIsInitialized && !fIsStreaming) {
+         throw std::runtime_error("TMVA-SOFIE: RModel::Generate: streaming mode requested for model " + fName +
+                                  " which was already initialized without it");
+      }
+      fIsStreaming = true;
+   }
 
    // initialize the model including all operators and sub-graphs
    Initialize(batchSize, verbose);
+   if (!fBatchSpecializations.empty() && fShapeParams.empty()) {
+      throw std::runtime_error("TMVA-SOFIE: RModel::Generate: model " + fName +
+                               " has no parametric batch size, it cannot be specialized for fixed batch sizes");
+   }
 
    std::string hgname;
    if (!fIsGNNComponent && !fIsSubGraph) {
@@ -947,10 +1747,19 @@ void RModel::Generate(std::underlying_type_t<Options> options, int batchSize, lo
       GenerateHeaderInfo(hgname);
    }
 
+   if (fUseBlockedLayout && !fIsGNN && !fIsGNNComponent && fSubGraphs.empty())
+      AssignBlockedLayout();
+
+   // the initialized tensors not used by the generated code are not declared or written in the weight file
+   if (fRemoveDeadCode && !fIsGNN && !fIsGNNComponent)
+      RemoveUnusedInitializedTensors();
+
    // generate first code for the subgraphs
    for (auto &graph : fSubGraphs) {
       if (fVerbose)
          std::cout << "generate session code for subgraph " << graph->fName << std::endl;
+      if (fRemoveDeadCode)
+         graph->RemoveUnusedInitializedTensors();
       graph->GenerateSessionCode();
       fGC += graph->fGC;
    }
@@ -963,10 +1772,149 @@ void RModel::Generate(std::underlying_type_t<Options> options, int batchSize, lo
 
    if (!fIsGNNComponent && !fIsSubGraph) {
       fGC += ("} //SOFIE_" + fName + "\n");
+      if (fUseCInterface)
+         GenerateCInterface();
       fGC += "\n#endif  // " + hgname + "\n";
    }
 }
 
+void RModel::Generate(std::underlying_type_t<Options> options, const std::vector<int> &batchSizes, long pos,
+                      bool verbose)
+{
+   auto unsupported = Options::kNoSession | Options::kGNN | Options::kGNNComponent | Options::kStreaming;
+   if (options & unsupported) {
+      throw std::runtime_error(
+         "TMVA-SOFIE: RModel::Generate: specializations for fixed batch sizes require generating a stand-alone Session class");
+   }
+
+   // the model can be initialized only once, a new instance is parsed for each batch size
+   std::set<int> sizes;
+   for (int bs : batchSizes) {
+      if (bs > 0)
+         sizes.insert(bs);
+   }
+   if (!sizes.empty() && !fModelSource) {
+      throw std::runtime_error("TMVA-SOFIE: RModel::Generate: model " + fName +
+                               " has no source for building it again for each fixed batch size. The source is set "
+                               "by the ONNX parser, for the other models give it with RModel::SetModelSource");
+   }
+   fBatchSpecializations.clear();
+   for (int bs : sizes) {
+      auto spec = std::make_shared<RModel>(fModelSource());
+      spec->fRemoveDeadCode = !(static_cast<std::underlying_type_t<Options>>(Options::kNoDeadCodeRemoval) & options);
+      spec->Initialize(bs, verbose);
+      if (!spec->fInputTensorInfos.empty() || !spec->fDynamicTensorInfos.empty() || !spec->fSubGraphs.empty()) {
+         throw std::runtime_error("TMVA-SOFIE: RModel::Generate: model " + fName +
+                                  " cannot be specialized for batch size " + std::to_string(bs) +
+                                  ", only the batch size can be parametric and sub-graphs are not supported");
+      }
+      spec->fBatchSize = bs;
+      if (static_cast<std::underlying_type_t<Options>>(Options::kBlockedLayout) & options) {
+         spec->fUseBlockedLayout = true;
+         spec->AssignBlockedLayout();
+      }
+      if (spec->fRemoveDeadCode)
+         spec->RemoveUnusedInitializedTensors();
+      // the Session includes what is needed by the specializations
+      fNeededBlasRoutines.insert(spec->fNeededBlasRoutines.begin(), spec->fNeededBlasRoutines.end());
+      fNeededStdLib.insert(spec->fNeededStdLib.begin(), spec->fNeededStdLib.end());
+      fCustomOpHeaders.insert(spec->fCustomOpHeaders.begin(), spec->fCustomOpHeaders.end());
+      fBatchSpecializations.push_back(spec);
+   }
+
+   // the model itself is generated for a dynamic batch size, used for the sizes without specialization
+   Generate(options, -1, pos, verbose);
+}
+
+void RModel::GenerateCInterface()
+{
+   // the C interface exchanges only fixed size buffers
+   if (!fShapeParams.empty())
+      throw std::runtime_error("TMVA-SOFIE: C interface is not supported for models with dynamic shapes - "
+                               "give the batch size when generating the code");
+   for (auto &name : fOutputTensorNames) {
+      if (IsDynamicTensor(name))
+         throw std::runtime_error("TMVA-SOFIE: C interface is not supported for dynamic output tensor " + name);
+   }
+
+   std::string session = "SOFIE_" + fName + "::Session";
+   fGC += "\n// C interface of the model, used for loading it from a shared library. The libraries are compiled with\n"
+          "// hidden visibility (see RModelCompiler): only these functions are exported, and two versions of the same\n"
+          "// model loaded in a process do not share their inline members (e.g. the constant tensors)\n";
+   fGC += "#pragma GCC visibility push(default)\n";
+   fGC += "extern \"C\" {\n";
+   fGC += "int sofie_abi_version() { return 1; }\n";
+   fGC += "const char * sofie_model_name() { return \"" + fName + "\"; }\n";
+
+   // name, type, rank and shape of the input and output tensors
+   auto generateTensorQueries = [&](const std::string &kind, const std::vector<std::string> &names) {
+      std::string n = std::to_string(names.size());
+      std::string namesList, typesList, ranksList, shapesList, shapesDecl;
+      for (size_t i = 0; i < names.size(); i++) {
+         auto shape = GetTensorShape(names[i]);
+         namesList += "\"" + names[i] + "\",";
+         typesList += std::to_string(static_cast<int>(GetTensorType(names[i]))) + ",";
+         ranksList += std::to_string(shape.size()) + ",";
+         // add a last element to avoid zero-size arrays for scalars
+         shapesDecl += SP + "static const size_t shape_" + std::to_string(i) + "[] = {";
+         for (auto d : shape)
+            shapesDecl += std::to_string(d) + ",";
+         shapesDecl += "0};\n";
+         shapesList += "shape_" + std::to_string(i) + ",";
+      }
+      fGC += "size_t sofie_num_" + kind + "s() { return " + n + "; }\n";
+      fGC += "const char * sofie_" + kind + "_name(size_t i) {\n" + SP + "static const char * names[] = {" + namesList +
+             "};\n" + SP + "return i < " + n + " ? names[i] : nullptr;\n}\n";
+      fGC += "int sofie_" + kind + "_type(size_t i) {\n" + SP + "static const int types[] = {" + typesList + "};\n" + SP +
+             "return i < " + n + " ? types[i] : 0;\n}\n";
+      fGC += "size_t sofie_" + kind + "_rank(size_t i) {\n" + SP + "static const size_t ranks[] = {" + ranksList + "};\n" +
+             SP + "return i < " + n + " ? ranks[i] : 0;\n}\n";
+      fGC += "const size_t * sofie_" + kind + "_shape(size_t i) {\n" + shapesDecl + SP + "static const size_t * shapes[] = {" +
+             shapesList + "};\n" + SP + "return i < " + n + " ? shapes[i] : nullptr;\n}\n";
+   };
+   generateTensorQueries("input", fInputTensorNames);
+   generateTensorQueries("output", fOutputTensorNames);
+
+   // weights are read from the default weight file, if any. Return a null session in case of errors
+   fGC += "void * sofie_create_session() {\n";
+   fGC += SP + "try {\n" + SP + SP + "return new " + session + "();\n";
+   fGC += SP + "} catch (...) {\n" + SP + SP + "return nullptr;\n" + SP + "}\n}\n";
+   fGC += "void sofie_destroy_session(void * session) { delete static_cast<" + session + " *>(session); }\n";
+   if (fProfileOperators) {
+      fGC += "size_t sofie_num_operators() { return " + std::to_string(fOperators.size()) + "; }\n";
+      fGC += "const double * sofie_operator_times(void * session) {\n" + SP + "return static_cast<" + session +
+             " *>(session)->fOperatorTimes.data();\n}\n";
+   }
+
+   // copy the outputs in the buffers given by the caller. Return a non-zero value in case of errors
+   fGC += "int sofie_infer(void * session, const void * const * inputs, void * const * outputs) {\n";
+   fGC += SP + "try {\n";
+   fGC += SP + SP + "auto result = static_cast<" + session + " *>(session)->infer(";
+   for (size_t i = 0; i < fInputTensorNames.size(); i++) {
+      std::string type = ConvertTypeToString(GetTensorType(fInputTensorNames[i]));
+      fGC += "static_cast<" + type + " *>(const_cast<void *>(inputs[" + std::to_string(i) + "]))";
+      if (i < fInputTensorNames.size() - 1)
+         fGC += ", ";
+   }
+   fGC += ");\n";
+   // infer returns a vector for a single output, a vector of vectors for outputs of the same type or a tuple
+   bool sameOutputTypes = true;
+   for (auto &name : fOutputTensorNames)
+      sameOutputTypes &= (GetTensorType(name) == GetTensorType(fOutputTensorNames[0]));
+   for (size_t i = 0; i < fOutputTensorNames.size(); i++) {
+      std::string type = ConvertTypeToString(GetTensorType(fOutputTensorNames[i]));
+      std::string out = "result";
+      if (fOutputTensorNames.size() > 1)
+         out = sameOutputTypes ? "result[" + std::to_string(i) + "]" : "std::get<" + std::to_string(i) + ">(result)";
+      fGC += SP + SP + "std::copy(" + out + ".begin(), " + out + ".end(), static_cast<" + type + " *>(outputs[" +
+             std::to_string(i) + "]));\n";
+   }
+   fGC += SP + SP + "return 0;\n";
+   fGC += SP + "} catch (...) {\n" + SP + SP + "return 1;\n" + SP + "}\n}\n";
+   fGC += "} // extern \"C\"\n";
+   fGC += "#pragma GCC visibility pop\n";
+}
+
 void RModel::ReadInitializedTensorsFromFile(long pos) {
     // generate the code to read initialized tensors from a text data file
     if (fWeightFile == WeightFileType::Text) {
@@ -1239,6 +2187,14 @@ void RModel::PrintDynamicTensors() {
     std::cout << "\n";
 }
 
+void RModel::PrintOptimizationReport() {
+    std::cout << "Model optimizations removed " << fOptimizationReport.size() << " operators or tensors:\n";
+    for (auto& it: fOptimizationReport) {
+        std::cout << "\t" << it << std::endl;
+    }
+    std::cout << "\n";
+}
+
 void RModel::PrintOutputTensors() {
     std::cout << "Model specify the following output tensors:\n";
     for (auto& it: fOutputTensorNames) {
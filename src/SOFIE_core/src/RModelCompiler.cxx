@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "TMD5.h"
+#include "TROOT.h"
+#include "TSystem.h"
+
+#include "SOFIE/RModelCompiler.hxx"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+#ifndef SOFIE_INCLUDE_DIR
+#define SOFIE_INCLUDE_DIR ""
+#endif
+
+// BLAS libraries found when configuring SOFIE, separated by commas
+#ifndef SOFIE_BLAS_LIBRARIES
+#define SOFIE_BLAS_LIBRARIES ""
+#endif
+
+namespace SOFIE {
+
+namespace {
+
+// directory of the SOFIE_core library, to which the compiled models are linked. Empty if SOFIE_core is not
+// loaded as a shared library (the symbols are then resolved in the executable)
+std::string GetCoreLibraryDirectory()
+{
+#ifndef _WIN32
+   Dl_info info;
+   if (dladdr(reinterpret_cast<void *>(&ConvertShapeToLength), &info) != 0 && info.dli_fname) {
+      std::filesystem::path library = std::filesystem::canonical(info.dli_fname);
+      if (library.filename().string().rfind("libSOFIE_core", 0) == 0)
+         return library.parent_path().string();
+   }
+#endif
+   return "";
+}
+
+// quote an argument of the compiler command line for the shell
+std::string Quote(const std::string &arg)
+{
+   std::string quoted = "\"";
+   for (char c : arg) {
+      if (c == '"' || c == '\\' || c == '$' || c == '`')
+         quoted += '\\';
+      quoted += c;
+   }
+   return quoted + "\"";
+}
+
+// link flags of the BLAS libraries configured with SOFIE, or of the default BLAS library
+std::string GetBLASLinkFlags()
+{
+   std::string flags;
+   std::stringstream libraries(SOFIE_BLAS_LIBRARIES);
+   std::string library;
+   while (std::getline(libraries, library, ',')) {
+      if (library.empty())
+         continue;
+      // linker options (e.g. -lopenblas or -framework Accelerate) are kept as they are, the paths are quoted
+      flags += " " + ((library[0] == '-') ? library : Quote(library));
+   }
+   return flags.empty() ? " -lblas" : flags;
+}
+
+// content of SOFIE_common.hxx, included by the generated code, from the first include directory containing it
+std::string ReadCommonHeader(const std::vector<std::string> &includeDirs)
+{
+   for (auto &dir : includeDirs) {
+      std::ifstream header(std::filesystem::path(dir) / "SOFIE" / "SOFIE_common.hxx", std::ios::binary);
+      if (header) {
+         std::stringstream content;
+         content << header.rdbuf();
+         return content.str();
+      }
+   }
+   return "";
+}
+
+} // namespace
+
+RModelCompiler::RModelCompiler(std::string cacheDir) : fCacheDirectory(cacheDir)
+{
+   fFlags = "-O3";
+   std::string target = GetCPUTarget();
+   if (target.find("x86-64") == 0)
+      fFlags += " -march=" + target;
+   if (std::string(SOFIE_INCLUDE_DIR).size() > 0)
+      fIncludeDirs.push_back(SOFIE_INCLUDE_DIR);
+   fIncludeDirs.push_back(TROOT::GetIncludeDir().Data());
+}
+
+std::string RModelCompiler::GetCPUTarget()
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+      return "x86-64-v4";
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return "x86-64-v3";
+   if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+      return "x86-64-v2";
+   return "x86-64";
+#elif defined(__aarch64__)
+   return "aarch64";
+#else
+   return "generic";
+#endif
+}
+
+std::vector<std::string> RModelCompiler::GetCompatibleCPUTargets()
+{
+   std::string target = GetCPUTarget();
+   // x86-64 levels are supersets of the lower ones
+   const std::vector<std::string> levels = {"x86-64-v4", "x86-64-v3", "x86-64-v2", "x86-64"};
+   for (size_t i = 0; i < levels.size(); i++) {
+      if (levels[i] == target)
+         return std::vector<std::string>(levels.begin() + i, levels.end());
+   }
+   return {target};
+}
+
+std::string RModelCompiler::GetCPUModel()
+{
+   std::ifstream cpuinfo("/proc/cpuinfo");
+   std::string line;
+   while (std::getline(cpuinfo, line)) {
+      size_t pos = line.find(':');
+      if (line.rfind("model name", 0) != 0 || pos == std::string::npos)
+         continue;
+      pos = line.find_first_not_of(" \t", pos + 1);
+      if (pos != std::string::npos)
+         return line.substr(pos);
+   }
+   return GetCPUTarget();
+}
+
+std::string RModelCompiler::GenerateCode(RModel &model, std::underlying_type_t<Options> options, int batchSize)
+{
+   // the weight file options given to Generate are kept by the model: restore them, and the code generated before,
+   // so that the following generations (e.g. OutputGenerated) are not changed by the compilation
+   bool useWeightFile = model.fUseWeightFile;
+   WeightFileType weightFile = model.fWeightFile;
+   std::string previousCode = model.fGC;
+   auto restore = [&]() {
+      model.fUseWeightFile = useWeightFile;
+      model.fWeightFile = weightFile;
+      model.fGC = previousCode;
+   };
+   std::string code;
+   try {
+      model.Generate(options, batchSize, 0, fVerbose);
+      code = model.ReturnGenerated();
+   } catch (...) {
+      restore();
+      throw;
+   }
+   restore();
+   return code;
+}
+
+std::string RModelCompiler::Compile(RModel &model, int batchSize, std::underlying_type_t<Options> options)
+{
+   // weights are embedded as raw bytes in the library
+   options = options | Options::kNoWeightFile | Options::kBinaryConstants | Options::kCInterface;
+   return CompileCode(model.GetName(), GenerateCode(model, options, batchSize), true);
+}
+
+std::string RModelCompiler::CompileCode(const std::string &modelName, const std::string &code, bool updateLink)
+{
+   std::string linkFlags = fLinkFlags;
+   // the generated code includes SOFIE_common.hxx, which declares functions defined in SOFIE_core
+   std::string coreLibraryDir = GetCoreLibraryDirectory();
+   if (!coreLibraryDir.empty())
+      linkFlags += " -L" + Quote(coreLibraryDir) + " " + Quote("-Wl,-rpath," + coreLibraryDir) + " -lSOFIE_core";
+   if (code.find("namespace BLAS") != std::string::npos)
+      linkFlags += GetBLASLinkFlags();
+   std::string includes;
+   for (auto &dir : fIncludeDirs)
+      includes += " -I" + Quote(dir);
+   std::string target = GetCPUTarget();
+
+   // the library depends on the code, on the SOFIE header it includes, on the compiler and its options
+   // and on the CPU target
+   TMD5 md5;
+   std::string config = fCompiler + ";" + fFlags + ";" + linkFlags + ";" + target + ";";
+   md5.Update(reinterpret_cast<const UChar_t *>(config.data()), config.size());
+   std::string commonHeader = ReadCommonHeader(fIncludeDirs);
+   md5.Update(reinterpret_cast<const UChar_t *>(commonHeader.data()), commonHeader.size());
+   // skip the header comment, which contains the generation time
+   size_t begin = (code.rfind("//Code generated", 0) == 0) ? code.find('\n') + 1 : 0;
+   md5.Update(reinterpret_cast<const UChar_t *>(code.data() + begin), code.size() - begin);
+   md5.Final();
+   std::string hash = md5.AsString();
+
+   std::filesystem::path modelDir = std::filesystem::path(fCacheDirectory) / modelName;
+   std::filesystem::path targetDir = modelDir / target;
+   std::filesystem::path library = targetDir / (hash + ".so");
+   std::filesystem::create_directories(targetDir);
+
+   if (!std::filesystem::exists(library)) {
+      // build in temporary files, so that concurrent jobs never load a partially written library
+      std::string tmpName = hash + "." + std::to_string(gSystem->GetPid());
+      std::filesystem::path source = targetDir / (tmpName + ".cxx");
+      std::filesystem::path tmpLibrary = targetDir / (tmpName + ".so");
+      std::ofstream f(source);
+      if (!f)
+         throw std::runtime_error("TMVA-SOFIE: cannot write source file " + source.string());
+      f << code;
+      f.close();
+
+      // only the C interface is exported (see RModel::GenerateCInterface)
+      std::string command = fCompiler + " -std=c++20 -shared -fPIC -fvisibility=hidden -fvisibility-inlines-hidden " +
+                            fFlags + includes + " " + Quote(source.string()) +
+                            " -o " + Quote(tmpLibrary.string()) + " " + linkFlags;
+      if (fVerbose)
+         std::cout << "Compiling model " << modelName << " : " << command << std::endl;
+      int ret = std::system(command.c_str());
+      std::filesystem::remove(source);
+      if (ret != 0) {
+         std::filesystem::remove(tmpLibrary);
+         throw std::runtime_error("TMVA-SOFIE: compilation of model " + modelName + " failed: " + command);
+      }
+      std::filesystem::rename(tmpLibrary, library);
+   } else if (fVerbose) {
+      std::cout << "Found compiled model " << modelName << " in cache: " << library.string() << std::endl;
+   }
+
+   if (!updateLink)
+      return library.string();
+
+   // point the library of the target to the last compiled one
+   std::filesystem::path link = modelDir / (target + ".so");
+   std::filesystem::path tmpLink = modelDir / (target + ".so." + std::to_string(gSystem->GetPid()));
+   std::filesystem::remove(tmpLink);
+   std::filesystem::create_symlink(std::filesystem::path(target) / library.filename(), tmpLink);
+   std::filesystem::rename(tmpLink, link);
+
+   return library.string();
+}
+
+void RModelCompiler::Tune(RModel &model, int batchSize)
+{
+   std::string cacheFile =
+      fTuningCache.empty() ? (std::filesystem::path(fCacheDirectory) / "tuning.txt").string() : fTuningCache;
+   std::string cpu = GetCPUModel();
+
+   // variants chosen for the host CPU model. Each line of the file has the CPU model, the kernel key
+   // and the variant separated by tabs
+   std::map<std::string, std::string> choices;
+   std::ifstream input(cacheFile);
+   std::string line;
+   while (std::getline(input, line)) {
+      size_t pos1 = line.find('\t');
+      size_t pos2 = line.rfind('\t');
+      if (line.empty() || line[0] == '#' || pos1 == std::string::npos || pos2 == pos1)
+         continue;
+      if (line.substr(0, pos1) == cpu)
+         choices[line.substr(pos1 + 1, pos2 - pos1 - 1)] = line.substr(pos2 + 1);
+   }
+   input.close();
+
+   // the kernel keys depend on the shapes, known after initialization
+   model.Initialize(batchSize, fVerbose);
+   auto &operators = model.GetOperators();
+   std::vector<size_t> tunedOperators;
+   size_t nVariants = 0;
+   for (size_t i = 0; i < operators.size(); i++) {
+      auto variants = operators[i]->GetKernelVariants();
+      if (variants.size() < 2)
+         continue;
+      auto itr = choices.find(operators[i]->GetKernelKey());
+      if (itr != choices.end() && std::find(variants.begin(), variants.end(), itr->second) != variants.end()) {
+         operators[i]->SetKernelVariant(itr->second);
+      } else {
+         tunedOperators.push_back(i);
+         nVariants = std::max(nVariants, variants.size());
+      }
+   }
+   if (tunedOperators.empty())
+      return;
+
+   // all operators are benchmarked together: the model is compiled for each variant index v, with the operators
+   // using their v-th variant and timers around each operator. Operators with the same key add their times
+   std::map<std::string, std::vector<double>> times;
+   for (size_t v = 0; v < nVariants; v++) {
+      for (auto i : tunedOperators) {
+         auto variants = operators[i]->GetKernelVariants();
+         operators[i]->SetKernelVariant(variants[std::min(v, variants.size() - 1)]);
+      }
+      std::string code = GenerateCode(
+         model, Options::kNoWeightFile | Options::kBinaryConstants | Options::kCInterface | Options::kProfile, batchSize);
+      RCompiledModel compiled(CompileCode(model.GetName(), code, false));
+
+      // floating point inputs are filled with random values in [0,1), the other ones with zeros
+      std::mt19937 generator(1234);
+      std::uniform_real_distribution<float> uniform(0.f, 1.f);
+      std::vector<std::vector<char>> inputs(compiled.GetNumInputs());
+      std::vector<std::vector<char>> outputs(compiled.GetNumOutputs());
+      std::vector<const void *> inputData;
+      std::vector<void *> outputData;
+      for (size_t i = 0; i < inputs.size(); i++) {
+         size_t length = ConvertShapeToLength(compiled.GetInputShape(i));
+         inputs[i].resize(length * GetTypeSize(compiled.GetInputType(i)));
+         if (compiled.GetInputType(i) == ETensorType::FLOAT) {
+            float *x = reinterpret_cast<float *>(inputs[i].data());
+            for (size_t j = 0; j < length; j++)
+               x[j] = uniform(generator);
+         } else if (compiled.GetInputType(i) == ETensorType::DOUBLE) {
+            double *x = reinterpret_cast<double *>(inputs[i].data());
+            for (size_t j = 0; j < length; j++)
+               x[j] = uniform(generator);
+         }
+         inputData.push_back(inputs[i].data());
+      }
+      for (size_t i = 0; i < outputs.size(); i++) {
+         outputs[i].resize(ConvertShapeToLength(compiled.GetOutputShape(i)) * GetTypeSize(compiled.GetOutputType(i)));
+         outputData.push_back(outputs[i].data());
+      }
+
+      // the first inference is not measured (memory allocation, caches)
+      compiled.Infer(inputData, outputData);
+      std::vector<double> start = compiled.GetOperatorTimes();
+      for (int iter = 0; iter < fTuningIterations; iter++)
+         compiled.Infer(inputData, outputData);
+      std::vector<double> end = compiled.GetOperatorTimes();
+
+      for (auto i : tunedOperators) {
+         size_t n = operators[i]->GetKernelVariants().size();
+         if (v >= n)
+            continue;
+         auto &t = times[operators[i]->GetKernelKey()];
+         t.resize(n);
+         t[v] += end[i] - start[i];
+      }
+   }
+
+   // select the fastest variants and add them to the cache
+   std::ofstream output(cacheFile, std::ios::app);
+   if (!output)
+      throw std::runtime_error("TMVA-SOFIE: cannot write tuning cache " + cacheFile);
+   for (auto i : tunedOperators) {
+      std::string key = operators[i]->GetKernelKey();
+      if (choices.count(key) == 0) {
+         auto &t = times[key];
+         size_t best = std::min_element(t.begin(), t.end()) - t.begin();
+         choices[key] = operators[i]->GetKernelVariants()[best];
+         output << cpu << '\t' << key << '\t' << choices[key] << '\n';
+         if (fVerbose) {
+            std::cout << "Tuning " << key << " :";
+            for (size_t v = 0; v < t.size(); v++)
+               std::cout << " " << operators[i]->GetKernelVariants()[v] << " " << t[v] / fTuningIterations * 1.E6 << " us";
+            std::cout << " -> " << choices[key] << std::endl;
+         }
+      }
+      operators[i]->SetKernelVariant(choices[key]);
+   }
+}
+
+RCompiledModel::RCompiledModel(const std::string &library)
+{
+#ifdef _WIN32
+   throw std::runtime_error("TMVA-SOFIE: loading compiled models is not supported on Windows");
+#else
+   fHandle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+   if (!fHandle)
+      throw std::runtime_error("TMVA-SOFIE: cannot load compiled model " + library + ": " + dlerror());
+
+   auto abiVersion = reinterpret_cast<int (*)()>(GetSymbol("sofie_abi_version"));
+   if (abiVersion() != 1) {
+      dlclose(fHandle);
+      throw std::runtime_error("TMVA-SOFIE: compiled model " + library + " has unsupported C interface version " +
+                               std::to_string(abiVersion()));
+   }
+   fName = reinterpret_cast<const char *(*)()>(GetSymbol("sofie_model_name"))();
+   const std::string kinds[2] = {"input", "output"};
+   for (int k = 0; k < 2; k++) {
+      fNumTensors[k] = reinterpret_cast<size_t (*)()>(GetSymbol("sofie_num_" + kinds[k] + "s"));
+      fTensorName[k] = reinterpret_cast<const char *(*)(size_t)>(GetSymbol("sofie_" + kinds[k] + "_name"));
+      fTensorType[k] = reinterpret_cast<int (*)(size_t)>(GetSymbol("sofie_" + kinds[k] + "_type"));
+      fTensorRank[k] = reinterpret_cast<size_t (*)(size_t)>(GetSymbol("sofie_" + kinds[k] + "_rank"));
+      fTensorShape[k] = reinterpret_cast<const size_t *(*)(size_t)>(GetSymbol("sofie_" + kinds[k] + "_shape"));
+   }
+   fInfer = reinterpret_cast<int (*)(void *, const void *const *, void *const *)>(GetSymbol("sofie_infer"));
+   fDestroySession = reinterpret_cast<void (*)(void *)>(GetSymbol("sofie_destroy_session"));
+   fNumOperators = reinterpret_cast<size_t (*)()>(dlsym(fHandle, "sofie_num_operators"));
+   fOperatorTimes = reinterpret_cast<const double *(*)(void *)>(dlsym(fHandle, "sofie_operator_times"));
+
+   fSession = reinterpret_cast<void *(*)()>(GetSymbol("sofie_create_session"))();
+   if (!fSession) {
+      dlclose(fHandle);
+      throw std::runtime_error("TMVA-SOFIE: cannot create session of compiled model " + library);
+   }
+#endif
+}
+
+RCompiledModel::~RCompiledModel()
+{
+#ifndef _WIN32
+   if (fSession)
+      fDestroySession(fSession);
+   if (fHandle)
+      dlclose(fHandle);
+#endif
+}
+
+void *RCompiledModel::GetSymbol(const std::string &name)
+{
+#ifndef _WIN32
+   void *symbol = dlsym(fHandle, name.c_str());
+   if (symbol)
+      return symbol;
+   dlclose(fHandle);
+#endif
+   throw std::runtime_error("TMVA-SOFIE: symbol " + name + " not found in compiled model");
+}
+
+std::string RCompiledModel::FindLibrary(const std::string &cacheDir, const std::string &modelName)
+{
+   for (auto &target : RModelCompiler::GetCompatibleCPUTargets()) {
+      std::filesystem::path library = std::filesystem::path(cacheDir) / modelName / (target + ".so");
+      if (std::filesystem::exists(library))
+         return library.string();
+   }
+   throw std::runtime_error("TMVA-SOFIE: no compiled library of model " + modelName + " for CPU target " +
+                            RModelCompiler::GetCPUTarget() + " in " + cacheDir);
+}
+
+std::vector<size_t> RCompiledModel::GetInputShape(size_t i) const
+{
+   const size_t *shape = fTensorShape[0](i);
+   return std::vector<size_t>(shape, shape + fTensorRank[0](i));
+}
+
+std::vector<size_t> RCompiledModel::GetOutputShape(size_t i) const
+{
+   const size_t *shape = fTensorShape[1](i);
+   return std::vector<size_t>(shape, shape + fTensorRank[1](i));
+}
+
+void RCompiledModel::Infer(const std::vector<const void *> &inputs, const std::vector<void *> &outputs)
+{
+   if (inputs.size() != GetNumInputs() || outputs.size() != GetNumOutputs())
+      throw std::runtime_error("TMVA-SOFIE: compiled model " + fName + " called with wrong number of inputs or outputs");
+   if (fInfer(fSession, inputs.data(), outputs.data()) != 0)
+      throw std::runtime_error("TMVA-SOFIE: inference of compiled model " + fName + " failed");
+}
+
+std::vector<double> RCompiledModel::GetOperatorTimes() const
+{
+   if (!fNumOperators || !fOperatorTimes)
+      return {};
+   const double *times = fOperatorTimes(fSession);
+   return std::vector<double>(times, times + fNumOperators());
+}
+
+} // namespace SOFIE
@@ -32,6 +32,9 @@ void RModel_Base::GenerateHeaderInfo(std::string& hgname) {
     fGC += "#include \"SOFIE/SOFIE_common.hxx\"\n";
     if (fUseWeightFile)
         fGC += "#include <fstream>\n";
+    // the options used for a single generation (e.g. profiling) do not change the needed libraries of the model
+    if (fProfileOperators)
+        fGC += "#include <chrono>\n";
     // Include TFile when saving the weights in a binary ROOT file
     if (fWeightFile == WeightFileType::RootBinary)
         fGC += "#include \"TFile.h\"\n";
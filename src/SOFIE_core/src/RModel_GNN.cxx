@@ -20,6 +20,7 @@ RModel_GNN::RModel_GNN(RModel_GNN&& other) {
 
     num_nodes = std::move(other.num_nodes);
     num_edges = std::move(other.num_edges);
+    num_graphs = std::move(other.num_graphs);
 
     fName = std::move(other.fName);
     fFileName = std::move(other.fFileName);
@@ -37,6 +38,7 @@ RModel_GNN& RModel_GNN::operator=(RModel_GNN&& other) {
 
     num_nodes = std::move(other.num_nodes);
     num_edges = std::move(other.num_edges);
+    num_graphs = std::move(other.num_graphs);
 
     fName = std::move(other.fName);
     fFileName = std::move(other.fFileName);
@@ -56,6 +58,7 @@ RModel_GNN::RModel_GNN(GNN_Init& graph_input_struct) {
 
     num_nodes = graph_input_struct.num_nodes;
     num_edges = graph_input_struct.edges.size();
+    num_graphs = graph_input_struct.num_graphs;
     num_node_features = graph_input_struct.num_node_features;
     num_edge_features = graph_input_struct.num_edge_features;
     num_global_features = graph_input_struct.num_global_features;
@@ -80,12 +83,15 @@ void RModel_GNN::Generate() {
     long next_pos;
     //size_t block_size = num_edges;
     fGC+="\n\nnamespace Edge_Update{\nstruct Session {\n";
-    // there are 4 input tensors for edge updates: {edges, receiver nodes, sender nodes, globals }
-    std::vector<std::vector<Dim>> update_input_edges(4);
+    // there are 6 input tensors for edge updates: {edges, nodes, globals, receivers, senders, graph of the nodes }
+    // the receiver and sender node features are gathered inside the edge update using the edge indices
+    std::vector<std::vector<Dim>> update_input_edges(6);
     update_input_edges[0] = {Dim{"num_edges",num_edges}, Dim{num_edge_features}};
-    update_input_edges[1] = {Dim{"num_edges",num_edges}, Dim{num_node_features}};
-    update_input_edges[2] = {Dim{"num_edges",num_edges}, Dim{num_node_features}};
-    update_input_edges[3] = {Dim{"num_edges",num_edges}, Dim{num_global_features}};
+    update_input_edges[1] = {Dim{"num_nodes",num_nodes}, Dim{num_node_features}};
+    update_input_edges[2] = {Dim{"num_graphs",num_graphs}, Dim{num_global_features}};
+    update_input_edges[3] = {Dim{"num_edges",num_edges}};
+    update_input_edges[4] = {Dim{"num_edges",num_edges}};
+    update_input_edges[5] = {Dim{"num_nodes",num_nodes}};
     edges_update_block->Initialize();
     edges_update_block->AddInputTensors(update_input_edges);
     fGC+=edges_update_block->GenerateModel(fName);
@@ -124,7 +130,11 @@ void RModel_GNN::Generate() {
 
     fGC+="\n\nnamespace Global_Update{\nstruct Session {\n";
     // Generating Infer function definition for Global Update function
-    std::vector<std::vector<std::size_t>> update_input_globals = {{1, num_edge_features},{1, num_node_features},{1, num_global_features}};
+    // one row per graph of the batch
+    std::vector<std::vector<Dim>> update_input_globals(3);
+    update_input_globals[0] = {Dim{"num_graphs",num_graphs}, Dim{num_edge_features}};
+    update_input_globals[1] = {Dim{"num_graphs",num_graphs}, Dim{num_node_features}};
+    update_input_globals[2] = {Dim{"num_graphs",num_graphs}, Dim{num_global_features}};
     globals_update_block->Initialize();
     globals_update_block->AddInputTensors(update_input_globals);
     fGC+=globals_update_block->GenerateModel(fName,next_pos);
@@ -133,18 +143,13 @@ void RModel_GNN::Generate() {
 
     // correct for difference in global size  (check shape[1] of output of the globals update)
     auto num_global_features_input = num_global_features;
-    if(globals_update_block->GetFunctionBlock()->GetTensorShape(globals_update_block->GetFunctionBlock()->GetOutputTensorNames()[0])[1] != num_global_features) {
-        num_global_features = globals_update_block->GetFunctionBlock()->GetTensorShape(globals_update_block->GetFunctionBlock()->GetOutputTensorNames()[0])[1];
+    auto globals_update_output_shape =  globals_update_block->GetFunctionBlock()->GetDynamicTensorShape(globals_update_block->GetFunctionBlock()->GetOutputTensorNames()[0]);
+    if(!globals_update_output_shape[1].isParam && globals_update_output_shape[1].dim != num_global_features_input) {
+        num_global_features = globals_update_output_shape[1].dim;
     }
 
-    fGC+=edge_node_agg_block->GenerateModel();
-
-    if(edge_node_agg_block->GetFunctionType() != edge_global_agg_block->GetFunctionType()) {
-        fGC+=edge_global_agg_block->GenerateModel();
-    }
-    if((edge_node_agg_block->GetFunctionType() != node_global_agg_block->GetFunctionType()) && (edge_global_agg_block->GetFunctionType() != node_global_agg_block->GetFunctionType())) {
-        fGC+=node_global_agg_block->GenerateModel();
-    }
+    // aggregations are computed as segment reductions (SOFIE::UTILITY::Segment*) of the edge and node data,
+    // no aggregate function needs to be generated
     fGC+="\n\n";
 
     // computing inplace on input graph
@@ -154,8 +159,8 @@ void RModel_GNN::Generate() {
     fGC += "Node_Update::Session node_update;\n";
     fGC += "Global_Update::Session global_update;\n\n";
 
-    std::string e_num = std::to_string(num_edges);
     std::string n_num = std::to_string(num_nodes);
+    std::string b_num = std::to_string(num_graphs);
     std::string e_size_input =  std::to_string(num_edge_features_input);
     std::string n_size_input =  std::to_string(num_node_features_input);
     std::string g_size_input =  std::to_string(num_global_features_input);
@@ -163,143 +168,229 @@ void RModel_GNN::Generate() {
     std::string n_size =  std::to_string(num_node_features);
     std::string g_size =  std::to_string(num_global_features);
 
-    // create temp vector for edge and node updates
-    fGC += "std::vector<float> fEdgeUpdates = std::vector<float>(" + e_num + "*" + e_size + ");\n";
-    fGC += "\n\nstd::vector<float> fNodeUpdates = std::vector<float>(" + n_num + "*" + n_size + ");\n";
-
-    fGC += "\n// input vectors for edge update\n";
-    fGC += "std::vector<float> fEdgeInputs = std::vector<float>(" + e_num + "*" + e_size_input + ");\n";
-    fGC += "std::vector<float> fRecNodeInputs = std::vector<float>(" + e_num + "*" + n_size_input + ");\n";
-    fGC += "std::vector<float> fSndNodeInputs = std::vector<float>(" + e_num + "*" + n_size_input + ");\n";
-    fGC += "std::vector<float> fGlobInputs = std::vector<float>(" + e_num + "*" + g_size_input + ");\n\n";
+    // the updates are left in the output tensors of the update sessions, which grow them when needed
+    fGC += "float * fEdgeUpdates = nullptr;\n";
+    fGC += "float * fNodeUpdates = nullptr;\n";
+    fGC += "float * fGlobalUpdates = nullptr;\n";
 
+    // the sizes of the generated model (num_nodes, num_edges, num_graphs) are only the initial capacities:
+    // the vectors below are grown on demand and reused by the following calls
     fGC += "\n// input vectors for node update\n";
-    fGC += "std::vector<float> fNodeInputs = std::vector<float>(" + n_num + "*" + n_size_input + ");\n";
-    fGC += "std::vector<float> fNodeEdgeAggregate = std::vector<float>(" + n_num + "*" + n_size_input + ", 0);\n";
-    fGC += "std::vector<float> fNodeAggregateTemp;\n";
-
-    fGC += "\nvoid infer(SOFIE::GNN_Data& input_graph){\n";
+    fGC += "std::vector<float> fGlobInputs = std::vector<float>(" + n_num + "*" + g_size_input + ");\n";
+    fGC += "std::vector<float> fNodeEdgeAggregate = std::vector<float>(" + n_num + "*" + e_size + ", 0);\n";
+    // CSR index of the edges sorted by receiver node, rebuilt at every infer call
+    fGC += "std::vector<size_t> fRecvOffsets;\n";
+    fGC += "std::vector<size_t> fRecvIndex;\n";
+
+    fGC += "\n// graph of each node and ranges of nodes and edges of each graph\n";
+    fGC += "std::vector<int> fNodeGraph = std::vector<int>(" + n_num + ");\n";
+    fGC += "std::vector<size_t> fNodeGraphOffsets = std::vector<size_t>(" + b_num + " + 1);\n";
+    fGC += "std::vector<size_t> fEdgeGraphOffsets = std::vector<size_t>(" + b_num + " + 1);\n";
+
+    fGC += "\n// aggregated vectors for global update (one row per graph)\n";
+    fGC += "std::vector<float> fEdgeGlobalAggregate = std::vector<float>(" + b_num + "*" + e_size + ");\n";
+    fGC += "std::vector<float> fNodeGlobalAggregate = std::vector<float>(" + b_num + "*" + n_size + ");\n";
+
+    fGC += "\n// disjoint union of a batch of graphs\n";
+    fGC += "std::vector<float> fUnionNodes;\n";
+    fGC += "std::vector<float> fUnionEdges;\n";
+    fGC += "std::vector<float> fUnionGlobals;\n";
+    fGC += "std::vector<int> fUnionEdgeIndex;\n";
+    fGC += "std::vector<SOFIE::GNN_DataView> fBatchViews;\n";
+
+    // the update and aggregation blocks run once on a graph made of n_graphs disjoint graphs, whose nodes and
+    // edges are stored graph after graph (ranges given by fNodeGraphOffsets and fEdgeGraphOffsets)
+    fGC += "\nvoid infer_graphs(size_t n_graphs, size_t n_nodes, size_t n_edges, float * node_data, float * edge_data,\n";
+    fGC += "                  float * global_data, int * receivers, int * senders) {\n";
+    fGC += "fGlobInputs.resize(n_nodes * " + g_size_input + ");\n";
+    fGC += "fNodeEdgeAggregate.resize(n_nodes * " + e_size + ");\n";
+    fGC += "fNodeGraph.resize(n_nodes);\n";
+    fGC += "fEdgeGlobalAggregate.resize(n_graphs * " + e_size + ");\n";
+    fGC += "fNodeGlobalAggregate.resize(n_graphs * " + n_size + ");\n\n";
+    // the CSR index checks also that the receivers are valid node indices
+    fGC += "SOFIE::UTILITY::BuildCSRIndex(receivers, n_edges, n_nodes, fRecvOffsets, fRecvIndex);\n";
+    fGC += "for (size_t k = 0; k < n_edges; k++) {\n";
+    fGC += "   if (senders[k] < 0 || size_t(senders[k]) >= n_nodes)\n";
+    fGC += "      throw std::runtime_error(\"Sender index of edge \" + std::to_string(k) + \" is out of range\");\n";
+    fGC += "}\n";
+    fGC += "for (size_t b = 0; b < n_graphs; b++)\n";
+    fGC += "   std::fill(fNodeGraph.begin() + fNodeGraphOffsets[b], fNodeGraph.begin() + fNodeGraphOffsets[b + 1], int(b));\n";
 
     // computing updated edge attributes
     fGC += "\n// --- Edge Update ---\n";
-    fGC +=  "size_t n_edges = input_graph.edge_data.GetShape()[0];\n";
-    fGC +=  "if (n_edges > " + e_num + ")\n";
-    fGC +=  "   throw std::runtime_error(\"Number of input edges larger than " + e_num + "\" );\n\n";
-    fGC += "auto receivers = input_graph.edge_index.GetData();\n";
-    fGC += "auto senders = input_graph.edge_index.GetData() + n_edges;\n";
-
-    fGC += "for (size_t k = 0; k < n_edges; k++) { \n";
-    fGC += "   std::copy(input_graph.edge_data.GetData() + k * " + e_size_input +
-           ", input_graph.edge_data.GetData() + (k + 1) * " + e_size_input +
-           ", fEdgeInputs.begin() + k * " + e_size_input + ");\n";
-    fGC += "   std::copy(input_graph.node_data.GetData() + receivers[k] * " + n_size_input +
-           ", input_graph.node_data.GetData() + (receivers[k] + 1) * " + n_size_input +
-           ", fRecNodeInputs.begin() + k * " + n_size_input + ");\n";
-    fGC += "   std::copy(input_graph.node_data.GetData() + senders[k] * " + n_size_input +
-           ", input_graph.node_data.GetData() + (senders[k] + 1) * " + n_size_input +
-           ", fSndNodeInputs.begin() + k * " + n_size_input + ");\n";
-    fGC += "   std::copy(input_graph.global_data.GetData()";
-    fGC += ", input_graph.global_data.GetData() + " + g_size_input +
-           ", fGlobInputs.begin() + k * " + g_size_input + ");\n";
+    // edge features are read directly from the graph and node features gathered with receivers and senders
+    fGC += edges_update_block->GenerateNoCopy({"n_edges","edge_data","n_nodes","node_data","n_graphs","global_data",
+                                               "receivers","senders","fNodeGraph.data()"}) + "\n";
+    fGC += "fEdgeUpdates = " + edges_update_block->GetOutputTensorPtr() + ";\n";
+
+    fGC += "\n// --- Node Update ---\n";
+    fGC += "for (size_t k = 0; k < n_nodes; k++)\n";
+    fGC += "   std::copy(global_data + fNodeGraph[k] * " + g_size_input + ", global_data + (fNodeGraph[k] + 1) * " +
+           g_size_input + ", fGlobInputs.begin() + k * " + g_size_input + ");\n";
+
+    // aggregate incoming edges: reduce each group of edge rows of the CSR index (edges sorted by receiver)
+    // directly in the aggregate vector (empty groups give zeros)
+    fGC += "\n// aggregate edges going to a node\n";
+    fGC += edge_node_agg_block->GenerateSegmentReduce(num_edge_features, "fEdgeUpdates", "fRecvOffsets.data()",
+                                                      "fRecvIndex.data()", "n_nodes", "fNodeEdgeAggregate.data()") + "\n";
+    // computing updated node attributes
+    fGC += nodes_update_block->GenerateNoCopy({"n_nodes","fNodeEdgeAggregate.data()","node_data","fGlobInputs.data()"}) + "\n";
+    fGC += "fNodeUpdates = " + nodes_update_block->GetOutputTensorPtr() + ";\n";
+
+    fGC += "\n// --- Global Update ---\n";
+    // aggregating edges & nodes of each graph for global update: contiguous segments of rows
+    fGC += edge_global_agg_block->GenerateSegmentReduce(num_edge_features, "fEdgeUpdates", "fEdgeGraphOffsets.data()",
+                                                        "nullptr", "n_graphs", "fEdgeGlobalAggregate.data()") + "\n";
+    fGC += node_global_agg_block->GenerateSegmentReduce(num_node_features, "fNodeUpdates", "fNodeGraphOffsets.data()",
+                                                        "nullptr", "n_graphs", "fNodeGlobalAggregate.data()") + "\n";
+    // computing updated global attributes
+    fGC += globals_update_block->GenerateNoCopy({"n_graphs","fEdgeGlobalAggregate.data()","fNodeGlobalAggregate.data()","global_data"}) + "\n";
+    fGC += "fGlobalUpdates = " + globals_update_block->GetOutputTensorPtr() + ";\n";
     fGC += "}\n";
 
-    fGC += "fEdgeUpdates = " + edges_update_block->Generate({"n_edges","fEdgeInputs.data(), fRecNodeInputs.data(), fSndNodeInputs.data(), fGlobInputs.data()"}) + "\n";
+    // write the updated features of the nodes, edges and globals of graph b of the union in the given buffers
+    fGC += "\nvoid copy_output(float * node_out, float * edge_out, float * global_out, size_t b) {\n";
+    fGC += "std::copy(fEdgeUpdates + fEdgeGraphOffsets[b] * " + e_size + ", fEdgeUpdates + fEdgeGraphOffsets[b + 1] * " +
+           e_size + ", edge_out);\n";
+    fGC += "std::copy(fNodeUpdates + fNodeGraphOffsets[b] * " + n_size + ", fNodeUpdates + fNodeGraphOffsets[b + 1] * " +
+           n_size + ", node_out);\n";
+    fGC += "std::copy(fGlobalUpdates + b * " + g_size + ", fGlobalUpdates + (b + 1) * " + g_size + ", global_out);\n";
+    fGC += "}\n";
 
+    fGC += "\nvoid copy_output(SOFIE::GNN_Data& graph, size_t b) {\n";
     if(num_edge_features != num_edge_features_input) {
-        fGC += "\n//  resize edge graph data since output feature size is not equal to input size\n";
-        fGC+="input_graph.edge_data = input_graph.edge_data.Resize({n_edges, "+e_size+"});\n";
+        fGC += "//  resize edge graph data since output feature size is not equal to input size\n";
+        fGC += "graph.edge_data = graph.edge_data.Resize({fEdgeGraphOffsets[b + 1] - fEdgeGraphOffsets[b], "+e_size+"});\n";
+    }
+    if(num_node_features != num_node_features_input) {
+        fGC += "//  resize node graph data since output feature size is not equal to input size\n";
+        fGC += "graph.node_data = graph.node_data.Resize({fNodeGraphOffsets[b + 1] - fNodeGraphOffsets[b], " + n_size + "});\n";
+    }
+    if(num_global_features != num_global_features_input) {
+        fGC += "//  resize global graph data since output feature size is not equal to input size\n";
+        fGC += "graph.global_data = graph.global_data.Resize({"+g_size+"});\n";
     }
-    // copy output
-    fGC += "\nfor (size_t k = 0; k < n_edges; k++) { \n";
-    fGC += "   std::copy(fEdgeUpdates.begin()+ k * " + e_size + ", fEdgeUpdates.begin()+ (k+1) * " + e_size +
-           ",input_graph.edge_data.GetData() + k * " + e_size + ");\n";
+    fGC += "copy_output(graph.node_data.GetData(), graph.edge_data.GetData(), graph.global_data.GetData(), b);\n";
     fGC += "}\n";
-    fGC += "\n";
 
-    fGC += "\n\n// --- Node Update ---\n";
-    fGC += "size_t n_nodes = input_graph.node_data.GetShape()[0];\n";
-    // computing updated node attributes
-    fGC += "for (size_t k = 0; k < n_nodes; k++) { \n";
-    fGC += "   std::copy(input_graph.node_data.GetData() + k * " + n_size_input +
-           ", input_graph.node_data.GetData() + (k + 1) * " + n_size_input +
-           ", fNodeInputs.begin() + k * " + n_size_input + ");\n";
-    fGC += "}\n";
-    // reset initial aggregate edge vector to zero
-    fGC += "\nstd::fill(fNodeEdgeAggregate.begin(), fNodeEdgeAggregate.end(), 0.);\n";
-    // fGlobInputs is size { n_edges, n_globals}. It needs to be here { n_nodes, n_globals}
-    // if number of nodes is larger than edges we need to resize it and copy values
-
-    fGC += "\n// resize global vector feature to number of nodes if needed\n";
-    fGC += "if (n_nodes > n_edges) {\n";
-    fGC += "   fGlobInputs.resize( n_nodes * " + std::to_string(num_global_features_input) + ");\n";
-    fGC += "   for (size_t k = n_edges; k < n_nodes; k++)\n";
-    fGC += "      std::copy(fGlobInputs.begin(), fGlobInputs.begin() + " + g_size_input +
-                   " , fGlobInputs.begin() + k * " + g_size_input + ");\n";
+    // the buffers of an output view are not resized: they must be large enough for the updated features
+    fGC += "\nvoid copy_output(SOFIE::GNN_DataView& graph, size_t b) {\n";
+    fGC += "size_t n_nodes = fNodeGraphOffsets[b + 1] - fNodeGraphOffsets[b];\n";
+    fGC += "size_t n_edges = fEdgeGraphOffsets[b + 1] - fEdgeGraphOffsets[b];\n";
+    fGC += "if (graph.node_data.size() < n_nodes * " + n_size + " || graph.edge_data.size() < n_edges * " + e_size +
+           " || graph.global_data.size() < " + g_size + ")\n";
+    fGC += "   throw std::runtime_error(\"Output graph buffers are too small for the updated features of graph \" + std::to_string(b));\n";
+    fGC += "copy_output(graph.node_data.data(), graph.edge_data.data(), graph.global_data.data(), b);\n";
+    fGC += "graph.num_nodes = n_nodes;\n";
+    fGC += "graph.num_edges = n_edges;\n";
+    fGC += "graph.num_node_features = " + n_size + ";\n";
+    fGC += "graph.num_edge_features = " + e_size + ";\n";
+    fGC += "graph.num_global_features = " + g_size + ";\n";
     fGC += "}\n";
 
-    // loop on nodes and aggregate incoming edges
-    fGC += "\n// aggregate edges going to a node\n";
-    fGC += "for (size_t j = 0; j < n_nodes; j++) {\n";
-    // approximate number of receivers/node to allocate vector
-    fGC += "   std::vector<float *> edgesData; edgesData.reserve( int(n_edges/n_nodes) +1);\n";
-    // loop on edges
-    fGC += "   for (size_t k = 0; k < n_edges; k++) {\n";
-    fGC += "      if (receivers[k] == j) \n";
-    fGC += "         edgesData.emplace_back(input_graph.edge_data.GetData() + k * " + e_size + ");\n";
-    fGC += "   }\n";
-    fGC += "   fNodeAggregateTemp = " + edge_node_agg_block->Generate(num_edge_features, "edgesData") + ";\n";
-    fGC += "   std::copy(fNodeAggregateTemp.begin(), fNodeAggregateTemp.end(), fNodeEdgeAggregate.begin() + " +
-                   e_size + " * j);\n";
-    fGC += "}\n";   // end node loop
-
-
-    fGC+="\n";
-    fGC+="fNodeUpdates = ";
-    fGC+=nodes_update_block->Generate({"n_nodes","fNodeEdgeAggregate.data()","fNodeInputs.data()","fGlobInputs.data()"});    // computing updated node attributes
-    fGC+="\n";
+    // input views must have the features of the model
+    fGC += "\nvoid check_input(const SOFIE::GNN_DataView& graph) {\n";
+    fGC += "if (graph.num_node_features != " + n_size_input + " || graph.num_edge_features != " + e_size_input +
+           " || graph.num_global_features != " + g_size_input + ")\n";
+    fGC += "   throw std::runtime_error(\"Input graph has wrong numbers of features\");\n";
+    fGC += "if (!graph.HasValidSizes())\n";
+    fGC += "   throw std::runtime_error(\"Input graph buffers are smaller than its numbers of nodes and edges\");\n";
+    fGC += "}\n";
 
-    if(num_node_features != num_node_features_input) {
-        fGC += "\n//  resize node graph data since output feature size is not equal to input size\n";
-        fGC+="input_graph.node_data = input_graph.node_data.Resize({n_nodes, " + n_size + "});\n";
-    }
-    // copy output
-    fGC += "\nfor (size_t k = 0; k < n_nodes; k++) { \n";
-    fGC += "   std::copy(fNodeUpdates.begin()+ k * " + n_size + ", fNodeUpdates.begin() + (k+1) * " + n_size +
-           ",input_graph.node_data.GetData() + k * " + n_size+ ");\n";
+    // single graph
+    fGC += "\nvoid infer(SOFIE::GNN_Data& input_graph){\n";
+    fGC += "size_t n_edges = input_graph.edge_data.GetShape()[0];\n";
+    fGC += "size_t n_nodes = input_graph.node_data.GetShape()[0];\n";
+    fGC += "fNodeGraphOffsets.resize(2);\n";
+    fGC += "fEdgeGraphOffsets.resize(2);\n";
+    fGC += "fNodeGraphOffsets[0] = 0; fNodeGraphOffsets[1] = n_nodes;\n";
+    fGC += "fEdgeGraphOffsets[0] = 0; fEdgeGraphOffsets[1] = n_edges;\n";
+    fGC += "infer_graphs(1, n_nodes, n_edges, input_graph.node_data.GetData(), input_graph.edge_data.GetData(),\n";
+    fGC += "             input_graph.global_data.GetData(), input_graph.edge_index.GetData(), input_graph.edge_index.GetData() + n_edges);\n";
+    fGC += "copy_output(input_graph, 0);\n";
     fGC += "}\n";
-    fGC += "\n";
 
-    // aggregating edges & nodes for global update
-    fGC += "std::vector<float *> allEdgesData; allEdgesData.reserve(n_edges);\n";
-    fGC += "for (size_t k = 0; k < n_edges; k++) {\n";
-    fGC += "   allEdgesData.emplace_back(input_graph.edge_data.GetData() + k * " + e_size + ");\n";
+    // single graph in caller buffers: the output view can be the input one (in-place update), since the
+    // outputs are written after all update blocks are computed. The edge index is shared with the input
+    fGC += "\nvoid infer(const SOFIE::GNN_DataView& input_graph, SOFIE::GNN_DataView& output_graph){\n";
+    fGC += "check_input(input_graph);\n";
+    fGC += "size_t n_edges = input_graph.num_edges;\n";
+    fGC += "size_t n_nodes = input_graph.num_nodes;\n";
+    fGC += "fNodeGraphOffsets.resize(2);\n";
+    fGC += "fEdgeGraphOffsets.resize(2);\n";
+    fGC += "fNodeGraphOffsets[0] = 0; fNodeGraphOffsets[1] = n_nodes;\n";
+    fGC += "fEdgeGraphOffsets[0] = 0; fEdgeGraphOffsets[1] = n_edges;\n";
+    fGC += "infer_graphs(1, n_nodes, n_edges, input_graph.node_data.data(), input_graph.edge_data.data(),\n";
+    fGC += "             input_graph.global_data.data(), input_graph.edge_index.data(), input_graph.edge_index.data() + n_edges);\n";
+    fGC += "copy_output(output_graph, 0);\n";
+    fGC += "output_graph.edge_index = input_graph.edge_index;\n";
     fGC += "}\n";
-    fGC += "std::vector<float *> allNodesData; allNodesData.reserve(n_nodes);\n";
-    fGC += "for (size_t k = 0; k < n_nodes; k++) {\n";
-    fGC += "   allNodesData.emplace_back(input_graph.node_data.GetData() + k * " + n_size + ");\n";
+    fGC += "\nvoid infer(SOFIE::GNN_DataView& graph){\n";
+    fGC += "infer(graph, graph);\n";
     fGC += "}\n";
 
+    // batch of graphs processed as their disjoint union: nodes, edges and globals are concatenated
+    // and the node indices of the edges are offset by the first node of their graph
+    fGC += "\nvoid infer_union(const std::vector<SOFIE::GNN_DataView>& input_graphs){\n";
+    fGC += "size_t n_graphs = input_graphs.size();\n";
+    fGC += "fNodeGraphOffsets.resize(n_graphs + 1);\n";
+    fGC += "fEdgeGraphOffsets.resize(n_graphs + 1);\n";
+    fGC += "fNodeGraphOffsets[0] = 0;\n";
+    fGC += "fEdgeGraphOffsets[0] = 0;\n";
+    fGC += "for (size_t b = 0; b < n_graphs; b++) {\n";
+    fGC += "   check_input(input_graphs[b]);\n";
+    fGC += "   fNodeGraphOffsets[b + 1] = fNodeGraphOffsets[b] + input_graphs[b].num_nodes;\n";
+    fGC += "   fEdgeGraphOffsets[b + 1] = fEdgeGraphOffsets[b] + input_graphs[b].num_edges;\n";
+    fGC += "}\n";
+    fGC += "size_t n_nodes = fNodeGraphOffsets[n_graphs];\n";
+    fGC += "size_t n_edges = fEdgeGraphOffsets[n_graphs];\n";
+    fGC += "fUnionNodes.resize(n_nodes * " + n_size_input + ");\n";
+    fGC += "fUnionEdges.resize(n_edges * " + e_size_input + ");\n";
+    fGC += "fUnionGlobals.resize(n_graphs * " + g_size_input + ");\n";
+    fGC += "fUnionEdgeIndex.resize(2 * n_edges);\n";
+    fGC += "for (size_t b = 0; b < n_graphs; b++) {\n";
+    fGC += "   auto & graph = input_graphs[b];\n";
+    fGC += "   size_t graph_edges = graph.num_edges;\n";
+    fGC += "   std::copy(graph.node_data.data(), graph.node_data.data() + graph.num_nodes * " + n_size_input + ", fUnionNodes.begin() + fNodeGraphOffsets[b] * " + n_size_input + ");\n";
+    fGC += "   std::copy(graph.edge_data.data(), graph.edge_data.data() + graph_edges * " + e_size_input + ", fUnionEdges.begin() + fEdgeGraphOffsets[b] * " + e_size_input + ");\n";
+    fGC += "   std::copy(graph.global_data.data(), graph.global_data.data() + " + g_size_input + ", fUnionGlobals.begin() + b * " + g_size_input + ");\n";
+    fGC += "   const int * index = graph.edge_index.data();\n";
+    fGC += "   int offset = fNodeGraphOffsets[b];\n";
+    fGC += "   int graph_nodes = graph.num_nodes;\n";
+    fGC += "   for (size_t k = 0; k < 2 * graph_edges; k++) {\n";
+    fGC += "      if (index[k] < 0 || index[k] >= graph_nodes)\n";
+    fGC += "         throw std::runtime_error(\"Edge index out of range in graph \" + std::to_string(b) + \" of the batch\");\n";
+    fGC += "   }\n";
+    fGC += "   for (size_t k = 0; k < graph_edges; k++) {\n";
+    fGC += "      fUnionEdgeIndex[fEdgeGraphOffsets[b] + k] = index[k] + offset;\n";
+    fGC += "      fUnionEdgeIndex[n_edges + fEdgeGraphOffsets[b] + k] = index[graph_edges + k] + offset;\n";
+    fGC += "   }\n";
+    fGC += "}\n";
+    fGC += "infer_graphs(n_graphs, n_nodes, n_edges, fUnionNodes.data(), fUnionEdges.data(), fUnionGlobals.data(),\n";
+    fGC += "             fUnionEdgeIndex.data(), fUnionEdgeIndex.data() + n_edges);\n";
+    fGC += "}\n";
 
-    fGC += "\n// --- Global Update ---\n";
-    fGC+="std::vector<float> Edge_Global_Aggregate = ";
-    fGC+=edge_global_agg_block->Generate(num_edge_features, "allEdgesData");     // aggregating edge attributes globally
-    fGC+=";\n";
-
-    fGC+="std::vector<float> Node_Global_Aggregate = ";
-    fGC+=node_global_agg_block->Generate(num_node_features, "allNodesData");     // aggregating node attributes globally
-    fGC+=";\n";
-
-    // computing updated global attributes
-    fGC += "std::vector<float> Global_Data = ";
-    fGC += globals_update_block->Generate({"Edge_Global_Aggregate.data()","Node_Global_Aggregate.data()", "input_graph.global_data.GetData()"});
-    if(num_global_features != num_global_features_input) {
-        fGC += "\n//  resize global graph data since output feature size is not equal to input size\n";
-        fGC+="input_graph.global_data = input_graph.global_data.Resize({"+g_size+"});\n";
-    }
-    fGC += "\nstd::copy(Global_Data.begin(), Global_Data.end(), input_graph.global_data.GetData());";
-    fGC+="\n}\n";
-    fGC+="};\n";
+    fGC += "\nvoid infer(std::vector<SOFIE::GNN_Data>& input_graphs){\n";
+    fGC += "fBatchViews.assign(input_graphs.begin(), input_graphs.end());\n";
+    fGC += "infer_union(fBatchViews);\n";
+    fGC += "// split the results back in the input graphs\n";
+    fGC += "for (size_t b = 0; b < input_graphs.size(); b++)\n";
+    fGC += "   copy_output(input_graphs[b], b);\n";
+    fGC += "}\n";
 
+    fGC += "\nvoid infer(const std::vector<SOFIE::GNN_DataView>& input_graphs, std::vector<SOFIE::GNN_DataView>& output_graphs){\n";
+    fGC += "if (output_graphs.size() != input_graphs.size())\n";
+    fGC += "   throw std::runtime_error(\"Number of output graphs different than the number of input graphs\");\n";
+    fGC += "infer_union(input_graphs);\n";
+    fGC += "for (size_t b = 0; b < input_graphs.size(); b++) {\n";
+    fGC += "   copy_output(output_graphs[b], b);\n";
+    fGC += "   output_graphs[b].edge_index = input_graphs[b].edge_index;\n";
+    fGC += "}\n";
+    fGC += "}\n";
+    fGC += "\nvoid infer(std::vector<SOFIE::GNN_DataView>& graphs){\n";
+    fGC += "infer(graphs, graphs);\n";
+    fGC += "}\n";
+    fGC += "};\n";
     fGC += ("} //SOFIE_" + fName + "\n");
     fGC += "\n#endif  // SOFIE_" + hgname + "\n";
 }
@@ -14,6 +14,7 @@ RModel_GraphIndependent::RModel_GraphIndependent(RModel_GraphIndependent&& other
 
     num_nodes = std::move(other.num_nodes);
     num_edges = std::move(other.num_edges);
+    num_threads = std::move(other.num_threads);
 
     fName = std::move(other.fName);
     fFileName = std::move(other.fFileName);
@@ -27,6 +28,7 @@ RModel_GraphIndependent& RModel_GraphIndependent::operator=(RModel_GraphIndepend
 
     num_nodes = std::move(other.num_nodes);
     num_edges = std::move(other.num_edges);
+    num_threads = std::move(other.num_threads);
 
     fName = std::move(other.fName);
     fFileName = std::move(other.fFileName);
@@ -45,6 +47,7 @@ RModel_GraphIndependent::RModel_GraphIndependent(GraphIndependent_Init& graph_in
     num_node_features = graph_input_struct.num_node_features;
     num_edge_features = graph_input_struct.num_edge_features;
     num_global_features = graph_input_struct.num_global_features;
+    num_threads = std::max<std::size_t>(1, graph_input_struct.num_threads);
 
     fFileName = graph_input_struct.filename;
     fName = fFileName.substr(0, fFileName.rfind("."));
@@ -130,104 +133,207 @@ void RModel_GraphIndependent::Generate() {
     }
 
 
+    std::string e_size_input = std::to_string(num_edge_features_input);
+    std::string n_size_input = std::to_string(num_node_features_input);
+    std::string g_size_input = std::to_string(num_global_features_input);
+    std::string e_size = std::to_string(num_edge_features);
+    std::string n_size = std::to_string(num_node_features);
+    std::string g_size = std::to_string(num_global_features);
+
     // computing inplace on input graph
     fGC += "struct Session {\n";
     fGC += "\n// Instantiating session objects for graph components\n";
-    // create session classes and corresponding temporary vectors
-    if (edges_update_block) {
-       fGC += "Edge_Update::Session edge_update;\n";
-       // this we can remove when we support full dynamic edges and nodes
-       fGC += "std::vector<float> fEdgeInputs = std::vector<float>(" + std::to_string(num_edges) + "*" + std::to_string(num_edge_features_input) + ");\n";
-       //fGC += "std::vector<float> fEdgeUpdates {" + std::to_string(num_edges) + "*" + std::to_string(num_edge_features) + "};";
-    }
-    if (nodes_update_block) {
-       fGC += "Node_Update::Session node_update;\n";
-       fGC += "std::vector<float> fNodeInputs = std::vector<float>(" + std::to_string(num_nodes) + "*" + std::to_string(num_node_features_input) + ");\n";
-       //fGC += "std::vector<float> fNodeUpdates {" + std::to_string(num_nodes) + "*" + std::to_string(num_node_features) + "};";
+    bool parallel = num_threads > 1;
+    // create session classes, the updates are left in their output tensors
+    if (parallel) {
+       // with several threads the edge and node blocks have one session per thread, each one processing a range
+       // of rows, so that the intermediate tensors are not shared between threads
+       if (edges_update_block) {
+          fGC += "std::vector<std::unique_ptr<Edge_Update::Session>> fEdgeSessions;\n";
+          fGC += "std::vector<size_t> fEdgeRanges;\n";
+       }
+       if (nodes_update_block) {
+          fGC += "std::vector<std::unique_ptr<Node_Update::Session>> fNodeSessions;\n";
+          fGC += "std::vector<size_t> fNodeRanges;\n";
+       }
+    } else {
+       if (edges_update_block) {
+          // the update sessions read the graph data directly and grow their tensors with the number of edges and nodes
+          fGC += "Edge_Update::Session edge_update;\n";
+          fGC += "const float * fEdgeUpdates = nullptr;\n";
+       }
+       if (nodes_update_block) {
+          fGC += "Node_Update::Session node_update;\n";
+          fGC += "const float * fNodeUpdates = nullptr;\n";
+       }
     }
     if (globals_update_block) {
-      fGC += "Global_Update::Session global_update;\n\n";
-      //fGC += "std::vector<float> fGlobalUpdates {" + std::to_string(num_global_features) + "};";
+       fGC += "Global_Update::Session global_update;\n";
+       fGC += "const float * fGlobalUpdates = nullptr;\n";
     }
 
-    fGC += "\nvoid infer(SOFIE::GNN_Data& input_graph){\n";
-
-    // computing updated edge attributes
-    // could use std::span
-    if (edges_update_block) {
-       fGC += "\n// --- Edge Update ---\n";
-
-       std::string e_size_input = std::to_string(num_edge_features_input);
-       fGC += "size_t n_edges = input_graph.edge_data.GetShape()[0];\n";
-       fGC += "for (size_t k = 0; k < n_edges; k++) { \n";
-       fGC += "   std::copy(input_graph.edge_data.GetData() + k * " + e_size_input +
-              ", input_graph.edge_data.GetData() + (k + 1) * " + e_size_input + ", fEdgeInputs.begin() + k * " +
-              e_size_input + ");\n";
+    if (parallel) {
+       // the weights are read once by the first session and shared (read-only) by the sessions of the other threads,
+       // which have only their own intermediate tensors
+       fGC += "\nSession(size_t n_threads = " + std::to_string(num_threads) + ") {\n";
+       if (edges_update_block)
+          fGC += "fEdgeSessions.emplace_back(new Edge_Update::Session());\n";
+       if (nodes_update_block)
+          fGC += "fNodeSessions.emplace_back(new Node_Update::Session());\n";
+       fGC += "for (size_t t = 1; t < n_threads; t++) {\n";
+       if (edges_update_block)
+          fGC += "   fEdgeSessions.emplace_back(new Edge_Update::Session(*fEdgeSessions[0], " + std::to_string(num_edges) +
+                 "));\n";
+       if (nodes_update_block)
+          fGC += "   fNodeSessions.emplace_back(new Node_Update::Session(*fNodeSessions[0], " + std::to_string(num_nodes) +
+                 "));\n";
        fGC += "}\n";
-
-       fGC += "auto edgeUpdates = " + edges_update_block->Generate({"n_edges","fEdgeInputs.data()"}) + "\n";
-
-       if (num_edge_features != num_edge_features_input) {
-          fGC += "\n//  resize edge graph data since output feature size is not equal to input size\n";
-          fGC += "input_graph.edge_data = input_graph.edge_data.Resize({ n_edges, " +
-                 std::to_string(num_edge_features) + "});\n";
-       }
-       // copy output
-       fGC += "\nfor (size_t k = 0; k < n_edges; k++) { \n";
-       fGC += "   std::copy(edgeUpdates.begin()+ k * " + std::to_string(num_edge_features) +
-              ", edgeUpdates.begin()+ (k+1) * " + std::to_string(num_edge_features) +
-              ",input_graph.edge_data.GetData() + k * " + std::to_string(num_edge_features) + ");\n";
        fGC += "}\n";
-       fGC += "\n";
     }
 
-    // computing updated node attributes
-    if (nodes_update_block) {
-       std::string n_size_input = std::to_string(num_node_features_input);
-       fGC += "\n// --- Node Update ---\n";
-       fGC += "size_t n_nodes = input_graph.node_data.GetShape()[0];\n";
-       fGC += "for (size_t k = 0; k < n_nodes; k++) { \n";
-       fGC += "   std::copy(input_graph.node_data.GetData() + k * " + n_size_input +
-              ", input_graph.node_data.GetData() + (k + 1) * " + n_size_input + ", fNodeInputs.begin() + k * " +
-              n_size_input + ");\n";
+    // run the update blocks independently on the edges, nodes and globals of the graph
+    fGC += "\nvoid infer_updates(const SOFIE::GNN_DataView& input_graph){\n";
+    if (parallel) {
+       // minimum number of rows processed by a thread, smaller graphs are not split
+       std::string minRows = "512";
+       if (edges_update_block)
+          fGC += "SOFIE::UTILITY::PartitionRows(input_graph.num_edges, fEdgeSessions.size(), " + minRows + ", fEdgeRanges);\n";
+       if (nodes_update_block)
+          fGC += "SOFIE::UTILITY::PartitionRows(input_graph.num_nodes, fNodeSessions.size(), " + minRows + ", fNodeRanges);\n";
+       // all the row ranges of the edge and node blocks and the global block are independent tasks. The code
+       // must be compiled with OpenMP (e.g. -fopenmp), otherwise the pragmas are ignored and the tasks run in sequence
+       fGC += "// the tasks run concurrently only when compiling with OpenMP (e.g. -fopenmp)\n";
+       fGC += "#pragma omp parallel\n";
+       fGC += "#pragma omp single\n";
+       fGC += "{\n";
+       if (edges_update_block) {
+          fGC += "// --- Edge Update ---\n";
+          fGC += "for (size_t c = 0; c + 1 < fEdgeRanges.size(); c++) {\n";
+          fGC += "#pragma omp task firstprivate(c)\n";
+          fGC += "   " + edges_update_block->GenerateNoCopy({"fEdgeRanges[c + 1] - fEdgeRanges[c]",
+                 "input_graph.edge_data.data() + fEdgeRanges[c] * " + e_size_input}, "fEdgeSessions[c]->") + "\n";
+          fGC += "}\n";
+       }
+       if (nodes_update_block) {
+          fGC += "// --- Node Update ---\n";
+          fGC += "for (size_t c = 0; c + 1 < fNodeRanges.size(); c++) {\n";
+          fGC += "#pragma omp task firstprivate(c)\n";
+          fGC += "   " + nodes_update_block->GenerateNoCopy({"fNodeRanges[c + 1] - fNodeRanges[c]",
+                 "input_graph.node_data.data() + fNodeRanges[c] * " + n_size_input}, "fNodeSessions[c]->") + "\n";
+          fGC += "}\n";
+       }
+       if (globals_update_block) {
+          fGC += "// --- Global Update ---\n";
+          fGC += "#pragma omp task\n";
+          fGC += globals_update_block->GenerateNoCopy({"input_graph.global_data.data()"}) + "\n";
+       }
        fGC += "}\n";
+    } else {
+       if (edges_update_block) {
+          fGC += "// --- Edge Update ---\n";
+          fGC += edges_update_block->GenerateNoCopy({"input_graph.num_edges","input_graph.edge_data.data()"}) + "\n";
+          fGC += "fEdgeUpdates = " + edges_update_block->GetOutputTensorPtr() + ";\n";
+       }
+       if (nodes_update_block) {
+          fGC += "// --- Node Update ---\n";
+          fGC += nodes_update_block->GenerateNoCopy({"input_graph.num_nodes","input_graph.node_data.data()"}) + "\n";
+          fGC += "fNodeUpdates = " + nodes_update_block->GetOutputTensorPtr() + ";\n";
+       }
+       if (globals_update_block) {
+          fGC += "// --- Global Update ---\n";
+          fGC += globals_update_block->GenerateNoCopy({"input_graph.global_data.data()"}) + "\n";
+       }
+    }
+    if (globals_update_block)
+       fGC += "fGlobalUpdates = " + globals_update_block->GetOutputTensorPtr() + ";\n";
+    fGC += "}\n";
+
+    // code copying the updated edges and nodes, gathering the row ranges of the thread sessions
+    auto copyUpdates = [&](RFunction_Update & block, const std::string & sessions, const std::string & ranges,
+                           const std::string & updates, const std::string & num, const std::string & size,
+                           const std::string & out) {
+       if (!parallel)
+          return "std::copy(" + updates + ", " + updates + " + " + num + " * " + size + ", " + out + ");\n";
+       std::string code = "for (size_t c = 0; c + 1 < " + ranges + ".size(); c++) {\n";
+       code += "   const float * updates = " + block.GetOutputTensorPtr(sessions + "[c]->") + ";\n";
+       code += "   std::copy(updates, updates + (" + ranges + "[c + 1] - " + ranges + "[c]) * " + size + ", " + out + " + " +
+               ranges + "[c] * " + size + ");\n";
+       code += "}\n";
+       return code;
+    };
 
-       fGC += "auto nodeUpdates = ";
-       fGC += nodes_update_block->Generate({"n_nodes","fNodeInputs.data()"}); // computing updated node attributes
-       fGC += "\n";
-
+    fGC += "\nvoid infer(SOFIE::GNN_Data& input_graph){\n";
+    fGC += "SOFIE::GNN_DataView view(input_graph);\n";
+    fGC += "infer_updates(view);\n";
+    if (edges_update_block) {
+       if (num_edge_features != num_edge_features_input) {
+          fGC += "//  resize edge graph data since output feature size is not equal to input size\n";
+          fGC += "input_graph.edge_data = input_graph.edge_data.Resize({ view.num_edges, " + e_size + "});\n";
+       }
+       fGC += copyUpdates(*edges_update_block, "fEdgeSessions", "fEdgeRanges", "fEdgeUpdates", "view.num_edges", e_size,
+                          "input_graph.edge_data.GetData()");
+    }
+    if (nodes_update_block) {
        if (num_node_features != num_node_features_input) {
-          fGC += "\n//  resize node graph data since output feature size is not equal to input size\n";
-          fGC += "input_graph.node_data = input_graph.node_data.Resize({ n_nodes, " +
-                 std::to_string(num_node_features) + "});\n";
-       }
-       // copy output
-       fGC += "\nfor (size_t k = 0; k < n_nodes; k++) { \n";
-       fGC += "   std::copy(nodeUpdates.begin()+ k * " + std::to_string(num_node_features) +
-              ", nodeUpdates.begin() + (k+1) * " + std::to_string(num_node_features) +
-              ",input_graph.node_data.GetData() + k * " + std::to_string(num_node_features) + ");\n";
-       fGC += "}\n";
-       fGC += "\n";
+          fGC += "//  resize node graph data since output feature size is not equal to input size\n";
+          fGC += "input_graph.node_data = input_graph.node_data.Resize({ view.num_nodes, " + n_size + "});\n";
+       }
+       fGC += copyUpdates(*nodes_update_block, "fNodeSessions", "fNodeRanges", "fNodeUpdates", "view.num_nodes", n_size,
+                          "input_graph.node_data.GetData()");
     }
-
-    // computing updated global attributes
     if (globals_update_block) {
-       fGC += "\n// --- Global Update ---\n";
-       fGC += "std::vector<float> Global_Data = ";
-       fGC += globals_update_block->Generate({"input_graph.global_data.GetData()"});
-       fGC += "\n";
-
        if (num_global_features != num_global_features_input) {
-          fGC += "\n//  resize global graph data since output feature size is not equal to input size\n";
-          fGC += "input_graph.global_data = input_graph.global_data.Resize({" + std::to_string(num_global_features) +
-                 "});\n";
+          fGC += "//  resize global graph data since output feature size is not equal to input size\n";
+          fGC += "input_graph.global_data = input_graph.global_data.Resize({" + g_size + "});\n";
        }
-
-       fGC += "\nstd::copy(Global_Data.begin(), Global_Data.end(), input_graph.global_data.GetData());";
-       fGC += "\n";
+       fGC += "std::copy(fGlobalUpdates, fGlobalUpdates + " + g_size + ", input_graph.global_data.GetData());\n";
     }
-
-    fGC += ("}\n};\n} //SOFIE_" + fName + "\n");
+    fGC += "}\n";
+
+    // graph in caller buffers: the output view can be the input one (in-place update) since the outputs
+    // are written after all update blocks are computed. Features without update block are passed through
+    auto copyFeatures = [&](const std::string & data, const std::string & num, const std::string & size,
+                            const std::string & updatedCode) {
+       if (!updatedCode.empty()) {
+          fGC += updatedCode;
+       } else {
+          fGC += "if (output_graph." + data + ".data() != input_graph." + data + ".data())\n";
+          fGC += "   std::copy(input_graph." + data + ".data(), input_graph." + data + ".data() + " + num + " * " + size +
+                 ", output_graph." + data + ".data());\n";
+       }
+    };
+    fGC += "\nvoid infer(const SOFIE::GNN_DataView& input_graph, SOFIE::GNN_DataView& output_graph){\n";
+    fGC += "if (input_graph.num_node_features != " + n_size_input + " || input_graph.num_edge_features != " + e_size_input +
+           " || input_graph.num_global_features != " + g_size_input + ")\n";
+    fGC += "   throw std::runtime_error(\"Input graph has wrong numbers of features\");\n";
+    fGC += "if (!input_graph.HasValidSizes())\n";
+    fGC += "   throw std::runtime_error(\"Input graph buffers are smaller than its numbers of nodes and edges\");\n";
+    fGC += "size_t n_edges = input_graph.num_edges;\n";
+    fGC += "size_t n_nodes = input_graph.num_nodes;\n";
+    fGC += "if (output_graph.node_data.size() < n_nodes * " + n_size + " || output_graph.edge_data.size() < n_edges * " + e_size +
+           " || output_graph.global_data.size() < " + g_size + ")\n";
+    fGC += "   throw std::runtime_error(\"Output graph buffers are too small for the updated features\");\n";
+    fGC += "infer_updates(input_graph);\n";
+    copyFeatures("edge_data", "n_edges", e_size, !edges_update_block ? "" :
+                 copyUpdates(*edges_update_block, "fEdgeSessions", "fEdgeRanges", "fEdgeUpdates", "n_edges", e_size,
+                             "output_graph.edge_data.data()"));
+    copyFeatures("node_data", "n_nodes", n_size, !nodes_update_block ? "" :
+                 copyUpdates(*nodes_update_block, "fNodeSessions", "fNodeRanges", "fNodeUpdates", "n_nodes", n_size,
+                             "output_graph.node_data.data()"));
+    copyFeatures("global_data", "1", g_size, !globals_update_block ? "" :
+                 "std::copy(fGlobalUpdates, fGlobalUpdates + " + g_size + ", output_graph.global_data.data());\n");
+    fGC += "output_graph.num_nodes = n_nodes;\n";
+    fGC += "output_graph.num_edges = n_edges;\n";
+    fGC += "output_graph.num_node_features = " + n_size + ";\n";
+    fGC += "output_graph.num_edge_features = " + e_size + ";\n";
+    fGC += "output_graph.num_global_features = " + g_size + ";\n";
+    fGC += "output_graph.edge_index = input_graph.edge_index;\n";
+    fGC += "}\n";
+    fGC += "\nvoid infer(SOFIE::GNN_DataView& graph){\n";
+    fGC += "infer(graph, graph);\n";
+    fGC += "}\n";
+
+    fGC += ("};\n} //SOFIE_" + fName + "\n");
     fGC += "\n#endif  // SOFIE_" + hgname + "\n";
 
 }
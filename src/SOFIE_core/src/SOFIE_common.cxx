@@ -128,6 +128,34 @@ std::string ConvertDynamicShapeToString(std::vector<Dim> shape) {
    return out.str();
 }
 
+std::string ConvertBytesToStringLiteral(size_t n, const char * data) {
+   std::string ret;
+   ret.reserve(4 * n + n / 32 + 4);
+   ret += "\"";
+   size_t lineLength = 0;
+   for (size_t i = 0; i < n; i++) {
+      unsigned char c = data[i];
+      // printable characters are written as they are, all the others as 3-digit octal escapes
+      // (which, unlike hexadecimal ones, cannot be continued by the following character)
+      if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') {
+         ret += c;
+         lineLength += 1;
+      } else {
+         ret += '\\';
+         ret += char('0' + (c >> 6));
+         ret += char('0' + ((c >> 3) & 7));
+         ret += char('0' + (c & 7));
+         lineLength += 4;
+      }
+      if (lineLength >= 120 && i < n - 1) {
+         ret += "\"\n\"";
+         lineLength = 0;
+      }
+   }
+   ret += "\"";
+   return ret;
+}
+
 std::string ConvertDynamicShapeToLength(std::vector<Dim> shape) {
    // convert generic shape to a string
    // multiply all the integer specified dimensions of the shape
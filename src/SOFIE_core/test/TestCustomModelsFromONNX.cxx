@@ -176,6 +176,11 @@
 #include "Softmax4d_FromONNX.hxx"
 #include "input_models/references/Softmax4d.ref.hxx"
 
+#include "LogSoftmax_FromONNX.hxx"
+#include "input_models/references/LogSoftmax.ref.hxx"
+
+#include "ExternalData_FromONNX.hxx"
+
 #include "ConvTranspose1d_FromONNX.hxx"
 #include "input_models/references/ConvTranspose1d.ref.hxx"
 
@@ -2044,6 +2049,46 @@ TEST(ONNX, Softmax4d)
    }
 }
 
+TEST(ONNX, LogSoftmax)
+{
+   constexpr float TOLERANCE = DEFAULT_TOLERANCE;
+
+   std::vector<float> input({
+        -0.5869, -1.4272, -0.1546,  0.0096,  0.1706,  0.0388, -0.3484, -0.7829,
+         1.1138, -0.5644, -0.6264, -1.1890,  1.6741, -0.7130,  0.9592,  1.7477,
+        -0.4775,  1.3407, -0.3882, -0.4560,  1.0385, -0.1669,  0.5540, -1.0790,
+        -0.6153, -0.6274, -1.2304, -0.6757,  1.0178, -0.2379, -0.7912, -0.0165,
+        -0.5423,  0.1459,  1.3585, -0.5005, -0.2187, -1.8181, -0.6642,  0.0287,
+        -1.9103,  0.7984, -0.7860,  1.5134,  1.3873, -0.6462, -0.6354, -0.1335});
+   SOFIE_LogSoftmax::Session s("LogSoftmax_FromONNX.dat");
+   std::vector<float> output(s.infer(input.data()));
+
+   EXPECT_EQ(output.size(), sizeof(LogSoftmax_ExpectedOutput::output) / sizeof(float));
+
+   float *correct = LogSoftmax_ExpectedOutput::output;
+
+   // Checking every output value, one by one
+   for (size_t i = 0; i < output.size(); ++i) {
+      EXPECT_LE(std::abs(output[i] - correct[i]), TOLERANCE);
+   }
+}
+
+TEST(ONNX, ExternalData)
+{
+   constexpr float TOLERANCE = DEFAULT_TOLERANCE;
+
+   // weights of MatMul and bias of Add are read from the external data file ExternalData.data
+   std::vector<float> input({1., 0., -1., 2., 1., 0.5});
+   SOFIE_ExternalData::Session s("ExternalData_FromONNX.dat");
+   std::vector<float> output(s.infer(input.data()));
+
+   std::vector<float> correct({-3.5, -5., 8., 10.});
+   EXPECT_EQ(output.size(), correct.size());
+   for (size_t i = 0; i < output.size(); ++i) {
+      EXPECT_LE(std::abs(output[i] - correct[i]), TOLERANCE);
+   }
+}
+
 TEST(ONNX, ConvTranspose1d)
 {
    constexpr float TOLERANCE = DEFAULT_TOLERANCE;
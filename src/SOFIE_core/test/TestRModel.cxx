@@ -0,0 +1,1152 @@
+// Tests of the code generation options and of the graph optimizations of RModel.
+// The models are built in memory, compiled with RModelCompiler and compared with reference computations
+// or with the same models generated without the option or the optimization under test.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "SOFIE/RModel.hxx"
+#include "SOFIE/RInterpreter.hxx"
+#include "SOFIE/RModelCompiler.hxx"
+#include "SOFIE/RModelParser_ONNX.hxx"
+#include "SOFIE/RModel_GraphIndependent.hxx"
+#include "SOFIE/FunctionList.hxx"
+#include "SOFIE/ROperator_BasicBinary.hxx"
+#include "SOFIE/ROperator_BatchNormalization.hxx"
+#include "SOFIE/ROperator_Conv.hxx"
+#include "SOFIE/ROperator_ConvTranspose.hxx"
+#include "SOFIE/ROperator_Einsum.hxx"
+#include "SOFIE/ROperator_FusedMLP.hxx"
+#include "SOFIE/ROperator_GRU.hxx"
+#include "SOFIE/ROperator_Gemm.hxx"
+#include "SOFIE/ROperator_LSTM.hxx"
+#include "SOFIE/ROperator_Pool.hxx"
+#include "SOFIE/ROperator_RNN.hxx"
+#include "SOFIE/ROperator_Relu.hxx"
+#include "SOFIE/ROperator_Reshape.hxx"
+#include "SOFIE/ROperator_Softmax.hxx"
+#include "SOFIE/ROperator_Tanh.hxx"
+#include "SOFIE/ROperator_Transpose.hxx"
+
+#include "onnx_proto3.pb.h"
+
+#include "gtest/gtest.h"
+
+using namespace SOFIE;
+
+namespace {
+
+const std::string kCacheDirectory = "sofie_test_cache";
+
+std::vector<float> RandomVector(size_t n, unsigned int seed)
+{
+   std::mt19937 generator(seed);
+   std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+   std::vector<float> v(n);
+   for (auto &x : v)
+      x = uniform(generator);
+   return v;
+}
+
+void AddWeight(RModel &model, const std::string &name, const std::vector<size_t> &shape, std::vector<float> data)
+{
+   model.AddInitializedTensor<float>(name, shape, data.data());
+}
+
+// run one inference of a compiled model with float inputs and outputs
+std::vector<std::vector<float>> Infer(RCompiledModel &compiled, const std::vector<std::vector<float>> &inputs)
+{
+   std::vector<const void *> inputData;
+   for (auto &x : inputs)
+      inputData.push_back(x.data());
+   std::vector<std::vector<float>> outputs(compiled.GetNumOutputs());
+   std::vector<void *> outputData;
+   for (size_t i = 0; i < outputs.size(); i++) {
+      outputs[i].resize(ConvertShapeToLength(compiled.GetOutputShape(i)));
+      outputData.push_back(outputs[i].data());
+   }
+   compiled.Infer(inputData, outputData);
+   return outputs;
+}
+
+// compile the model (generated with the given additional options) and run one inference
+std::vector<std::vector<float>> RunCompiled(RModel &model, const std::vector<std::vector<float>> &inputs,
+                                            std::underlying_type_t<Options> options = 0)
+{
+   RModelCompiler compiler(kCacheDirectory);
+   RCompiledModel compiled(compiler.Compile(model, -1, options));
+   return Infer(compiled, inputs);
+}
+
+void ExpectNear(const std::vector<float> &result, const std::vector<float> &reference, float tolerance = 1.E-4)
+{
+   ASSERT_EQ(result.size(), reference.size());
+   for (size_t i = 0; i < result.size(); i++)
+      EXPECT_NEAR(result[i], reference[i], tolerance * std::max(1.f, std::abs(reference[i]))) << " at index " << i;
+}
+
+// the code without the first line, which contains the parsing time
+std::string CodeBody(const std::string &code)
+{
+   return code.substr(code.find('\n') + 1);
+}
+
+// model with a single recurrent operator ("RNN", "GRU" or "LSTM") returning the hidden states Y
+void BuildRecurrentModel(RModel &model, const std::string &type, size_t seqLength)
+{
+   const size_t batch = 2, inputSize = 3, hidden = 4;
+   const size_t gates = (type == "RNN") ? 1 : ((type == "GRU") ? 3 : 4);
+   model.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{seqLength, batch, inputSize});
+   model.AddInputTensorName("X");
+   AddWeight(model, "W", {1, gates * hidden, inputSize}, RandomVector(gates * hidden * inputSize, 11));
+   AddWeight(model, "R", {1, gates * hidden, hidden}, RandomVector(gates * hidden * hidden, 12));
+   AddWeight(model, "B", {1, 2 * gates * hidden}, RandomVector(2 * gates * hidden, 13));
+   if (type == "RNN")
+      model.AddOperator(std::make_unique<ROperator_RNN<float>>(std::vector<float>{}, std::vector<float>{},
+                                                               std::vector<std::string>{}, 0., "forward", hidden,
+                                                               0, "X", "W", "R", "B", "", "", "Y", ""));
+   else if (type == "GRU")
+      model.AddOperator(std::make_unique<ROperator_GRU<float>>(std::vector<float>{}, std::vector<float>{},
+                                                               std::vector<std::string>{}, 0., "forward", hidden,
+                                                               0, 0, "X", "W", "R", "B", "", "", "Y", ""));
+   else
+      model.AddOperator(std::make_unique<ROperator_LSTM<float>>(std::vector<float>{}, std::vector<float>{},
+                                                                std::vector<std::string>{}, 0., "forward", hidden,
+                                                                0, 0, "X", "W", "R", "B", "", "", "", "", "Y", "",
+                                                                ""));
+   model.AddOutputTensorNameList({"Y"});
+}
+
+// reference einsum looping on all the values of the labels
+std::vector<float> NaiveEinsum(const std::vector<std::string> &inputLabels, const std::string &outputLabels,
+                               std::map<char, size_t> dims, const std::vector<std::vector<float>> &inputs)
+{
+   std::string labels;
+   for (auto &tensorLabels : inputLabels)
+      for (char l : tensorLabels)
+         if (labels.find(l) == std::string::npos)
+            labels += l;
+   auto offset = [&](const std::string &tensorLabels, const std::map<char, size_t> &index) {
+      size_t o = 0;
+      for (char l : tensorLabels)
+         o = o * dims[l] + index.at(l);
+      return o;
+   };
+   size_t outputLength = 1;
+   for (char l : outputLabels)
+      outputLength *= dims[l];
+   std::vector<float> output(outputLength, 0.f);
+   std::map<char, size_t> index;
+   for (char l : labels)
+      index[l] = 0;
+   while (true) {
+      float product = 1.f;
+      for (size_t i = 0; i < inputs.size(); i++)
+         product *= inputs[i][offset(inputLabels[i], index)];
+      output[offset(outputLabels, index)] += product;
+      size_t d = labels.size();
+      while (d-- > 0) {
+         if (++index[labels[d]] < dims[labels[d]])
+            break;
+         index[labels[d]] = 0;
+      }
+      if (d == std::string::npos)
+         break;
+   }
+   return output;
+}
+
+// reference 2d convolution (symmetric padding) of x {n, c, h, w} with the filters w {m, c / group, kh, kw}
+std::vector<float> NaiveConv2d(const std::vector<float> &x, const std::vector<size_t> &shapeX, const std::vector<float> &w,
+                               const std::vector<size_t> &shapeW, const std::vector<float> &b, size_t group,
+                               std::vector<size_t> pads, std::vector<size_t> strides, std::vector<size_t> dilations,
+                               std::vector<size_t> &shapeY)
+{
+   const size_t n = shapeX[0], c = shapeX[1], h = shapeX[2], wd = shapeX[3];
+   const size_t m = shapeW[0], cg = shapeW[1], kh = shapeW[2], kw = shapeW[3];
+   const size_t oh = (h + 2 * pads[0] - dilations[0] * (kh - 1) - 1) / strides[0] + 1;
+   const size_t ow = (wd + 2 * pads[1] - dilations[1] * (kw - 1) - 1) / strides[1] + 1;
+   shapeY = {n, m, oh, ow};
+   std::vector<float> y(n * m * oh * ow);
+   for (size_t in = 0; in < n; in++) {
+      for (size_t om = 0; om < m; om++) {
+         size_t g = om / (m / group);
+         for (size_t oy = 0; oy < oh; oy++) {
+            for (size_t ox = 0; ox < ow; ox++) {
+               float sum = b.empty() ? 0.f : b[om];
+               for (size_t ic = 0; ic < cg; ic++) {
+                  for (size_t ky = 0; ky < kh; ky++) {
+                     for (size_t kx = 0; kx < kw; kx++) {
+                        long iy = long(oy * strides[0] + ky * dilations[0]) - long(pads[0]);
+                        long ix = long(ox * strides[1] + kx * dilations[1]) - long(pads[1]);
+                        if (iy < 0 || ix < 0 || iy >= long(h) || ix >= long(wd))
+                           continue;
+                        sum += x[((in * c + g * cg + ic) * h + iy) * wd + ix] * w[((om * cg + ic) * kh + ky) * kw + kx];
+                     }
+                  }
+               }
+               y[((in * m + om) * oh + oy) * ow + ox] = sum;
+            }
+         }
+      }
+   }
+   return y;
+}
+
+// reference 2d transposed convolution of x {n, c, h, w} with the filters w {c, m / group, kh, kw}, with the paddings
+// {top, left, bottom, right} removed from the borders of the output and the output paddings added at the end
+std::vector<float> NaiveConvTranspose2d(const std::vector<float> &x, const std::vector<size_t> &shapeX,
+                                        const std::vector<float> &w, const std::vector<size_t> &shapeW,
+                                        const std::vector<float> &b, size_t group, std::vector<size_t> pads,
+                                        std::vector<size_t> strides, std::vector<size_t> dilations,
+                                        std::vector<size_t> outputPadding, std::vector<size_t> &shapeY)
+{
+   const size_t n = shapeX[0], c = shapeX[1], h = shapeX[2], wd = shapeX[3];
+   const size_t cg = c / group, mg = shapeW[1], m = mg * group, kh = shapeW[2], kw = shapeW[3];
+   const size_t oh = strides[0] * (h - 1) + outputPadding[0] + dilations[0] * (kh - 1) + 1 - pads[0] - pads[2];
+   const size_t ow = strides[1] * (wd - 1) + outputPadding[1] + dilations[1] * (kw - 1) + 1 - pads[1] - pads[3];
+   shapeY = {n, m, oh, ow};
+   std::vector<float> y(n * m * oh * ow);
+   for (size_t in = 0; in < n; in++) {
+      for (size_t om = 0; om < m; om++) {
+         for (size_t i = 0; i < oh * ow; i++)
+            y[(in * m + om) * oh * ow + i] = b.empty() ? 0.f : b[om];
+      }
+      for (size_t ic = 0; ic < c; ic++) {
+         size_t g = ic / cg;
+         for (size_t iy = 0; iy < h; iy++) {
+            for (size_t ix = 0; ix < wd; ix++) {
+               float v = x[((in * c + ic) * h + iy) * wd + ix];
+               for (size_t om = 0; om < mg; om++) {
+                  for (size_t ky = 0; ky < kh; ky++) {
+                     for (size_t kx = 0; kx < kw; kx++) {
+                        long oy = long(iy * strides[0] + ky * dilations[0]) - long(pads[0]);
+                        long ox = long(ix * strides[1] + kx * dilations[1]) - long(pads[1]);
+                        if (oy < 0 || ox < 0 || oy >= long(oh) || ox >= long(ow))
+                           continue;
+                        y[((in * m + g * mg + om) * oh + oy) * ow + ox] += v * w[((ic * mg + om) * kh + ky) * kw + kx];
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+   return y;
+}
+
+} // namespace
+
+TEST(RModelCompiler, CompileLoadAndRun)
+{
+   // more than 100 weights, which are embedded as raw bytes in the library
+   const size_t batch = 3, n = 30, m = 4;
+   auto buildModel = [&](RModel &model, const std::vector<float> &w, const std::vector<float> &b) {
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{batch, n});
+      model.AddInputTensorName("X");
+      AddWeight(model, "W", {m, n}, w);
+      AddWeight(model, "B", {m}, b);
+      model.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "X", "W", "B", "H"));
+      model.AddOperator(std::make_unique<ROperator_Relu<float>>("H", "Y"));
+      model.AddOutputTensorNameList({"Y"});
+   };
+   auto computeReference = [&](const std::vector<float> &x, const std::vector<float> &w, const std::vector<float> &b) {
+      std::vector<float> reference(batch * m);
+      for (size_t i = 0; i < batch; i++) {
+         for (size_t j = 0; j < m; j++) {
+            float sum = b[j];
+            for (size_t k = 0; k < n; k++)
+               sum += x[i * n + k] * w[j * n + k];
+            reference[i * m + j] = std::max(sum, 0.f);
+         }
+      }
+      return reference;
+   };
+   auto w = RandomVector(m * n, 1);
+   auto b = RandomVector(m, 2);
+   RModel model("CompiledGemm.onnx", "");
+   buildModel(model, w, b);
+
+   model.Generate();
+   std::string code = model.ReturnGenerated();
+
+   auto x = RandomVector(batch * n, 3);
+   auto y = RunCompiled(model, {x});
+   auto reference = computeReference(x, w, b);
+   ASSERT_EQ(y.size(), 1u);
+   ExpectNear(y[0], reference);
+
+   // the compilation does not change the code and the options of the model
+   EXPECT_EQ(model.ReturnGenerated(), code);
+   model.Generate();
+   EXPECT_EQ(CodeBody(model.ReturnGenerated()), CodeBody(code));
+   EXPECT_EQ(code.find("sofie_infer"), std::string::npos);
+
+   // two versions of the model (with other weights) loaded at the same time use their own weights
+   auto w2 = RandomVector(m * n, 4);
+   auto b2 = RandomVector(m, 5);
+   RModel model2("CompiledGemm.onnx", "");
+   buildModel(model2, w2, b2);
+   RModelCompiler compiler(kCacheDirectory);
+   RCompiledModel compiled(compiler.Compile(model));
+   RCompiledModel compiled2(compiler.Compile(model2));
+   auto y2 = Infer(compiled2, {x});
+   y = Infer(compiled, {x});
+   ASSERT_EQ(y.size(), 1u);
+   ASSERT_EQ(y2.size(), 1u);
+   ExpectNear(y[0], reference);
+   ExpectNear(y2[0], computeReference(x, w2, b2));
+}
+
+TEST(Streaming, StepMatchesFullSequence)
+{
+   const size_t seqLength = 5;
+   for (std::string type : {"RNN", "GRU", "LSTM"}) {
+      SCOPED_TRACE(type);
+      RModel full("StreamingFull" + type + ".onnx", "");
+      BuildRecurrentModel(full, type, seqLength);
+      RModel streaming("StreamingStep" + type + ".onnx", "");
+      BuildRecurrentModel(streaming, type, 1);
+
+      auto x = RandomVector(seqLength * 2 * 3, 14);
+      auto y = RunCompiled(full, {x});
+      ASSERT_EQ(y.size(), 1u);
+      const size_t stepOutput = y[0].size() / seqLength;
+
+      // every call of the streaming model advances the sequence of one time step
+      RModelCompiler compiler(kCacheDirectory);
+      RCompiledModel compiled(compiler.Compile(streaming, -1, Options::kStreaming));
+      const size_t stepInput = x.size() / seqLength;
+      for (size_t t = 0; t < seqLength; t++) {
+         std::vector<float> xt(x.begin() + t * stepInput, x.begin() + (t + 1) * stepInput);
+         auto yt = Infer(compiled, {xt});
+         ExpectNear(yt[0], std::vector<float>(y[0].begin() + t * stepOutput, y[0].begin() + (t + 1) * stepOutput));
+      }
+
+      // the streaming code needs a sequence length of 1
+      RModel sequence("StreamingSequence" + type + ".onnx", "");
+      BuildRecurrentModel(sequence, type, seqLength);
+      try {
+         sequence.Generate(Options::kStreaming);
+         ADD_FAILURE() << "streaming generation of a sequence of length " << seqLength << " did not throw";
+      } catch (const std::runtime_error &e) {
+         EXPECT_NE(std::string(e.what()).find("sequence length of 1"), std::string::npos) << e.what();
+      }
+      EXPECT_THROW(full.Generate(Options::kStreaming), std::runtime_error);
+   }
+}
+
+TEST(BatchedGemm, MatchesGemmPerBatch)
+{
+   // A of shape {2, 3, m, k}, B of shape {3, k, n} broadcasted on the first dimension
+   const int m = 4, n = 5, k = 6;
+   const size_t batchShape[] = {2, 3};
+   const size_t strideA[] = {3 * size_t(m) * k, size_t(m) * k};
+   for (bool sharedB : {false, true}) {
+      const size_t strideB[] = {0, sharedB ? 0 : size_t(k) * n};
+      for (bool transA : {false, true}) {
+         for (bool transB : {false, true}) {
+            SCOPED_TRACE(std::string("sharedB ") + std::to_string(sharedB) + " transA " + std::to_string(transA) +
+                         " transB " + std::to_string(transB));
+            auto a = RandomVector(6 * m * k, 21);
+            auto b = RandomVector(3 * k * n, 22);
+            auto y0 = RandomVector(6 * m * n, 23);
+            const float alpha = 0.5, beta = 2.;
+            std::vector<float> reference(y0);
+            for (size_t i0 = 0; i0 < batchShape[0]; i0++) {
+               for (size_t i1 = 0; i1 < batchShape[1]; i1++) {
+                  const float *pA = a.data() + i0 * strideA[0] + i1 * strideA[1];
+                  const float *pB = b.data() + i0 * strideB[0] + i1 * strideB[1];
+                  float *pY = reference.data() + (i0 * batchShape[1] + i1) * m * n;
+                  for (int i = 0; i < m; i++) {
+                     for (int j = 0; j < n; j++) {
+                        float sum = 0;
+                        for (int p = 0; p < k; p++)
+                           sum += (transA ? pA[p * m + i] : pA[i * k + p]) * (transB ? pB[j * k + p] : pB[p * n + j]);
+                        pY[i * n + j] = alpha * sum + beta * pY[i * n + j];
+                     }
+                  }
+               }
+            }
+            // the internal kernel and BLAS
+            for (size_t threshold : {std::numeric_limits<size_t>::max(), size_t(0)}) {
+               std::vector<float> y(y0);
+               UTILITY::BatchedGemm(transA, transB, m, n, k, alpha, a.data(), b.data(), beta, y.data(), 2,
+                                    batchShape, strideA, strideB, threshold);
+               ExpectNear(y, reference);
+            }
+         }
+      }
+   }
+}
+
+TEST(Einsum, MultiOperandContraction)
+{
+   // contractions needing permuted operands, a batch label and labels summed in a single operand
+   const std::vector<std::pair<std::string, std::vector<std::string>>> equations = {
+      {"il", {"ij", "jk", "kl"}}, {"bim", {"bij", "bjk", "kl", "ml"}}, {"ea", {"abc", "cd", "bde", "f"}}};
+   const std::map<char, size_t> dims = {{'a', 3}, {'b', 2}, {'c', 4}, {'d', 5}, {'e', 3}, {'f', 2},
+                                        {'i', 3}, {'j', 4}, {'k', 5}, {'l', 2}, {'m', 3}};
+   int id = 0;
+   for (auto &eq : equations) {
+      std::string equation;
+      for (auto &labels : eq.second)
+         equation += (equation.empty() ? "" : ",") + labels;
+      equation += "->" + eq.first;
+      SCOPED_TRACE(equation);
+      RModel model("Einsum" + std::to_string(id++) + ".onnx", "");
+      std::vector<std::string> names;
+      std::vector<std::vector<float>> inputs;
+      for (auto &labels : eq.second) {
+         std::string name = "X" + std::to_string(names.size());
+         std::vector<size_t> shape;
+         for (char l : labels)
+            shape.push_back(dims.at(l));
+         model.AddInputTensorInfo(name, ETensorType::FLOAT, shape);
+         model.AddInputTensorName(name);
+         names.push_back(name);
+         inputs.push_back(RandomVector(ConvertShapeToLength(shape), 30 + names.size()));
+      }
+      model.AddOperator(std::make_unique<ROperator_Einsum<float>>(equation, names, "Y"));
+      model.AddOutputTensorNameList({"Y"});
+
+      auto y = RunCompiled(model, inputs);
+      ASSERT_EQ(y.size(), 1u);
+      ExpectNear(y[0], NaiveEinsum(eq.second, eq.first, dims, inputs));
+
+      // the intermediate tensors of the plan are scratch tensors of the operator, not inputs or outputs
+      auto &op = *model.GetOperators()[0];
+      EXPECT_EQ(op.GetOpOutputTensors().size(), 1u);
+      EXPECT_EQ(op.GetOpInputTensors().size(), names.size());
+      EXPECT_FALSE(op.GetOpScratchTensors().empty());
+   }
+}
+
+TEST(BatchNormalization, FoldedInConvolution)
+{
+   const std::vector<size_t> shapeX = {2, 4, 6, 6}, shapeW = {6, 4, 3, 3};
+   const size_t channels = shapeW[0];
+   auto x = RandomVector(ConvertShapeToLength(shapeX), 41);
+   auto w = RandomVector(ConvertShapeToLength(shapeW), 42);
+   auto b = RandomVector(channels, 43);
+   auto scale = RandomVector(channels, 44);
+   auto shift = RandomVector(channels, 45);
+   auto mean = RandomVector(channels, 46);
+   auto var = RandomVector(channels, 47);
+   for (auto &v : var)
+      v = std::abs(v) + 0.5f;
+   const float epsilon = 1.E-5;
+
+   auto buildModel = [&](RModel &model, bool convIsOutput) {
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, shapeX);
+      model.AddInputTensorName("X");
+      AddWeight(model, "W", shapeW, w);
+      AddWeight(model, "B", {channels}, b);
+      AddWeight(model, "scale", {channels}, scale);
+      AddWeight(model, "shift", {channels}, shift);
+      AddWeight(model, "mean", {channels}, mean);
+      AddWeight(model, "var", {channels}, var);
+      model.AddOperator(std::make_unique<ROperator_Conv<float>>("NOTSET", std::vector<size_t>{1, 1}, 1,
+                                                                std::vector<size_t>{3, 3}, std::vector<size_t>{1, 1, 1, 1},
+                                                                std::vector<size_t>{1, 1}, "X", "W", "B", "H"));
+      model.AddOperator(std::make_unique<ROperator_BatchNormalization<float>>(epsilon, 0.9, 0, "H", "scale", "shift",
+                                                                              "mean", "var", "Y"));
+      if (convIsOutput)
+         model.AddOutputTensorNameList({"Y", "H"});
+      else
+         model.AddOutputTensorNameList({"Y"});
+   };
+   // the BatchNormalization is not folded when the convolution output is needed
+   RModel folded("ConvBNFolded.onnx", "");
+   buildModel(folded, false);
+   auto yFolded = RunCompiled(folded, {x});
+   EXPECT_EQ(folded.GetOperators().size(), 1u);
+   RModel unfolded("ConvBNUnfolded.onnx", "");
+   buildModel(unfolded, true);
+   auto yUnfolded = RunCompiled(unfolded, {x});
+   EXPECT_EQ(unfolded.GetOperators().size(), 2u);
+
+   std::vector<size_t> shapeY;
+   auto reference = NaiveConv2d(x, shapeX, w, shapeW, b, 1, {1, 1}, {1, 1}, {1, 1}, shapeY);
+   ExpectNear(yUnfolded[1], reference);
+   size_t spatial = shapeY[2] * shapeY[3];
+   for (size_t i = 0; i < reference.size(); i++) {
+      size_t c = (i / spatial) % channels;
+      reference[i] = (reference[i] - mean[c]) / std::sqrt(var[c] + epsilon) * scale[c] + shift[c];
+   }
+   ExpectNear(yUnfolded[0], reference);
+   ExpectNear(yFolded[0], reference);
+}
+
+TEST(BatchNormalization, ParametersPerElement)
+{
+   // parameters which cannot be folded in a per-channel scale and shift use the generic normalization
+   const std::vector<size_t> shapeX = {2, 3, 4, 5};
+   const size_t channels = shapeX[1], image = channels * shapeX[2] * shapeX[3];
+   RModel model("BNPerElement.onnx", "");
+   model.AddInputTensorInfo("X", ETensorType::FLOAT, shapeX);
+   model.AddInputTensorName("X");
+   model.AddInputTensorInfo("mean", ETensorType::FLOAT, std::vector<size_t>{channels});
+   model.AddInputTensorName("mean");
+   auto scale = RandomVector(channels, 51);
+   auto shift = RandomVector(image, 52);
+   auto var = RandomVector(image, 53);
+   for (auto &v : var)
+      v = std::abs(v) + 0.5f;
+   AddWeight(model, "scale", {channels, 1, 1}, scale);
+   AddWeight(model, "shift", {channels, shapeX[2], shapeX[3]}, shift);
+   AddWeight(model, "var", {channels, shapeX[2], shapeX[3]}, var);
+   const float epsilon = 1.E-3;
+   model.AddOperator(std::make_unique<ROperator_BatchNormalization<float>>(epsilon, 0.9, 0, "X", "scale", "shift",
+                                                                           "mean", "var", "Y"));
+   model.AddOutputTensorNameList({"Y"});
+
+   auto x = RandomVector(ConvertShapeToLength(shapeX), 54);
+   auto mean = RandomVector(channels, 55);
+   auto y = RunCompiled(model, {x, mean});
+   std::vector<float> reference(x.size());
+   for (size_t i = 0; i < x.size(); i++) {
+      size_t c = (i % image) / (image / channels);
+      reference[i] = (x[i] - mean[c]) / std::sqrt(var[i % image] + epsilon) * scale[c] + shift[i % image];
+   }
+   ExpectNear(y[0], reference);
+}
+
+TEST(AggregateFunctions, SegmentReductions)
+{
+   // edges grouped by receiver, with an empty segment and a number of features not multiple of the block size
+   const size_t nNodes = 4;
+   const std::vector<int> receivers = {2, 0, 2, 3, 2, 0, 3};
+   std::vector<size_t> offsets, index;
+   UTILITY::BuildCSRIndex(receivers.data(), receivers.size(), nNodes, offsets, index);
+   for (size_t nFeatures : {size_t(5), size_t(21)}) {
+      auto data = RandomVector(receivers.size() * nFeatures, 61);
+      std::vector<float> sum(nNodes * nFeatures, 0.f), mean(sum), max(sum);
+      std::vector<size_t> count(nNodes, 0);
+      for (size_t e = 0; e < receivers.size(); e++) {
+         size_t j = receivers[e];
+         for (size_t f = 0; f < nFeatures; f++) {
+            float x = data[e * nFeatures + f];
+            sum[j * nFeatures + f] += x;
+            max[j * nFeatures + f] = (count[j] == 0) ? x : std::max(max[j * nFeatures + f], x);
+         }
+         count[j]++;
+      }
+      for (size_t i = 0; i < mean.size(); i++)
+         mean[i] = (count[i / nFeatures] > 0) ? sum[i] / count[i / nFeatures] : 0.f;
+
+      std::vector<float> y(nNodes * nFeatures);
+      UTILITY::SegmentSum(data.data(), nFeatures, offsets.data(), index.data(), nNodes, y.data());
+      ExpectNear(y, sum);
+      UTILITY::SegmentMean(data.data(), nFeatures, offsets.data(), index.data(), nNodes, y.data());
+      ExpectNear(y, mean);
+      UTILITY::SegmentMax(data.data(), nFeatures, offsets.data(), index.data(), nNodes, y.data());
+      ExpectNear(y, max);
+
+      // contiguous rows, without index
+      std::vector<size_t> contiguous = {0, 3, 3, 7};
+      UTILITY::SegmentSum(data.data(), nFeatures, contiguous.data(), nullptr, 3, y.data());
+      for (size_t f = 0; f < nFeatures; f++) {
+         EXPECT_NEAR(y[f], data[f] + data[nFeatures + f] + data[2 * nFeatures + f], 1.E-5);
+         EXPECT_EQ(y[nFeatures + f], 0.f);
+      }
+   }
+
+   // the aggregate functions call the corresponding reduction
+   RFunction_Sum fsum;
+   RFunction_Mean fmean;
+   RFunction_Max fmax;
+   EXPECT_NE(fsum.GenerateSegmentReduce(5, "x", "o", "i", "n", "y").find("SOFIE::UTILITY::SegmentSum("), std::string::npos);
+   EXPECT_NE(fmean.GenerateSegmentReduce(5, "x", "o", "i", "n", "y").find("SOFIE::UTILITY::SegmentMean("), std::string::npos);
+   EXPECT_NE(fmax.GenerateSegmentReduce(5, "x", "o", "i", "n", "y").find("SOFIE::UTILITY::SegmentMax("), std::string::npos);
+}
+
+TEST(GraphIndependent, ThreadSessionsShareWeights)
+{
+   GraphIndependent_Init init;
+   init.num_nodes = 6;
+   init.edges = {{1, 0}, {2, 1}, {3, 2}, {4, 3}, {5, 4}};
+   init.num_node_features = 3;
+   init.num_edge_features = 2;
+   init.num_global_features = 2;
+   init.num_threads = 4;
+   init.filename = "GraphIndependentThreads";
+   const std::vector<std::pair<FunctionTarget, std::string>> blocks = {
+      {FunctionTarget::EDGES, "edge"}, {FunctionTarget::NODES, "node"}, {FunctionTarget::GLOBALS, "global"}};
+   for (auto &block : blocks) {
+      std::unique_ptr<RFunction_Update> func(
+         new RFunction_MLP(block.first, 1, Activation::RELU, true, GraphType::GraphIndependent));
+      func->AddInitializedTensors({{block.second + "_w"}, {block.second + "_b"}});
+      size_t n = (block.first == FunctionTarget::EDGES)
+                    ? init.num_edge_features
+                    : ((block.first == FunctionTarget::NODES) ? init.num_node_features : init.num_global_features);
+      AddWeight(*func->GetFunctionBlock(), block.second + "_w", {n, n}, RandomVector(n * n, 71));
+      AddWeight(*func->GetFunctionBlock(), block.second + "_b", {n}, RandomVector(n, 72));
+      if (block.first == FunctionTarget::EDGES)
+         init.edges_update_block = std::move(func);
+      else if (block.first == FunctionTarget::NODES)
+         init.nodes_update_block = std::move(func);
+      else
+         init.globals_update_block = std::move(func);
+   }
+   RModel_GraphIndependent model(init);
+   model.AddBlasRoutines({"Gemm"});
+   model.Generate();
+   std::string code = model.ReturnGenerated();
+
+   // the weights are read once for each block, the sessions of the other threads use the ones of the first session
+   size_t nReads = 0;
+   for (size_t pos = code.find("f.open(filename)"); pos != std::string::npos; pos = code.find("f.open(filename)", pos + 1))
+      nReads++;
+   EXPECT_EQ(nReads, blocks.size());
+   EXPECT_NE(code.find("Session(const Session & weights, size_t num_edges)"), std::string::npos);
+   EXPECT_NE(code.find("new Edge_Update::Session(*fEdgeSessions[0], 5)"), std::string::npos);
+   EXPECT_NE(code.find("new Node_Update::Session(*fNodeSessions[0], 6)"), std::string::npos);
+   EXPECT_NE(code.find("#pragma omp task"), std::string::npos);
+}
+
+TEST(FusedMLP, MatchesGemmReluChain)
+{
+   // several blocks of rows with a partial last block, and layer widths not multiple of the row unrolling
+   const size_t rows = 150;
+   const std::vector<size_t> widths = {7, 64, 33, 5};
+   auto x = RandomVector(rows * widths[0], 61);
+   std::vector<std::vector<float>> kernels, biases;
+   for (size_t i = 0; i + 1 < widths.size(); i++) {
+      kernels.push_back(RandomVector(widths[i] * widths[i + 1], 62 + 2 * i));
+      biases.push_back(RandomVector(widths[i + 1], 63 + 2 * i));
+   }
+
+   auto addWeights = [&](RModel &model, std::vector<std::string> &nameW, std::vector<std::string> &nameB) {
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{rows, widths[0]});
+      model.AddInputTensorName("X");
+      for (size_t i = 0; i < kernels.size(); i++) {
+         nameW.push_back("W" + std::to_string(i));
+         nameB.push_back("B" + std::to_string(i));
+         AddWeight(model, nameW[i], {widths[i], widths[i + 1]}, kernels[i]);
+         AddWeight(model, nameB[i], {widths[i + 1]}, biases[i]);
+      }
+   };
+
+   for (bool reluOutput : {false, true}) {
+      RModel fused("FusedMLP.onnx", "");
+      std::vector<std::string> nameW, nameB;
+      addWeights(fused, nameW, nameB);
+      fused.AddOperator(std::make_unique<ROperator_FusedMLP<float>>("X", nameW, nameB, true, reluOutput, "Y"));
+      fused.AddOutputTensorNameList({"Y"});
+      auto yFused = RunCompiled(fused, {x});
+
+      RModel chain("UnfusedMLP.onnx", "");
+      nameW.clear();
+      nameB.clear();
+      addWeights(chain, nameW, nameB);
+      std::string input = "X";
+      for (size_t i = 0; i < nameW.size(); i++) {
+         bool last = (i + 1 == nameW.size());
+         std::string gemm = (last && !reluOutput) ? "Y" : "H" + std::to_string(i);
+         chain.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 0, input, nameW[i], nameB[i], gemm));
+         input = gemm;
+         if (!last || reluOutput) {
+            input = last ? "Y" : "R" + std::to_string(i);
+            chain.AddOperator(std::make_unique<ROperator_Relu<float>>(gemm, input));
+         }
+      }
+      chain.AddOutputTensorNameList({"Y"});
+      auto yChain = RunCompiled(chain, {x});
+
+      ASSERT_EQ(yFused.size(), 1u);
+      ASSERT_EQ(yChain.size(), 1u);
+      EXPECT_EQ(yFused[0].size(), rows * widths.back());
+      ExpectNear(yFused[0], yChain[0]);
+   }
+}
+
+TEST(BinaryConstants, BytesRoundTrip)
+{
+   // floats from random bit patterns, so that the literal contains all the byte values (including the quotes,
+   // backslashes, question marks and null bytes). NaN, infinities, zeros and denormals are excluded since
+   // they are not kept exactly by the Gemm below
+   const size_t batch = 4, n = 3, m = 64;
+   std::mt19937 generator(71);
+   std::vector<float> bias;
+   while (bias.size() < batch * m) {
+      uint32_t bits = generator();
+      uint32_t exponent = (bits >> 23) & 0xFF;
+      if (exponent == 0 || exponent == 0xFF)
+         continue;
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      bias.push_back(value);
+   }
+
+   // Y = 0 * W + B returns the bytes of B
+   RModel model("BinaryConstants.onnx", "");
+   model.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{batch, n});
+   model.AddInputTensorName("X");
+   AddWeight(model, "W", {m, n}, RandomVector(m * n, 72));
+   AddWeight(model, "B", {batch, m}, bias);
+   model.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "X", "W", "B", "Y"));
+   model.AddOutputTensorNameList({"Y"});
+
+   model.Generate(Options::kNoWeightFile | Options::kBinaryConstants);
+   EXPECT_NE(model.ReturnGenerated().find("fTensorBytes_B"), std::string::npos);
+   // the option is not kept for the following generations
+   model.Generate(Options::kNoWeightFile);
+   EXPECT_EQ(model.ReturnGenerated().find("fTensorBytes_"), std::string::npos);
+
+   // the compiled library embeds the weights as raw bytes
+   auto y = RunCompiled(model, {std::vector<float>(batch * n, 0.f)});
+   ASSERT_EQ(y.size(), 1u);
+   ASSERT_EQ(y[0].size(), bias.size());
+   EXPECT_EQ(std::memcmp(y[0].data(), bias.data(), bias.size() * sizeof(float)), 0);
+}
+
+TEST(KernelVariants, MatchDefaultKernel)
+{
+   // every variant of the operators of the model gives the same outputs as the default kernel
+   auto checkVariants = [](RModel &model, const std::vector<std::vector<float>> &inputs) {
+      auto reference = RunCompiled(model, inputs);
+      auto &op = model.GetOperators().front();
+      auto variants = op->GetKernelVariants();
+      EXPECT_FALSE(variants.empty());
+      std::set<std::string> codes;
+      for (auto &variant : variants) {
+         op->SetKernelVariant(variant);
+         auto y = RunCompiled(model, inputs);
+         SCOPED_TRACE(op->GetKernelKey() + " variant " + variant);
+         ExpectNear(y[0], reference[0]);
+         model.Generate();
+         codes.insert(CodeBody(model.ReturnGenerated()));
+      }
+      // each variant generates a different code
+      EXPECT_EQ(codes.size(), variants.size());
+      return reference;
+   };
+
+   // strided, dilated and padded convolution
+   const std::vector<size_t> shapeX = {2, 3, 9, 8}, shapeW = {5, 3, 3, 3};
+   auto x = RandomVector(ConvertShapeToLength(shapeX), 81);
+   auto w = RandomVector(ConvertShapeToLength(shapeW), 82);
+   auto b = RandomVector(shapeW[0], 83);
+   RModel conv("ConvVariants.onnx", "");
+   conv.AddInputTensorInfo("X", ETensorType::FLOAT, shapeX);
+   conv.AddInputTensorName("X");
+   AddWeight(conv, "W", shapeW, w);
+   AddWeight(conv, "B", {shapeW[0]}, b);
+   conv.AddOperator(std::make_unique<ROperator_Conv<float>>("NOTSET", std::vector<size_t>{2, 1}, 1,
+                                                            std::vector<size_t>{3, 3}, std::vector<size_t>{2, 1, 2, 1},
+                                                            std::vector<size_t>{2, 1}, "X", "W", "B", "Y"));
+   conv.AddOutputTensorNameList({"Y"});
+   auto yConv = checkVariants(conv, {x});
+   std::vector<size_t> shapeY;
+   ExpectNear(yConv[0], NaiveConv2d(x, shapeX, w, shapeW, b, 1, {2, 1}, {2, 1}, {2, 1}, shapeY));
+
+   // Gemm with transposed inputs and a bias
+   const size_t m = 6, k = 7, n = 9;
+   auto a = RandomVector(k * m, 84);
+   auto bt = RandomVector(n * k, 85);
+   auto c = RandomVector(n, 86);
+   RModel gemm("GemmVariants.onnx", "");
+   gemm.AddInputTensorInfo("A", ETensorType::FLOAT, std::vector<size_t>{k, m});
+   gemm.AddInputTensorName("A");
+   AddWeight(gemm, "B", {n, k}, bt);
+   AddWeight(gemm, "C", {n}, c);
+   gemm.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 1, 1, "A", "B", "C", "Y"));
+   gemm.AddOutputTensorNameList({"Y"});
+   auto yGemm = checkVariants(gemm, {a});
+   std::vector<float> reference(m * n);
+   for (size_t i = 0; i < m; i++) {
+      for (size_t j = 0; j < n; j++) {
+         float sum = c[j];
+         for (size_t l = 0; l < k; l++)
+            sum += a[l * m + i] * bt[j * k + l];
+         reference[i * n + j] = sum;
+      }
+   }
+   ExpectNear(yGemm[0], reference);
+}
+
+TEST(RInterpreter, MatchesGeneratedCode)
+{
+   // Conv -> Relu -> Transpose -> Flatten -> Gemm -> Add (broadcast) -> Tanh -> Softmax, with the output of the
+   // convolution as second model output
+   const std::vector<size_t> shapeX = {2, 3, 6, 6}, shapeW = {4, 3, 3, 3};
+   const size_t nFlat = 4 * 6 * 6, nOut = 5;
+   RModel model("InterpretedModel.onnx", "");
+   model.AddInputTensorInfo("X", ETensorType::FLOAT, shapeX);
+   model.AddInputTensorName("X");
+   AddWeight(model, "W", shapeW, RandomVector(ConvertShapeToLength(shapeW), 91));
+   AddWeight(model, "B", {shapeW[0]}, RandomVector(shapeW[0], 92));
+   AddWeight(model, "W2", {nOut, nFlat}, RandomVector(nOut * nFlat, 93));
+   AddWeight(model, "B2", {nOut}, RandomVector(nOut, 94));
+   AddWeight(model, "S", {nOut}, RandomVector(nOut, 95));
+   model.AddOperator(std::make_unique<ROperator_Conv<float>>("NOTSET", std::vector<size_t>{1, 1}, 1,
+                                                             std::vector<size_t>{3, 3}, std::vector<size_t>{1, 1, 1, 1},
+                                                             std::vector<size_t>{1, 1}, "X", "W", "B", "C"));
+   model.AddOperator(std::make_unique<ROperator_Relu<float>>("C", "R"));
+   model.AddOperator(std::make_unique<ROperator_Transpose<float>>(std::vector<int_t>{0, 2, 3, 1}, "R", "T"));
+   model.AddOperator(std::make_unique<ROperator_Reshape>(Flatten, 1, "T", "", "F"));
+   model.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "F", "W2", "B2", "G"));
+   model.AddOperator(std::make_unique<ROperator_BasicBinary<float, Add>>("G", "S", "A"));
+   model.AddOperator(std::make_unique<ROperator_Tanh<float>>("A", "H"));
+   model.AddOperator(std::make_unique<ROperator_Softmax<float>>(-1, "H", "Y"));
+   model.AddOutputTensorNameList({"Y", "C"});
+
+   auto x = RandomVector(ConvertShapeToLength(shapeX), 96);
+   RInterpreter interpreter(model);
+   auto interpreted = interpreter.Infer<float>({x.data()});
+   auto compiled = RunCompiled(model, {x});
+   ASSERT_EQ(interpreted.size(), 2u);
+   ASSERT_EQ(compiled.size(), 2u);
+   EXPECT_EQ(interpreted[0].size(), shapeX[0] * nOut);
+   ExpectNear(interpreted[0], compiled[0]);
+   ExpectNear(interpreted[1], compiled[1]);
+   // a second run reuses the arena
+   auto x2 = RandomVector(ConvertShapeToLength(shapeX), 97);
+   ExpectNear(interpreter.Infer<float>({x2.data()})[0], RunCompiled(model, {x2})[0]);
+}
+
+TEST(ConstantFolding, ConstantSubgraph)
+{
+   // the rectified kernel (depending on a weight) and the bias computed from a constant by a chain of two
+   // operators are evaluated when initializing the model, only the Gemm and the Tanh of the output remain
+   const size_t batch = 3, n = 4, m = 5;
+   auto w = RandomVector(m * n, 101);
+   auto c = RandomVector(m, 102);
+   auto x = RandomVector(batch * n, 103);
+
+   RModel folded("ConstantSubgraph.onnx", "");
+   folded.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{batch, n});
+   folded.AddInputTensorName("X");
+   AddWeight(folded, "W", {m, n}, w);
+   folded.AddConstantTensor<float>("C", {m}, c);
+   folded.AddOperator(std::make_unique<ROperator_Relu<float>>("W", "WR"));
+   folded.AddOperator(std::make_unique<ROperator_Relu<float>>("C", "CR"));
+   folded.AddOperator(std::make_unique<ROperator_Tanh<float>>("CR", "CT"));
+   folded.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "X", "WR", "CT", "G"));
+   folded.AddOperator(std::make_unique<ROperator_Tanh<float>>("G", "Y"));
+   folded.AddOutputTensorNameList({"Y"});
+   auto yFolded = RunCompiled(folded, {x});
+   EXPECT_EQ(folded.GetOperators().size(), 2u);
+   size_t nFolded = 0;
+   for (auto &report : folded.GetOptimizationReport())
+      nFolded += (report.rfind("folded constant operator", 0) == 0);
+   EXPECT_EQ(nFolded, 3u);
+   // the outputs depending on weights stay in the weight file
+   EXPECT_TRUE(folded.IsInitializedTensor("WR"));
+   EXPECT_FALSE(folded.IsConstantTensor("WR"));
+   EXPECT_TRUE(folded.IsConstantTensor("CT"));
+
+   // same model with the folded tensors given as weights
+   std::vector<float> wr(m * n), ct(m);
+   for (size_t i = 0; i < m * n; i++)
+      wr[i] = std::max(w[i], 0.f);
+   for (size_t i = 0; i < m; i++)
+      ct[i] = std::tanh(std::max(c[i], 0.f));
+   RModel reference("ConstantSubgraphReference.onnx", "");
+   reference.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<size_t>{batch, n});
+   reference.AddInputTensorName("X");
+   AddWeight(reference, "WR", {m, n}, wr);
+   AddWeight(reference, "CT", {m}, ct);
+   reference.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "X", "WR", "CT", "G"));
+   reference.AddOperator(std::make_unique<ROperator_Tanh<float>>("G", "Y"));
+   reference.AddOutputTensorNameList({"Y"});
+   auto yReference = RunCompiled(reference, {x});
+
+   ASSERT_EQ(yFolded.size(), 1u);
+   ASSERT_EQ(yReference.size(), 1u);
+   ExpectNear(yFolded[0], yReference[0]);
+}
+
+TEST(GraphOptimizations, DuplicatedNodesDeadOperatorsAndUnusedWeights)
+{
+   // Y = Relu(X * S) + Relu(X * S), where the second Relu duplicates the first one. The MatMul computing D is not
+   // needed for the output, and the weights U (never used) and WD (used only by the MatMul) are not needed either
+   const size_t batch = 2, n = 4, m = 3;
+   auto x = RandomVector(batch * n, 111);
+   auto s = RandomVector(n, 112);
+
+   onnx::ModelProto modelProto;
+   modelProto.set_ir_version(8);
+   modelProto.add_opset_import()->set_version(13);
+   auto *graph = modelProto.mutable_graph();
+   graph->set_name("GraphOptimizations");
+   auto addValueInfo = [](onnx::ValueInfoProto *info, const std::string &name, const std::vector<size_t> &shape) {
+      info->set_name(name);
+      auto *tensorType = info->mutable_type()->mutable_tensor_type();
+      tensorType->set_elem_type(onnx::TensorProto::FLOAT);
+      for (auto d : shape)
+         tensorType->mutable_shape()->add_dim()->set_dim_value(d);
+   };
+   addValueInfo(graph->add_input(), "X", {batch, n});
+   addValueInfo(graph->add_output(), "Y", {batch, n});
+   auto addInitializer = [&](const std::string &name, const std::vector<size_t> &shape, const std::vector<float> &data) {
+      auto *tensor = graph->add_initializer();
+      tensor->set_name(name);
+      tensor->set_data_type(onnx::TensorProto::FLOAT);
+      for (auto d : shape)
+         tensor->add_dims(d);
+      for (auto v : data)
+         tensor->add_float_data(v);
+   };
+   addInitializer("S", {n}, s);
+   addInitializer("WD", {n, m}, RandomVector(n * m, 113));
+   addInitializer("U", {5}, RandomVector(5, 114));
+   auto addNode = [&](const std::string &type, const std::string &name, const std::vector<std::string> &inputs,
+                      const std::string &output) {
+      auto *node = graph->add_node();
+      node->set_op_type(type);
+      node->set_name(name);
+      for (auto &input : inputs)
+         node->add_input(input);
+      node->add_output(output);
+   };
+   addNode("Mul", "mul", {"X", "S"}, "A");
+   addNode("Relu", "relu1", {"A"}, "R1");
+   addNode("Relu", "relu2", {"A"}, "R2");
+   addNode("MatMul", "matmul", {"X", "WD"}, "D");
+   addNode("Add", "add", {"R1", "R2"}, "Y");
+   const std::string modelFile = "GraphOptimizations.onnx";
+   {
+      std::ofstream out(modelFile, std::ios::binary);
+      ASSERT_TRUE(modelProto.SerializeToOstream(&out));
+   }
+
+   RModelParser_ONNX parser;
+   RModel model = parser.Parse(modelFile);
+   auto y = RunCompiled(model, {x});
+
+   std::vector<std::string> removed;
+   for (auto &report : model.GetOptimizationReport()) {
+      for (auto prefix : {"removed duplicated node Relu relu2", "removed dead operator", "removed unused weight tensor U",
+                          "removed unused weight tensor WD"}) {
+         if (report.rfind(prefix, 0) == 0)
+            removed.push_back(prefix);
+      }
+   }
+   EXPECT_EQ(removed.size(), 4u);
+   EXPECT_EQ(model.GetOperators().size(), 3u);
+   EXPECT_FALSE(model.IsInitializedTensor("U"));
+   EXPECT_FALSE(model.IsInitializedTensor("WD"));
+
+   std::vector<float> reference(batch * n);
+   for (size_t i = 0; i < reference.size(); i++)
+      reference[i] = 2.f * std::max(x[i] * s[i % n], 0.f);
+   ASSERT_EQ(y.size(), 1u);
+   ExpectNear(y[0], reference);
+
+   // the dead operator and the unused weights are kept when their removal is disabled
+   RModel kept = parser.Parse(modelFile);
+   auto yKept = RunCompiled(kept, {x}, static_cast<std::underlying_type_t<Options>>(Options::kNoDeadCodeRemoval));
+   ASSERT_EQ(kept.GetOptimizationReport().size(), 1u);
+   EXPECT_EQ(kept.GetOptimizationReport()[0].rfind("removed duplicated node Relu relu2", 0), 0u);
+   EXPECT_EQ(kept.GetOperators().size(), 4u);
+   EXPECT_TRUE(kept.IsInitializedTensor("U"));
+   EXPECT_TRUE(kept.IsInitializedTensor("WD"));
+   ASSERT_EQ(yKept.size(), 1u);
+   ExpectNear(yKept[0], reference);
+}
+
+TEST(BatchSpecializations, RequireModelSource)
+{
+   // a Gemm on a parametric batch size, built in memory: the model must be built again for each fixed batch size
+   const size_t n = 4, m = 3;
+   auto w = RandomVector(m * n, 121);
+   auto b = RandomVector(m, 122);
+   auto buildModel = [&]() {
+      RModel model("BatchSpecializations.onnx", "");
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, std::vector<Dim>{Dim{"batch_size"}, Dim{n}});
+      model.AddInputTensorName("X");
+      AddWeight(model, "W", {m, n}, w);
+      AddWeight(model, "B", {m}, b);
+      model.AddOperator(std::make_unique<ROperator_Gemm<float>>(1.0, 1.0, 0, 1, "X", "W", "B", "Y"));
+      model.AddOutputTensorNameList({"Y"});
+      return model;
+   };
+
+   RModel model = buildModel();
+   try {
+      model.Generate(Options::kDefault, {1, 8});
+      FAIL() << "the specializations were generated without a model source";
+   } catch (const std::runtime_error &e) {
+      EXPECT_NE(std::string(e.what()).find("RModel::SetModelSource"), std::string::npos) << e.what();
+   }
+
+   // no source is needed when there is no fixed batch size
+   RModel dynamicModel = buildModel();
+   dynamicModel.Generate(Options::kDefault, {-1});
+   EXPECT_EQ(dynamicModel.ReturnGenerated().find("Session_bs"), std::string::npos);
+
+   RModel specialized = buildModel();
+   specialized.SetModelSource(buildModel);
+   specialized.Generate(Options::kDefault, {1, 8});
+   std::string code = specialized.ReturnGenerated();
+   EXPECT_NE(code.find("Session_bs1"), std::string::npos);
+   EXPECT_NE(code.find("Session_bs8"), std::string::npos);
+}
+
+TEST(BlockedLayout, ConvPoolBatchNormalization)
+{
+   // Conv -> MaxPool -> BatchNormalization -> Conv: the tensors between the operators have 16 channels and are
+   // stored in the channel-blocked layout, the model input and output keep the plain layout
+   const std::vector<size_t> shapeX = {2, 3, 10, 10}, shapeW1 = {16, 3, 3, 3}, shapeW2 = {8, 16, 1, 1};
+   const size_t channels = shapeW1[0];
+   auto x = RandomVector(ConvertShapeToLength(shapeX), 131);
+   auto w1 = RandomVector(ConvertShapeToLength(shapeW1), 132);
+   auto b1 = RandomVector(channels, 133);
+   auto w2 = RandomVector(ConvertShapeToLength(shapeW2), 134);
+   auto b2 = RandomVector(shapeW2[0], 135);
+   auto scale = RandomVector(channels, 136);
+   auto shift = RandomVector(channels, 137);
+   auto mean = RandomVector(channels, 138);
+   auto var = RandomVector(channels, 139);
+   for (auto &v : var)
+      v = std::abs(v) + 0.5f;
+
+   auto buildModel = [&](RModel &model) {
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, shapeX);
+      model.AddInputTensorName("X");
+      AddWeight(model, "W1", shapeW1, w1);
+      AddWeight(model, "B1", {channels}, b1);
+      AddWeight(model, "W2", shapeW2, w2);
+      AddWeight(model, "B2", {shapeW2[0]}, b2);
+      AddWeight(model, "scale", {channels}, scale);
+      AddWeight(model, "shift", {channels}, shift);
+      AddWeight(model, "mean", {channels}, mean);
+      AddWeight(model, "var", {channels}, var);
+      model.AddOperator(std::make_unique<ROperator_Conv<float>>("NOTSET", std::vector<size_t>{1, 1}, 1,
+                                                                std::vector<size_t>{3, 3}, std::vector<size_t>{1, 1, 1, 1},
+                                                                std::vector<size_t>{1, 1}, "X", "W1", "B1", "H"));
+      RAttributes_Pool attributes;
+      attributes.kernel_shape = {3, 3};
+      attributes.pads = {1, 1, 1, 1};
+      attributes.strides = {2, 2};
+      attributes.dilations = {1, 1};
+      model.AddOperator(std::make_unique<ROperator_Pool<float>>(MaxPool, attributes, "H", "P"));
+      model.AddOperator(std::make_unique<ROperator_BatchNormalization<float>>(1.E-5, 0.9, 0, "P", "scale", "shift",
+                                                                              "mean", "var", "N"));
+      model.AddOperator(std::make_unique<ROperator_Conv<float>>("NOTSET", std::vector<size_t>{1, 1}, 1,
+                                                                std::vector<size_t>{1, 1}, std::vector<size_t>{0, 0, 0, 0},
+                                                                std::vector<size_t>{1, 1}, "N", "W2", "B2", "Y"));
+      model.AddOutputTensorNameList({"Y"});
+   };
+
+   RModel plain("ConvPoolBNPlain.onnx", "");
+   buildModel(plain);
+   auto yPlain = RunCompiled(plain, {x});
+   RModel blocked("ConvPoolBNBlocked.onnx", "");
+   buildModel(blocked);
+   const auto blockedLayout = static_cast<std::underlying_type_t<Options>>(Options::kBlockedLayout);
+   auto yBlocked = RunCompiled(blocked, {x}, blockedLayout);
+   // a second generation with the blocked layout reuses the packed weights
+   auto yBlockedAgain = RunCompiled(blocked, {x}, blockedLayout);
+   EXPECT_EQ(blocked.GetOperators().size(), 4u);
+
+   plain.Generate(Options::kNoWeightFile);
+   blocked.Generate(Options::kNoWeightFile | Options::kBlockedLayout);
+   EXPECT_NE(CodeBody(blocked.ReturnGenerated()), CodeBody(plain.ReturnGenerated()));
+   // the weights of the blocked model are packed in place, it cannot be generated again with the plain layout
+   EXPECT_THROW(blocked.Generate(Options::kNoWeightFile), std::runtime_error);
+
+   ASSERT_EQ(yPlain.size(), 1u);
+   ASSERT_EQ(yBlocked.size(), 1u);
+   ASSERT_EQ(yBlockedAgain.size(), 1u);
+   ExpectNear(yBlocked[0], yPlain[0]);
+   ExpectNear(yBlockedAgain[0], yPlain[0]);
+}
+
+TEST(Conv, ImplicitGemmMatchesNaiveConvolution)
+{
+   // the implicit Gemm kernel unrolls the im2col panels on the fly: check the index computations with strides,
+   // paddings, dilations and groups against the direct loops of NaiveConv2d
+   struct ConvCase {
+      std::vector<size_t> shapeX, shapeW;
+      size_t group;
+      std::vector<size_t> pads, strides, dilations;
+   };
+   const std::vector<ConvCase> cases = {
+      {{2, 3, 9, 8}, {5, 3, 3, 3}, 1, {1, 1}, {2, 2}, {1, 1}},
+      {{1, 4, 11, 7}, {6, 4, 3, 2}, 1, {2, 1}, {1, 2}, {2, 3}},
+      {{2, 4, 10, 10}, {6, 2, 3, 3}, 2, {1, 1}, {2, 1}, {2, 1}},
+      {{1, 8, 7, 9}, {8, 1, 3, 3}, 8, {1, 1}, {1, 1}, {1, 1}},
+      {{1, 6, 9, 9}, {4, 6, 1, 1}, 1, {0, 0}, {2, 2}, {1, 1}},
+      {{1, 16, 20, 20}, {24, 16, 3, 3}, 1, {1, 1}, {1, 1}, {1, 1}},
+   };
+   unsigned int seed = 141;
+   for (auto &c : cases) {
+      auto x = RandomVector(ConvertShapeToLength(c.shapeX), seed++);
+      auto w = RandomVector(ConvertShapeToLength(c.shapeW), seed++);
+      auto b = RandomVector(c.shapeW[0], seed++);
+      RModel model("ConvImplicitGemm.onnx", "");
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, c.shapeX);
+      model.AddInputTensorName("X");
+      AddWeight(model, "W", c.shapeW, w);
+      AddWeight(model, "B", {c.shapeW[0]}, b);
+      model.AddOperator(std::make_unique<ROperator_Conv<float>>(
+         "NOTSET", c.dilations, c.group, std::vector<size_t>{c.shapeW[2], c.shapeW[3]},
+         std::vector<size_t>{c.pads[0], c.pads[1], c.pads[0], c.pads[1]}, c.strides, "X", "W", "B", "Y"));
+      model.AddOutputTensorNameList({"Y"});
+      model.GetOperators().front()->SetKernelVariant("gemm");
+      auto y = RunCompiled(model, {x});
+
+      std::vector<size_t> shapeY;
+      auto reference = NaiveConv2d(x, c.shapeX, w, c.shapeW, b, c.group, c.pads, c.strides, c.dilations, shapeY);
+      SCOPED_TRACE("X" + ConvertShapeToString(c.shapeX) + " W" + ConvertShapeToString(c.shapeW) +
+                   " group=" + std::to_string(c.group));
+      ASSERT_EQ(y.size(), 1u);
+      ExpectNear(y[0], reference);
+   }
+}
+
+TEST(ConvTranspose, SubPixelMatchesNaiveTransposedConvolution)
+{
+   // the sub-pixel decomposition computes each phase of the strided outputs with a regular convolution: check the
+   // phases, the paddings removed from the borders and the output paddings against the scatter loops of
+   // NaiveConvTranspose2d
+   struct ConvTransposeCase {
+      std::vector<size_t> shapeX, shapeW;
+      size_t group;
+      std::vector<size_t> pads, strides, dilations, outputPadding;
+   };
+   const std::vector<ConvTransposeCase> cases = {
+      {{1, 3, 5, 4}, {3, 4, 3, 3}, 1, {1, 1, 1, 1}, {2, 2}, {1, 1}, {1, 1}},
+      {{2, 2, 4, 6}, {2, 3, 4, 3}, 1, {2, 1, 2, 1}, {3, 2}, {1, 1}, {2, 1}},
+      {{1, 4, 4, 5}, {4, 3, 3, 2}, 2, {1, 0, 1, 0}, {2, 3}, {1, 1}, {1, 2}},
+      {{1, 3, 6, 5}, {3, 2, 3, 3}, 1, {1, 2, 1, 2}, {2, 2}, {2, 2}, {1, 0}},
+      {{1, 8, 7, 7}, {8, 8, 4, 4}, 1, {1, 1, 1, 1}, {2, 2}, {1, 1}, {0, 0}},
+   };
+   unsigned int seed = 161;
+   for (auto &c : cases) {
+      auto x = RandomVector(ConvertShapeToLength(c.shapeX), seed++);
+      auto w = RandomVector(ConvertShapeToLength(c.shapeW), seed++);
+      auto b = RandomVector(c.shapeW[1] * c.group, seed++);
+      RModel model("ConvTransposeSubPixel.onnx", "");
+      model.AddInputTensorInfo("X", ETensorType::FLOAT, c.shapeX);
+      model.AddInputTensorName("X");
+      AddWeight(model, "W", c.shapeW, w);
+      AddWeight(model, "B", {b.size()}, b);
+      model.AddOperator(std::make_unique<ROperator_ConvTranspose<float>>(
+         "NOTSET", c.dilations, c.group, std::vector<size_t>{c.shapeW[2], c.shapeW[3]}, c.outputPadding,
+         std::vector<size_t>{}, c.pads, c.strides, "X", "W", "B", "Y"));
+      model.AddOutputTensorNameList({"Y"});
+      auto y = RunCompiled(model, {x});
+
+      std::vector<size_t> shapeY;
+      auto reference = NaiveConvTranspose2d(x, c.shapeX, w, c.shapeW, b, c.group, c.pads, c.strides, c.dilations,
+                                            c.outputPadding, shapeY);
+      SCOPED_TRACE("X" + ConvertShapeToString(c.shapeX) + " W" + ConvertShapeToString(c.shapeW) + " strides" +
+                   ConvertShapeToString(c.strides) + " dilations" + ConvertShapeToString(c.dilations));
+      EXPECT_EQ(model.GetTensorShape("Y"), shapeY);
+      ASSERT_EQ(y.size(), 1u);
+      ExpectNear(y[0], reference);
+   }
+}
@@ -0,0 +1,9 @@
+namespace LogSoftmax_ExpectedOutput{
+   float output[] = {
+        -2.0273, -2.9598, -0.8819, -0.6572, -2.0642, -0.8266, -1.9689, -2.6606,
+        -0.3266, -2.0970, -1.3537, -1.8558, -0.5607, -1.5784, -0.6613, -0.1300,
+        -1.9179, -0.1919, -1.1155, -1.1228, -1.1963, -1.0323, -1.0665, -2.9567,
+        -0.8543, -1.9917, -2.7647, -2.4086, -1.0070, -0.6263, -1.1951, -1.0770,
+        -0.7813, -1.2184, -0.1758, -2.2334, -2.2435, -2.2065, -1.0681, -1.0318,
+        -2.1493, -0.5659, -2.3203, -0.2195, -0.6375, -1.0346, -1.0393, -1.1940};
+}
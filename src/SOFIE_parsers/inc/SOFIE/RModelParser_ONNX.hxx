@@ -27,6 +27,8 @@ using ParserFuseFuncSignature =
 class RModelParser_ONNX {
 public:
    struct OperatorsMapImpl;
+   // file holding ONNX external data, mapped in memory
+   struct ExternalDataFile;
 
 private:
 
@@ -37,6 +39,10 @@ private:
    std::unordered_map<std::string, ETensorType> fTensorTypeMap;
    // flag list of fused operators
    std::vector<bool> fFusedOperators;
+   // directory of the parsed ONNX file, used to locate the external data files
+   std::string fModelDirectory;
+   // external data files of the parsed model (shared with the initialized tensors referring to them)
+   std::unordered_map<std::string, std::shared_ptr<ExternalDataFile>> fExternalDataFiles;
 
 
 public:
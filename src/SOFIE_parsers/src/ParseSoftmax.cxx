@@ -12,7 +12,7 @@ ParserFuncSignature ParseSoftmax = [](RModelParser_ONNX &parser, const onnx::Nod
    if (parser.IsRegisteredTensorType(input_name)) {
       input_type = parser.GetTensorType(input_name);
    } else {
-      throw std::runtime_error("TMVA::SOFIE ONNX Parser Softmax op has input tensor " + input_name +
+      throw std::runtime_error("TMVA::SOFIE ONNX Parser " + nodeproto.op_type() + " op has input tensor " + input_name +
                                " but its type is not yet registered");
    }
 
@@ -23,10 +23,13 @@ ParserFuncSignature ParseSoftmax = [](RModelParser_ONNX &parser, const onnx::Nod
    if (nodeproto.attribute_size() == 1 && nodeproto.attribute(0).name() == "axis")
       attr_axis = nodeproto.attribute(0).i();
 
+   // LogSoftmax shares the Softmax implementation
+   bool logSoftmax = (nodeproto.op_type() == "LogSoftmax");
+
    switch (input_type) {
-   case ETensorType::FLOAT: op.reset(new ROperator_Softmax<float>(attr_axis, input_name, output_name)); break;
+   case ETensorType::FLOAT: op.reset(new ROperator_Softmax<float>(attr_axis, input_name, output_name, logSoftmax)); break;
    default:
-      throw std::runtime_error("TMVA::SOFIE - Unsupported - Operator Softmax does not yet support input type " +
+      throw std::runtime_error("TMVA::SOFIE - Unsupported - Operator " + nodeproto.op_type() + " does not yet support input type " +
                                std::to_string(static_cast<int>(input_type)));
    }
 
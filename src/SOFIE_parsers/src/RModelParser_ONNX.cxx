@@ -8,9 +8,23 @@
 #include <cassert>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <queue>
 #include <functional>
+#include <climits>
+#include <fstream>
 #include "SOFIE/SOFIE_common.hxx"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 namespace SOFIE {
 
@@ -90,7 +104,6 @@ extern ParserFuncSignature ParseScatterElements;
 extern ParserFuseFuncSignature ParseFuseConvAdd;
 extern ParserFuseFuncSignature ParseFuseGemmRelu;
 extern ParserFuseFuncSignature ParseFuseBatchnormRelu;
-extern ParserFuseFuncSignature ParseFuseConvTransposeAdd;
 extern ParserFuseFuncSignature ParseFuseMatMulAdd;
 
 // Definition of  RModelParser_ONNX::OperatorsMap
@@ -134,6 +147,17 @@ struct ExtractDataFromTP<int64_t> {
 };
 template<typename T>
 std::shared_ptr<void> GetInitializedTensorData(onnx::TensorProto * tensorproto, size_t length) {
+#ifdef R__BYTESWAP
+   // take ownership of the raw bytes stored in the protobuf message instead of copying them
+   if (tensorproto->raw_data().size() >= length * sizeof(T)) {
+      std::shared_ptr<std::string> raw(tensorproto->release_raw_data());
+      if (reinterpret_cast<std::uintptr_t>(raw->data()) % alignof(T) == 0)
+         return std::shared_ptr<void>(raw, raw->data());
+      std::shared_ptr<void> data(malloc(length * sizeof(T)), free);
+      std::memcpy(data.get(), raw->data(), length * sizeof(T));
+      return data;
+   }
+#endif
    std::shared_ptr<void> data(malloc(length * sizeof(T)), free);
 
    if (!tensorproto->raw_data().empty()) {
@@ -150,6 +174,109 @@ std::shared_ptr<void> GetInitializedTensorData(onnx::TensorProto * tensorproto,
    return data;
 }
 
+// Definition of RModelParser_ONNX::ExternalDataFile
+// The file is mapped private and writable: pages are read from disk only when accessed and are copied
+// only if an operator modifies the initialized tensor in place
+struct RModelParser_ONNX::ExternalDataFile {
+   char *fData = nullptr;
+   std::size_t fSize = 0;
+   bool fIsMapped = false;
+
+   ExternalDataFile(const std::string &path)
+   {
+#ifndef _WIN32
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+         throw std::runtime_error("TMVA::SOFIE - cannot open ONNX external data file " + path);
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+         close(fd);
+         throw std::runtime_error("TMVA::SOFIE - cannot read size of ONNX external data file " + path);
+      }
+      fSize = st.st_size;
+      if (fSize > 0) {
+         void *addr = mmap(nullptr, fSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+         if (addr != MAP_FAILED) {
+            fData = static_cast<char *>(addr);
+            fIsMapped = true;
+         }
+      }
+      close(fd);
+      if (fIsMapped || fSize == 0)
+         return;
+#endif
+      // no memory mapping available: read the full file
+      std::ifstream input(path, std::ios::in | std::ios::binary | std::ios::ate);
+      if (!input)
+         throw std::runtime_error("TMVA::SOFIE - cannot open ONNX external data file " + path);
+      fSize = input.tellg();
+      fData = static_cast<char *>(malloc(fSize));
+      input.seekg(0);
+      if (!input.read(fData, fSize))
+         throw std::runtime_error("TMVA::SOFIE - cannot read ONNX external data file " + path);
+   }
+
+   ~ExternalDataFile()
+   {
+#ifndef _WIN32
+      if (fIsMapped) {
+         munmap(fData, fSize);
+         return;
+      }
+#endif
+      free(fData);
+   }
+
+   ExternalDataFile(const ExternalDataFile &) = delete;
+   ExternalDataFile &operator=(const ExternalDataFile &) = delete;
+};
+
+// get initialized tensor data stored in an external file (data_location = EXTERNAL).
+// The returned pointer refers directly to the mapped file, which is kept alive as long as the tensor data are used
+template<typename T>
+std::shared_ptr<void> GetExternalTensorData(const onnx::TensorProto & tensorproto, size_t length, const std::string & modelDir,
+                                            std::unordered_map<std::string, std::shared_ptr<RModelParser_ONNX::ExternalDataFile>> & files) {
+   std::string location;
+   std::size_t offset = 0;
+   std::size_t nbytes = length * sizeof(T);
+   for (const auto &entry : tensorproto.external_data()) {
+      if (entry.key() == "location")
+         location = entry.value();
+      else if (entry.key() == "offset")
+         offset = std::stoull(entry.value());
+      else if (entry.key() == "length" && std::stoull(entry.value()) < nbytes)
+         throw std::runtime_error("TMVA::SOFIE - external data of tensor " + tensorproto.name() + " has length " +
+                                  entry.value() + " smaller than its shape");
+   }
+   if (location.empty())
+      throw std::runtime_error("TMVA::SOFIE - no location given for external data of tensor " + tensorproto.name());
+
+   std::string path = modelDir.empty() ? location : modelDir + "/" + location;
+   auto &file = files[path];
+   if (!file)
+      file = std::make_shared<RModelParser_ONNX::ExternalDataFile>(path);
+   if (offset + nbytes > file->fSize)
+      throw std::runtime_error("TMVA::SOFIE - external data of tensor " + tensorproto.name() + " exceeds size of file " + path);
+
+   const char *begin = file->fData + offset;
+#ifdef R__BYTESWAP
+   if (reinterpret_cast<std::uintptr_t>(begin) % alignof(T) == 0)
+      return std::shared_ptr<void>(file, const_cast<char *>(begin));
+#endif
+   // misaligned data or big-endian host: a copy is needed
+   std::shared_ptr<void> data(malloc(nbytes), free);
+#ifdef R__BYTESWAP
+   std::memcpy(data.get(), begin, nbytes);
+#else
+   for (std::size_t k = 0; k < length; ++k) {
+      typename RByteSwap<sizeof(T)>::value_type value;
+      std::memcpy(&value, begin + k * sizeof(T), sizeof(T));
+      (reinterpret_cast<typename RByteSwap<sizeof(T)>::value_type *>(data.get()))[k] = RByteSwap<sizeof(T)>::bswap(value);
+   }
+#endif
+   return data;
+}
+
 // Constructor of the parser
 RModelParser_ONNX::RModelParser_ONNX() noexcept : fOperatorsMapImpl(std::make_unique<OperatorsMapImpl>()) {
    // Register operators
@@ -211,6 +338,7 @@ RModelParser_ONNX::RModelParser_ONNX() noexcept : fOperatorsMapImpl(std::make_un
    RegisterOperator("Sigmoid", ParseSigmoid);
    RegisterOperator("Slice", ParseSlice);
    RegisterOperator("Softmax", ParseSoftmax);
+   RegisterOperator("LogSoftmax", ParseSoftmax);
    RegisterOperator("Tanh", ParseTanh);
    RegisterOperator("Transpose", ParseTranspose);
    RegisterOperator("MatMul", ParseMatMul);
@@ -302,16 +430,11 @@ RModelParser_ONNX::ParseOperator(const size_t i, const onnx::GraphProto &graphpr
          else {
             return ParseMatMul(*this, graphproto.node(idx));
          }
-      } else if (nodeproto.op_type() == "Conv" || nodeproto.op_type() == "ConvTranspose") {
-      // Fuse Conv or ConvTranspose without bias and Add
+      } else if (nodeproto.op_type() == "Conv") {
+      // Fuse Conv without bias and Add
          if (idx2 < graphproto.node_size() && graphproto.node(idx2).op_type() == "Add") {
-            if (nodeproto.op_type() == "Conv") {
-               fFusedOperators[idx2] = true;
-               return ParseFuseConvAdd(*this, graphproto.node(idx), graphproto.node(idx2));
-            } else {
-               fFusedOperators[idx2] = true;
-               return ParseFuseConvTransposeAdd(*this, graphproto.node(idx), graphproto.node(idx2));
-            }
+            fFusedOperators[idx2] = true;
+            return ParseFuseConvAdd(*this, graphproto.node(idx), graphproto.node(idx2));
          }
       } else if (nodeproto.op_type() == "Gemm") {
          // Fuse Gemm with activation operators
@@ -347,6 +470,26 @@ RModel RModelParser_ONNX::Parse(std::string filename, bool verbose)
 
    fTensorTypeMap.clear();
 
+   // get name of model (filename without directory name)
+   char sep = '/';
+#ifdef _WIN32
+   sep = '\\';
+#endif
+   size_t isep = filename.rfind(sep, filename.length());
+   std::string filename_nodir = filename;
+   if (isep != std::string::npos) {
+      filename_nodir = (filename.substr(isep + 1, filename.length() - isep));
+   }
+
+   // a model can be initialized only once: it is parsed again with the same operators when other initialized
+   // instances are needed (e.g. for generating code specialized for fixed batch sizes)
+   auto operators = std::make_shared<OperatorsMapImpl>(*fOperatorsMapImpl);
+   auto modelSource = [filename, operators]() {
+      RModelParser_ONNX parser;
+      *parser.fOperatorsMapImpl = *operators;
+      return parser.Parse(filename);
+   };
+
    auto model = LoadModel(filename);
    if (!model)
       throw std::runtime_error("TMVA::SOFIE - Failed to load onnx file " + filename);
@@ -358,19 +501,14 @@ RModel RModelParser_ONNX::Parse(std::string filename, bool verbose)
    std::tm *gmt_time = std::gmtime(&ttime);
    std::string parsetime(std::asctime(gmt_time));
 
-   // get name of model (filename without directory name)
-   char sep = '/';
-#ifdef _WIN32
-   sep = '\\';
-#endif
-   size_t isep = filename.rfind(sep, filename.length());
-   std::string filename_nodir = filename;
-   if (isep != std::string::npos) {
-      filename_nodir = (filename.substr(isep + 1, filename.length() - isep));
-   }
+   // external data are given relative to the directory of the model file
+   fModelDirectory = (isep != std::string::npos) ? filename.substr(0, isep) : std::string();
 
    RModel rmodel(filename_nodir, parsetime);
    ParseONNXGraph(rmodel, graph, filename_nodir);
+   rmodel.SetModelSource(modelSource);
+   // the initialized tensors keep the external data files they refer to
+   fExternalDataFiles.clear();
    return rmodel;
 }
 
@@ -380,7 +518,12 @@ std::unique_ptr<onnx::ModelProto> RModelParser_ONNX::LoadModel(std::string filen
    auto model = std::make_unique<onnx::ModelProto>();
 
    std::fstream input(filename, std::ios::in | std::ios::binary);
-   if (!model->ParseFromIstream(&input)) {
+   // raise the default protobuf limit on the message size to the maximum allowed (2GB).
+   // Larger models must store their initializers as external data
+   google::protobuf::io::IstreamInputStream zeroCopyInput(&input);
+   google::protobuf::io::CodedInputStream codedInput(&zeroCopyInput);
+   codedInput.SetTotalBytesLimit(INT_MAX);
+   if (!model->ParseFromCodedStream(&codedInput) || !codedInput.ConsumedEntireMessage()) {
       std::cerr << "TMVA::SOFIE - Failed to open onnx file " <<  filename << std::endl;
       return std::unique_ptr<onnx::ModelProto>();
    }
@@ -532,8 +675,6 @@ void RModelParser_ONNX::ParseONNXGraph(RModel & rmodel, const onnx::GraphProto &
       rmodel.AddInputTensorName(input_name); // store also names in given order
    }
 
-   std::map<std::string, int> allInitializedTensors;
-
    if (verbose)
       std::cout << "\nParsing graph initializer list and fill model initialized tensors" << std::endl;
 
@@ -556,34 +697,36 @@ void RModelParser_ONNX::ParseONNXGraph(RModel & rmodel, const onnx::GraphProto &
       // register also the initialized tensors
       auto tensor_type = static_cast<ETensorType>(graph.initializer(i).data_type());
       RegisterTensorType(input_name, tensor_type);
+      // data stored in a separate file next to the model
+      bool isExternal = (tensorproto->data_location() == onnx::TensorProto::EXTERNAL);
 
       switch (tensor_type) {
       case ETensorType::FLOAT: {
-         std::shared_ptr<void> data = GetInitializedTensorData<float>(tensorproto, fLength);
+         std::shared_ptr<void> data = isExternal ? GetExternalTensorData<float>(*tensorproto, fLength, fModelDirectory, fExternalDataFiles)
+                                                 : GetInitializedTensorData<float>(tensorproto, fLength);
          if (verbose) std::cout << "add FLOAT initialized tensor " << input_name << " shape " << ConvertShapeToString(shape) << std::endl;
          rmodel.AddInitializedTensor(input_name, ETensorType::FLOAT, shape, data);
-         allInitializedTensors[input_name] = i;
          break;
       }
       case ETensorType::DOUBLE: {
-         std::shared_ptr<void> data = GetInitializedTensorData<double>(tensorproto, fLength);
+         std::shared_ptr<void> data = isExternal ? GetExternalTensorData<double>(*tensorproto, fLength, fModelDirectory, fExternalDataFiles)
+                                                 : GetInitializedTensorData<double>(tensorproto, fLength);
          if (verbose) std::cout << "add DOUBLE initialized tensor " << input_name << " shape " << ConvertShapeToString(shape) << std::endl;
          rmodel.AddInitializedTensor(input_name, ETensorType::DOUBLE, shape, data);
-         allInitializedTensors[input_name] = i;
          break;
       }
       case ETensorType::INT32: {
-         std::shared_ptr<void> data = GetInitializedTensorData<int32_t>(tensorproto, fLength);
+         std::shared_ptr<void> data = isExternal ? GetExternalTensorData<int32_t>(*tensorproto, fLength, fModelDirectory, fExternalDataFiles)
+                                                 : GetInitializedTensorData<int32_t>(tensorproto, fLength);
          if (verbose) std::cout << "add INT32 initialized tensor " << input_name << " shape " << ConvertShapeToString(shape) << std::endl;
          rmodel.AddInitializedTensor(input_name, ETensorType::INT32, shape, data);
-         allInitializedTensors[input_name] = i;
          break;
       }
       case ETensorType::INT64: {
-         std::shared_ptr<void> data = GetInitializedTensorData<int64_t>(tensorproto, fLength);
+         std::shared_ptr<void> data = isExternal ? GetExternalTensorData<int64_t>(*tensorproto, fLength, fModelDirectory, fExternalDataFiles)
+                                                 : GetInitializedTensorData<int64_t>(tensorproto, fLength);
          if (verbose) std::cout << "add INT64 initialized tensor " << input_name << " shape " << ConvertShapeToString(shape) << std::endl;
          rmodel.AddInitializedTensor(input_name, ETensorType::INT64, shape, data);
-         allInitializedTensors[input_name] = i;
          break;
       }
       default:
@@ -609,88 +752,163 @@ void RModelParser_ONNX::ParseONNXGraph(RModel & rmodel, const onnx::GraphProto &
    // make order of nodes:
    if (verbose)
       std::cout << "\n***********************\nRe-Order graph operator list\n*************************\n";
+
+   // index of the node producing each tensor and of the nodes consuming it, built once and used both for
+   // ordering the nodes and for finding the children of each node when fusing operators
+   std::unordered_map<std::string, int> tensorProducer;
+   std::unordered_map<std::string, std::vector<int>> tensorConsumers;
+   for (int i = 0; i < graph.node_size(); i++) {
+      for (const auto &output_name : graph.node(i).output()) {
+         if (!output_name.empty())
+            tensorProducer[output_name] = i;
+      }
+   }
+   // number of inputs of each node not yet computed
+   std::vector<int> missingInputs(graph.node_size(), 0);
+   for (int i = 0; i < graph.node_size(); i++) {
+      for (const auto &input_name : graph.node(i).input()) {
+         // skip empty names
+         if (input_name.empty())
+            continue;
+         tensorConsumers[input_name].push_back(i);
+         if (tensorProducer.find(input_name) != tensorProducer.end()) {
+            missingInputs[i]++;
+         } else if (!IsRegisteredTensorType(input_name)) {
+            // not a graph input, an initializer or a tensor of an enclosing graph
+            std::cout << "cannot find input " << input_name << " of node " << graph.node(i).op_type() << " "
+                      << graph.node(i).name() << std::endl;
+            throw std::runtime_error("TMVA::SOFIE - cannot find input tensor " + input_name);
+         }
+      }
+   }
+
+   // Kahn's algorithm: a node is added as soon as all its inputs are computed. Among the nodes ready to be
+   // added the one with the smallest index is taken first, so that the ONNX order is kept when it is already
+   // a valid one
    std::vector<size_t> nodesOrder;
    nodesOrder.reserve(graph.node_size());
-   std::vector<bool> foundNodes(graph.node_size());
-
-   // loop at graph inputs
-   std::map<std::string, int> allInputs;
-   for (int i = 0; i < graph.input_size(); i++) {
-      allInputs[graph.input(i).name()] = -1;
+   std::priority_queue<int, std::vector<int>, std::greater<int>> readyNodes;
+   for (int i = 0; i < graph.node_size(); i++) {
+      if (missingInputs[i] == 0)
+         readyNodes.push(i);
+   }
+   while (!readyNodes.empty()) {
+      int i = readyNodes.top();
+      readyNodes.pop();
+      // adding node to the currectly ordered list
+      if (verbose)
+         std::cout << "===> New node " << graph.node(i).op_type() << "  " << graph.node(i).name() << " order " << i << std::endl;
+      nodesOrder.push_back(i);
+      for (const auto &output_name : graph.node(i).output()) {
+         if (fVerbose) std::cout << "\toutput : " << output_name << std::endl;
+         auto itc = tensorConsumers.find(output_name);
+         if (output_name.empty() || itc == tensorConsumers.end())
+            continue;
+         for (int j : itc->second) {
+            if (--missingInputs[j] == 0)
+               readyNodes.push(j);
+         }
+      }
    }
-   do {
-      auto psize = nodesOrder.size();
+   // remaining nodes depend on each other - something wrong
+   if ((int)nodesOrder.size() < graph.node_size()) {
       for (int i = 0; i < graph.node_size(); i++) {
-         if (foundNodes[i])
+         if (missingInputs[i] > 0) {
+            std::cout << "cannot order node " << graph.node(i).op_type() << " " << graph.node(i).name()
+                      << " : its inputs are in a cycle" << std::endl;
+            break;
+         }
+      }
+      throw std::runtime_error("TMVA::SOFIE - cannot find a new node ");
+   }
+
+   // common sub-expression elimination: a node with the same type, inputs and attributes as a previous one
+   // (e.g. the Shape/Gather/Unsqueeze patterns repeated by the exporters) is not parsed, and the following
+   // nodes use the outputs of the previous one instead. This is not done for graphs with sub-graphs, which
+   // can refer to the tensors of this graph, and for the random generators
+   std::vector<bool> duplicatedNodes(graph.node_size(), false);
+   bool hasSubGraphs = false;
+   for (const auto &node : graph.node()) {
+      for (const auto &attribute : node.attribute()) {
+         if (attribute.type() == onnx::AttributeProto::GRAPH || attribute.type() == onnx::AttributeProto::GRAPHS)
+            hasSubGraphs = true;
+      }
+   }
+   // the following nodes are parsed from a copy of the nodes with the inputs renamed, the ONNX graph is not modified
+   onnx::GraphProto renamedGraph;
+   const onnx::GraphProto *nodesGraph = &graph;
+   if (!hasSubGraphs) {
+      std::unordered_set<std::string> graphOutputs;
+      for (int i = 0; i < graph.output_size(); i++)
+         graphOutputs.insert(graph.output(i).name());
+      std::unordered_map<std::string, std::string> renamedTensors;
+      auto renamed = [&](const std::string &name) -> const std::string & {
+         auto itr = renamedTensors.find(name);
+         return (itr != renamedTensors.end()) ? itr->second : name;
+      };
+      std::unordered_map<std::string, int> nodeSignatures;
+      for (size_t k = 0; k < nodesOrder.size(); k++) {
+         int i = nodesOrder[k];
+         const auto &nodeproto = graph.node(i);
+         if (nodeproto.op_type().rfind("Random", 0) == 0)
             continue;
-         // check if all input exists add to list
-         bool existInputs = true;
-         int input_size = graph.node(i).input_size();
-         // special case for Reshape where shape is input and not a weight tensor
-         if (fVerbose)
-            std::cout << "Checking input of  Node " << i << " : " << graph.node(i).name() << std::endl;
-         for (int j = 0; j < input_size; j++) {
-            std::string name = graph.node(i).input(j);
-            // skip empty names
-            if (!name.empty()) {
-               existInputs &= (allInputs.find(name) != allInputs.end() ||
-                               allInitializedTensors.find(name) != allInitializedTensors.end());
-               if (fVerbose) {
-                  std::cout << "\t\t input " << name << " "
-                     << bool(allInputs.find(name) != allInputs.end()) << "  " <<
-                     bool(allInitializedTensors.find(name) != allInitializedTensors.end()) << "  " <<
-                     existInputs << std::endl;
-               }
-            }
+         std::string signature = nodeproto.domain() + "\n" + nodeproto.op_type() + "\n" +
+                                 std::to_string(nodeproto.output_size()) + "\n";
+         for (const auto &input_name : nodeproto.input())
+            signature += renamed(input_name) + "\n";
+         for (const auto &attribute : nodeproto.attribute())
+            signature += attribute.SerializeAsString();
+         auto inserted = nodeSignatures.emplace(signature, i);
+         if (inserted.second)
+            continue;
+         // the nodes computing graph outputs are kept
+         bool isGraphOutput = false;
+         for (const auto &output_name : nodeproto.output()) {
+            if (graphOutputs.count(output_name) > 0)
+               isGraphOutput = true;
          }
-         if (!existInputs) {
-            if (fVerbose) {
-               std::cout << "skip node " << graph.node(i).op_type() << "  " << graph.node(i).name() << " inputs are not existing ";
-               for (int j = 0; j < input_size; j++) {
-                  std::cout << graph.node(i).input(j) << " ";
-               }
-               std::cout << std::endl;
-            }
+         if (isGraphOutput)
             continue;
+         const auto &original = graph.node(inserted.first->second);
+         for (int j = 0; j < nodeproto.output_size(); j++) {
+            if (!nodeproto.output(j).empty())
+               renamedTensors[nodeproto.output(j)] = original.output(j);
          }
-
-         // adding node to the currectly ordered list
+         duplicatedNodes[i] = true;
+         std::string report = "removed duplicated node " + nodeproto.op_type() + " " + nodeproto.name() +
+                              " computing the same outputs as node " + original.name();
          if (verbose)
-            std::cout << "===> New node " << graph.node(i).op_type() << "  " << graph.node(i).name() << " order " << i << std::endl;
-
-         nodesOrder.push_back(i);
-         foundNodes[i] = true;
-         // register the outputs
-         for (int j = 0; j < graph.node(i).output_size(); j++) {
-            if (fVerbose) std::cout << "\toutput : " << graph.node(i).output(j) << std::endl;
-            allInputs[graph.node(i).output(j)] = i;
-         }
+            std::cout << report << std::endl;
+         rmodel.AddOptimizationReport(report);
       }
-      // no increment in nodes - something wrong
-      if (nodesOrder.size() == psize) {
-         int ilast = nodesOrder.back();
-         std::cout << "cannot find a new node after " << graph.node(ilast).op_type() << " " << graph.node(ilast).name() << std::endl;
-         throw std::runtime_error("TMVA::SOFIE - cannot find a new node ");
+      // the consumers of the removed nodes outputs have changed
+      if (!renamedTensors.empty()) {
+         *renamedGraph.mutable_node() = graph.node();
+         for (auto &nodeproto : *renamedGraph.mutable_node()) {
+            for (int j = 0; j < nodeproto.input_size(); j++)
+               nodeproto.set_input(j, renamed(nodeproto.input(j)));
+         }
+         nodesGraph = &renamedGraph;
+         tensorConsumers.clear();
+         for (int i = 0; i < graph.node_size(); i++) {
+            if (duplicatedNodes[i])
+               continue;
+            for (const auto &input_name : nodesGraph->node(i).input()) {
+               if (!input_name.empty())
+                  tensorConsumers[input_name].push_back(i);
+            }
+         }
       }
-   } while ((int)nodesOrder.size() < graph.node_size());
-
+   }
 
-   // find list of children for each operator (used for fusing oiperators)
+   // find list of children for each operator (used for fusing operators)
    std::vector<std::vector<int>> nodesChildren(graph.node_size());
-
-   for (int k = 0; k < graph.node_size(); k++) {
-      int i = nodesOrder[k];
-      // compute the number of output for the operators
-      if (graph.node(i).output_size() > 0) nodesChildren[i].reserve(graph.node(i).output_size());
-      for (const auto& output_name : graph.node(i).output()) {
-         // loop on all nodes
-         for (int l = k; l < graph.node_size(); l++) {
-            int j = nodesOrder[l];
-            for (const auto& input_name : graph.node(j).input()) {
-               if (input_name == output_name)
-                  nodesChildren[i].push_back(j);
-            }
-         }
+   for (int i = 0; i < graph.node_size(); i++) {
+      for (const auto &output_name : graph.node(i).output()) {
+         auto itc = tensorConsumers.find(output_name);
+         if (output_name.empty() || itc == tensorConsumers.end())
+            continue;
+         nodesChildren[i].insert(nodesChildren[i].end(), itc->second.begin(), itc->second.end());
       }
    }
 
@@ -722,7 +940,11 @@ void RModelParser_ONNX::ParseONNXGraph(RModel & rmodel, const onnx::GraphProto &
    // we have to record order of node execution separately to
    // account for fused operators
    size_t node_order_exec = 0;
-   fFusedOperators = std::vector<bool>(graph.node_size(), false);
+   // a sub-graph (e.g. of an If operator) is parsed while parsing its enclosing graph: keep the flags of the latter
+   std::vector<bool> enclosingFusedOperators;
+   std::swap(enclosingFusedOperators, fFusedOperators);
+   // the duplicated nodes are skipped as the fused ones
+   fFusedOperators = duplicatedNodes;
    for (int i = 0; i < graph.node_size(); i++) {
       std::string op_type = graph.node(nodesOrder[i]).op_type();
 
@@ -730,16 +952,17 @@ void RModelParser_ONNX::ParseONNXGraph(RModel & rmodel, const onnx::GraphProto &
          std::cout << "\t" << i << "  " << nodesOrder[i] << " parsing operator " << op_type << std::endl;
       }
 
-      std::unique_ptr<ROperator> op = ParseOperator(i, graph, nodesOrder, nodesChildren[i]);
+      std::unique_ptr<ROperator> op = ParseOperator(i, *nodesGraph, nodesOrder, nodesChildren[nodesOrder[i]]);
       if (!op) {
          if (verbose) {
-            std::cout << "\t\tskipping operator since it is fused with previous one" << std::endl;
+            std::cout << "\t\tskipping operator since it is fused with previous one or duplicated" << std::endl;
          }
          // for skipping the fused nodes like Add after MatMul
          continue;
       }
       rmodel.AddOperator(std::move(op), node_order_exec++);
    }
+   std::swap(enclosingFusedOperators, fFusedOperators);
 
    std::vector<std::string> outputnames;
    if (verbose)